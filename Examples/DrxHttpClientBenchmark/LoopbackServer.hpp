@@ -0,0 +1,674 @@
+/*
+ * LoopbackServer.hpp
+ * ==================
+ * DrxHttpClient 基准测试用的最小 HTTP/1.1 回环服务器 (127.0.0.1)。
+ *
+ * - Windows (Winsock) / Linux (BSD socket) 通用，便于两个后端用同一组场景对比吞吐
+ * - 每连接一个线程，支持 keep-alive、Content-Length 与 chunked 请求/响应
+ * - 路由由调用方通过 Handler 回调提供
+ * - 以 h2c 连接前言 (prior knowledge) 开头的连接按 HTTP/2 处理: 每条流在独立线程中调用 Handler，
+ *   遵循对端流控窗口。HPACK 只实现 DrxHttpClient 编码端用到的子集 (静态表索引 + 不入表的字面量，无 Huffman)
+ *
+ * 仅用于基准与回归验证，不适合作为生产服务器。
+ */
+
+#ifndef DRX_LOOPBACK_SERVER_HPP
+#define DRX_LOOPBACK_SERVER_HPP
+
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #pragma comment(lib, "ws2_32.lib")
+#else
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <arpa/inet.h>
+    #include <unistd.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+
+namespace drx_bench {
+
+#if defined(_WIN32)
+using socket_t = SOCKET;
+constexpr socket_t kInvalidSocket = INVALID_SOCKET;
+inline void close_socket(socket_t s) { closesocket(s); }
+#else
+using socket_t = int;
+constexpr socket_t kInvalidSocket = -1;
+inline void close_socket(socket_t s) { ::close(s); }
+#endif
+
+struct LoopbackRequest
+{
+    std::string                         method;
+    std::string                         path;      ///< 含 query
+    std::map<std::string, std::string>  headers;   ///< 名称已转小写
+    std::string                         body;
+
+    std::string header(const std::string& lowerName) const
+    {
+        auto it = headers.find(lowerName);
+        return it == headers.end() ? std::string() : it->second;
+    }
+};
+
+struct LoopbackResponse
+{
+    int                                              status = 200;
+    std::string                                      reason = "OK";
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string                                      body;
+    size_t                                           chunkSize = 0;      ///< > 0 时以 chunked 编码发送
+    bool                                             closeAfter = false; ///< 发送后关闭连接
+    size_t                                           bytesPerSecond = 0; ///< > 0 时按该速率分片发送 body，模拟单连接带宽上限
+    size_t                                           abortAfter = 0;     ///< > 0 时只发送这么多字节的 body 就断开，模拟断线
+};
+
+class LoopbackServer
+{
+public:
+    using Handler = std::function<void(const LoopbackRequest&, LoopbackResponse&)>;
+
+    explicit LoopbackServer(Handler handler) : handler_(std::move(handler))
+    {
+#if defined(_WIN32)
+        WSADATA wsa;
+        WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+    }
+
+    ~LoopbackServer()
+    {
+        stop();
+#if defined(_WIN32)
+        WSACleanup();
+#endif
+    }
+
+    LoopbackServer(const LoopbackServer&) = delete;
+    LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+    /// 绑定 127.0.0.1:port (0 = 随机端口)，返回实际端口
+    uint16_t start(uint16_t port = 0)
+    {
+        listen_ = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listen_ == kInvalidSocket) throw std::runtime_error("socket() failed");
+
+        int one = 1;
+        setsockopt(listen_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(listen_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listen_, 512) != 0)
+            throw std::runtime_error("bind/listen failed");
+
+        socklen_t len = sizeof(addr);
+        getsockname(listen_, reinterpret_cast<sockaddr*>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+
+        running_.store(true);
+        acceptThread_ = std::thread([this]() { accept_loop(); });
+        return port_;
+    }
+
+    void stop()
+    {
+        if (!running_.exchange(false)) return;
+#if defined(_WIN32)
+        closesocket(listen_);
+#else
+        ::shutdown(listen_, SHUT_RDWR);
+        ::close(listen_);
+#endif
+        if (acceptThread_.joinable()) acceptThread_.join();
+
+        std::vector<std::thread> workers;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            for (auto s : clients_) {
+#if defined(_WIN32)
+                ::shutdown(s, SD_BOTH);
+#else
+                ::shutdown(s, SHUT_RDWR);
+#endif
+            }
+            workers.swap(workers_);
+        }
+        for (auto& t : workers) if (t.joinable()) t.join();
+    }
+
+    uint16_t port() const { return port_; }
+    std::string baseUrl() const { return "http://127.0.0.1:" + std::to_string(port_); }
+
+    /// 已接受的 TCP 连接总数 (用于观察连接复用)
+    uint64_t acceptedConnections() const { return accepted_.load(); }
+
+    /// 以 HTTP/2 处理的请求 (流) 总数
+    uint64_t http2Streams() const { return h2Streams_.load(); }
+
+    /// 已处理的请求总数 (HTTP/1.1 与 HTTP/2)
+    uint64_t handledRequests() const { return handled_.load(); }
+
+private:
+    Handler                  handler_;
+    socket_t                 listen_ = kInvalidSocket;
+    uint16_t                 port_ = 0;
+    std::atomic<bool>        running_{false};
+    std::atomic<uint64_t>    accepted_{0};
+    std::atomic<uint64_t>    h2Streams_{0};
+    std::atomic<uint64_t>    handled_{0};
+    std::thread              acceptThread_;
+    std::mutex               mu_;
+    std::vector<socket_t>    clients_;
+    std::vector<std::thread> workers_;
+
+    void accept_loop()
+    {
+        while (running_.load()) {
+            socket_t s = ::accept(listen_, nullptr, nullptr);
+            if (s == kInvalidSocket) {
+                if (!running_.load()) break;
+                continue;
+            }
+            int one = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+            accepted_++;
+
+            std::lock_guard<std::mutex> lock(mu_);
+            clients_.push_back(s);
+            workers_.emplace_back([this, s]() {
+                serve(s);
+                std::lock_guard<std::mutex> lk(mu_);
+                clients_.erase(std::remove(clients_.begin(), clients_.end(), s), clients_.end());
+                close_socket(s);
+            });
+        }
+    }
+
+    static bool send_all(socket_t s, const char* p, size_t n)
+    {
+        while (n > 0) {
+#if defined(_WIN32)
+            int w = ::send(s, p, (int)std::min<size_t>(n, 1 << 30), 0);
+#else
+            ssize_t w = ::send(s, p, n, MSG_NOSIGNAL);
+#endif
+            if (w <= 0) return false;
+            p += w;
+            n -= (size_t)w;
+        }
+        return true;
+    }
+
+    static std::string lower(std::string s)
+    {
+        for (auto& c : s) c = (char)std::tolower((unsigned char)c);
+        return s;
+    }
+
+    // ──────── HTTP/2 (h2c prior knowledge) ────────
+
+    struct H2Stream
+    {
+        LoopbackRequest req;
+        std::string     block;          ///< 头块 (HEADERS + CONTINUATION)
+        int64_t         sendWindow = 0;
+        bool            endStream = false;
+        bool            reset = false;
+    };
+
+    struct H2Conn
+    {
+        socket_t                                   s;
+        std::mutex                                 mu;     ///< 保护写 socket 与以下状态
+        std::condition_variable                    cv;     ///< 发送窗口变化
+        std::map<uint32_t, std::shared_ptr<H2Stream>> streams;
+        int64_t                                    sendWindow = 65535;
+        int64_t                                    initialWindow = 65535;
+        size_t                                     maxFrame = 16384;
+        bool                                       closed = false;
+    };
+
+    static void put_frame(std::string& out, uint8_t type, uint8_t flags, uint32_t id, const char* p, size_t n)
+    {
+        const char head[9] = { (char)(n >> 16), (char)(n >> 8), (char)n, (char)type, (char)flags,
+                               (char)(id >> 24), (char)(id >> 16), (char)(id >> 8), (char)id };
+        out.append(head, 9);
+        if (n) out.append(p, n);
+    }
+
+    static void put_int(std::string& out, uint8_t flags, int prefixBits, size_t v)
+    {
+        size_t max = (1u << prefixBits) - 1;
+        if (v < max) { out.push_back((char)(flags | v)); return; }
+        out.push_back((char)(flags | max));
+        for (v -= max; v >= 128; v >>= 7) out.push_back((char)(0x80 | (v & 0x7f)));
+        out.push_back((char)v);
+    }
+
+    static void put_literal(std::string& block, const std::string& name, const std::string& value)
+    {
+        put_int(block, 0x00, 4, 0);
+        put_int(block, 0x00, 7, name.size());
+        block += name;
+        put_int(block, 0x00, 7, value.size());
+        block += value;
+    }
+
+    static size_t get_int(const std::string& b, size_t& pos, int prefixBits)
+    {
+        if (pos >= b.size()) throw std::runtime_error("hpack: truncated");
+        size_t max = (1u << prefixBits) - 1;
+        size_t v = (uint8_t)b[pos++] & max;
+        if (v < max) return v;
+        for (int shift = 0; ; shift += 7) {
+            if (pos >= b.size() || shift > 28) throw std::runtime_error("hpack: bad integer");
+            uint8_t c = (uint8_t)b[pos++];
+            v += (size_t)(c & 0x7f) << shift;
+            if (!(c & 0x80)) return v;
+        }
+    }
+
+    static std::string get_string(const std::string& b, size_t& pos)
+    {
+        if (pos >= b.size() || ((uint8_t)b[pos] & 0x80)) throw std::runtime_error("hpack: huffman not supported");
+        size_t n = get_int(b, pos, 7);
+        if (n > b.size() - pos) throw std::runtime_error("hpack: truncated");
+        pos += n;
+        return b.substr(pos - n, n);
+    }
+
+    static void decode_block(const std::string& b, LoopbackRequest& req)
+    {
+        static const char* const kStatic[61][2] = {
+            { ":authority", "" }, { ":method", "GET" }, { ":method", "POST" }, { ":path", "/" },
+            { ":path", "/index.html" }, { ":scheme", "http" }, { ":scheme", "https" }, { ":status", "200" },
+            { ":status", "204" }, { ":status", "206" }, { ":status", "304" }, { ":status", "400" },
+            { ":status", "404" }, { ":status", "500" }, { "accept-charset", "" }, { "accept-encoding", "gzip, deflate" },
+            { "accept-language", "" }, { "accept-ranges", "" }, { "accept", "" }, { "access-control-allow-origin", "" },
+            { "age", "" }, { "allow", "" }, { "authorization", "" }, { "cache-control", "" },
+            { "content-disposition", "" }, { "content-encoding", "" }, { "content-language", "" }, { "content-length", "" },
+            { "content-location", "" }, { "content-range", "" }, { "content-type", "" }, { "cookie", "" },
+            { "date", "" }, { "etag", "" }, { "expect", "" }, { "expires", "" },
+            { "from", "" }, { "host", "" }, { "if-match", "" }, { "if-modified-since", "" },
+            { "if-none-match", "" }, { "if-range", "" }, { "if-unmodified-since", "" }, { "last-modified", "" },
+            { "link", "" }, { "location", "" }, { "max-forwards", "" }, { "proxy-authenticate", "" },
+            { "proxy-authorization", "" }, { "range", "" }, { "referer", "" }, { "refresh", "" },
+            { "retry-after", "" }, { "server", "" }, { "set-cookie", "" }, { "strict-transport-security", "" },
+            { "transfer-encoding", "" }, { "user-agent", "" }, { "vary", "" }, { "via", "" },
+            { "www-authenticate", "" },
+        };
+        auto entry = [&](size_t index) {
+            if (index < 1 || index > 61) throw std::runtime_error("hpack: dynamic table not supported");
+            return kStatic[index - 1];
+        };
+
+        size_t pos = 0;
+        while (pos < b.size()) {
+            uint8_t c = (uint8_t)b[pos];
+            std::string name, value;
+            if (c & 0x80) {
+                auto e = entry(get_int(b, pos, 7));
+                name = e[0];
+                value = e[1];
+            } else if ((c & 0xe0) == 0x20) {
+                get_int(b, pos, 5);   // 动态表大小更新
+                continue;
+            } else {
+                if (c & 0x40) throw std::runtime_error("hpack: dynamic table not supported");
+                size_t index = get_int(b, pos, 4);
+                name = index ? entry(index)[0] : get_string(b, pos);
+                value = get_string(b, pos);
+            }
+            if (name == ":method") req.method = value;
+            else if (name == ":path") req.path = value;
+            else if (name[0] != ':') req.headers[name] = value;
+        }
+    }
+
+    /// 在窗口允许的范围内写 DATA，窗口耗尽时等待 WINDOW_UPDATE
+    static bool h2_send_body(H2Conn& conn, uint32_t id, H2Stream& st, const std::string& body)
+    {
+        std::unique_lock<std::mutex> lock(conn.mu);
+        size_t pos = 0;
+        do {
+            conn.cv.wait(lock, [&]() {
+                return conn.closed || st.reset || body.empty() || (conn.sendWindow > 0 && st.sendWindow > 0);
+            });
+            if (conn.closed || st.reset) return false;
+            size_t n = std::min<size_t>({ body.size() - pos, conn.maxFrame,
+                                          (size_t)std::max<int64_t>(conn.sendWindow, 0),
+                                          (size_t)std::max<int64_t>(st.sendWindow, 0) });
+            std::string out;
+            put_frame(out, 0x0, pos + n == body.size() ? 0x1 : 0x0, id, body.data() + pos, n);
+            conn.sendWindow -= (int64_t)n;
+            st.sendWindow -= (int64_t)n;
+            pos += n;
+            if (!send_all(conn.s, out.data(), out.size())) return false;
+        } while (pos < body.size());
+        return true;
+    }
+
+    void h2_respond(H2Conn& conn, uint32_t id, std::shared_ptr<H2Stream> st)
+    {
+        h2Streams_++;
+        LoopbackResponse resp;
+        handled_++;
+        handler_(st->req, resp);
+        if (st->req.method == "HEAD") resp.body.clear();
+
+        std::string block;
+        put_int(block, 0x00, 4, 8);   // :status (静态表名称索引 8)
+        put_int(block, 0x00, 7, std::to_string(resp.status).size());
+        block += std::to_string(resp.status);
+        for (auto& [k, v] : resp.headers) put_literal(block, lower(k), v);
+        put_literal(block, "content-length", std::to_string(resp.body.size()));
+
+        {
+            std::lock_guard<std::mutex> lock(conn.mu);
+            std::string out;
+            put_frame(out, 0x1, 0x4 | (resp.body.empty() ? 0x1 : 0x0), id, block.data(), block.size());
+            if (!send_all(conn.s, out.data(), out.size())) return;
+        }
+        if (!resp.body.empty()) h2_send_body(conn, id, *st, resp.body);
+
+        std::lock_guard<std::mutex> lock(conn.mu);
+        conn.streams.erase(id);
+    }
+
+    void serve_h2(socket_t s, std::string& buf)
+    {
+        H2Conn conn;
+        conn.s = s;
+        struct Worker
+        {
+            std::thread                        thread;
+            std::shared_ptr<std::atomic<bool>> finished;
+        };
+        std::vector<Worker> workers;
+        char tmp[64 * 1024];
+
+        {
+            std::string out;
+            const char settings[6] = { 0, 3, 0, 0, 1, 0 };   // MAX_CONCURRENT_STREAMS = 256
+            put_frame(out, 0x4, 0, 0, settings, sizeof(settings));
+            std::lock_guard<std::mutex> lock(conn.mu);
+            send_all(s, out.data(), out.size());
+        }
+
+        auto u32 = [](const char* p) {
+            return ((uint32_t)(uint8_t)p[0] << 24) | ((uint32_t)(uint8_t)p[1] << 16) | ((uint32_t)(uint8_t)p[2] << 8) | (uint8_t)p[3];
+        };
+        auto control = [&](uint8_t type, uint8_t flags, uint32_t id, const char* p, size_t n) {
+            std::string out;
+            put_frame(out, type, flags, id, p, n);
+            std::lock_guard<std::mutex> lock(conn.mu);
+            send_all(s, out.data(), out.size());
+        };
+        auto dispatch = [&](uint32_t id, std::shared_ptr<H2Stream> st) {
+            // 回收已结束的流线程，长连接上的线程数只随并发流数增长
+            for (auto it = workers.begin(); it != workers.end();) {
+                if (it->finished->load()) { it->thread.join(); it = workers.erase(it); }
+                else ++it;
+            }
+            auto finished = std::make_shared<std::atomic<bool>>(false);
+            workers.push_back({ std::thread([this, &conn, id, st, finished]() {
+                h2_respond(conn, id, st);
+                finished->store(true);
+            }), finished });
+        };
+
+        try {
+            while (running_.load()) {
+                while (buf.size() < 9) {
+                    int n = (int)::recv(s, tmp, sizeof(tmp), 0);
+                    if (n <= 0) throw std::runtime_error("closed");
+                    buf.append(tmp, (size_t)n);
+                }
+                size_t len = ((size_t)(uint8_t)buf[0] << 16) | ((size_t)(uint8_t)buf[1] << 8) | (uint8_t)buf[2];
+                while (buf.size() < 9 + len) {
+                    int n = (int)::recv(s, tmp, sizeof(tmp), 0);
+                    if (n <= 0) throw std::runtime_error("closed");
+                    buf.append(tmp, (size_t)n);
+                }
+                uint8_t type = (uint8_t)buf[3], flags = (uint8_t)buf[4];
+                uint32_t id = u32(buf.data() + 5) & 0x7fffffffu;
+                std::string payload = buf.substr(9, len);
+                buf.erase(0, 9 + len);
+
+                std::shared_ptr<H2Stream> st;
+                {
+                    std::lock_guard<std::mutex> lock(conn.mu);
+                    auto it = conn.streams.find(id);
+                    if (it != conn.streams.end()) st = it->second;
+                }
+
+                switch (type) {
+                    case 0x0:   // DATA: 收到即归还窗口
+                        if (st) st->req.body += payload;
+                        if (len) {
+                            char inc[4] = { (char)(len >> 24), (char)(len >> 16), (char)(len >> 8), (char)len };
+                            control(0x8, 0, 0, inc, 4);
+                            if (!(flags & 0x1)) control(0x8, 0, id, inc, 4);
+                        }
+                        if (st && (flags & 0x1)) dispatch(id, st);
+                        break;
+                    case 0x1:   // HEADERS
+                    case 0x9: { // CONTINUATION
+                        if (type == 0x1) {
+                            st = std::make_shared<H2Stream>();
+                            std::lock_guard<std::mutex> lock(conn.mu);
+                            st->sendWindow = conn.initialWindow;
+                            conn.streams[id] = st;
+                        }
+                        if (!st) throw std::runtime_error("CONTINUATION without HEADERS");
+                        size_t off = 0, pad = 0;
+                        if (type == 0x1) {
+                            if (flags & 0x8) { pad = (uint8_t)payload[0]; off = 1; }
+                            if (flags & 0x20) off += 5;
+                            st->endStream = (flags & 0x1) != 0;
+                        }
+                        st->block.append(payload, off, payload.size() - off - pad);
+                        if (flags & 0x4) {
+                            decode_block(st->block, st->req);
+                            st->block.clear();
+                            if (st->endStream) dispatch(id, st);
+                        }
+                        break;
+                    }
+                    case 0x3:   // RST_STREAM
+                        if (st) {
+                            std::lock_guard<std::mutex> lock(conn.mu);
+                            st->reset = true;
+                            conn.cv.notify_all();
+                        }
+                        break;
+                    case 0x4:   // SETTINGS
+                        if (flags & 0x1) break;
+                        for (size_t i = 0; i + 6 <= payload.size(); i += 6) {
+                            uint16_t key = (uint16_t)(((uint8_t)payload[i] << 8) | (uint8_t)payload[i + 1]);
+                            uint32_t value = u32(payload.data() + i + 2);
+                            std::lock_guard<std::mutex> lock(conn.mu);
+                            if (key == 0x4) {
+                                for (auto& [sid, other] : conn.streams) other->sendWindow += (int64_t)value - conn.initialWindow;
+                                conn.initialWindow = value;
+                            } else if (key == 0x5) {
+                                conn.maxFrame = value;
+                            }
+                        }
+                        control(0x4, 0x1, 0, nullptr, 0);
+                        break;
+                    case 0x6:   // PING
+                        if (!(flags & 0x1)) control(0x6, 0x1, 0, payload.data(), payload.size());
+                        break;
+                    case 0x7:   // GOAWAY
+                        throw std::runtime_error("goaway");
+                    case 0x8: { // WINDOW_UPDATE
+                        int64_t inc = u32(payload.data()) & 0x7fffffffu;
+                        std::lock_guard<std::mutex> lock(conn.mu);
+                        if (id == 0) conn.sendWindow += inc;
+                        else if (st) st->sendWindow += inc;
+                        conn.cv.notify_all();
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+        } catch (...) {}
+
+        {
+            std::lock_guard<std::mutex> lock(conn.mu);
+            conn.closed = true;
+            conn.cv.notify_all();
+        }
+        ::shutdown(s, 2);   // SHUT_RDWR / SD_BOTH
+        for (auto& w : workers) w.thread.join();
+    }
+
+    void serve(socket_t s)
+    {
+        std::string buf;
+        char tmp[64 * 1024];
+
+        auto fill = [&]() -> bool {
+            int n = (int)::recv(s, tmp, sizeof(tmp), 0);
+            if (n <= 0) return false;
+            buf.append(tmp, (size_t)n);
+            return true;
+        };
+
+        while (running_.load()) {
+            size_t headEnd;
+            while ((headEnd = buf.find("\r\n\r\n")) == std::string::npos) {
+                if (!fill()) return;
+            }
+
+            if (buf.compare(0, 16, "PRI * HTTP/2.0\r\n") == 0) {
+                while (buf.size() < 24) { if (!fill()) return; }
+                buf.erase(0, 24);
+                serve_h2(s, buf);
+                return;
+            }
+
+            LoopbackRequest req;
+            {
+                std::string head = buf.substr(0, headEnd);
+                buf.erase(0, headEnd + 4);
+                size_t lineEnd = head.find("\r\n");
+                std::string requestLine = head.substr(0, lineEnd);
+                auto sp1 = requestLine.find(' ');
+                auto sp2 = requestLine.find(' ', sp1 + 1);
+                req.method = requestLine.substr(0, sp1);
+                req.path = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+
+                size_t pos = (lineEnd == std::string::npos) ? head.size() : lineEnd + 2;
+                while (pos < head.size()) {
+                    size_t e = head.find("\r\n", pos);
+                    if (e == std::string::npos) e = head.size();
+                    auto line = head.substr(pos, e - pos);
+                    pos = e + 2;
+                    auto c = line.find(':');
+                    if (c == std::string::npos) continue;
+                    auto v = line.substr(c + 1);
+                    while (!v.empty() && v.front() == ' ') v.erase(0, 1);
+                    req.headers[lower(line.substr(0, c))] = v;
+                }
+            }
+
+            if (lower(req.header("transfer-encoding")).find("chunked") != std::string::npos) {
+                while (true) {
+                    size_t e;
+                    while ((e = buf.find("\r\n")) == std::string::npos) { if (!fill()) return; }
+                    size_t size = std::stoul(buf.substr(0, e), nullptr, 16);
+                    buf.erase(0, e + 2);
+                    while (buf.size() < size + 2) { if (!fill()) return; }
+                    req.body.append(buf, 0, size);
+                    buf.erase(0, size + 2);
+                    if (size == 0) break;
+                }
+            } else {
+                size_t contentLength = 0;
+                auto cl = req.header("content-length");
+                if (!cl.empty()) contentLength = std::stoul(cl);
+                while (buf.size() < contentLength) { if (!fill()) return; }
+                req.body = buf.substr(0, contentLength);
+                buf.erase(0, contentLength);
+            }
+
+            LoopbackResponse resp;
+            handled_++;
+            handler_(req, resp);
+
+            bool close = resp.closeAfter || lower(req.header("connection")) == "close";
+            std::string out = "HTTP/1.1 " + std::to_string(resp.status) + " " + resp.reason + "\r\n";
+            for (auto& [k, v] : resp.headers) out += k + ": " + v + "\r\n";
+            if (resp.chunkSize > 0) out += "Transfer-Encoding: chunked\r\n";
+            else out += "Content-Length: " + std::to_string(resp.body.size()) + "\r\n";
+            if (close) out += "Connection: close\r\n";
+            out += "\r\n";
+
+            bool ok;
+            if (req.method == "HEAD") {
+                ok = send_all(s, out.data(), out.size());
+            } else if (resp.chunkSize > 0) {
+                ok = send_all(s, out.data(), out.size());
+                for (size_t off = 0; ok && off < resp.body.size(); off += resp.chunkSize) {
+                    size_t n = std::min(resp.chunkSize, resp.body.size() - off);
+                    char hex[32];
+                    int hn = snprintf(hex, sizeof(hex), "%zx\r\n", n);
+                    ok = send_all(s, hex, (size_t)hn) && send_all(s, resp.body.data() + off, n) && send_all(s, "\r\n", 2);
+                }
+                if (ok) ok = send_all(s, "0\r\n\r\n", 5);
+            } else if (resp.abortAfter > 0 && resp.abortAfter < resp.body.size()) {
+                send_all(s, out.data(), out.size());
+                send_all(s, resp.body.data(), resp.abortAfter);
+                return;
+            } else if (resp.bytesPerSecond > 0) {
+                ok = send_all(s, out.data(), out.size());
+                const size_t slice = std::max<size_t>(resp.bytesPerSecond / 100, 1024);
+                auto start = std::chrono::steady_clock::now();
+                for (size_t off = 0; ok && off < resp.body.size(); off += slice) {
+                    ok = send_all(s, resp.body.data() + off, std::min(slice, resp.body.size() - off));
+                    std::this_thread::sleep_until(start + std::chrono::microseconds(
+                        (long long)((off + slice) * 1e6 / resp.bytesPerSecond)));
+                }
+            } else if (resp.body.size() <= 64 * 1024) {
+                out += resp.body;
+                ok = send_all(s, out.data(), out.size());
+            } else {
+                ok = send_all(s, out.data(), out.size()) && send_all(s, resp.body.data(), resp.body.size());
+            }
+            if (!ok || close) return;
+        }
+    }
+};
+
+} // namespace drx_bench
+
+#endif // DRX_LOOPBACK_SERVER_HPP
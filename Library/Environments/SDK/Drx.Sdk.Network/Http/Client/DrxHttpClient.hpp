@@ -1,11 +1,15 @@
 ﻿/*
- * DrxHttpClient.hpp  v2.0
+ * DrxHttpClient.hpp  v2.1
  * ========================
  * C++ Header-Only HTTP Client — 对应 C# DrxHttpClient 的等价实现。
  *
- * 依赖: WinHTTP (Windows 系统自带), BCrypt (SHA256)
- * 编译: 链接 winhttp.lib, bcrypt.lib  (MSVC: #pragma comment 已内置)
- * 标准: C++17
+ * 依赖: Windows — WinHTTP (系统自带), BCrypt (SHA256)
+ *       Linux   — POSIX socket + epoll (内置 HTTP/1.1 解析器与 HTTP/2 帧层), iconv (glibc，只用于生成 CJK 代码页查找表)
+ *                 HTTPS 需定义 DRX_HTTP_ENABLE_OPENSSL 并链接 -lssl -lcrypto
+ *       可选压缩 — DRX_HTTP_ENABLE_ZLIB (gzip / deflate, -lz)、DRX_HTTP_ENABLE_BROTLI (br, -lbrotlidec -lbrotlienc)、
+ *                 DRX_HTTP_ENABLE_ZSTD (zstd, -lzstd)，两个平台通用
+ * 编译: Windows 链接 winhttp.lib, bcrypt.lib  (MSVC: #pragma comment 已内置)
+ * 标准: C++17 (C++20 下额外提供协程接口)
  *
  * v2.0 改进:
  *   - RAII WinHTTP / BCrypt handle 管理（杜绝泄漏）
@@ -21,16 +25,51 @@
  *   - boundary RNG 改用 random_device + thread_local
  *   - 响应 body 延迟生成 (bodyAsString)
  *   - downloadFileWithMetadata 文件创建失败检查
+ *
+ * v2.1 改进:
+ *   - Linux 传输后端 (非阻塞 socket + epoll + 内置 HTTP/1.1 解析器)，API 与 WinHTTP 后端一致
+ *   - 按 (scheme, host, port) 复用 keep-alive 连接的连接池 (setConnectionPoolOptions / getConnectionPoolStats)
+ *   - 请求队列改为固定工作线程池 + 有界无锁 MPMC 队列，enqueue 背压 / tryEnqueue / getQueueStats
+ *   - 事件驱动异步引擎 sendAsync (future / 回调)：Windows 为 WinHTTP 异步模式，Linux 为单线程 epoll 事件循环
+ *   - C++20 协程接口 (getAsync / downloadFileAsync / connectSseAsync + Task / 执行器)，C++17 下自动关闭
+ *   - 批量请求 sendBatch：按 origin 分组、多连接车道复用，结果按提交顺序返回，整批共享截止时间与取消令牌
+ *   - 可选 HTTP/2 (setHttpVersion)：Windows 使用 WinHTTP 自带 h2，Linux 内置 h2/h2c 帧层 + HPACK，同 origin 并发请求多路复用并按流控窗口收发
+ *   - 可选请求合并 (setCoalescingOptions)：并发的相同 GET / HEAD 共享一次往返，sendShared / getShared 返回同一响应对象，getCoalescingStats 统计命中
+ *   - 可选响应缓存 (setCacheOptions)：内存 LRU + 磁盘目录，遵循 Cache-Control / Expires / Vary，ETag / Last-Modified 自动验证，stale-while-revalidate 后台刷新，getCacheStats 统计命中率与节省字节
+ *   - 同步读取响应体按 Content-Length 预分配并直接读入最终位置，sendInto / getInto 复用调用方的响应缓冲
+ *   - 流式响应 sendStreaming / getStreaming：收到响应头即返回，BodyReader 以 read / chunks() 按需拉取 body，读完归还连接、提前销毁则关闭
+ *   - 文件上传改为流式: multipart body 由内存段与文件段拼成 detail::BodyStream 按块发出 (POSIX 复用接收缓冲区，WinHTTP 用 WinHttpWriteData)，文件不再整体读入内存，进度按实际写出回调，上传中可取消
+ *   - 新增 BodySource (fromFile / fromMemory / fromString / then) 供 send / post / put 使用: Linux 明文 HTTP 经 sendfile 零拷贝发送文件，TLS 与 WinHTTP 下改用内存映射；multipart 上传的文件段同样受益
+ *   - 新增 downloadFileSegmented / SegmentedDownloadOptions: Range 探测后预分配临时文件，多连接并行取回区间并按偏移写入，连接数按吞吐自适应，带 If-Range 检测资源变化，不支持区间时退化为单流
+ *   - downloadFile / downloadFileWithMetadata 断点续传 (Range + If-Range，.download.meta 记录进度)，重试从断点继续；discardPartialDownload 清理
+ *   - downloadFileWithHash / downloadFileWithMetadata 边下载边计算摘要 (独立线程流水线)，不再回读文件；可选 SHA-256 / SHA-1 / XXH3，校验失败不替换目标文件
+ *   - 跨平台 detail::Sha256 引擎: 运行时选择 SHA-NI / ARMv8 指令，Windows 回退到进程内缓存的 BCrypt provider；sha256_batch 为短消息提供 AVX2 8 路多缓冲
+ *   - 透明内容编码 (setCompressionOptions): 自动声明 Accept-Encoding，send / sendAsync / sendStreaming / downloadToStream / SSE 按 gzip / deflate / br / zstd 边收边解压；
+ *     可选按大小阈值压缩请求体；HttpResponse::compression / getCompressionStats 报告压缩前后字节与编解码 CPU 时间
+ *   - SSE 解析器重写为增量状态机: SIMD 扫描行尾 (\r\n / \r / \n)，字段写入复用缓冲区，connectSseView 以 SseEventView 零拷贝回调
+ *   - subscribeSse 托管订阅: 断线后按服务器 retry: 与抖动退避自动重连，携带 Last-Event-ID 续传，SseSubscriptionStats 统计重连次数与断线时长
+ *   - Headers 改为扁平容器: 名称 / 值存放在同一块内联缓冲区，插入时计算大小写不敏感哈希，保留插入顺序与同名多值 (Set-Cookie)；传输层直接解析进 Headers
+ *   - 客户端配置 (默认头、超时、重试、Session 名称、日志回调等) 改为不可变快照整体发布，请求路径一次 acquire load 读取、不再加锁；默认头发布时预先序列化
+ *   - Cookie 存储按 RFC 6265 重写: 按可注册域名分片加锁，Domain / Path / Secure 匹配，Max-Age / Expires 过期清理，每个 origin 的 Cookie 头缓存到存储变化为止；
+ *     exportCookies / importCookies 携带 Expires 并与 C# 的 Domain 写法一致
+ *   - saveCookies / loadCookies 二进制 Cookie 快照: 内存映射加载，按可注册域名在首次使用时解码；importCookies 改为单遍 JSON 解析 (正确处理转义与嵌套值)
+ *   - 响应体字符集解码: 合法 UTF-8 经 SIMD 校验后不再转码，bodyView 零拷贝返回并缓存转码结果；代码页改为进程内查找表解码 (UTF-16 / Latin-1 / 1252 内置，CJK 由系统转换器一次生成)，Windows 与 Linux 一致
  */
 
 #ifndef DRX_HTTP_CLIENT_HPP
 #define DRX_HTTP_CLIENT_HPP
 
 // ─── Platform ──────────────────────────────────────────────────────────────
-#ifndef _WIN32
-    #error "DrxHttpClient.hpp requires Windows (WinHTTP)"
+#if defined(_WIN32)
+    #define DRX_HTTP_BACKEND_WINHTTP 1
+#elif defined(__linux__)
+    #define DRX_HTTP_BACKEND_POSIX 1
+#else
+    #error "DrxHttpClient.hpp requires Windows (WinHTTP) or Linux (epoll)"
 #endif
 
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+
 #ifndef WIN32_LEAN_AND_MEAN
     #define WIN32_LEAN_AND_MEAN
 #endif
@@ -47,16 +86,49 @@
 #pragma comment(lib, "winhttp.lib")
 #pragma comment(lib, "bcrypt.lib")
 
+#else // DRX_HTTP_BACKEND_POSIX
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <iconv.h>
+#include <time.h>
+#include <cerrno>
+#include <cstring>
+
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+    #include <openssl/ssl.h>
+    #include <openssl/err.h>
+    #include <openssl/x509v3.h>
+#endif
+
+#endif
+
 // ─── Standard Library ──────────────────────────────────────────────────────
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
 #include <functional>
 #include <fstream>
 #include <sstream>
 #include <mutex>
 #include <thread>
-#include <queue>
 #include <condition_variable>
 #include <atomic>
 #include <algorithm>
@@ -68,6 +140,76 @@
 #include <cassert>
 #include <memory>
 #include <cctype>
+#include <cstring>
+#include <string_view>
+#include <optional>
+#include <array>
+#include <system_error>
+#include <future>
+#include <exception>
+#include <utility>
+
+// ─── C++20 协程 (可选) ─────────────────────────────────────────────────────
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+    #if __has_include(<coroutine>)
+        #include <coroutine>
+        #include <optional>
+        #define DRX_HTTP_HAS_COROUTINES 1
+    #endif
+#endif
+
+// ─── C++20 std::span (可选) ────────────────────────────────────────────────
+#if defined(__has_include)
+    #if __has_include(<version>)
+        #include <version>
+    #endif
+#endif
+#if defined(__cpp_lib_span)
+    #include <span>
+    #define DRX_HTTP_HAS_SPAN 1
+#endif
+
+// ─── SIMD (SHA-256 指令运行时检测；SSE2 / NEON 行扫描) ──────────────────────────────────────
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #define DRX_HTTP_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #define DRX_HTTP_NEON 1
+    #include <arm_neon.h>
+    #if defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO) || defined(_M_ARM64)
+        #define DRX_HTTP_ARM_SHA2 1
+    #endif
+#endif
+#if defined(DRX_HTTP_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define DRX_HTTP_SSE2 1
+#endif
+
+// ─── 压缩编解码器 (可选，按编译开关启用) ──────────────────────────────────
+#if defined(DRX_HTTP_ENABLE_ZLIB)
+    #include <zlib.h>
+#endif
+#if defined(DRX_HTTP_ENABLE_BROTLI)
+    #include <brotli/decode.h>
+    #include <brotli/encode.h>
+#endif
+#if defined(DRX_HTTP_ENABLE_ZSTD)
+    #include <zstd.h>
+#endif
+#if defined(DRX_HTTP_ENABLE_ZLIB) || defined(DRX_HTTP_ENABLE_BROTLI) || defined(DRX_HTTP_ENABLE_ZSTD)
+    #define DRX_HTTP_HAS_COMPRESSION 1
+#endif
+
+/// 单个函数启用额外指令集 (GCC / Clang)，调用前须确认 CPU 支持；MSVC 的内建函数无需编译开关
+#if defined(__GNUC__) || defined(__clang__)
+    #define DRX_HTTP_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define DRX_HTTP_TARGET(isa)
+#endif
 
 namespace drx { namespace sdk { namespace network { namespace http {
 
@@ -75,11 +217,483 @@ namespace drx { namespace sdk { namespace network { namespace http {
 //  Forward Declarations & Types
 // ═══════════════════════════════════════════════════════════════════════════
 
-using Headers     = std::map<std::string, std::string>;
 using QueryParams = std::map<std::string, std::string>;
 
 namespace detail {
-std::string decode_body_to_utf8(const std::vector<uint8_t>& bodyBytes, const Headers& headers);
+
+/// 平凡类型的小缓冲: 不超过 N 个元素时存放在对象内部，超出后整体搬到堆上 (按 2 倍增长)
+template <class T, size_t N>
+class SmallBuffer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SmallBuffer requires a trivially copyable type");
+
+public:
+    SmallBuffer() = default;
+    SmallBuffer(const SmallBuffer& other) { append(other.data(), other.size_); }
+    SmallBuffer(SmallBuffer&& other) noexcept { take(other); }
+    SmallBuffer& operator=(const SmallBuffer& other)
+    {
+        if (this != &other) {
+            size_ = 0;
+            append(other.data(), other.size_);
+        }
+        return *this;
+    }
+    SmallBuffer& operator=(SmallBuffer&& other) noexcept
+    {
+        if (this != &other) take(other);
+        return *this;
+    }
+
+    T*       data()       { return heap_ ? heap_.get() : inline_; }
+    const T* data() const { return heap_ ? heap_.get() : inline_; }
+    size_t   size() const { return size_; }
+    size_t   capacity() const { return heap_ ? capacity_ : N; }
+
+    T&       operator[](size_t i)       { return data()[i]; }
+    const T& operator[](size_t i) const { return data()[i]; }
+
+    void reserve(size_t n)
+    {
+        if (n <= capacity()) return;
+        size_t grown = std::max(n, capacity() * 2);
+        std::unique_ptr<T[]> next(new T[grown]);
+        if (size_) std::memcpy(next.get(), data(), size_ * sizeof(T));
+        heap_ = std::move(next);
+        capacity_ = grown;
+    }
+
+    /// 源数据不能位于本缓冲区内 (扩容后失效)
+    void append(const T* src, size_t n)
+    {
+        if (n == 0) return;
+        reserve(size_ + n);
+        std::memcpy(data() + size_, src, n * sizeof(T));
+        size_ += n;
+    }
+
+    void push_back(const T& value) { append(&value, 1); }
+
+    /// 删除 [first, first + n)，其后的元素前移
+    void erase(size_t first, size_t n)
+    {
+        std::memmove(data() + first, data() + first + n, (size_ - first - n) * sizeof(T));
+        size_ -= n;
+    }
+
+    void resize(size_t n) { reserve(n); size_ = n; }
+    void clear() { size_ = 0; }   // 保留已分配的堆内存
+
+private:
+    void take(SmallBuffer& other)
+    {
+        if (other.heap_) {
+            heap_ = std::move(other.heap_);
+            capacity_ = other.capacity_;
+        } else {
+            heap_.reset();
+            if (other.size_) std::memcpy(inline_, other.inline_, other.size_ * sizeof(T));
+        }
+        size_ = other.size_;
+        other.size_ = 0;
+    }
+
+    T                    inline_[N];
+    std::unique_ptr<T[]> heap_;
+    size_t               size_ = 0;
+    size_t               capacity_ = 0;
+};
+
+} // namespace detail
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  请求 / 响应头
+// ═══════════════════════════════════════════════════════════════════════════
+
+/// 请求 / 响应头集合: 保持插入顺序，同名头可有多个值 (如 Set-Cookie)，名称大小写不敏感。
+/// 名称与值连续存放在同一块缓冲区，一般的响应头不需要堆分配；每项只记偏移、长度与插入时算好的名称哈希，
+/// 查找先比较哈希再比较名称。
+/// 迭代与 std::map<std::string, std::string> 一样得到 std::pair<std::string, std::string> (复制)；
+/// 不需要复制时用 fields() 迭代 std::pair<std::string_view, std::string_view>，视图在下一次修改前有效
+class Headers
+{
+public:
+    using value_type = std::pair<std::string, std::string>;
+    using field_type = std::pair<std::string_view, std::string_view>;
+
+    /// 前向迭代器。Value 为 value_type 时复制当前项 (复用上一项的容量)，为 field_type 时只给出视图
+    template <class Value>
+    class basic_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = Value;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const Value*;
+        using reference         = const Value&;
+
+        basic_iterator() = default;
+        const Value& operator*() const { return current_; }
+        const Value* operator->() const { return &current_; }
+        basic_iterator& operator++() { ++index_; load(); return *this; }
+        basic_iterator operator++(int) { auto copy = *this; ++*this; return copy; }
+        bool operator==(const basic_iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const basic_iterator& other) const { return index_ != other.index_; }
+
+    private:
+        friend class Headers;
+        basic_iterator(const Headers* owner, size_t index) : owner_(owner), index_(index) { load(); }
+        void load()
+        {
+            if (!owner_ || index_ >= owner_->entries_.size()) return;
+            if constexpr (std::is_same_v<Value, field_type>) {
+                current_ = owner_->field(index_);
+            } else {
+                current_.first.assign(owner_->name_at(index_));
+                current_.second.assign(owner_->value_at(index_));
+            }
+        }
+
+        const Headers* owner_ = nullptr;
+        size_t         index_ = 0;
+        Value          current_;
+    };
+    using const_iterator = basic_iterator<value_type>;
+    using iterator       = const_iterator;
+    using field_iterator = basic_iterator<field_type>;
+
+    /// fields() 的返回值，供 range-for 使用
+    class FieldRange
+    {
+    public:
+        field_iterator begin() const { return field_iterator(owner_, 0); }
+        field_iterator end() const { return field_iterator(owner_, owner_->entries_.size()); }
+    private:
+        friend class Headers;
+        explicit FieldRange(const Headers* owner) : owner_(owner) {}
+        const Headers* owner_;
+    };
+
+    /// h["Name"] = value 等价于 set；读取时得到第一个值 (不存在为空，且不会插入)
+    class ValueRef
+    {
+    public:
+        ValueRef& operator=(std::string_view value) { owner_.set(name_, value); return *this; }
+        ValueRef& operator=(const ValueRef& other) { return *this = other.view(); }
+        std::string_view view() const { return owner_.get(name_); }
+        std::string str() const { return std::string(view()); }
+        operator std::string_view() const { return view(); }
+        operator std::string() const { return str(); }
+        bool empty() const { return view().empty(); }
+        size_t size() const { return view().size(); }
+        bool operator==(std::string_view value) const { return view() == value; }
+        bool operator!=(std::string_view value) const { return view() != value; }
+        friend std::ostream& operator<<(std::ostream& os, const ValueRef& ref) { return os << ref.view(); }
+
+    private:
+        friend class Headers;
+        ValueRef(Headers& owner, std::string_view name) : owner_(owner), name_(name) {}
+        Headers&         owner_;
+        std::string_view name_;
+    };
+
+    Headers() = default;
+    Headers(std::initializer_list<field_type> init)
+    {
+        for (const auto& kv : init) add(kv.first, kv.second);
+    }
+
+    // ── 查找 ──
+
+    const_iterator find(std::string_view name) const { return const_iterator(this, index_of(name, 0)); }
+    bool contains(std::string_view name) const { return index_of(name, 0) < entries_.size(); }
+
+    /// 同名值的个数 (std::map 兼容: 0 / 1 的判断照常可用)
+    size_t count(std::string_view name) const
+    {
+        size_t n = 0;
+        for (size_t i = index_of(name, 0); i < entries_.size(); i = index_of(name, i + 1)) ++n;
+        return n;
+    }
+
+    /// 第一个值，不存在时为空
+    std::string_view get(std::string_view name) const
+    {
+        size_t i = index_of(name, 0);
+        return i < entries_.size() ? value_at(i) : std::string_view();
+    }
+
+    /// 第一个值 (复制)，不存在时抛出 std::out_of_range
+    std::string at(std::string_view name) const
+    {
+        size_t i = index_of(name, 0);
+        if (i >= entries_.size()) throw std::out_of_range("Headers::at: " + std::string(name));
+        return std::string(value_at(i));
+    }
+
+    /// 可赋值的第一个值: h.at("Name") = value 等价于 set；不存在时抛出 std::out_of_range
+    ValueRef at(std::string_view name)
+    {
+        if (!contains(name)) throw std::out_of_range("Headers::at: " + std::string(name));
+        return ValueRef(*this, name);
+    }
+
+    /// 全部同名值，按插入顺序
+    std::vector<std::string_view> getAll(std::string_view name) const
+    {
+        std::vector<std::string_view> out;
+        for (size_t i = index_of(name, 0); i < entries_.size(); i = index_of(name, i + 1)) out.push_back(value_at(i));
+        return out;
+    }
+
+    // ── 修改 ──
+
+    /// 追加一项，保留已有的同名项
+    void add(std::string_view name, std::string_view value)
+    {
+        if (inside(name) || inside(value)) {   // 参数指向本集合 (扩容会使其失效)
+            add(std::string(name), std::string(value));
+            return;
+        }
+        Entry e;
+        e.hash = hash_name(name);
+        e.nameOff = (uint32_t)arena_.size();
+        e.nameLen = (uint32_t)name.size();
+        append_arena(name);
+        e.valueOff = (uint32_t)arena_.size();
+        e.valueLen = (uint32_t)value.size();
+        append_arena(value);
+        entries_.push_back(e);
+    }
+
+    /// 替换全部同名项为一个值 (位置取第一个同名项)；不存在时追加
+    void set(std::string_view name, std::string_view value)
+    {
+        if (inside(name) || inside(value)) {
+            set(std::string(name), std::string(value));
+            return;
+        }
+        size_t i = index_of(name, 0);
+        if (i >= entries_.size()) {
+            add(name, value);
+            return;
+        }
+        for (size_t j = index_of(name, i + 1); j < entries_.size(); j = index_of(name, j)) remove_at(j);
+        replace_value(i, value);
+    }
+
+    /// 删除全部同名项，返回删除的个数
+    size_t erase(std::string_view name)
+    {
+        if (inside(name)) return erase(std::string(name));
+        size_t n = 0;
+        for (size_t i = index_of(name, 0); i < entries_.size(); i = index_of(name, i)) { remove_at(i); ++n; }
+        return n;
+    }
+
+    const_iterator erase(const_iterator it)
+    {
+        remove_at(it.index_);
+        return const_iterator(this, it.index_);
+    }
+
+    /// 在最后一项的值后追加 (解析 obs-fold 续行)
+    void appendToLast(std::string_view extra)
+    {
+        if (entries_.size() == 0) return;
+        std::string value(value_at(entries_.size() - 1));
+        value += extra;
+        replace_value(entries_.size() - 1, value);
+    }
+
+    ValueRef operator[](std::string_view name) { return ValueRef(*this, name); }
+
+    void reserve(size_t fields, size_t bytes = 0)
+    {
+        entries_.reserve(fields);
+        arena_.reserve(bytes);
+    }
+
+    void clear()
+    {
+        entries_.clear();
+        arena_.clear();
+        garbage_ = 0;
+    }
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.size() == 0; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, entries_.size()); }
+
+    /// 按插入顺序迭代名称 / 值视图，不复制
+    FieldRange fields() const { return FieldRange(this); }
+
+    /// 按 "Name: value\r\n" 逐行追加到 out
+    void serialize(std::string& out) const
+    {
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            out.append(name_at(i));
+            out.append(": ", 2);
+            out.append(value_at(i));
+            out.append("\r\n", 2);
+        }
+    }
+
+    /// 名称的大小写不敏感哈希 (FNV-1a，按 ASCII 小写)
+    static uint32_t hash_name(std::string_view name)
+    {
+        uint32_t h = 2166136261u;
+        for (unsigned char c : name) {
+            if (c >= 'A' && c <= 'Z') c = (unsigned char)(c + 32);
+            h = (h ^ c) * 16777619u;
+        }
+        return h;
+    }
+
+private:
+    struct Entry
+    {
+        uint32_t hash;
+        uint32_t nameOff;
+        uint32_t nameLen;
+        uint32_t valueOff;
+        uint32_t valueLen;
+    };
+
+    static constexpr size_t kInlineFields = 16;
+    static constexpr size_t kInlineBytes  = 512;
+
+    std::string_view name_at(size_t i) const  { return { arena_.data() + entries_[i].nameOff, entries_[i].nameLen }; }
+    std::string_view value_at(size_t i) const { return { arena_.data() + entries_[i].valueOff, entries_[i].valueLen }; }
+    field_type field(size_t i) const { return { name_at(i), value_at(i) }; }
+
+    static bool iequals_ascii(std::string_view a, std::string_view b)
+    {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i) {
+            unsigned char x = (unsigned char)a[i], y = (unsigned char)b[i];
+            if (x == y) continue;
+            if ((x | 0x20) != (y | 0x20) || (x | 0x20) < 'a' || (x | 0x20) > 'z') return false;
+        }
+        return true;
+    }
+
+    /// 从 start 起第一个同名项的下标，没有时返回 size()
+    size_t index_of(std::string_view name, size_t start) const
+    {
+        uint32_t h = hash_name(name);
+        for (size_t i = start; i < entries_.size(); ++i)
+            if (entries_[i].hash == h && iequals_ascii(name_at(i), name)) return i;
+        return entries_.size();
+    }
+
+    bool inside(std::string_view text) const
+    {
+        auto p = reinterpret_cast<std::uintptr_t>(text.data());
+        auto base = reinterpret_cast<std::uintptr_t>(arena_.data());
+        return !text.empty() && p >= base && p < base + arena_.size();
+    }
+
+    void append_arena(std::string_view text)
+    {
+        if (arena_.size() + text.size() > UINT32_MAX) throw std::length_error("Headers: too large");
+        arena_.append(text.data(), text.size());
+    }
+
+    /// 新值写到缓冲区末尾，旧值成为空洞；空洞超过一半时整体压缩
+    void replace_value(size_t i, std::string_view value)
+    {
+        auto& e = entries_[i];
+        if (value.size() <= e.valueLen) {
+            std::memmove(arena_.data() + e.valueOff, value.data(), value.size());
+            garbage_ += e.valueLen - value.size();
+            e.valueLen = (uint32_t)value.size();
+        } else {
+            std::string copy(value);   // value 可能指向本缓冲区
+            garbage_ += e.valueLen;
+            uint32_t off = (uint32_t)arena_.size();
+            append_arena(copy);
+            entries_[i].valueOff = off;
+            entries_[i].valueLen = (uint32_t)copy.size();
+        }
+        compact_if_sparse();
+    }
+
+    void remove_at(size_t i)
+    {
+        garbage_ += entries_[i].nameLen + entries_[i].valueLen;
+        entries_.erase(i, 1);
+        compact_if_sparse();
+    }
+
+    void compact_if_sparse()
+    {
+        if (garbage_ < 256 || garbage_ * 2 < arena_.size()) return;
+        detail::SmallBuffer<char, kInlineBytes> packed;
+        packed.reserve(arena_.size() - garbage_);
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            auto& e = entries_[i];
+            uint32_t nameOff = (uint32_t)packed.size();
+            packed.append(arena_.data() + e.nameOff, e.nameLen);
+            uint32_t valueOff = (uint32_t)packed.size();
+            packed.append(arena_.data() + e.valueOff, e.valueLen);
+            e.nameOff = nameOff;
+            e.valueOff = valueOff;
+        }
+        arena_ = std::move(packed);
+        garbage_ = 0;
+    }
+
+    detail::SmallBuffer<Entry, kInlineFields> entries_;
+    detail::SmallBuffer<char, kInlineBytes>   arena_;
+    size_t                                    garbage_ = 0;   ///< arena_ 中不再被引用的字节
+};
+
+namespace detail {
+/// HttpResponse 解码结果的缓存。首次读取时解码并以 CAS 发布，之后并发读取只做一次 acquire load。
+/// 已是 UTF-8 时结果直接指向 bodyBytes，以地址、长度、开头 4 字节 (BOM) 与 Content-Type 为键；
+/// 转码结果另存一份源字节，每次读取都与 bodyBytes 比较，长度不变的原地改写也会触发重新解码。
+/// 复制得到空缓存，移动时随 bodyBytes 一起转移
+class DecodedBody
+{
+public:
+    DecodedBody() = default;
+    DecodedBody(const DecodedBody&) noexcept {}
+    DecodedBody(DecodedBody&& other) noexcept : entry_(other.entry_.exchange(nullptr, std::memory_order_acq_rel)) {}
+    DecodedBody& operator=(const DecodedBody& other) noexcept
+    {
+        if (this != &other) reset();
+        return *this;
+    }
+    DecodedBody& operator=(DecodedBody&& other) noexcept
+    {
+        if (this != &other) delete entry_.exchange(other.entry_.exchange(nullptr, std::memory_order_acq_rel), std::memory_order_acq_rel);
+        return *this;
+    }
+    ~DecodedBody() { reset(); }
+
+    void reset() noexcept { delete entry_.exchange(nullptr, std::memory_order_acq_rel); }
+
+    /// bytes 的 UTF-8 视图: 已是 UTF-8 时指向 bytes 本身，否则指向缓存的转码结果
+    std::string_view get(const std::vector<uint8_t>& bytes, const Headers& headers) const;
+
+private:
+    struct Entry
+    {
+        const uint8_t* data = nullptr;
+        size_t         size = 0;
+        uint8_t        prefix[4] = {};      ///< bodyBytes 开头 (BOM 决定偏移与编码)
+        std::string    contentType;
+        std::string    source;              ///< borrowed == false 时解码所用的源字节
+        bool           borrowed = true;     ///< true: 结果为 bytes[offset, offset + length)
+        size_t         offset = 0;
+        size_t         length = 0;
+        std::string    text;                ///< borrowed == false 时的转码结果
+    };
+
+    mutable std::atomic<Entry*> entry_{ nullptr };
+};
 }
 
 /// 进度回调: (已传输字节, 总字节 —— 若未知则 total == -1)
@@ -109,6 +723,50 @@ private:
     std::shared_ptr<std::atomic<bool>> cancelled_;
 };
 
+// ═══════════════════════════════════════════════════════════════════════════
+//  内容编码 (压缩)
+// ═══════════════════════════════════════════════════════════════════════════
+
+/// 响应透明解压与请求体压缩。可用的编解码器由编译开关决定 (见文件头)，一个都未启用时本设置不起作用
+struct CompressionOptions
+{
+    bool        decompressResponses = true;     ///< 自动发送 Accept-Encoding (只列出已启用的编码) 并流式解压响应体
+    size_t      requestMinBytes     = 0;        ///< 请求体达到该字节数时压缩后发送，0 = 不压缩请求体 (须确认服务器支持)
+    std::string requestEncoding     = "gzip";   ///< 请求体编码: gzip / deflate / br / zstd
+    int         level               = -1;       ///< 压缩级别，-1 = 默认 (zlib 6、br 5、zstd 3)
+    /// 只压缩 Content-Type 含其中任一项 (大小写不敏感) 的请求体；已压缩的格式 (图片、zip 等) 再压缩没有收益
+    std::vector<std::string> compressibleTypes = { "text/", "json", "xml", "javascript", "x-www-form-urlencoded" };
+};
+
+/// 单个请求 / 响应的编解码统计
+struct CompressionInfo
+{
+    std::string encoding;                   ///< 已解压的响应编码，空 = 响应未压缩 (或未经解压)
+    uint64_t    compressedBytes   = 0;      ///< 线上收到的压缩 body 字节
+    uint64_t    decompressedBytes = 0;      ///< 解压后交给调用方的字节
+    double      decodeCpuMs       = 0;      ///< 解压消耗的线程 CPU 时间
+    std::string requestEncoding;            ///< 请求体编码，空 = 未压缩
+    uint64_t    requestBytes      = 0;      ///< 压缩前的请求体字节
+    uint64_t    requestWireBytes  = 0;      ///< 压缩后实际发送的字节
+    double      encodeCpuMs       = 0;      ///< 压缩消耗的线程 CPU 时间
+};
+
+/// 客户端累计的编解码统计 (getCompressionStats)
+struct CompressionStats
+{
+    uint64_t responsesDecoded  = 0;
+    uint64_t compressedBytes   = 0;
+    uint64_t decompressedBytes = 0;
+    double   decodeCpuMs       = 0;
+    uint64_t requestsEncoded   = 0;
+    uint64_t requestBytes      = 0;
+    uint64_t requestWireBytes  = 0;
+    double   encodeCpuMs       = 0;
+
+    /// 解压后字节 / 线上字节
+    double responseRatio() const { return compressedBytes ? (double)decompressedBytes / (double)compressedBytes : 0.0; }
+};
+
 // ═══════════════════════════════════════════════════════════════════════════
 //  HttpResponse
 // ═══════════════════════════════════════════════════════════════════════════
@@ -119,17 +777,26 @@ struct HttpResponse
     std::vector<uint8_t>    bodyBytes;       ///< 原始响应体
     Headers                 headers;         ///< 响应头
     std::string             reasonPhrase;    ///< e.g. "OK", "Not Found"
+    CompressionInfo         compression;     ///< 请求体压缩与响应解压统计 (已解压时 headers 不再含 Content-Encoding / Content-Length)
 
     bool ok() const { return statusCode >= 200 && statusCode < 300; }
 
+    /// 响应体的 UTF-8 视图，不复制: 响应体已是 UTF-8 / ASCII 时直接指向 bodyBytes，
+    /// 其他字符集 (BOM 或 Content-Type charset) 转码一次后缓存，bodyBytes (含原地改写) / Content-Type 变化后自动重新解码。
+    /// 视图在 response 被修改或销毁前有效；多线程可同时读取 (如 sendShared 共享的响应)
+    std::string_view bodyView() const { return bodyCache.get(bodyBytes, headers); }
+
     /// 按需转为 UTF-8 字符串（避免双存储）
-    std::string bodyAsString() const
-    {
-        return detail::decode_body_to_utf8(bodyBytes, headers);
-    }
+    std::string bodyAsString() const { return std::string(bodyView()); }
 
     /// 兼容旧代码的 body 字段 —— 调用 bodyAsString()
     std::string body() const { return bodyAsString(); }
+
+    /// 释放缓存的解码结果 (只影响内存占用，改写 bodyBytes 后无需调用)
+    void clearBodyCache() { bodyCache.reset(); }
+
+    /// bodyView() 的解码缓存，内部使用。放在最后并保持公开，HttpResponse 仍可按旧字段顺序聚合初始化；复制时不复制缓存
+    detail::DecodedBody     bodyCache;
 };
 
 // ═══════════════════════════════════════════════════════════════════════════
@@ -154,16 +821,26 @@ struct Cookie
 {
     std::string name;
     std::string value;
-    std::string domain;
+    std::string domain;                 ///< 小写主机名；以 '.' 开头时视为域 Cookie (hostOnly = false)
     std::string path = "/";
     bool        secure   = false;
     bool        httpOnly = false;
+    bool        hostOnly = false;       ///< 只发给 domain 本身 (Set-Cookie 未带 Domain 属性)
+    int64_t     expires  = 0;           ///< 到期时间 (Unix 秒)，0 = 会话 Cookie
 };
 
 // ═══════════════════════════════════════════════════════════════════════════
 //  DownloadResult
 // ═══════════════════════════════════════════════════════════════════════════
 
+/// 下载时边接收边计算的摘要算法。Xxh3 为非密码学哈希，只适合检测损坏
+enum class HashAlgorithm
+{
+    Sha256,
+    Sha1,
+    Xxh3,
+};
+
 struct DownloadResult
 {
     int         statusCode      = 0;
@@ -177,6 +854,15 @@ struct DownloadResult
     Headers     serverMetadata;
 };
 
+/// 分段 (多 Range 并行) 下载参数。并发数从 initialSegments 起步，吞吐仍有明显提升时逐个增加到 maxSegments
+struct SegmentedDownloadOptions
+{
+    size_t  initialSegments = 2;                   ///< 起始并发的区间请求数
+    size_t  maxSegments     = 8;                   ///< 并发区间请求上限 (每个占一条连接)
+    int64_t chunkSize       = 8 * 1024 * 1024;     ///< 每个区间请求的字节数，空闲连接依次领取下一段
+    int     sampleMs        = 500;                 ///< 吞吐采样间隔，据此决定是否再加一条连接
+};
+
 // ═══════════════════════════════════════════════════════════════════════════
 //  SSE Event
 // ═══════════════════════════════════════════════════════════════════════════
@@ -189,6 +875,59 @@ struct SseEvent
     int         retry = -1;
 };
 
+/// SseEvent 的零拷贝视图 (connectSseView / detail::SseParser)，指向解析器内部复用的缓冲区，
+/// 只在回调期间有效；需要保留时用 toEvent() / copyTo() 复制
+struct SseEventView
+{
+    std::string_view event;     ///< 未设置时为 "message"
+    std::string_view data;      ///< 多行用 \n 连接
+    std::string_view id;        ///< 最近一次收到的 id (跨事件保留，即 Last-Event-ID)
+    int              retry = -1;
+
+    SseEvent toEvent() const
+    {
+        SseEvent ev;
+        copyTo(ev);
+        return ev;
+    }
+
+    /// 复制到已有对象，沿用其字符串容量 (逐事件复用同一个 SseEvent 时不再分配)
+    void copyTo(SseEvent& out) const
+    {
+        out.event.assign(event.data(), event.size());
+        out.data.assign(data.data(), data.size());
+        out.id.assign(id.data(), id.size());
+        out.retry = retry;
+    }
+};
+
+/// 托管 SSE 订阅 (subscribeSse) 的累计统计
+struct SseSubscriptionStats
+{
+    uint64_t    connects       = 0;     ///< 成功建立 (200) 的连接数
+    uint64_t    reconnects     = 0;     ///< 其中断线后的重连次数
+    uint64_t    failedAttempts = 0;     ///< 连接失败或可重试的错误状态码
+    uint64_t    events         = 0;
+    std::string lastEventId;            ///< 最近一次收到的 id，重连时作为 Last-Event-ID 发送
+    int         retryMs        = -1;    ///< 服务器最近一次建议的重连间隔，-1 = 未收到
+    double      lastGapMs      = 0;     ///< 最近一次断线到重新连上的时长
+    double      totalGapMs     = 0;
+    double      maxGapMs       = 0;
+};
+
+/// 托管 SSE 订阅的重连参数。每次断线后等待 基础间隔 × backoffFactor^连续失败次数 (不超过 maxDelayMs)，
+/// 再随机浮动 ±jitter；基础间隔优先用服务器 retry: 的值。收到过事件的连接断开不算失败
+struct SseReconnectOptions
+{
+    int         initialDelayMs = 3000;  ///< 服务器未发送 retry: 时的基础间隔
+    int         maxDelayMs     = 60000;
+    double      backoffFactor  = 2.0;
+    double      jitter         = 0.2;   ///< 0 ~ 1，避免大量客户端在服务器重启后同时重连
+    int         maxAttempts    = -1;    ///< 连续失败次数上限，超过后抛出；-1 = 不限
+    std::string lastEventId;            ///< 首次连接即携带的 Last-Event-ID (从上次保存的位置继续)
+    std::function<void(const SseSubscriptionStats&)> onReconnect;   ///< 每次重连成功后回调
+};
+
 // ═══════════════════════════════════════════════════════════════════════════
 //  重试策略
 // ═══════════════════════════════════════════════════════════════════════════
@@ -205,45 +944,176 @@ struct RetryPolicy
 };
 
 // ═══════════════════════════════════════════════════════════════════════════
-//  Internal Helpers
+//  连接池
 // ═══════════════════════════════════════════════════════════════════════════
 
-namespace detail {
-
-// ──────── RAII WinHTTP Handle ────────
+/// 连接池参数 (按 scheme + host + port 复用 keep-alive 连接)
+struct ConnectionPoolOptions
+{
+    bool   enabled               = true;
+    size_t maxIdlePerHost        = 8;       ///< 每个主机保留的空闲连接上限
+    size_t maxIdleTotal          = 64;      ///< 全部主机空闲连接总上限
+    size_t maxConnectionsPerHost = 32;      ///< 每个主机同时打开的连接上限 (0 = 不限)
+    int    idleTimeoutMs         = 60000;   ///< 空闲超过该时长的连接被淘汰
+};
 
-class WinHttpHandle
+/// 连接池计数 (累计值 + 当前快照)
+struct ConnectionPoolStats
 {
-public:
-    WinHttpHandle() = default;
-    explicit WinHttpHandle(HINTERNET h) : h_(h) {}
-    ~WinHttpHandle() { close(); }
+    uint64_t hits    = 0;   ///< 复用了空闲连接
+    uint64_t misses  = 0;   ///< 新建连接
+    uint64_t evicted = 0;   ///< 因空闲超时或容量上限被关闭的空闲连接
+    uint64_t stale   = 0;   ///< 复用前健康检查失败 (对端已关闭) 而丢弃的连接
+    size_t   idle    = 0;   ///< 当前空闲连接数
+    size_t   active  = 0;   ///< 当前使用中的连接数
+};
 
-    WinHttpHandle(const WinHttpHandle&) = delete;
-    WinHttpHandle& operator=(const WinHttpHandle&) = delete;
+// ═══════════════════════════════════════════════════════════════════════════
+//  HTTP 协议版本
+// ═══════════════════════════════════════════════════════════════════════════
 
-    WinHttpHandle(WinHttpHandle&& o) noexcept : h_(o.h_) { o.h_ = nullptr; }
-    WinHttpHandle& operator=(WinHttpHandle&& o) noexcept { close(); h_ = o.h_; o.h_ = nullptr; return *this; }
+/// 请求使用的 HTTP 版本 (默认 HTTP/1.1)。HTTP/2 下同一 origin 的并发请求作为多条流复用同一条连接。
+/// 配置了代理时始终使用 HTTP/1.1。
+enum class HttpVersion
+{
+    Http1_1,               ///< 只用 HTTP/1.1
+    Http2,                 ///< https:// 通过 ALPN 协商 h2，服务器不支持时回退 HTTP/1.1；http:// 仍为 HTTP/1.1
+    Http2PriorKnowledge,   ///< 同 Http2，另外 http:// 直接以 h2c (prior knowledge) 发送 (仅 Linux 后端)
+};
 
-    HINTERNET get() const { return h_; }
-    explicit operator bool() const { return h_ != nullptr; }
-    HINTERNET release() { auto tmp = h_; h_ = nullptr; return tmp; }
-    void reset(HINTERNET h = nullptr) { close(); h_ = h; }
+// ═══════════════════════════════════════════════════════════════════════════
+//  请求队列统计
+// ═══════════════════════════════════════════════════════════════════════════
 
-private:
-    HINTERNET h_ = nullptr;
-    void close() { if (h_) { WinHttpCloseHandle(h_); h_ = nullptr; } }
+struct QueueStats
+{
+    size_t   depth         = 0;   ///< 当前排队中的请求数
+    size_t   capacity      = 0;   ///< 队列容量 (2 的幂)
+    int      workers       = 0;   ///< 工作线程数
+    int      activeWorkers = 0;   ///< 正在执行请求的工作线程数
+    uint64_t enqueued      = 0;   ///< 累计入队
+    uint64_t completed     = 0;   ///< 累计完成
+    uint64_t rejected      = 0;   ///< tryEnqueue 因队列满 / 超时被拒绝的次数
+    double   avgWaitMs     = 0;   ///< 入队到开始执行的平均等待时间
+    double   maxWaitMs     = 0;   ///< 最大等待时间
 };
 
-// ──────── RAII BCrypt Handles ────────
+// ═══════════════════════════════════════════════════════════════════════════
+//  批量请求
+// ═══════════════════════════════════════════════════════════════════════════
 
-class BcryptAlg
+struct BatchOptions
 {
-public:
-    BcryptAlg() = default;
-    ~BcryptAlg() { if (h_) BCryptCloseAlgorithmProvider(h_, 0); }
-    BcryptAlg(const BcryptAlg&) = delete;
-    BcryptAlg& operator=(const BcryptAlg&) = delete;
+    int    timeoutMs            = 0;   ///< 整批共享的截止时间，从调用 sendBatch 起算 (0 = 不限)
+    size_t connectionsPerOrigin = 4;   ///< 每个 origin 同时在途的请求数 (即复用的连接数，不超过连接池的 maxIdlePerHost)
+};
+
+/// sendBatch 的单项结果: error 为空表示成功
+struct BatchResult
+{
+    HttpResponse response;
+    std::string  error;
+
+    bool ok() const { return error.empty(); }
+};
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  请求合并 (singleflight)
+// ═══════════════════════════════════════════════════════════════════════════
+
+/// 并发的相同 GET / HEAD 请求只发出一次，所有调用方共享同一个响应
+struct CoalescingOptions
+{
+    bool                     enabled = false;
+    /// 参与合并键的请求头 (名称大小写不敏感)；方法与完整 URL 总是参与
+    std::vector<std::string> varyHeaders = { "Authorization", "Cookie", "Accept", "Accept-Encoding", "Accept-Language" };
+};
+
+struct CoalescingStats
+{
+    uint64_t leaders   = 0;   ///< 实际发出网络请求的调用
+    uint64_t coalesced = 0;   ///< 共享了在途请求结果、没有发出网络请求的调用
+    size_t   inFlight  = 0;   ///< 当前在途的合并请求数
+};
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  响应缓存
+// ═══════════════════════════════════════════════════════════════════════════
+
+/// 客户端私有 HTTP 缓存 (RFC 9111)：内存 LRU + 可选磁盘目录，只缓存 GET
+struct HttpCacheOptions
+{
+    bool        enabled            = false;
+    size_t      maxMemoryBytes     = 32 * 1024 * 1024;   ///< 内存缓存字节预算 (响应体 + 响应头)
+    size_t      maxEntryBytes      = 4 * 1024 * 1024;    ///< 超过此大小的响应不缓存
+    std::string diskPath;                                ///< 非空时同时写入该目录，内存淘汰后仍可命中
+    uint64_t    maxDiskBytes       = 256ull * 1024 * 1024;
+    bool        heuristicFreshness = true;               ///< 无显式过期信息时按 Last-Modified 的 10% 估算新鲜期
+};
+
+struct HttpCacheStats
+{
+    uint64_t hits        = 0;   ///< 新鲜命中，未发出请求
+    uint64_t staleHits   = 0;   ///< stale-while-revalidate 窗口内直接返回旧响应 (后台刷新)
+    uint64_t revalidated = 0;   ///< 条件请求得到 304，响应体取自缓存
+    uint64_t misses      = 0;   ///< 发出完整请求 (无缓存、不可用或内容已变化)
+    uint64_t stores      = 0;
+    uint64_t evictions   = 0;   ///< 因内存预算被淘汰的条目
+    uint64_t bytesSaved  = 0;   ///< 由缓存提供、未经网络传输的响应体字节
+    size_t   entries     = 0;
+    size_t   memoryBytes = 0;
+    uint64_t diskBytes   = 0;
+
+    /// (hits + staleHits + revalidated) / 全部经过缓存的 GET
+    double hitRatio() const
+    {
+        uint64_t total = hits + staleHits + revalidated + misses;
+        return total ? (double)(hits + staleHits + revalidated) / (double)total : 0.0;
+    }
+};
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  Internal Helpers
+// ═══════════════════════════════════════════════════════════════════════════
+
+namespace detail {
+
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+
+// ──────── RAII WinHTTP Handle ────────
+
+class WinHttpHandle
+{
+public:
+    WinHttpHandle() = default;
+    explicit WinHttpHandle(HINTERNET h) : h_(h) {}
+    ~WinHttpHandle() { close(); }
+
+    WinHttpHandle(const WinHttpHandle&) = delete;
+    WinHttpHandle& operator=(const WinHttpHandle&) = delete;
+
+    WinHttpHandle(WinHttpHandle&& o) noexcept : h_(o.h_) { o.h_ = nullptr; }
+    WinHttpHandle& operator=(WinHttpHandle&& o) noexcept { close(); h_ = o.h_; o.h_ = nullptr; return *this; }
+
+    HINTERNET get() const { return h_; }
+    explicit operator bool() const { return h_ != nullptr; }
+    HINTERNET release() { auto tmp = h_; h_ = nullptr; return tmp; }
+    void reset(HINTERNET h = nullptr) { close(); h_ = h; }
+
+private:
+    HINTERNET h_ = nullptr;
+    void close() { if (h_) { WinHttpCloseHandle(h_); h_ = nullptr; } }
+};
+
+// ──────── RAII BCrypt Handles ────────
+
+class BcryptAlg
+{
+public:
+    BcryptAlg() = default;
+    ~BcryptAlg() { if (h_) BCryptCloseAlgorithmProvider(h_, 0); }
+    BcryptAlg(const BcryptAlg&) = delete;
+    BcryptAlg& operator=(const BcryptAlg&) = delete;
 
     NTSTATUS open(LPCWSTR algId) { return BCryptOpenAlgorithmProvider(&h_, algId, nullptr, 0); }
     BCRYPT_ALG_HANDLE get() const { return h_; }
@@ -287,16 +1157,25 @@ inline std::string to_utf8(const std::wstring& ws)
     return s;
 }
 
+#else
+
+// POSIX 下沿用 Win32 的代码页编号表示字符集
+using UINT = unsigned int;
+constexpr UINT CP_ACP  = 0;
+constexpr UINT CP_UTF8 = 65001;
+
+#endif
+
 // ──────── 字符串辅助 ────────
 
-inline std::string to_lower(const std::string& s)
+inline std::string to_lower(std::string_view s)
 {
-    std::string out = s;
+    std::string out(s);
     std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return (char)std::tolower(c); });
     return out;
 }
 
-inline bool iequals(const std::string& a, const std::string& b)
+inline bool iequals(std::string_view a, std::string_view b)
 {
     if (a.size() != b.size()) return false;
     for (size_t i = 0; i < a.size(); ++i)
@@ -304,7 +1183,7 @@ inline bool iequals(const std::string& a, const std::string& b)
     return true;
 }
 
-inline std::string trim_copy(const std::string& s)
+inline std::string_view trim_view(std::string_view s)
 {
     size_t begin = 0;
     while (begin < s.size() && std::isspace((unsigned char)s[begin])) ++begin;
@@ -313,12 +1192,11 @@ inline std::string trim_copy(const std::string& s)
     return s.substr(begin, end - begin);
 }
 
-inline std::string get_header_ci(const Headers& headers, const std::string& name)
+inline std::string trim_copy(std::string_view s) { return std::string(trim_view(s)); }
+
+inline std::string get_header_ci(const Headers& headers, std::string_view name)
 {
-    for (const auto& kv : headers) {
-        if (iequals(kv.first, name)) return kv.second;
-    }
-    return {};
+    return std::string(headers.get(name));
 }
 
 inline std::string extract_charset_from_content_type(const std::string& contentType)
@@ -405,7 +1283,8 @@ inline CharsetSpec parse_charset_codepage(const std::string& charset)
     if (n == "utf16" || n == "utf16le" || n == "ucs2" || n == "unicode") return { CharsetKind::Utf16Le, 0 };
     if (n == "utf16be") return { CharsetKind::Utf16Be, 0 };
 
-    if (n == "gbk" || n == "gb2312" || n == "gb18030" || n == "cp936" || n == "ms936") return { CharsetKind::CodePage, 936 };
+    if (n == "gb18030") return { CharsetKind::CodePage, 54936 };
+    if (n == "gbk" || n == "gb2312" || n == "cp936" || n == "ms936") return { CharsetKind::CodePage, 936 };
     if (n == "big5" || n == "cp950") return { CharsetKind::CodePage, 950 };
     if (n == "latin1" || n == "iso88591") return { CharsetKind::CodePage, 28591 };
     if (n == "windows1252" || n == "cp1252") return { CharsetKind::CodePage, 1252 };
@@ -421,108 +1300,23 @@ inline CharsetSpec parse_charset_codepage(const std::string& charset)
     return spec;
 }
 
-inline bool bytes_to_utf8_via_codepage(const std::vector<uint8_t>& bytes, UINT codePage, bool strictUtf8, std::string& out)
-{
-    out.clear();
-    if (bytes.empty()) return true;
-
-    DWORD flags = (strictUtf8 && codePage == CP_UTF8) ? MB_ERR_INVALID_CHARS : 0;
-
-    int wlen = MultiByteToWideChar(codePage,
-                                   flags,
-                                   reinterpret_cast<const char*>(bytes.data()),
-                                   (int)bytes.size(),
-                                   nullptr,
-                                   0);
-    if (wlen <= 0) return false;
-
-    std::wstring ws((size_t)wlen, 0);
-    if (MultiByteToWideChar(codePage,
-                            flags,
-                            reinterpret_cast<const char*>(bytes.data()),
-                            (int)bytes.size(),
-                            ws.data(),
-                            wlen) <= 0) {
-        return false;
-    }
-
-    int u8len = WideCharToMultiByte(CP_UTF8, 0, ws.data(), (int)ws.size(), nullptr, 0, nullptr, nullptr);
-    if (u8len <= 0) return false;
-
-    out.assign((size_t)u8len, 0);
-    if (WideCharToMultiByte(CP_UTF8, 0, ws.data(), (int)ws.size(), out.data(), u8len, nullptr, nullptr) <= 0) {
-        out.clear();
-        return false;
-    }
-    return true;
-}
-
-inline bool utf16_bytes_to_utf8(const std::vector<uint8_t>& bytes, bool bigEndian, std::string& out)
-{
-    out.clear();
-    if (bytes.empty()) return true;
-    if ((bytes.size() % 2) != 0) return false;
-
-    std::wstring ws;
-    ws.resize(bytes.size() / 2);
-
-    for (size_t i = 0, j = 0; i + 1 < bytes.size(); i += 2, ++j) {
-        uint16_t cu = bigEndian
-            ? (uint16_t)(((uint16_t)bytes[i] << 8) | (uint16_t)bytes[i + 1])
-            : (uint16_t)(((uint16_t)bytes[i + 1] << 8) | (uint16_t)bytes[i]);
-        ws[j] = (wchar_t)cu;
-    }
-
-    int u8len = WideCharToMultiByte(CP_UTF8, 0, ws.data(), (int)ws.size(), nullptr, 0, nullptr, nullptr);
-    if (u8len <= 0) return false;
-
-    out.assign((size_t)u8len, 0);
-    if (WideCharToMultiByte(CP_UTF8, 0, ws.data(), (int)ws.size(), out.data(), u8len, nullptr, nullptr) <= 0) {
-        out.clear();
-        return false;
-    }
-    return true;
-}
-
-inline std::string decode_body_to_utf8(const std::vector<uint8_t>& bodyBytes, const Headers& headers)
+inline void append_utf8(std::string& out, uint32_t cp)
 {
-    if (bodyBytes.empty()) return {};
-
-    std::string out;
-
-    // 1) BOM 优先
-    if (bodyBytes.size() >= 3 && bodyBytes[0] == 0xEF && bodyBytes[1] == 0xBB && bodyBytes[2] == 0xBF) {
-        std::vector<uint8_t> payload(bodyBytes.begin() + 3, bodyBytes.end());
-        if (bytes_to_utf8_via_codepage(payload, CP_UTF8, false, out)) return out;
-    }
-    if (bodyBytes.size() >= 2 && bodyBytes[0] == 0xFF && bodyBytes[1] == 0xFE) {
-        std::vector<uint8_t> payload(bodyBytes.begin() + 2, bodyBytes.end());
-        if (utf16_bytes_to_utf8(payload, false, out)) return out;
-    }
-    if (bodyBytes.size() >= 2 && bodyBytes[0] == 0xFE && bodyBytes[1] == 0xFF) {
-        std::vector<uint8_t> payload(bodyBytes.begin() + 2, bodyBytes.end());
-        if (utf16_bytes_to_utf8(payload, true, out)) return out;
-    }
-
-    // 2) Content-Type charset
-    auto contentType = get_header_ci(headers, "Content-Type");
-    auto charset = extract_charset_from_content_type(contentType);
-    if (!charset.empty()) {
-        auto spec = parse_charset_codepage(charset);
-        if (spec.kind == CharsetKind::Utf16Le) {
-            if (utf16_bytes_to_utf8(bodyBytes, false, out)) return out;
-        } else if (spec.kind == CharsetKind::Utf16Be) {
-            if (utf16_bytes_to_utf8(bodyBytes, true, out)) return out;
-        } else if (spec.kind == CharsetKind::CodePage && spec.codePage != 0) {
-            if (bytes_to_utf8_via_codepage(bodyBytes, spec.codePage, false, out)) return out;
-        }
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
     }
-
-    // 3) 回退: UTF-8(严格) -> ACP -> 原始字节
-    if (bytes_to_utf8_via_codepage(bodyBytes, CP_UTF8, true, out)) return out;
-    if (bytes_to_utf8_via_codepage(bodyBytes, CP_ACP, false, out)) return out;
-
-    return std::string(bodyBytes.begin(), bodyBytes.end());
 }
 
 // ──────── URL 编码 ────────
@@ -620,225 +1414,9780 @@ inline std::string generate_boundary()
     return boundary;
 }
 
-// ──────── SHA256 (RAII) ────────
+// ──────── SHA-256 ────────
 
-inline std::string sha256_hex(const void* data, size_t size)
+inline std::string hex_lower(const uint8_t* data, size_t len)
 {
-    BcryptAlg alg;
-    if (!BCRYPT_SUCCESS(alg.open(BCRYPT_SHA256_ALGORITHM)))
-        throw std::runtime_error("BCryptOpenAlgorithmProvider failed");
-
-    DWORD hashLen = 0, resultLen = 0;
-    BCryptGetProperty(alg.get(), BCRYPT_HASH_LENGTH, (PUCHAR)&hashLen, sizeof(hashLen), &resultLen, 0);
-
-    BcryptHash hash;
-    if (!BCRYPT_SUCCESS(hash.create(alg.get())))
-        throw std::runtime_error("BCryptCreateHash failed");
-
-    if (!BCRYPT_SUCCESS(hash.update(data, (ULONG)size)))
-        throw std::runtime_error("BCryptHashData failed");
-
-    std::vector<uint8_t> hashBuf;
-    if (!BCRYPT_SUCCESS(hash.finish(hashBuf, hashLen)))
-        throw std::runtime_error("BCryptFinishHash failed");
-
     static const char hex[] = "0123456789abcdef";
     std::string out;
-    out.reserve(hashLen * 2);
-    for (auto b : hashBuf) { out += hex[(b >> 4) & 0x0F]; out += hex[b & 0x0F]; }
+    out.reserve(len * 2);
+    for (size_t i = 0; i < len; ++i) { out += hex[(data[i] >> 4) & 0x0F]; out += hex[data[i] & 0x0F]; }
     return out;
 }
 
-inline std::string sha256_hex(const std::vector<uint8_t>& data)
+/// 运行时检测一次的 CPU 特性
+struct CpuFeatures
 {
-    return sha256_hex(data.data(), data.size());
-}
+    bool sha  = false;   ///< x86 SHA-NI (含 SSSE3 / SSE4.1) 或 ARMv8 SHA2 指令
+    bool avx2 = false;   ///< AVX2 且操作系统保存 YMM 寄存器
 
-inline std::string sha256_file(const std::string& filePath)
-{
-    std::ifstream ifs(filePath, std::ios::binary);
-    if (!ifs) return {};
+    static const CpuFeatures& get()
+    {
+        static const CpuFeatures features = detect();
+        return features;
+    }
 
-    BcryptAlg alg;
-    if (!BCRYPT_SUCCESS(alg.open(BCRYPT_SHA256_ALGORITHM))) return {};
+private:
+    static CpuFeatures detect()
+    {
+        CpuFeatures f;
+#if defined(DRX_HTTP_X86)
+        unsigned r1[4] = {}, r7[4] = {};
+    #if defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 0);
+        int maxLeaf = regs[0];
+        __cpuid(regs, 1);
+        std::memcpy(r1, regs, sizeof(r1));
+        if (maxLeaf >= 7) { __cpuidex(regs, 7, 0); std::memcpy(r7, regs, sizeof(r7)); }
+    #else
+        unsigned maxLeaf = __get_cpuid_max(0, nullptr);
+        __get_cpuid(1, &r1[0], &r1[1], &r1[2], &r1[3]);
+        if (maxLeaf >= 7) __get_cpuid_count(7, 0, &r7[0], &r7[1], &r7[2], &r7[3]);
+    #endif
+        bool ssse3  = (r1[2] >> 9) & 1;
+        bool sse41  = (r1[2] >> 19) & 1;
+        bool osxsave = (r1[2] >> 27) & 1;
+        f.sha = ssse3 && sse41 && ((r7[1] >> 29) & 1);
+        if (osxsave && ((r7[1] >> 5) & 1)) {
+    #if defined(_MSC_VER)
+            unsigned long long xcr0 = _xgetbv(0);
+    #else
+            unsigned lo, hi;
+            __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            unsigned long long xcr0 = ((unsigned long long)hi << 32) | lo;
+    #endif
+            f.avx2 = (xcr0 & 6) == 6;
+        }
+#elif defined(DRX_HTTP_ARM_SHA2) && defined(_M_ARM64)
+        f.sha = IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+#elif defined(DRX_HTTP_ARM_SHA2)
+        f.sha = true;
+#endif
+        return f;
+    }
+};
 
-    DWORD hashLen = 0, resultLen = 0;
-    BCryptGetProperty(alg.get(), BCRYPT_HASH_LENGTH, (PUCHAR)&hashLen, sizeof(hashLen), &resultLen, 0);
+alignas(16) inline constexpr uint32_t kSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
 
-    BcryptHash hash;
-    if (!BCRYPT_SUCCESS(hash.create(alg.get()))) return {};
+inline constexpr uint32_t kSha256Init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
 
-    char buf[81920];
-    while (ifs.read(buf, sizeof(buf)) || ifs.gcount() > 0) {
-        if (!BCRYPT_SUCCESS(hash.update(buf, (ULONG)ifs.gcount()))) return {};
-    }
+inline uint32_t sha256_load_be32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
 
-    std::vector<uint8_t> hashBuf;
-    if (!BCRYPT_SUCCESS(hash.finish(hashBuf, hashLen))) return {};
+/// 可移植实现 (FIPS 180-4)，处理 blocks 个连续的 64 字节块
+inline void sha256_compress_portable(uint32_t state[8], const uint8_t* data, size_t blocks)
+{
+    auto rotr = [](uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) w[i] = sha256_load_be32(data + i * 4);
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
 
-    static const char hex[] = "0123456789abcdef";
-    std::string out;
-    out.reserve(hashLen * 2);
-    for (auto b : hashBuf) { out += hex[(b >> 4) & 0x0F]; out += hex[b & 0x0F]; }
-    return out;
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t S1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + S1 + ch + kSha256K[i] + w[i];
+            uint32_t S0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = S0 + maj;
+            h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
 }
 
-// ──────── JSON 辅助 (Cookie 导入/导出) ────────
+#if defined(DRX_HTTP_X86)
 
-inline std::string json_escape(const std::string& s)
+/// SHA-NI: 每条 sha256rnds2 完成两轮，消息扩展由 sha256msg1 / sha256msg2 完成
+DRX_HTTP_TARGET("sha,sse4.1,ssse3")
+inline void sha256_compress_shani(uint32_t state[8], const uint8_t* data, size_t blocks)
 {
-    std::string out;
-    for (char c : s) {
-        switch (c) {
-            case '"':  out += "\\\""; break;
-            case '\\': out += "\\\\"; break;
-            case '\n': out += "\\n";  break;
-            case '\r': out += "\\r";  break;
-            case '\t': out += "\\t";  break;
-            default:   out += c;
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // 寄存器布局: state0 = ABEF，state1 = CDGH
+    __m128i tmp    = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        __m128i saveAbef = state0, saveCdgh = state1;
+        __m128i msg[4];
+        for (int i = 0; i < 4; ++i)
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), byteSwap);
+
+        for (int g = 0; g < 16; ++g) {
+            __m128i wk = _mm_add_epi32(msg[g & 3], _mm_load_si128((const __m128i*)&kSha256K[4 * g]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+            if (g < 12) {
+                // W[4g+16 .. 4g+19]
+                __m128i next = _mm_sha256msg1_epu32(msg[g & 3], msg[(g + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(msg[(g + 3) & 3], msg[(g + 2) & 3], 4));
+                msg[g & 3] = _mm_sha256msg2_epu32(next, msg[(g + 3) & 3]);
+            }
         }
+        state0 = _mm_add_epi32(state0, saveAbef);
+        state1 = _mm_add_epi32(state1, saveCdgh);
     }
-    return out;
-}
 
-inline std::string json_get_string(const std::string& json, const std::string& key)
-{
-    std::string search = "\"" + key + "\"";
-    auto pos = json.find(search);
-    if (pos == std::string::npos) return {};
-    pos = json.find(':', pos + search.size());
-    if (pos == std::string::npos) return {};
-    pos = json.find('"', pos + 1);
-    if (pos == std::string::npos) return {};
-    auto end = json.find('"', pos + 1);
-    if (end == std::string::npos) return {};
-    return json.substr(pos + 1, end - pos - 1);
+    tmp    = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
 }
 
-inline bool json_get_bool(const std::string& json, const std::string& key)
+#elif defined(DRX_HTTP_ARM_SHA2)
+
+/// ARMv8 加密扩展: vsha256hq / vsha256h2q 每条完成四轮
+inline void sha256_compress_armv8(uint32_t state[8], const uint8_t* data, size_t blocks)
 {
-    std::string search = "\"" + key + "\"";
-    auto pos = json.find(search);
-    if (pos == std::string::npos) return false;
-    pos = json.find(':', pos + search.size());
-    if (pos == std::string::npos) return false;
-    return json.substr(pos + 1, 10).find("true") != std::string::npos;
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32x4_t saveAbcd = state0, saveEfgh = state1;
+        uint32x4_t msg[4];
+        for (int i = 0; i < 4; ++i)
+            msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+
+        for (int g = 0; g < 16; ++g) {
+            uint32x4_t wk = vaddq_u32(msg[g & 3], vld1q_u32(&kSha256K[4 * g]));
+            if (g < 12)
+                msg[g & 3] = vsha256su1q_u32(vsha256su0q_u32(msg[g & 3], msg[(g + 1) & 3]), msg[(g + 2) & 3], msg[(g + 3) & 3]);
+            uint32x4_t abcd = state0;
+            state0 = vsha256hq_u32(state0, state1, wk);
+            state1 = vsha256h2q_u32(state1, abcd, wk);
+        }
+        state0 = vaddq_u32(state0, saveAbcd);
+        state1 = vaddq_u32(state1, saveEfgh);
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
 }
 
-// ──────── ASCII header 转义 ────────
+#endif
 
-inline std::string ensure_ascii_header(const std::string& value)
-{
-    bool allAscii = true;
-    for (unsigned char c : value) { if (c > 127) { allAscii = false; break; } }
-    if (allAscii) return value;
+using Sha256CompressFn = void (*)(uint32_t state[8], const uint8_t* data, size_t blocks);
 
-    static const char hex[] = "0123456789ABCDEF";
-    std::string out;
-    for (unsigned char c : value) {
-        if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '-' || c == '_' || c == '.' || c == '~')
-            out += (char)c;
-        else { out += '%'; out += hex[(c >> 4) & 0x0F]; out += hex[c & 0x0F]; }
-    }
-    return out;
+/// CPU 支持时返回 SHA 指令实现，否则为 nullptr
+inline Sha256CompressFn sha256_hardware_compress()
+{
+#if defined(DRX_HTTP_X86)
+    if (CpuFeatures::get().sha) return &sha256_compress_shani;
+#elif defined(DRX_HTTP_ARM_SHA2)
+    if (CpuFeatures::get().sha) return &sha256_compress_armv8;
+#endif
+    return nullptr;
 }
 
-// ──────── WinHTTP 错误描述 ────────
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
 
-inline std::string winhttp_error_string(DWORD err)
+/// 进程内共享的 BCrypt 算法句柄。打开 provider 需要加载模块并查询注册表，代价远高于一次短哈希；
+/// 算法句柄可以被多个线程同时用来创建哈希对象，因此每种算法只打开一次
+inline BCRYPT_ALG_HANDLE bcrypt_hash_provider(LPCWSTR algId, DWORD* hashLen)
 {
-    switch (err) {
-        case 12001: return "error=12001 (OUT_OF_HANDLES)";
-        case 12002: return "error=12002 (TIMEOUT)";
-        case 12004: return "error=12004 (INTERNAL_ERROR)";
-        case 12005: return "error=12005 (INVALID_URL)";
-        case 12007: return "error=12007 (NAME_NOT_RESOLVED) DNS lookup failed";
-        case 12009: return "error=12009 (INVALID_OPTION)";
-        case 12029: return "error=12029 (CANNOT_CONNECT) Connection refused or unreachable";
-        case 12030: return "error=12030 (CONNECTION_ERROR)";
-        case 12038: return "error=12038 (SECURE_CERT_CN_INVALID) Certificate CN mismatch";
-        case 12044: return "error=12044 (SECURE_CERT_DATE_INVALID) Certificate expired";
-        case 12045: return "error=12045 (SECURE_CERT_REV_FAILED)";
-        case 12057: return "error=12057 (SECURE_CERT_REVOKED)";
-        case 12157: return "error=12157 (SECURE_CHANNEL_ERROR) TLS/SSL handshake failed";
-        case 12175: return "error=12175 (SECURE_FAILURE) SSL certificate error — try setting ignoreSslErrors=true";
-        case 12178: return "error=12178 (AUTO_PROXY_SERVICE_ERROR)";
-        default:    return "error=" + std::to_string(err);
-    }
-}
+    struct Provider
+    {
+        BcryptAlg alg;
+        DWORD     hashLen = 0;
 
-} // namespace detail
+        explicit Provider(LPCWSTR id)
+        {
+            if (!BCRYPT_SUCCESS(alg.open(id)))
+                throw std::runtime_error("BCryptOpenAlgorithmProvider failed");
+            DWORD resultLen = 0;
+            BCryptGetProperty(alg.get(), BCRYPT_HASH_LENGTH, (PUCHAR)&hashLen, sizeof(hashLen), &resultLen, 0);
+        }
+    };
+    static Provider sha256(BCRYPT_SHA256_ALGORITHM);
+    static Provider sha1(BCRYPT_SHA1_ALGORITHM);
 
-// ═══════════════════════════════════════════════════════════════════════════
-//  DrxHttpClient
-// ═══════════════════════════════════════════════════════════════════════════
+    Provider& p = std::wcscmp(algId, BCRYPT_SHA1_ALGORITHM) == 0 ? sha1 : sha256;
+    if (hashLen) *hashLen = p.hashLen;
+    return p.alg.get();
+}
 
-class DrxHttpClient
+#endif
+
+/// 增量 SHA-256。后端按优先级选择: SHA-NI / ARMv8 指令 → (Windows) 缓存的 BCrypt provider → 可移植实现。
+/// allowHardware = false 时固定使用可移植实现 (对照测试用)
+class Sha256
 {
 public:
-    // ──────────────────────────── 构造 / 析构 ────────────────────────────
+    static constexpr size_t kDigestSize = 32;
 
-    DrxHttpClient()
+    explicit Sha256(bool allowHardware = true)
     {
-        init_session();
+        compress_ = allowHardware ? sha256_hardware_compress() : nullptr;
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        if (allowHardware && !compress_) {
+            bcrypt_ = std::make_unique<BcryptHash>();
+            if (!BCRYPT_SUCCESS(bcrypt_->create(bcrypt_hash_provider(BCRYPT_SHA256_ALGORITHM, nullptr))))
+                throw std::runtime_error("BCryptCreateHash failed");
+        }
+#endif
+        if (!compress_) compress_ = &sha256_compress_portable;
+        reset();
     }
 
-    explicit DrxHttpClient(const std::string& baseAddress)
-        : baseAddress_(baseAddress)
+    /// 当前机器上默认构造使用的后端: "sha-ni" / "armv8" / "bcrypt" / "portable"
+    static const char* backendName()
     {
-        init_session();
+#if defined(DRX_HTTP_X86)
+        if (sha256_hardware_compress()) return "sha-ni";
+#elif defined(DRX_HTTP_ARM_SHA2)
+        if (sha256_hardware_compress()) return "armv8";
+#endif
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        return "bcrypt";
+#else
+        return "portable";
+#endif
     }
 
-    ~DrxHttpClient()
+    void reset()
     {
-        stop_queue();
-        // hSession_ 由 RAII handle 自动关闭
+        std::copy(kSha256Init, kSha256Init + 8, h_);
+        bufLen_ = 0;
+        total_  = 0;
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        if (bcrypt_ && finished_) {
+            bcrypt_ = std::make_unique<BcryptHash>();
+            if (!BCRYPT_SUCCESS(bcrypt_->create(bcrypt_hash_provider(BCRYPT_SHA256_ALGORITHM, nullptr))))
+                throw std::runtime_error("BCryptCreateHash failed");
+        }
+        finished_ = false;
+#endif
     }
 
-    // 不可复制，不可移动（队列线程绑定了 this）
-    DrxHttpClient(const DrxHttpClient&) = delete;
-    DrxHttpClient& operator=(const DrxHttpClient&) = delete;
-    DrxHttpClient(DrxHttpClient&&) = delete;
-    DrxHttpClient& operator=(DrxHttpClient&&) = delete;
-
-    // ──────────────────────────── 日志 ──────────────────────────────────
+    void update(const void* data, size_t len)
+    {
+        auto p = static_cast<const uint8_t*>(data);
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        if (bcrypt_) {
+            while (len > 0) {
+                ULONG n = (ULONG)std::min<size_t>(len, 0x40000000);
+                if (!BCRYPT_SUCCESS(bcrypt_->update(p, n)))
+                    throw std::runtime_error("BCryptHashData failed");
+                p += n; len -= n;
+            }
+            return;
+        }
+#endif
+        total_ += len;
+        if (bufLen_ > 0) {
+            size_t take = std::min(len, sizeof(buf_) - bufLen_);
+            std::memcpy(buf_ + bufLen_, p, take);
+            bufLen_ += take; p += take; len -= take;
+            if (bufLen_ < sizeof(buf_)) return;
+            compress_(h_, buf_, 1);
+            bufLen_ = 0;
+        }
+        if (len >= 64) {
+            compress_(h_, p, len / 64);
+            p += len & ~(size_t)63;
+            len &= 63;
+        }
+        if (len > 0) { std::memcpy(buf_, p, len); bufLen_ = len; }
+    }
 
-    /// 设置日志回调
-    void setLogCallback(LogCallback cb)
+    void finish(uint8_t out[kDigestSize])
     {
-        std::lock_guard<std::mutex> lock(mu_);
-        logCallback_ = std::move(cb);
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        if (bcrypt_) {
+            finished_ = true;
+            if (!BCRYPT_SUCCESS(BCryptFinishHash(bcrypt_->get(), out, (ULONG)kDigestSize, 0)))
+                throw std::runtime_error("BCryptFinishHash failed");
+            return;
+        }
+#endif
+        uint64_t bits = total_ * 8;
+        uint8_t tail[128] = {};
+        std::memcpy(tail, buf_, bufLen_);
+        tail[bufLen_] = 0x80;
+        size_t tailLen = bufLen_ < 56 ? 64 : 128;
+        for (int i = 0; i < 8; ++i) tail[tailLen - 1 - i] = (uint8_t)(bits >> (8 * i));
+        compress_(h_, tail, tailLen / 64);
+        for (int i = 0; i < 8; ++i) {
+            out[i * 4 + 0] = (uint8_t)(h_[i] >> 24);
+            out[i * 4 + 1] = (uint8_t)(h_[i] >> 16);
+            out[i * 4 + 2] = (uint8_t)(h_[i] >> 8);
+            out[i * 4 + 3] = (uint8_t)(h_[i]);
+        }
     }
 
-    // ──────────────────────────── 属性 (线程安全) ───────────────────────
+    std::string finishHex()
+    {
+        uint8_t digest[kDigestSize];
+        finish(digest);
+        return hex_lower(digest, kDigestSize);
+    }
 
-    void setAutoManageCookies(bool v) { autoManageCookies_.store(v); }
-    bool getAutoManageCookies() const { return autoManageCookies_.load(); }
+private:
+    Sha256CompressFn compress_ = nullptr;
+    uint32_t h_[8];
+    uint8_t  buf_[64];
+    size_t   bufLen_ = 0;
+    uint64_t total_  = 0;
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+    std::unique_ptr<BcryptHash> bcrypt_;
+    bool finished_ = false;
+#endif
+};
+
+inline std::string sha256_hex(const void* data, size_t size)
+{
+    Sha256 hash;
+    hash.update(data, size);
+    return hash.finishHex();
+}
+
+inline std::string sha256_hex(const std::vector<uint8_t>& data)
+{
+    return sha256_hex(data.data(), data.size());
+}
+
+inline std::string sha256_file(const std::string& filePath)
+{
+    std::ifstream ifs(filePath, std::ios::binary);
+    if (!ifs) return {};
+
+    Sha256 hash;
+    std::vector<char> buf(256 * 1024);
+    while (ifs.read(buf.data(), (std::streamsize)buf.size()) || ifs.gcount() > 0) {
+        hash.update(buf.data(), (size_t)ifs.gcount());
+    }
+    return hash.finishHex();
+}
+
+// ──────── SHA-256 批量 (多缓冲) ────────
+
+#if defined(DRX_HTTP_X86)
+
+DRX_HTTP_TARGET("avx2") inline __m256i sha256x8_rotr(__m256i x, int n)
+{
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+/// 最多 8 条消息各占 AVX2 寄存器的一个 32 位 lane 同时计算。
+/// 各消息块数不同: 已结束的 lane 读零块，结果按 lane 掩码丢弃
+DRX_HTTP_TARGET("avx2")
+inline void sha256_x8_avx2(const std::string_view* inputs, size_t count, std::array<uint8_t, 32>* digests)
+{
+    static const uint8_t zeroBlock[64] = {};
+    uint8_t tails[8][128] = {};
+    size_t  fullBlocks[8] = {}, blocks[8] = {}, maxBlocks = 0;
+    for (size_t lane = 0; lane < count; ++lane) {
+        size_t len = inputs[lane].size();
+        size_t rest = len % 64;
+        fullBlocks[lane] = len / 64;
+        size_t tailLen = rest < 56 ? 64 : 128;
+        if (rest) std::memcpy(tails[lane], inputs[lane].data() + len - rest, rest);
+        tails[lane][rest] = 0x80;
+        uint64_t bits = (uint64_t)len * 8;
+        for (int i = 0; i < 8; ++i) tails[lane][tailLen - 1 - i] = (uint8_t)(bits >> (8 * i));
+        blocks[lane] = fullBlocks[lane] + tailLen / 64;
+        maxBlocks = std::max(maxBlocks, blocks[lane]);
+    }
+
+    __m256i st[8];
+    for (int i = 0; i < 8; ++i) st[i] = _mm256_set1_epi32((int)kSha256Init[i]);
+
+    for (size_t b = 0; b < maxBlocks; ++b) {
+        const uint8_t* src[8];
+        alignas(32) uint32_t active[8];
+        for (size_t lane = 0; lane < 8; ++lane) {
+            bool live = lane < count && b < blocks[lane];
+            active[lane] = live ? 0xFFFFFFFFu : 0;
+            if (!live)                        src[lane] = zeroBlock;
+            else if (b < fullBlocks[lane])    src[lane] = (const uint8_t*)inputs[lane].data() + b * 64;
+            else                              src[lane] = tails[lane] + (b - fullBlocks[lane]) * 64;
+        }
+
+        __m256i w[16];
+        for (int j = 0; j < 16; ++j) {
+            w[j] = _mm256_setr_epi32((int)sha256_load_be32(src[0] + 4 * j), (int)sha256_load_be32(src[1] + 4 * j),
+                                     (int)sha256_load_be32(src[2] + 4 * j), (int)sha256_load_be32(src[3] + 4 * j),
+                                     (int)sha256_load_be32(src[4] + 4 * j), (int)sha256_load_be32(src[5] + 4 * j),
+                                     (int)sha256_load_be32(src[6] + 4 * j), (int)sha256_load_be32(src[7] + 4 * j));
+        }
+
+        __m256i a = st[0], bb = st[1], c = st[2], d = st[3], e = st[4], f = st[5], g = st[6], h = st[7];
+        for (int i = 0; i < 64; ++i) {
+            __m256i wi;
+            if (i < 16) {
+                wi = w[i];
+            } else {
+                __m256i w15 = w[(i - 15) & 15], w2 = w[(i - 2) & 15];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(sha256x8_rotr(w15, 7), sha256x8_rotr(w15, 18)), _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(sha256x8_rotr(w2, 17), sha256x8_rotr(w2, 19)), _mm256_srli_epi32(w2, 10));
+                wi = _mm256_add_epi32(_mm256_add_epi32(w[i & 15], s0), _mm256_add_epi32(w[(i - 7) & 15], s1));
+                w[i & 15] = wi;
+            }
+            __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(sha256x8_rotr(e, 6), sha256x8_rotr(e, 11)), sha256x8_rotr(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, S1), _mm256_add_epi32(ch, _mm256_add_epi32(_mm256_set1_epi32((int)kSha256K[i]), wi)));
+            __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(sha256x8_rotr(a, 2), sha256x8_rotr(a, 13)), sha256x8_rotr(a, 22));
+            __m256i maj = _mm256_or_si256(_mm256_and_si256(a, bb), _mm256_and_si256(c, _mm256_or_si256(a, bb)));
+            __m256i t2 = _mm256_add_epi32(S0, maj);
+            h = g; g = f; f = e; e = _mm256_add_epi32(d, t1); d = c; c = bb; bb = a; a = _mm256_add_epi32(t1, t2);
+        }
+
+        const __m256i mask = _mm256_load_si256((const __m256i*)active);
+        const __m256i out[8] = { a, bb, c, d, e, f, g, h };
+        for (int i = 0; i < 8; ++i)
+            st[i] = _mm256_blendv_epi8(st[i], _mm256_add_epi32(st[i], out[i]), mask);
+    }
+
+    alignas(32) uint32_t words[8][8];
+    for (int i = 0; i < 8; ++i) _mm256_store_si256((__m256i*)words[i], st[i]);
+    for (size_t lane = 0; lane < count; ++lane) {
+        for (int i = 0; i < 8; ++i) {
+            uint32_t v = words[i][lane];
+            digests[lane][i * 4 + 0] = (uint8_t)(v >> 24);
+            digests[lane][i * 4 + 1] = (uint8_t)(v >> 16);
+            digests[lane][i * 4 + 2] = (uint8_t)(v >> 8);
+            digests[lane][i * 4 + 3] = (uint8_t)v;
+        }
+    }
+}
+
+#endif
+
+/// 用 AVX2 多缓冲路径批量计算；CPU 不支持 AVX2 时返回 false 且不写入结果
+inline bool sha256_batch_avx2(const std::string_view* inputs, size_t count, std::array<uint8_t, 32>* digests)
+{
+#if defined(DRX_HTTP_X86)
+    if (!CpuFeatures::get().avx2) return false;
+    for (size_t i = 0; i < count; i += 8)
+        sha256_x8_avx2(inputs + i, std::min<size_t>(8, count - i), digests + i);
+    return true;
+#else
+    (void)inputs; (void)count; (void)digests;
+    return false;
+#endif
+}
+
+/// 批量计算许多短消息 (缓存键、签名等) 的 SHA-256。
+/// 平均长度不超过 256 字节或没有 SHA 指令时优先 AVX2 8 路多缓冲 (短消息上省掉逐条的初始化与收尾)，
+/// 较长的消息有 SHA 指令时逐条走硬件路径，其余情况逐条计算
+inline void sha256_batch(const std::string_view* inputs, size_t count, std::array<uint8_t, 32>* digests)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) total += inputs[i].size();
+    bool shortMessages = total <= count * 256;
+    if ((shortMessages || !sha256_hardware_compress()) && sha256_batch_avx2(inputs, count, digests)) return;
+    for (size_t i = 0; i < count; ++i) {
+        Sha256 hash;
+        hash.update(inputs[i].data(), inputs[i].size());
+        hash.finish(digests[i].data());
+    }
+}
+
+// ──────── 增量摘要 (SHA-1 / SHA-256 / XXH3) ────────
+
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+
+/// BCrypt 增量摘要 (共享 bcrypt_hash_provider 的算法句柄)，algId 为 BCRYPT_SHA1_ALGORITHM / BCRYPT_SHA256_ALGORITHM
+class BcryptDigest
+{
+public:
+    explicit BcryptDigest(LPCWSTR algId)
+    {
+        if (!BCRYPT_SUCCESS(hash_.create(bcrypt_hash_provider(algId, &hashLen_))))
+            throw std::runtime_error("BCryptCreateHash failed");
+    }
+
+    void update(const void* data, size_t len)
+    {
+        auto p = static_cast<const uint8_t*>(data);
+        while (len > 0) {
+            ULONG n = (ULONG)std::min<size_t>(len, 0x40000000);
+            if (!BCRYPT_SUCCESS(hash_.update(p, n)))
+                throw std::runtime_error("BCryptHashData failed");
+            p += n; len -= n;
+        }
+    }
+
+    std::string finishHex()
+    {
+        std::vector<uint8_t> digest;
+        if (!BCRYPT_SUCCESS(hash_.finish(digest, hashLen_)))
+            throw std::runtime_error("BCryptFinishHash failed");
+        return hex_lower(digest.data(), digest.size());
+    }
+
+private:
+    BcryptHash hash_;
+    DWORD      hashLen_ = 0;
+};
+
+#else
+
+/// SHA-1 (FIPS 180-4) 纯 C++ 实现，仅用于与只提供 SHA-1 的源做完整性校验
+class Sha1
+{
+public:
+    static constexpr size_t kDigestSize = 20;
+
+    Sha1() { reset(); }
+
+    void reset()
+    {
+        static const uint32_t init[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+        std::copy(init, init + 5, h_);
+        bufLen_ = 0;
+        total_  = 0;
+    }
+
+    void update(const void* data, size_t len)
+    {
+        auto p = static_cast<const uint8_t*>(data);
+        total_ += len;
+        if (bufLen_ > 0) {
+            size_t take = std::min(len, sizeof(buf_) - bufLen_);
+            std::memcpy(buf_ + bufLen_, p, take);
+            bufLen_ += take; p += take; len -= take;
+            if (bufLen_ < sizeof(buf_)) return;
+            compress(buf_);
+            bufLen_ = 0;
+        }
+        for (; len >= 64; p += 64, len -= 64) compress(p);
+        if (len > 0) { std::memcpy(buf_, p, len); bufLen_ = len; }
+    }
+
+    std::string finishHex()
+    {
+        uint64_t bits = total_ * 8;
+        uint8_t pad = 0x80;
+        update(&pad, 1);
+        uint8_t zero = 0;
+        while (bufLen_ != 56) update(&zero, 1);
+        uint8_t len[8];
+        for (int i = 0; i < 8; ++i) len[i] = (uint8_t)(bits >> (56 - 8 * i));
+        update(len, 8);
+        uint8_t digest[kDigestSize];
+        for (int i = 0; i < 5; ++i) {
+            digest[i * 4 + 0] = (uint8_t)(h_[i] >> 24);
+            digest[i * 4 + 1] = (uint8_t)(h_[i] >> 16);
+            digest[i * 4 + 2] = (uint8_t)(h_[i] >> 8);
+            digest[i * 4 + 3] = (uint8_t)(h_[i]);
+        }
+        return hex_lower(digest, kDigestSize);
+    }
+
+private:
+    uint32_t h_[5];
+    uint8_t  buf_[64];
+    size_t   bufLen_ = 0;
+    uint64_t total_  = 0;
+
+    static uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+    void compress(const uint8_t* block)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16)
+                 | ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+        }
+        for (int i = 16; i < 80; ++i) w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h_[0], b = h_[1], c = h_[2], d = h_[3], e = h_[4];
+        auto round = [&](uint32_t f, uint32_t k, uint32_t wi) {
+            uint32_t t = rotl(a, 5) + f + e + k + wi;
+            e = d; d = c; c = rotl(b, 30); b = a; a = t;
+        };
+        int i = 0;
+        for (; i < 20; ++i) round((b & c) | (~b & d), 0x5a827999, w[i]);
+        for (; i < 40; ++i) round(b ^ c ^ d, 0x6ed9eba1, w[i]);
+        for (; i < 60; ++i) round((b & c) | (b & d) | (c & d), 0x8f1bbcdc, w[i]);
+        for (; i < 80; ++i) round(b ^ c ^ d, 0xca62c1d6, w[i]);
+        h_[0] += a; h_[1] += b; h_[2] += c; h_[3] += d; h_[4] += e;
+    }
+};
+
+#endif
+
+/// XXH3-64 (seed 0，默认 secret) 增量实现，输出与 xxhsum -H3 相同的 16 位十六进制。
+/// 非密码学哈希，只用于检测传输/存储损坏，速度远高于 SHA-256
+class Xxh3
+{
+public:
+    Xxh3() { reset(); }
+
+    void reset()
+    {
+        static const uint64_t init[8] = { kP32_3, kP64_1, kP64_2, kP64_3, kP64_4, kP32_2, kP64_5, kP32_1 };
+        std::copy(init, init + 8, acc_);
+        bufLen_ = 0;
+        stripesSoFar_ = 0;
+        total_ = 0;
+    }
+
+    void update(const void* data, size_t len)
+    {
+        auto p = static_cast<const uint8_t*>(data);
+        const uint8_t* end = p + len;
+        total_ += len;
+        if (len <= sizeof(buf_) && bufLen_ + len <= sizeof(buf_)) {
+            std::memcpy(buf_ + bufLen_, p, len);
+            bufLen_ += len;
+            return;
+        }
+        // 缓冲区只在确定后面还有数据时才消费，保证 digest 时至少留有一个字节
+        if (bufLen_ > 0) {
+            size_t load = sizeof(buf_) - bufLen_;
+            std::memcpy(buf_ + bufLen_, p, load);
+            p += load;
+            consume_stripes(buf_, sizeof(buf_) / kStripe);
+            bufLen_ = 0;
+        }
+        if ((size_t)(end - p) > sizeof(buf_)) {
+            size_t stripes = (size_t)(end - 1 - p) / kStripe;
+            consume_stripes(p, stripes);
+            p += stripes * kStripe;
+            // 末尾不足一个 stripe 时 digest 需要借用前一个 stripe 的尾部
+            std::memcpy(buf_ + sizeof(buf_) - kStripe, p - kStripe, kStripe);
+        }
+        std::memcpy(buf_, p, (size_t)(end - p));
+        bufLen_ = (size_t)(end - p);
+    }
+
+    uint64_t digest() const
+    {
+        if (total_ <= 240) return hash_short(buf_, (size_t)total_);
+
+        uint64_t acc[8];
+        std::copy(acc_, acc_ + 8, acc);
+        uint8_t lastStripe[kStripe];
+        const uint8_t* last;
+        if (bufLen_ >= kStripe) {
+            Xxh3 tmp(*this);
+            tmp.consume_stripes(buf_, (bufLen_ - 1) / kStripe);
+            std::copy(tmp.acc_, tmp.acc_ + 8, acc);
+            last = buf_ + bufLen_ - kStripe;
+        } else {
+            size_t catchup = kStripe - bufLen_;
+            std::memcpy(lastStripe, buf_ + sizeof(buf_) - catchup, catchup);
+            std::memcpy(lastStripe + catchup, buf_, bufLen_);
+            last = lastStripe;
+        }
+        accumulate512(acc, last, kSecret + sizeof(kSecret) - kStripe - 7);
+        return merge_accs(acc, kSecret + 11, total_ * kP64_1);
+    }
+
+    std::string finishHex() const
+    {
+        uint64_t h = digest();
+        uint8_t be[8];
+        for (int i = 0; i < 8; ++i) be[i] = (uint8_t)(h >> (56 - 8 * i));
+        return hex_lower(be, sizeof(be));
+    }
+
+private:
+    static constexpr uint64_t kP32_1 = 0x9E3779B1U, kP32_2 = 0x85EBCA77U, kP32_3 = 0xC2B2AE3DU;
+    static constexpr uint64_t kP64_1 = 0x9E3779B185EBCA87ULL, kP64_2 = 0xC2B2AE3D27D4EB4FULL,
+                              kP64_3 = 0x165667B19E3779F9ULL, kP64_4 = 0x85EBCA77C2B2AE63ULL,
+                              kP64_5 = 0x27D4EB2F165667C5ULL;
+    static constexpr uint64_t kMx1 = 0x165667919E3779F9ULL, kMx2 = 0x9FB21C651E98DF25ULL;
+    static constexpr size_t   kStripe = 64;
+    static constexpr size_t   kStripesPerBlock = (192 - kStripe) / 8;
+
+    static constexpr uint8_t kSecret[192] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    uint64_t acc_[8];
+    uint8_t  buf_[256];
+    size_t   bufLen_ = 0;
+    size_t   stripesSoFar_ = 0;
+    uint64_t total_ = 0;
+
+    static uint64_t swap64(uint64_t x)
+    {
+        x = ((x & 0x00FF00FF00FF00FFULL) << 8)  | ((x >> 8)  & 0x00FF00FF00FF00FFULL);
+        x = ((x & 0x0000FFFF0000FFFFULL) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFULL);
+        return (x << 32) | (x >> 32);
+    }
+    /// 小端读取 (memcpy 在主流编译器上即一条 load)
+    static uint64_t read64(const uint8_t* p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        v = swap64(v);
+#endif
+        return v;
+    }
+    static uint32_t read32(const uint8_t* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+    static uint64_t rotl64(uint64_t x, int n) { return (x << n) | (x >> (64 - n)); }
+
+    /// 64x64 -> 128 位乘积的高低两半异或
+    static uint64_t mul128_fold64(uint64_t a, uint64_t b)
+    {
+#if defined(__SIZEOF_INT128__)
+        __extension__ typedef unsigned __int128 u128;
+        u128 p = (u128)a * b;
+        return (uint64_t)p ^ (uint64_t)(p >> 64);
+#else
+        uint64_t lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+        uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+        uint64_t lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+        uint64_t hi_hi = (a >> 32) * (b >> 32);
+        uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+        uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+        uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+        return lower ^ upper;
+#endif
+    }
+
+    static uint64_t avalanche(uint64_t h)
+    {
+        h ^= h >> 37;
+        h *= kMx1;
+        return h ^ (h >> 32);
+    }
+
+    static uint64_t xxh64_avalanche(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= kP64_2;
+        h ^= h >> 29;
+        h *= kP64_3;
+        return h ^ (h >> 32);
+    }
+
+    static uint64_t mix16(const uint8_t* in, const uint8_t* secret)
+    {
+        return mul128_fold64(read64(in) ^ read64(secret), read64(in + 8) ^ read64(secret + 8));
+    }
+
+    /// 0..240 字节的单次哈希 (总长不超过 240 时数据全部留在 buf_ 中)
+    static uint64_t hash_short(const uint8_t* in, size_t len)
+    {
+        const uint8_t* s = kSecret;
+        if (len == 0) return xxh64_avalanche(read64(s + 56) ^ read64(s + 64));
+        if (len <= 3) {
+            uint32_t combined = ((uint32_t)in[0] << 16) | ((uint32_t)in[len >> 1] << 24)
+                              | (uint32_t)in[len - 1] | ((uint32_t)len << 8);
+            return xxh64_avalanche((uint64_t)combined ^ (uint64_t)(read32(s) ^ read32(s + 4)));
+        }
+        if (len <= 8) {
+            uint64_t input64 = read32(in + len - 4) + ((uint64_t)read32(in) << 32);
+            uint64_t h = input64 ^ (read64(s + 8) ^ read64(s + 16));
+            h ^= rotl64(h, 49) ^ rotl64(h, 24);
+            h *= kMx2;
+            h ^= (h >> 35) + len;
+            h *= kMx2;
+            return h ^ (h >> 28);
+        }
+        if (len <= 16) {
+            uint64_t lo = read64(in) ^ (read64(s + 24) ^ read64(s + 32));
+            uint64_t hi = read64(in + len - 8) ^ (read64(s + 40) ^ read64(s + 48));
+            return avalanche(len + swap64(lo) + hi + mul128_fold64(lo, hi));
+        }
+        uint64_t acc = len * kP64_1;
+        if (len <= 128) {
+            if (len > 32) {
+                if (len > 64) {
+                    if (len > 96) {
+                        acc += mix16(in + 48, s + 96);
+                        acc += mix16(in + len - 64, s + 112);
+                    }
+                    acc += mix16(in + 32, s + 64);
+                    acc += mix16(in + len - 48, s + 80);
+                }
+                acc += mix16(in + 16, s + 32);
+                acc += mix16(in + len - 32, s + 48);
+            }
+            acc += mix16(in, s);
+            acc += mix16(in + len - 16, s + 16);
+            return avalanche(acc);
+        }
+        for (size_t i = 0; i < 8; ++i) acc += mix16(in + 16 * i, s + 16 * i);
+        acc = avalanche(acc);
+        uint64_t accEnd = mix16(in + len - 16, s + 136 - 17);
+        for (size_t i = 8; i < len / 16; ++i) accEnd += mix16(in + 16 * i, s + 16 * (i - 8) + 3);
+        return avalanche(acc + accEnd);
+    }
+
+    static void accumulate512(uint64_t* acc, const uint8_t* in, const uint8_t* secret)
+    {
+        for (size_t i = 0; i < 8; ++i) {
+            uint64_t v = read64(in + i * 8);
+            uint64_t k = v ^ read64(secret + i * 8);
+            acc[i ^ 1] += v;
+            acc[i] += (k & 0xFFFFFFFF) * (k >> 32);
+        }
+    }
+
+    static void scramble(uint64_t* acc, const uint8_t* secret)
+    {
+        for (size_t i = 0; i < 8; ++i) {
+            uint64_t a = acc[i];
+            a ^= a >> 47;
+            a ^= read64(secret + i * 8);
+            acc[i] = a * kP32_1;
+        }
+    }
+
+    /// 累加 n 个 64 字节 stripe，每满一个 block (16 个 stripe) 做一次 scramble
+    void consume_stripes(const uint8_t* in, size_t n)
+    {
+        while (n > 0) {
+            size_t take = std::min(n, kStripesPerBlock - stripesSoFar_);
+            for (size_t i = 0; i < take; ++i)
+                accumulate512(acc_, in + i * kStripe, kSecret + (stripesSoFar_ + i) * 8);
+            in += take * kStripe;
+            n -= take;
+            stripesSoFar_ += take;
+            if (stripesSoFar_ == kStripesPerBlock) {
+                scramble(acc_, kSecret + sizeof(kSecret) - kStripe);
+                stripesSoFar_ = 0;
+            }
+        }
+    }
+
+    static uint64_t merge_accs(const uint64_t* acc, const uint8_t* secret, uint64_t start)
+    {
+        uint64_t r = start;
+        for (size_t i = 0; i < 4; ++i)
+            r += mul128_fold64(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+        return avalanche(r);
+    }
+};
+
+/// 按 HashAlgorithm 选择实现的增量摘要，结果为小写十六进制
+class StreamDigest
+{
+public:
+    explicit StreamDigest(HashAlgorithm algorithm) : algorithm_(algorithm)
+    {
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        if (algorithm == HashAlgorithm::Sha1) bcrypt_ = std::make_unique<BcryptDigest>(BCRYPT_SHA1_ALGORITHM);
+#endif
+    }
+
+    void update(const void* data, size_t len)
+    {
+        switch (algorithm_) {
+        case HashAlgorithm::Sha256: sha256_.update(data, len); break;
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        case HashAlgorithm::Sha1:   bcrypt_->update(data, len); break;
+#else
+        case HashAlgorithm::Sha1:   sha1_.update(data, len); break;
+#endif
+        case HashAlgorithm::Xxh3:   xxh3_.update(data, len); break;
+        }
+    }
+
+    std::string finishHex()
+    {
+        switch (algorithm_) {
+        case HashAlgorithm::Sha256: return sha256_.finishHex();
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        case HashAlgorithm::Sha1:   return bcrypt_->finishHex();
+#else
+        case HashAlgorithm::Sha1:   return sha1_.finishHex();
+#endif
+        case HashAlgorithm::Xxh3:   return xxh3_.finishHex();
+        }
+        return {};
+    }
+
+private:
+    HashAlgorithm algorithm_;
+    Sha256        sha256_;
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+    std::unique_ptr<BcryptDigest> bcrypt_;
+#else
+    Sha1          sha1_;
+#endif
+    Xxh3          xxh3_;
+};
+
+// ──────── 下载摘要流水线 ────────
+
+/// 下载循环把 body 直接读进 1 MB 块 (space / commit)，写盘后整块交给摘要线程，
+/// 哈希与网络读取、写盘重叠进行，不再事后回读文件。续传时先从临时文件补算已有的前缀。
+/// 单核机器上没有可重叠的算力，改为在调用线程上对每次读到的小块就地计算，省去线程切换；
+/// 此时收益只剩省掉的一次回读，墙钟时间与"下载后回读"基本持平
+class HashPipeline
+{
+public:
+    static constexpr size_t kBlockSize   = 1024 * 1024;
+    static constexpr size_t kBlocks      = 4;
+    static constexpr size_t kInlineChunk = 128 * 1024;   ///< 单核就地哈希时每次读取的上限
+
+    HashPipeline(HashAlgorithm algorithm, std::string prefixFile, int64_t prefixLen)
+        : digest_(algorithm), prefixFile_(std::move(prefixFile)), prefixLen_(prefixLen)
+    {
+        if (std::thread::hardware_concurrency() <= 1) {
+            storage_.emplace_back(new char[kInlineChunk]);
+            current_ = storage_.back().get();
+            hash_prefix();
+            prefixDone_ = true;
+            return;
+        }
+        for (size_t i = 0; i < kBlocks; ++i) {
+            storage_.emplace_back(new char[kBlockSize]);
+            free_.push_back(storage_.back().get());
+        }
+        current_ = free_.front();
+        free_.pop_front();
+        worker_ = std::thread([this]() { run(); });
+    }
+
+    ~HashPipeline()
+    {
+        if (!worker_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        worker_.join();
+    }
+
+    HashPipeline(const HashPipeline&) = delete;
+    HashPipeline& operator=(const HashPipeline&) = delete;
+
+    /// 当前块中可写入的位置与剩余容量
+    char*  space() const    { return current_ + used_; }
+    size_t capacity() const { return worker_.joinable() ? kBlockSize - used_ : kInlineChunk; }
+
+    /// 已向 space() 写入 n 字节；块写满后交给摘要线程，没有空闲块时等待。
+    /// 单核时立即就地哈希这 n 字节，趁刚收到的数据还在缓存里
+    void commit(size_t n)
+    {
+        if (!worker_.joinable()) {
+            if (!error_) digest_.update(current_, n);
+            return;
+        }
+        used_ += n;
+        if (used_ == kBlockSize) handoff();
+    }
+
+    /// 等摘要线程处理完所有数据后返回十六进制摘要
+    std::string finish()
+    {
+        if (used_ > 0) handoff();
+        std::unique_lock<std::mutex> lock(mu_);
+        cv_.wait(lock, [&] { return prefixDone_ && pending_ == 0; });
+        if (error_) std::rethrow_exception(error_);
+        return digest_.finishHex();
+    }
+
+private:
+    StreamDigest digest_;
+    std::string  prefixFile_;
+    int64_t      prefixLen_;
+
+    std::vector<std::unique_ptr<char[]>> storage_;
+    std::deque<char*>                    free_;
+    std::deque<std::pair<char*, size_t>> full_;
+    char*                                current_ = nullptr;
+    size_t                               used_ = 0;
+    size_t                               pending_ = 0;    ///< 已交出但尚未哈希完的块
+    bool                                 prefixDone_ = false;
+    bool                                 stop_ = false;
+    std::exception_ptr                   error_;
+    std::mutex                           mu_;
+    std::condition_variable              cv_;
+    std::thread                          worker_;
+
+    void handoff()
+    {
+        std::unique_lock<std::mutex> lock(mu_);
+        full_.emplace_back(current_, used_);
+        ++pending_;
+        cv_.notify_all();
+        cv_.wait(lock, [&] { return !free_.empty(); });
+        current_ = free_.front();
+        free_.pop_front();
+        used_ = 0;
+    }
+
+    /// 续传时已在临时文件中的前缀 [0, prefixLen_)；失败记入 error_，finish() 时抛出
+    void hash_prefix()
+    {
+        if (prefixLen_ <= 0) return;
+        try {
+            std::ifstream ifs(prefixFile_, std::ios::binary);
+            auto buf = std::make_unique<char[]>(kBlockSize);
+            int64_t left = prefixLen_;
+            while (left > 0 && ifs.read(buf.get(), (std::streamsize)std::min<int64_t>(left, (int64_t)kBlockSize))) {
+                digest_.update(buf.get(), (size_t)ifs.gcount());
+                left -= ifs.gcount();
+            }
+            if (left > 0) throw std::runtime_error("Cannot read partial download for hashing: " + prefixFile_);
+        } catch (...) {
+            error_ = std::current_exception();
+        }
+    }
+
+    void run()
+    {
+        // prefixDone_ 置位前 finish() 不会读取 error_
+        hash_prefix();
+
+        std::unique_lock<std::mutex> lock(mu_);
+        std::exception_ptr error;
+        prefixDone_ = true;
+        cv_.notify_all();
+        for (;;) {
+            cv_.wait(lock, [&] { return stop_ || !full_.empty(); });
+            if (stop_) return;
+            auto block = full_.front();
+            full_.pop_front();
+            bool failed = error_ != nullptr;
+            lock.unlock();
+            if (!failed) {
+                try {
+                    digest_.update(block.first, block.second);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            lock.lock();
+            if (error && !error_) error_ = error;
+            free_.push_back(block.first);
+            --pending_;
+            cv_.notify_all();
+        }
+    }
+};
+
+// ──────── JSON 辅助 (Cookie 导入/导出) ────────
+
+inline std::string json_escape(const std::string& s)
+{
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)(unsigned char)c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+/// JSON 标量值。数字保留原文
+struct JsonScalar
+{
+    enum class Kind { Null, String, Number, Bool, Composite } kind = Kind::Null;
+    std::string text;           ///< String: 反转义后的 UTF-8；Number: 原文
+    bool        boolean = false;
+};
+
+/// 单遍解析扁平对象数组 [{"Key": 标量, ...}, ...] (如 C# JsonSerializer 输出的 Cookie 列表)。
+/// 字符串按 RFC 8259 反转义 (含 \uXXXX 与代理对)，值为嵌套对象 / 数组时跳过并报告为 Composite。
+/// onField(key, value) 对每个字段调用，onObjectEnd() 在每个对象结束时调用；格式错误时抛出异常
+template <typename OnField, typename OnObjectEnd>
+void parse_json_object_array(std::string_view json, OnField&& onField, OnObjectEnd&& onObjectEnd)
+{
+    size_t i = 0;
+    auto fail = [&](const char* what) {
+        throw std::runtime_error(std::string("Invalid JSON: ") + what + " at offset " + std::to_string(i));
+    };
+    auto ws = [&]() { while (i < json.size() && (json[i] == ' ' || json[i] == '\t' || json[i] == '\r' || json[i] == '\n')) ++i; };
+    auto expect = [&](char c) {
+        ws();
+        if (i >= json.size() || json[i] != c) fail("unexpected character");
+        ++i;
+    };
+    auto hex4 = [&]() -> uint32_t {
+        if (i + 4 > json.size()) fail("truncated \\u escape");
+        uint32_t v = 0;
+        for (int k = 0; k < 4; ++k) {
+            char c = json[i++];
+            v <<= 4;
+            if (c >= '0' && c <= '9') v |= (uint32_t)(c - '0');
+            else if (c >= 'a' && c <= 'f') v |= (uint32_t)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') v |= (uint32_t)(c - 'A' + 10);
+            else fail("bad \\u escape");
+        }
+        return v;
+    };
+    auto string = [&](std::string& out) {
+        expect('"');
+        out.clear();
+        while (true) {
+            size_t run = i;
+            while (i < json.size() && json[i] != '"' && json[i] != '\\') ++i;
+            out.append(json.data() + run, i - run);
+            if (i >= json.size()) fail("unterminated string");
+            if (json[i++] == '"') return;
+            if (i >= json.size()) fail("unterminated string");
+            switch (json[i++]) {
+                case '"':  out += '"';  break;
+                case '\\': out += '\\'; break;
+                case '/':  out += '/';  break;
+                case 'b':  out += '\b'; break;
+                case 'f':  out += '\f'; break;
+                case 'n':  out += '\n'; break;
+                case 'r':  out += '\r'; break;
+                case 't':  out += '\t'; break;
+                case 'u': {
+                    uint32_t cp = hex4();
+                    if (cp >= 0xD800 && cp <= 0xDBFF && i + 6 <= json.size() && json[i] == '\\' && json[i + 1] == 'u') {
+                        i += 2;
+                        uint32_t lo = hex4();
+                        if (lo >= 0xDC00 && lo <= 0xDFFF) cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        else { append_utf8(out, 0xFFFD); cp = lo; }
+                    }
+                    if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;
+                    append_utf8(out, cp);
+                    break;
+                }
+                default: fail("bad escape");
+            }
+        }
+    };
+    // 跳过嵌套的对象 / 数组 (字符串内的括号不计)
+    auto skip_composite = [&]() {
+        int depth = 0;
+        std::string scratch;
+        do {
+            ws();
+            if (i >= json.size()) fail("unterminated value");
+            char c = json[i];
+            if (c == '"') { string(scratch); continue; }
+            if (c == '{' || c == '[') ++depth;
+            else if (c == '}' || c == ']') --depth;
+            ++i;
+        } while (depth > 0);
+    };
+
+    std::string key;
+    JsonScalar value;
+    expect('[');
+    ws();
+    if (i < json.size() && json[i] == ']') { ++i; return; }
+    while (true) {
+        expect('{');
+        ws();
+        if (i < json.size() && json[i] == '}') ++i;
+        else {
+            while (true) {
+                string(key);
+                expect(':');
+                ws();
+                if (i >= json.size()) fail("missing value");
+                char c = json[i];
+                value.boolean = false;
+                value.text.clear();
+                if (c == '"') {
+                    value.kind = JsonScalar::Kind::String;
+                    string(value.text);
+                } else if (c == '{' || c == '[') {
+                    value.kind = JsonScalar::Kind::Composite;
+                    skip_composite();
+                } else if (json.compare(i, 4, "true") == 0) {
+                    value.kind = JsonScalar::Kind::Bool; value.boolean = true; i += 4;
+                } else if (json.compare(i, 5, "false") == 0) {
+                    value.kind = JsonScalar::Kind::Bool; i += 5;
+                } else if (json.compare(i, 4, "null") == 0) {
+                    value.kind = JsonScalar::Kind::Null; i += 4;
+                } else if (c == '-' || (c >= '0' && c <= '9')) {
+                    size_t start = i;
+                    while (i < json.size() && (std::isdigit((unsigned char)json[i]) || json[i] == '-' || json[i] == '+' ||
+                                               json[i] == '.' || json[i] == 'e' || json[i] == 'E')) ++i;
+                    value.kind = JsonScalar::Kind::Number;
+                    value.text.assign(json.data() + start, i - start);
+                } else {
+                    fail("unexpected value");
+                }
+                onField(std::string_view(key), static_cast<const JsonScalar&>(value));
+                ws();
+                if (i < json.size() && json[i] == ',') { ++i; continue; }
+                expect('}');
+                break;
+            }
+        }
+        onObjectEnd();
+        ws();
+        if (i < json.size() && json[i] == ',') { ++i; continue; }
+        expect(']');
+        return;
+    }
+}
+
+// ──────── 响应体字符集解码 ────────
+
+/// [p, p + n) 开头连续 ASCII 字节 (< 0x80) 的个数。SSE2 / NEON 每次检查 16 字节
+inline size_t ascii_prefix(const uint8_t* p, size_t n)
+{
+    size_t i = 0;
+#if defined(DRX_HTTP_SSE2)
+    for (; n - i >= 16; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+        if (mask) {
+#if defined(_MSC_VER)
+            unsigned long bit;
+            _BitScanForward(&bit, (unsigned long)mask);
+            return i + bit;
+#else
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+#endif
+        }
+    }
+#elif defined(DRX_HTTP_NEON)
+    for (; n - i >= 16; i += 16)
+        if (vmaxvq_u8(vld1q_u8(p + i)) >= 0x80) break;   // 命中的 16 字节交给下面逐字节定位
+#endif
+    while (i < n && p[i] < 0x80) ++i;
+    return i;
+}
+
+/// p 处 UTF-8 序列的长度，非法 (截断、超长编码、代理项、> U+10FFFF) 时返回 0
+inline size_t utf8_sequence_length(const uint8_t* p, size_t n)
+{
+    uint8_t b = p[0];
+    if (b < 0x80) return 1;
+    auto cont = [&](size_t k, uint8_t lo = 0x80, uint8_t hi = 0xBF) { return k < n && p[k] >= lo && p[k] <= hi; };
+    if (b >= 0xC2 && b <= 0xDF) return cont(1) ? 2 : 0;
+    if (b >= 0xE0 && b <= 0xEF) {
+        bool second = b == 0xE0 ? cont(1, 0xA0) : b == 0xED ? cont(1, 0x80, 0x9F) : cont(1);
+        return second && cont(2) ? 3 : 0;
+    }
+    if (b >= 0xF0 && b <= 0xF4) {
+        bool second = b == 0xF0 ? cont(1, 0x90) : b == 0xF4 ? cont(1, 0x80, 0x8F) : cont(1);
+        return second && cont(2) && cont(3) ? 4 : 0;
+    }
+    return 0;
+}
+
+inline bool utf8_valid_scalar(const uint8_t* p, size_t n)
+{
+    for (size_t i = 0; i < n;) {
+        i += ascii_prefix(p + i, n - i);
+        if (i >= n) break;
+        size_t len = utf8_sequence_length(p + i, n - i);
+        if (len == 0) return false;
+        i += len;
+    }
+    return true;
+}
+
+#if defined(DRX_HTTP_X86)
+
+/// Keiser & Lemire 查表法 (simdjson "lookup4")：用前一字节的高 / 低 4 位与当前字节的高 4 位各查一张 16 项表，
+/// 三者按位与得到该字节对的错误类别；再检查第 3、4 字节位置上是否恰好是续字节。纯 ASCII 块只检查上一块是否截断
+DRX_HTTP_TARGET("avx2")
+inline bool utf8_valid_avx2(const uint8_t* p, size_t n)
+{
+    constexpr uint8_t TooShort = 1 << 0, TooLong = 1 << 1, Overlong3 = 1 << 2, TooLarge = 1 << 3, Surrogate = 1 << 4,
+                      Overlong2 = 1 << 5, TooLarge1000 = 1 << 6, Overlong4 = 1 << 6, TwoConts = 1 << 7;
+    constexpr uint8_t Carry = TooShort | TooLong | TwoConts;
+    const __m256i byte1High = _mm256_setr_epi8(
+        TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong,
+        (char)TwoConts, (char)TwoConts, (char)TwoConts, (char)TwoConts,
+        TooShort | Overlong2, TooShort, TooShort | Overlong3 | Surrogate, TooShort | TooLarge | TooLarge1000 | Overlong4,
+        TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong,
+        (char)TwoConts, (char)TwoConts, (char)TwoConts, (char)TwoConts,
+        TooShort | Overlong2, TooShort, TooShort | Overlong3 | Surrogate, TooShort | TooLarge | TooLarge1000 | Overlong4);
+    const __m256i byte1Low = _mm256_setr_epi8(
+        (char)(Carry | Overlong3 | Overlong2 | Overlong4), (char)(Carry | Overlong2), (char)Carry, (char)Carry,
+        (char)(Carry | TooLarge), (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000),
+        (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000),
+        (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000 | Surrogate), (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000),
+        (char)(Carry | Overlong3 | Overlong2 | Overlong4), (char)(Carry | Overlong2), (char)Carry, (char)Carry,
+        (char)(Carry | TooLarge), (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000),
+        (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000),
+        (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000 | Surrogate), (char)(Carry | TooLarge | TooLarge1000), (char)(Carry | TooLarge | TooLarge1000));
+    constexpr uint8_t Cont1000 = TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge1000 | Overlong4;
+    constexpr uint8_t Cont1001 = TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge;
+    constexpr uint8_t Cont101  = TooLong | Overlong2 | TwoConts | Surrogate | TooLarge;
+    const __m256i byte2High = _mm256_setr_epi8(
+        TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort,
+        (char)Cont1000, (char)Cont1001, (char)Cont101, (char)Cont101, TooShort, TooShort, TooShort, TooShort,
+        TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort,
+        (char)Cont1000, (char)Cont1001, (char)Cont101, (char)Cont101, TooShort, TooShort, TooShort, TooShort);
+    // 块末 3 字节中出现需要后续字节的前导字节即为 "未完成"，须由下一块补全
+    const __m256i incompleteMax = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    const __m256i low4 = _mm256_set1_epi8(0x0F);
+
+    // 尾部补零 (ASCII) 后多校验两块，顺带暴露末尾被截断的序列
+    const size_t full = n / 32;
+    alignas(32) uint8_t tail[64] = {};
+    std::memcpy(tail, p + full * 32, n - full * 32);
+
+    __m256i error = _mm256_setzero_si256(), prevInput = _mm256_setzero_si256(), prevIncomplete = _mm256_setzero_si256();
+    for (size_t k = 0; k < full + 2; ++k) {
+        const uint8_t* src = k < full ? p + k * 32 : tail + (k - full) * 32;
+        __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, prevIncomplete);
+            prevIncomplete = _mm256_setzero_si256();
+        } else {
+            __m256i carried = _mm256_permute2x128_si256(prevInput, input, 0x21);
+            __m256i prev1 = _mm256_alignr_epi8(input, carried, 15);
+            __m256i prev2 = _mm256_alignr_epi8(input, carried, 14);
+            __m256i prev3 = _mm256_alignr_epi8(input, carried, 13);
+            __m256i special = _mm256_and_si256(
+                _mm256_and_si256(_mm256_shuffle_epi8(byte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low4)),
+                                 _mm256_shuffle_epi8(byte1Low, _mm256_and_si256(prev1, low4))),
+                _mm256_shuffle_epi8(byte2High, _mm256_and_si256(_mm256_srli_epi16(input, 4), low4)));
+            __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80))),
+                                             _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80))));
+            __m256i must23x80 = _mm256_and_si256(must23, _mm256_set1_epi8((char)0x80));
+            error = _mm256_or_si256(error, _mm256_xor_si256(must23x80, special));
+            prevIncomplete = _mm256_subs_epu8(input, incompleteMax);
+        }
+        prevInput = input;
+        if ((k & 31) == 31 && !_mm256_testz_si256(error, error)) return false;
+    }
+    return _mm256_testz_si256(error, error) != 0;
+}
+
+#endif
+
+/// [p, p + n) 是否为合法 UTF-8。支持 AVX2 的 CPU 上每次校验 32 字节 (含多字节序列)，否则 ASCII 段按 16 字节跳过
+inline bool utf8_valid(const uint8_t* p, size_t n)
+{
+#if defined(DRX_HTTP_X86)
+    if (n >= 64 && CpuFeatures::get().avx2) return utf8_valid_avx2(p, n);
+#endif
+    return utf8_valid_scalar(p, n);
+}
+
+/// 把码位写到 dst 并前移 (转码输出已按上限预分配，省去逐字符的容量检查)
+inline char* put_utf8(char* dst, uint32_t cp)
+{
+    if (cp < 0x80) {
+        *dst++ = (char)cp;
+    } else if (cp < 0x800) {
+        *dst++ = (char)(0xC0 | (cp >> 6));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *dst++ = (char)(0xE0 | (cp >> 12));
+        *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *dst++ = (char)(0xF0 | (cp >> 18));
+        *dst++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return dst;
+}
+
+/// 非严格 UTF-8 解码: 合法序列原样保留，非法字节逐个替换为 U+FFFD
+inline void utf8_repair(const uint8_t* p, size_t n, std::string& out)
+{
+    out.resize(n * 3);
+    char* dst = out.data();
+    for (size_t i = 0; i < n;) {
+        size_t run = ascii_prefix(p + i, n - i);
+        std::memcpy(dst, p + i, run);
+        dst += run;
+        i += run;
+        if (i >= n) break;
+        size_t len = utf8_sequence_length(p + i, n - i);
+        if (len) {
+            std::memcpy(dst, p + i, len);
+            dst += len;
+            i += len;
+        } else {
+            dst = put_utf8(dst, 0xFFFD);
+            ++i;
+        }
+    }
+    out.resize((size_t)(dst - out.data()));
+}
+
+/// UTF-16 -> UTF-8 (孤立代理项与奇数长度末尾的半个码元替换为 U+FFFD)
+inline void utf16_to_utf8(const uint8_t* p, size_t n, bool bigEndian, std::string& out)
+{
+    auto unit = [&](size_t i) -> uint32_t {
+        return bigEndian ? ((uint32_t)p[i] << 8) | p[i + 1] : ((uint32_t)p[i + 1] << 8) | p[i];
+    };
+    out.resize(n / 2 * 3 + 3);
+    char* dst = out.data();
+    size_t i = 0;
+    for (; i + 1 < n; i += 2) {
+        uint32_t cu = unit(i);
+        if (cu >= 0xD800 && cu <= 0xDBFF && i + 3 < n) {
+            uint32_t lo = unit(i + 2);
+            if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                dst = put_utf8(dst, 0x10000 + ((cu - 0xD800) << 10) + (lo - 0xDC00));
+                i += 2;
+                continue;
+            }
+        }
+        if (cu >= 0xD800 && cu <= 0xDFFF) cu = 0xFFFD;
+        dst = put_utf8(dst, cu);
+    }
+    if (i < n) dst = put_utf8(dst, 0xFFFD);
+    out.resize((size_t)(dst - out.data()));
+}
+
+/// 单字节 / 双字节代码页到 Unicode 的查找表。进程内每个代码页只构建一次，之后解码只查表，
+/// 不再调用 MultiByteToWideChar / iconv
+struct CodePageTable
+{
+    uint16_t single[256] = {};              ///< 单字节映射，0 = 非法
+    bool     lead[256] = {};                ///< 双字节序列的前导字节
+    std::vector<uint16_t> pairs;            ///< ((lead - 0x80) << 8 | trail) -> BMP 码位，0 = 非法
+    std::vector<uint16_t> gb18030Bmp;       ///< GB18030 四字节序列 81 30 81 30 起的线性序号 -> BMP 码位
+};
+
+/// 用平台转换器 (WinHTTP 后端: MultiByteToWideChar；POSIX: iconv) 逐个字符探测代码页，只在构建查找表时使用
+class CodePageProbe
+{
+public:
+    explicit CodePageProbe(UINT codePage)
+    {
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        codePage_ = codePage;
+#else
+        std::string name;
+        switch (codePage) {
+            case 936: case 54936: name = "GB18030"; break;
+            case 950:   name = "BIG5"; break;
+            case 932:   name = "CP932"; break;
+            case 949:   name = "CP949"; break;
+            case CP_ACP: break;             // Linux 没有 ANSI 代码页
+            default:    name = "CP" + std::to_string(codePage); break;
+        }
+        if (!name.empty()) cd_ = iconv_open("UTF-32LE", name.c_str());
+#endif
+    }
+    ~CodePageProbe()
+    {
+#if !defined(DRX_HTTP_BACKEND_WINHTTP)
+        if (cd_ != (iconv_t)-1) iconv_close(cd_);
+#endif
+    }
+    CodePageProbe(const CodePageProbe&) = delete;
+    CodePageProbe& operator=(const CodePageProbe&) = delete;
+
+    bool ok() const
+    {
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        return IsValidCodePage(codePage_ == CP_ACP ? GetACP() : codePage_) != 0;
+#else
+        return cd_ != (iconv_t)-1;
+#endif
+    }
+
+    /// 把 [p, p + n) 整体解码为一个码位，不是恰好一个字符时返回 0
+    uint32_t decode(const uint8_t* p, size_t n)
+    {
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        wchar_t w[4];
+        int len = MultiByteToWideChar(codePage_, MB_ERR_INVALID_CHARS, reinterpret_cast<const char*>(p), (int)n, w, 4);
+        if (len == 1) return (uint32_t)w[0];
+        if (len == 2 && w[0] >= 0xD800 && w[0] <= 0xDBFF && w[1] >= 0xDC00 && w[1] <= 0xDFFF)
+            return 0x10000 + (((uint32_t)w[0] - 0xD800) << 10) + ((uint32_t)w[1] - 0xDC00);
+        return 0;
+#else
+        uint8_t out[8] = {};
+        char*  in = reinterpret_cast<char*>(const_cast<uint8_t*>(p));
+        char*  dst = reinterpret_cast<char*>(out);
+        size_t inLeft = n, outLeft = sizeof(out);
+        iconv(cd_, nullptr, nullptr, nullptr, nullptr);
+        if (iconv(cd_, &in, &inLeft, &dst, &outLeft) == (size_t)-1 || inLeft != 0 || outLeft != sizeof(out) - 4) return 0;
+        return (uint32_t)out[0] | ((uint32_t)out[1] << 8) | ((uint32_t)out[2] << 16) | ((uint32_t)out[3] << 24);
+#endif
+    }
+
+private:
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+    UINT    codePage_ = 0;
+#else
+    iconv_t cd_ = (iconv_t)-1;
+#endif
+};
+
+/// GB18030 四字节序列的线性序号 (81 30 81 30 = 0)
+inline uint32_t gb18030_linear(const uint8_t* p)
+{
+    return (((uint32_t)(p[0] - 0x81) * 10 + (p[1] - 0x30)) * 126 + (p[2] - 0x81)) * 10 + (p[3] - 0x30);
+}
+
+/// 四字节序列 81 30 81 30 .. 84 31 A4 39 映射到 BMP，90 30 81 30 起按线性序号映射到 U+10000 之后
+constexpr uint32_t kGb18030BmpCount = 39420;
+constexpr uint32_t kGb18030SupplementaryBase = 189000;   // gb18030_linear(90 30 81 30)
+
+inline std::unique_ptr<CodePageTable> build_code_page_table(UINT codePage)
+{
+    auto table = std::make_unique<CodePageTable>();
+    auto& t = *table;
+    for (int b = 0; b < 0x80; ++b) t.single[b] = (uint16_t)b;
+
+    if (codePage == 28591) {                            // ISO-8859-1: 字节即码位
+        for (int b = 0x80; b < 0x100; ++b) t.single[b] = (uint16_t)b;
+        return table;
+    }
+    if (codePage == 20127) return table;                // US-ASCII: 高位字节非法
+    if (codePage == 1252) {                             // Windows-1252: 0x80-0x9F 之外同 Latin-1
+        static const uint16_t c1[32] = {
+            0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+            0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178 };
+        for (int b = 0x80; b < 0x100; ++b) t.single[b] = b < 0xA0 ? c1[b - 0x80] : (uint16_t)b;
+        return table;
+    }
+
+    CodePageProbe probe(codePage);
+    if (!probe.ok()) return nullptr;
+    uint8_t first = 0x81, last = 0xFE;
+    bool dbcs = true;
+    switch (codePage) {
+        case 932: last = 0xFC; break;
+        case 936: case 54936: case 949: case 950: break;
+        default: dbcs = false; break;
+    }
+    for (int b = 0x80; b < 0x100; ++b) {
+        uint8_t byte = (uint8_t)b;
+        bool isLead = dbcs && byte >= first && byte <= last && !(codePage == 932 && byte >= 0xA0 && byte < 0xE0);
+        if (isLead) { t.lead[b] = true; continue; }
+        uint32_t cp = probe.decode(&byte, 1);
+        if (cp && cp < 0x10000) t.single[b] = (uint16_t)cp;
+    }
+    if (!dbcs) return table;
+    if ((codePage == 936 || codePage == 54936) && t.single[0x80] == 0) t.single[0x80] = 0x20AC;   // 同 WHATWG gb18030 解码器
+
+    t.pairs.assign(0x80 * 0x100, 0);
+    for (int lead = first; lead <= last; ++lead) {
+        if (!t.lead[lead]) continue;
+        for (int trail = 0x40; trail <= 0xFE; ++trail) {
+            uint8_t pair[2] = { (uint8_t)lead, (uint8_t)trail };
+            uint32_t cp = probe.decode(pair, 2);
+            if (cp && cp < 0x10000) t.pairs[((size_t)(lead - 0x80) << 8) | (size_t)trail] = (uint16_t)cp;
+        }
+    }
+
+    // 转换器支持 GB18030 四字节形式时 (Windows 54936、iconv GB18030) 一并建表
+    const uint8_t probe4[4] = { 0x81, 0x30, 0x81, 0x30 };
+    if ((codePage == 936 || codePage == 54936) && probe.decode(probe4, 4) == 0x80) {
+        t.gb18030Bmp.assign(kGb18030BmpCount, 0);
+        uint8_t seq[4] = { 0x81, 0x30, 0x81, 0x30 };
+        for (uint32_t linear = 0; linear < kGb18030BmpCount; ++linear) {
+            uint32_t cp = probe.decode(seq, 4);
+            if (cp && cp < 0x10000) t.gb18030Bmp[linear] = (uint16_t)cp;
+            if (++seq[3] > 0x39) { seq[3] = 0x30; if (++seq[2] > 0xFE) { seq[2] = 0x81; if (++seq[1] > 0x39) { seq[1] = 0x30; ++seq[0]; } } }
+        }
+    }
+    return table;
+}
+
+/// 代码页的查找表 (进程内缓存)，平台不支持该代码页时返回 nullptr
+inline const CodePageTable* code_page_table(UINT codePage)
+{
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+    if (codePage == CP_ACP) codePage = GetACP();
+#endif
+    static std::mutex mutex;
+    static std::unordered_map<UINT, std::unique_ptr<CodePageTable>> tables;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = tables.find(codePage);
+    if (it == tables.end()) it = tables.emplace(codePage, build_code_page_table(codePage)).first;
+    return it->second.get();
+}
+
+/// 按查找表解码，非法或截断的序列替换为 U+FFFD (只吞掉前导字节，后随的 ASCII 照常输出)
+inline void code_page_to_utf8(const CodePageTable& t, const uint8_t* p, size_t n, std::string& out)
+{
+    out.resize(n * 3);                      // 单字节最多 3 字节，双字节 / 四字节序列不会更长
+    char* dst = out.data();
+    for (size_t i = 0; i < n;) {
+        uint8_t b = p[i];
+        if (b < 0x80) {
+            size_t run = ascii_prefix(p + i, n - i);
+            std::memcpy(dst, p + i, run);
+            dst += run;
+            i += run;
+            continue;
+        }
+        if (!t.lead[b]) {
+            dst = put_utf8(dst, t.single[b] ? t.single[b] : 0xFFFD);
+            ++i;
+            continue;
+        }
+        uint32_t cp = 0;
+        size_t len = 1;
+        if (i + 1 < n) {
+            uint8_t b2 = p[i + 1];
+            if (b2 >= 0x30 && b2 <= 0x39 && !t.gb18030Bmp.empty()) {
+                if (i + 3 < n && p[i + 2] >= 0x81 && p[i + 2] <= 0xFE && p[i + 3] >= 0x30 && p[i + 3] <= 0x39) {
+                    uint32_t linear = gb18030_linear(p + i);
+                    if (linear < kGb18030BmpCount) cp = t.gb18030Bmp[linear];
+                    else if (linear >= kGb18030SupplementaryBase && linear - kGb18030SupplementaryBase < 0x100000)
+                        cp = 0x10000 + (linear - kGb18030SupplementaryBase);
+                    if (cp) len = 4;
+                }
+            } else {
+                cp = t.pairs[((size_t)(b - 0x80) << 8) | b2];
+                if (cp) len = 2;
+            }
+        }
+        dst = put_utf8(dst, cp ? cp : 0xFFFD);
+        i += len;
+    }
+    out.resize((size_t)(dst - out.data()));
+}
+
+/// 响应体解码结果: 借用原始字节中的一段，或转码得到的新字符串
+struct DecodedText
+{
+    bool        borrowed = true;
+    size_t      offset = 0;
+    size_t      length = 0;
+    std::string text;
+};
+
+/// 依次按 BOM、Content-Type charset、严格 UTF-8、ANSI 代码页 (仅 Windows) 解码，全部失败时保留原始字节。
+/// 合法的 UTF-8 (含纯 ASCII 的 ASCII 兼容字符集) 不复制，只给出区间
+inline void decode_body(const uint8_t* data, size_t size, std::string_view contentType, DecodedText& out)
+{
+    out = DecodedText();
+    out.length = size;
+    if (size == 0) return;
+
+    auto utf8 = [&](size_t offset) {
+        out.offset = offset;
+        out.length = size - offset;
+        if (!utf8_valid(data + offset, size - offset)) {
+            out.borrowed = false;
+            utf8_repair(data + offset, size - offset, out.text);
+        }
+    };
+    auto utf16 = [&](size_t offset, bool bigEndian) {
+        out.borrowed = false;
+        utf16_to_utf8(data + offset, size - offset, bigEndian, out.text);
+    };
+
+    // 1) BOM 优先
+    if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) return utf8(3);
+    if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE) return utf16(2, false);
+    if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF) return utf16(2, true);
+
+    // 2) Content-Type charset
+    auto charset = extract_charset_from_content_type(std::string(contentType));
+    if (!charset.empty()) {
+        auto spec = parse_charset_codepage(charset);
+        if (spec.kind == CharsetKind::Utf16Le) return utf16(0, false);
+        if (spec.kind == CharsetKind::Utf16Be) return utf16(0, true);
+        if (spec.kind == CharsetKind::CodePage && spec.codePage == CP_UTF8) return utf8(0);
+        if (spec.kind == CharsetKind::CodePage && spec.codePage != 0) {
+            if (ascii_prefix(data, size) == size) return;
+            if (auto* table = code_page_table(spec.codePage)) {
+                out.borrowed = false;
+                code_page_to_utf8(*table, data, size, out.text);
+                return;
+            }
+        }
+    }
+
+    // 3) 回退: UTF-8(严格) -> ACP -> 原始字节
+    if (utf8_valid(data, size)) return;
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+    if (auto* table = code_page_table(CP_ACP)) {
+        out.borrowed = false;
+        code_page_to_utf8(*table, data, size, out.text);
+    }
+#endif
+}
+
+inline std::string_view DecodedBody::get(const std::vector<uint8_t>& bytes, const Headers& headers) const
+{
+    auto contentType = headers.get("Content-Type");
+    auto view = [&](const Entry& e) {
+        return e.borrowed ? std::string_view(reinterpret_cast<const char*>(bytes.data()) + e.offset, e.length)
+                          : std::string_view(e.text);
+    };
+    const size_t prefixLen = std::min<size_t>(bytes.size(), 4);
+    // bodyBytes 是公开字段，无法得知是否被改写: 转码结果与源字节逐字节比较 (memcmp 远比重新转码便宜)，
+    // UTF-8 结果本就指向 bodyBytes，只需确认 BOM 与缓冲区未变
+    auto matches = [&](const Entry& e) {
+        if (e.size != bytes.size() || e.contentType != contentType) return false;
+        if (std::memcmp(e.prefix, bytes.data(), prefixLen) != 0) return false;
+        return e.borrowed ? e.data == bytes.data() : std::memcmp(e.source.data(), bytes.data(), bytes.size()) == 0;
+    };
+    Entry* current = entry_.load(std::memory_order_acquire);
+    for (;;) {
+        if (current && matches(*current)) return view(*current);
+
+        auto fresh = std::make_unique<Entry>();
+        fresh->data = bytes.data();
+        fresh->size = bytes.size();
+        if (prefixLen) std::memcpy(fresh->prefix, bytes.data(), prefixLen);
+        fresh->contentType.assign(contentType.data(), contentType.size());
+        DecodedText decoded;
+        decode_body(bytes.data(), bytes.size(), contentType, decoded);
+        fresh->borrowed = decoded.borrowed;
+        fresh->offset = decoded.offset;
+        fresh->length = decoded.length;
+        fresh->text = std::move(decoded.text);
+        if (!fresh->borrowed) fresh->source.assign(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+        // 旧结果与当前内容不符说明响应已被修改，此时不应再有其他线程持有它的视图
+        if (entry_.compare_exchange_strong(current, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+            delete current;
+            return view(*fresh.release());
+        }
+        // 其他线程先发布了结果: 丢弃自己的，回到开头比对
+    }
+}
+
+// ──────── SSE 事件流解析 ────────
+
+/// 返回 [p, end) 中第一个 '\r' 或 '\n' 的位置，没有时返回 end。SSE2 / NEON 每次比较 16 字节
+inline const char* find_line_break(const char* p, const char* end)
+{
+#if defined(DRX_HTTP_SSE2)
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+        if (mask) {
+#if defined(_MSC_VER)
+            unsigned long bit;
+            _BitScanForward(&bit, (unsigned long)mask);
+            return p + bit;
+#else
+            return p + __builtin_ctz((unsigned)mask);
+#endif
+        }
+    }
+#elif defined(DRX_HTTP_NEON)
+    const uint8x16_t cr = vdupq_n_u8('\r');
+    const uint8x16_t lf = vdupq_n_u8('\n');
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+        if (vmaxvq_u8(vorrq_u8(vceqq_u8(v, cr), vceqq_u8(v, lf)))) break;   // 命中的 16 字节交给下面逐字节定位
+    }
+#endif
+    for (; p < end; ++p)
+        if (*p == '\r' || *p == '\n') return p;
+    return end;
+}
+
+/// 增量解析 text/event-stream (WHATWG HTML 9.2)，feed() 可喂入任意分段的字节，每凑齐一个事件调用一次
+/// onEvent(const SseEventView&)。行尾支持 \r\n、\r、\n (含跨分段的 \r\n)，忽略开头的 UTF-8 BOM 与注释行。
+/// 完整落在输入分段内的行直接从输入解析，只有跨分段的残行进入行缓冲；事件字段写入复用的缓冲区，
+/// 稳定运行后不再分配内存。回调中抛出的异常原样传出，之后解析器不应继续使用
+class SseParser
+{
+public:
+    template <typename F>
+    void feed(const char* data, size_t len, F&& onEvent)
+    {
+        const char* p   = data;
+        const char* end = data + len;
+        if (skipLf_ && p < end) {
+            if (*p == '\n') ++p;
+            skipLf_ = false;
+        }
+        while (p < end) {
+            const char* eol = find_line_break(p, end);
+            if (eol == end) {
+                line_.append(p, (size_t)(end - p));
+                break;
+            }
+            if (line_.empty()) {
+                process_line(p, (size_t)(eol - p), onEvent);
+            } else {
+                line_.append(p, (size_t)(eol - p));
+                process_line(line_.data(), line_.size(), onEvent);
+                line_.clear();
+            }
+            p = eol + 1;
+            if (*eol == '\r') {
+                if (p == end) skipLf_ = true;
+                else if (*p == '\n') ++p;
+            }
+        }
+    }
+
+    /// 最近一次收到的 id，断线重连时作为 Last-Event-ID 发送
+    const std::string& lastEventId() const { return lastEventId_; }
+    void setLastEventId(const std::string& id) { lastEventId_ = id; }
+
+    /// 服务器最近一次通过 retry: 建议的重连间隔 (ms)，-1 = 未收到
+    int retryMs() const { return retryMs_; }
+
+    /// 丢弃未完成的行与事件 (重连后从新的连接开始)，保留 lastEventId / retryMs
+    void reset()
+    {
+        line_.clear();
+        clear_event();
+        skipLf_ = false;
+        firstLine_ = true;
+    }
+
+private:
+    template <typename F>
+    void process_line(const char* s, size_t n, F& onEvent)
+    {
+        if (firstLine_) {
+            firstLine_ = false;
+            if (n >= 3 && std::memcmp(s, "\xEF\xBB\xBF", 3) == 0) { s += 3; n -= 3; }
+        }
+        if (n == 0) {
+            dispatch(onEvent);
+            return;
+        }
+        if (s[0] == ':') return;   // 注释 (常用作心跳)
+
+        auto colon = static_cast<const char*>(std::memchr(s, ':', n));
+        size_t nameLen = colon ? (size_t)(colon - s) : n;
+        const char* value = colon ? colon + 1 : s + n;
+        size_t valueLen = n - nameLen - (colon ? 1 : 0);
+        if (valueLen > 0 && *value == ' ') { ++value; --valueLen; }
+
+        std::string_view name(s, nameLen);
+        if (name == "data") {
+            if (hasData_) data_.push_back('\n');
+            data_.append(value, valueLen);
+            hasData_ = true;
+        } else if (name == "event") {
+            event_.assign(value, valueLen);
+        } else if (name == "id") {
+            if (!std::memchr(value, '\0', valueLen)) lastEventId_.assign(value, valueLen);
+        } else if (name == "retry") {
+            // 只接受纯数字，超出 int 范围的按上限截断
+            if (valueLen == 0) return;
+            int64_t ms = 0;
+            for (size_t i = 0; i < valueLen; ++i) {
+                if (value[i] < '0' || value[i] > '9') return;
+                ms = std::min<int64_t>(ms * 10 + (value[i] - '0'), INT32_MAX);
+            }
+            retry_ = retryMs_ = (int)ms;
+        }
+    }
+
+    template <typename F>
+    void dispatch(F& onEvent)
+    {
+        if (!hasData_) {
+            clear_event();
+            return;
+        }
+        struct Reset
+        {
+            SseParser& parser;
+            ~Reset() { parser.clear_event(); }
+        } reset{ *this };
+        SseEventView view;
+        view.event = event_.empty() ? std::string_view("message") : std::string_view(event_);
+        view.data  = data_;
+        view.id    = lastEventId_;
+        view.retry = retry_;
+        onEvent(view);
+    }
+
+    void clear_event()
+    {
+        data_.clear();    // clear() 保留容量
+        event_.clear();
+        retry_ = -1;
+        hasData_ = false;
+    }
+
+    std::string line_;          ///< 跨分段的残行
+    std::string data_;
+    std::string event_;
+    std::string lastEventId_;
+    int         retry_ = -1;    ///< 当前事件内的 retry:
+    int         retryMs_ = -1;
+    bool        hasData_ = false;
+    bool        skipLf_ = false;    ///< 上一分段以 \r 结尾，本分段开头的 \n 属于同一个行尾
+    bool        firstLine_ = true;
+};
+
+// ──────── ASCII header 转义 ────────
+
+inline std::string ensure_ascii_header(std::string_view value)
+{
+    bool allAscii = true;
+    for (unsigned char c : value) { if (c > 127) { allAscii = false; break; } }
+    if (allAscii) return std::string(value);
+
+    static const char hex[] = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : value) {
+        if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '-' || c == '_' || c == '.' || c == '~')
+            out += (char)c;
+        else { out += '%'; out += hex[(c >> 4) & 0x0F]; out += hex[c & 0x0F]; }
+    }
+    return out;
+}
+
+// ──────── 响应头列表 (保留重复头，如 Set-Cookie) ────────
+
+/// 传输层解析出的响应头直接存为 Headers，交给 HttpResponse 时整体移交，不再逐项转换
+using HeaderList = Headers;
+
+inline std::string find_header(const HeaderList& headers, std::string_view name)
+{
+    return std::string(headers.get(name));
+}
+
+inline int64_t content_length_of(const HeaderList& headers)
+{
+    auto val = find_header(headers, "Content-Length");
+    if (val.empty()) return -1;
+    try { return std::stoll(val); } catch (...) { return -1; }
+}
+
+/// 解析 "bytes first-last/total"；total 为 "*" 时置 -1
+inline bool parse_content_range(const std::string& value, int64_t& first, int64_t& last, int64_t& total)
+{
+    auto v = trim_copy(value);
+    if (v.compare(0, 6, "bytes ") != 0) return false;
+    auto dash = v.find('-', 6);
+    auto slash = v.find('/', 6);
+    if (dash == std::string::npos || slash == std::string::npos || dash > slash) return false;
+    try {
+        first = std::stoll(v.substr(6, dash - 6));
+        last  = std::stoll(v.substr(dash + 1, slash - dash - 1));
+        auto t = v.substr(slash + 1);
+        if (t == "*") {
+            total = -1;
+        } else {
+            size_t used = 0;
+            total = std::stoll(t, &used);
+            if (used != t.size() || total <= last) return false;
+        }
+    } catch (...) {
+        return false;
+    }
+    return first >= 0 && last >= first;
+}
+
+/// 解析原始响应头块 ("HTTP/1.1 200 OK\r\nName: value\r\n...")，跳过状态行
+inline void parse_raw_header_block(const std::string& raw, HeaderList& out)
+{
+    size_t pos = 0;
+    while (pos < raw.size()) {
+        size_t end = raw.find('\n', pos);
+        if (end == std::string::npos) end = raw.size();
+        std::string_view line(raw.data() + pos, end - pos);
+        pos = end + 1;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty() || line.compare(0, 5, "HTTP/") == 0) continue;
+
+        auto sepPos = line.find(':');
+        if (sepPos == std::string_view::npos) continue;
+        out.add(line.substr(0, sepPos), trim_view(line.substr(sepPos + 1)));
+    }
+}
+
+/// 请求头块 ("Name: value\r\n"...) 中是否已有某个头 (大小写不敏感)
+inline bool header_block_has(const std::string& block, const std::string& name)
+{
+    size_t pos = 0;
+    while (pos < block.size()) {
+        if (block.size() - pos > name.size() && block[pos + name.size()] == ':') {
+            bool match = true;
+            for (size_t i = 0; i < name.size(); ++i) {
+                if (std::tolower((unsigned char)block[pos + i]) != std::tolower((unsigned char)name[i])) { match = false; break; }
+            }
+            if (match) return true;
+        }
+        auto nl = block.find('\n', pos);
+        if (nl == std::string::npos) break;
+        pos = nl + 1;
+    }
+    return false;
+}
+
+/// 头块中名为 name 的全部值 (大小写不敏感)，多次出现时以 ", " 连接
+inline std::string header_block_values(const std::string& block, const std::string& name)
+{
+    std::string values;
+    size_t pos = 0;
+    while (pos < block.size()) {
+        auto nl = block.find('\n', pos);
+        size_t end = nl == std::string::npos ? block.size() : nl;
+        if (end - pos > name.size() && block[pos + name.size()] == ':') {
+            bool match = true;
+            for (size_t i = 0; i < name.size(); ++i) {
+                if (std::tolower((unsigned char)block[pos + i]) != std::tolower((unsigned char)name[i])) { match = false; break; }
+            }
+            if (match) {
+                if (!values.empty()) values += ", ";
+                values += trim_copy(block.substr(pos + name.size() + 1, end - pos - name.size() - 1));
+            }
+        }
+        if (nl == std::string::npos) break;
+        pos = nl + 1;
+    }
+    return values;
+}
+
+// ──────── 请求体文件 (sendfile / 内存映射) ────────
+
+/// 只读打开的请求体文件。明文 HTTP 连接由传输层经 fd() 交给 sendfile(2)；
+/// 其它情况 map() 把区间映射为只读内存直接交给发送函数，省去读入用户缓冲区的一次复制
+class BodyFile
+{
+public:
+    /// 映射视图: 析构时解除映射
+    class View
+    {
+    public:
+        View() = default;
+        View(View&& other) noexcept { *this = std::move(other); }
+        View& operator=(View&& other) noexcept
+        {
+            if (this != &other) {
+                unmap();
+                base_ = other.base_; mapped_ = other.mapped_; data_ = other.data_; size_ = other.size_;
+                other.base_ = nullptr; other.mapped_ = 0;
+            }
+            return *this;
+        }
+        ~View() { unmap(); }
+
+        const uint8_t* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        friend class BodyFile;
+        void*          base_   = nullptr;
+        size_t         mapped_ = 0;
+        const uint8_t* data_   = nullptr;
+        size_t         size_   = 0;
+
+        void unmap()
+        {
+            if (!base_) return;
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+            UnmapViewOfFile(base_);
+#else
+            ::munmap(base_, mapped_);
+#endif
+            base_ = nullptr;
+        }
+    };
+
+    explicit BodyFile(const std::string& path) : path_(path)
+    {
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        h_ = CreateFileW(to_wide(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                         OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (h_ == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open body file: " + path);
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) throw std::runtime_error("Cannot open body file: " + path + " (" + std::generic_category().message(errno) + ")");
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    ~BodyFile()
+    {
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        if (mapping_) CloseHandle(mapping_);
+        if (h_ != INVALID_HANDLE_VALUE) CloseHandle(h_);
+#else
+        if (fd_ >= 0) ::close(fd_);
+#endif
+    }
+
+    BodyFile(const BodyFile&) = delete;
+    BodyFile& operator=(const BodyFile&) = delete;
+
+#if !defined(DRX_HTTP_BACKEND_WINHTTP)
+    int fd() const { return fd_; }
+#endif
+
+    /// 映射 [offset, offset + length)。映射越过当前文件末尾会在访问时触发 SIGBUS / 访问异常，先行检查
+    View map(uint64_t offset, size_t length)
+    {
+        if (offset + length > current_size())
+            throw std::runtime_error("Body file truncated while sending: " + path_);
+
+        View view;
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        if (!mapping_) {
+            mapping_ = CreateFileMappingW(h_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping_) throw std::runtime_error("Cannot map body file: " + path_);
+        }
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        uint64_t aligned = offset - offset % si.dwAllocationGranularity;
+        size_t delta = (size_t)(offset - aligned);
+        void* base = MapViewOfFile(mapping_, FILE_MAP_READ, (DWORD)(aligned >> 32), (DWORD)aligned, delta + length);
+        if (!base) throw std::runtime_error("Cannot map body file: " + path_);
+#else
+        uint64_t page = (uint64_t)::sysconf(_SC_PAGESIZE);
+        uint64_t aligned = offset - offset % page;
+        size_t delta = (size_t)(offset - aligned);
+        void* base = ::mmap(nullptr, delta + length, PROT_READ, MAP_SHARED, fd_, (off_t)aligned);
+        if (base == MAP_FAILED) throw std::runtime_error("Cannot map body file: " + path_ + " (" + std::generic_category().message(errno) + ")");
+        ::madvise(base, delta + length, MADV_SEQUENTIAL);
+#endif
+        view.base_ = base;
+        view.mapped_ = delta + length;
+        view.data_ = static_cast<const uint8_t*>(base) + delta;
+        view.size_ = length;
+        return view;
+    }
+
+private:
+    std::string path_;
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+    HANDLE h_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+
+    uint64_t current_size() const
+    {
+        LARGE_INTEGER size;
+        return GetFileSizeEx(h_, &size) ? (uint64_t)size.QuadPart : 0;
+    }
+#else
+    int fd_ = -1;
+
+    uint64_t current_size() const
+    {
+        struct stat st;
+        return ::fstat(fd_, &st) == 0 ? (uint64_t)st.st_size : 0;
+    }
+#endif
+};
+
+// ──────── 流式请求体 ────────
+
+/// 请求体的一段: 内存 (自有或借用) 或文件区间
+struct BodySegment
+{
+    std::shared_ptr<const std::string> owned;
+    const uint8_t* data = nullptr;
+    std::string    path;            ///< 非空表示文件段
+    uint64_t       offset = 0;
+    uint64_t       length = 0;
+
+    const uint8_t* bytes() const
+    {
+        return data ? data : reinterpret_cast<const uint8_t*>(owned->data());
+    }
+
+    static BodySegment memory(std::string bytes)
+    {
+        BodySegment seg;
+        seg.length = bytes.size();
+        seg.owned = std::make_shared<const std::string>(std::move(bytes));
+        return seg;
+    }
+
+    static BodySegment borrowed(const void* data, size_t length)
+    {
+        BodySegment seg;
+        seg.data = static_cast<const uint8_t*>(data);
+        seg.length = length;
+        return seg;
+    }
+
+    /// length 为 UINT64_MAX 时取到文件末尾；区间超出文件时报错
+    static BodySegment file(const std::string& path, uint64_t offset, uint64_t length)
+    {
+        std::error_code ec;
+        auto fileSize = std::filesystem::file_size(path, ec);
+        if (ec) throw std::runtime_error("Cannot stat body file: " + path);
+        if (offset > fileSize) throw std::runtime_error("Body file range out of bounds: " + path);
+        if (length == UINT64_MAX) length = fileSize - offset;
+        if (length > fileSize - offset) throw std::runtime_error("Body file range out of bounds: " + path);
+        BodySegment seg;
+        seg.path = path;
+        seg.offset = offset;
+        seg.length = length;
+        return seg;
+    }
+};
+
+/// 由若干内存段与文件段依次拼成的请求体: 总长度预先确定 (用于 Content-Length)，
+/// 传输层通过 sendTo() 逐段发出，内存占用与 body 大小无关。每次 (重新) 发送都从头开始；
+/// 进度在数据真正写出后回调
+class BodyStream
+{
+public:
+    using Progress = std::function<void(uint64_t sent, uint64_t total)>;
+
+    static constexpr size_t kPiece     = 1024 * 1024;        ///< 每次写出 / 检查取消的粒度
+    static constexpr size_t kMapWindow = 64 * 1024 * 1024;   ///< 文件一次映射的最大长度
+
+    BodyStream() = default;
+    explicit BodyStream(const std::vector<BodySegment>& segments)
+    {
+        for (const auto& seg : segments) push(seg);
+    }
+
+    /// 复制一段内存 (如 multipart 的分隔头)
+    void addMemory(std::string bytes) { push(BodySegment::memory(std::move(bytes))); }
+
+    /// 引用一段调用方内存，发送完成前必须保持有效
+    void addBorrowed(const void* data, size_t length) { push(BodySegment::borrowed(data, length)); }
+
+    /// 文件 [offset, offset + length) 区间
+    void addFile(const std::string& path, uint64_t offset, uint64_t length) { push(BodySegment::file(path, offset, length)); }
+
+    void setProgress(Progress progress) { progress_ = std::move(progress); }
+    void setCancel(const CancelToken* cancel) { cancel_ = cancel; }
+
+    uint64_t size() const { return total_; }
+    uint64_t sentBytes() const { return sent_; }
+
+    /// 从头发出全部段。write(data, len) 写出一段内存；sendFile(file, offset, len) 尝试由内核直接
+    /// 发送文件区间 (sendfile)，返回 false 表示不支持 (如 TLS)，该文件段剩余部分改为映射内存后 write。
+    /// 取消时抛出 "Request cancelled"
+    template <class Write, class SendFile>
+    void sendTo(Write&& write, SendFile&& sendFile)
+    {
+        sent_ = 0;
+        for (const auto& seg : segments_) {
+            if (seg.path.empty()) {
+                send_memory(seg.bytes(), (size_t)seg.length, write);
+                continue;
+            }
+
+            BodyFile file(seg.path);
+            uint64_t done = 0;
+            while (done < seg.length) {
+                check_cancel();
+                size_t n = (size_t)std::min<uint64_t>(kPiece, seg.length - done);
+                if (!sendFile(file, seg.offset + done, n)) break;
+                done += n;
+                advance(n);
+            }
+            while (done < seg.length) {
+                auto view = file.map(seg.offset + done, (size_t)std::min<uint64_t>(kMapWindow, seg.length - done));
+                send_memory(view.data(), view.size(), write);
+                done += view.size();
+            }
+        }
+    }
+
+private:
+    void push(BodySegment seg)
+    {
+        total_ += seg.length;
+        if (seg.length > 0) segments_.push_back(std::move(seg));
+    }
+
+    template <class Write>
+    void send_memory(const uint8_t* data, size_t length, Write& write)
+    {
+        for (size_t pos = 0; pos < length; ) {
+            check_cancel();
+            size_t n = std::min(kPiece, length - pos);
+            write(data + pos, n);
+            pos += n;
+            advance(n);
+        }
+    }
+
+    void check_cancel() const
+    {
+        if (cancel_ && cancel_->isCancelled())
+            throw std::runtime_error("Request cancelled");
+    }
+
+    void advance(size_t n)
+    {
+        sent_ += n;
+        if (progress_) progress_(sent_, total_);
+    }
+
+    std::vector<BodySegment> segments_;
+    uint64_t                 total_ = 0;
+    uint64_t                 sent_ = 0;
+    Progress                 progress_;
+    const CancelToken*       cancel_ = nullptr;
+};
+
+// ──────── 下载目标文件 (按偏移写入) ────────
+
+/// 分段下载的临时文件: 预先分配到最终大小，各段由不同线程按偏移写入 (pwrite / 带偏移的 WriteFile)
+class PositionalFile
+{
+public:
+    explicit PositionalFile(const std::string& path) : path_(path)
+    {
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        h_ = CreateFileW(to_wide(path).c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                         CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (h_ == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot create temp file: " + path);
+#else
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) throw std::runtime_error("Cannot create temp file: " + path);
+#endif
+    }
+
+    ~PositionalFile() { close(); }
+
+    PositionalFile(const PositionalFile&) = delete;
+    PositionalFile& operator=(const PositionalFile&) = delete;
+
+    /// 把文件扩展到 size 字节 (尽量真正分配磁盘块，避免写入时碎片化或中途磁盘满)
+    void preallocate(uint64_t size)
+    {
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)size;
+        if (!SetFilePointerEx(h_, end, nullptr, FILE_BEGIN) || !SetEndOfFile(h_))
+            throw std::runtime_error("Cannot preallocate temp file: " + path_);
+#else
+        if (size == 0) return;
+        int rc = ::posix_fallocate(fd_, 0, (off_t)size);
+        if (rc == ENOSPC) throw std::runtime_error("Cannot preallocate temp file: " + path_ + " (no space left on device)");
+        if (rc != 0 && ::ftruncate(fd_, (off_t)size) != 0)
+            throw std::runtime_error("Cannot preallocate temp file: " + path_);
+#endif
+    }
+
+    /// 线程安全: 不同线程可同时写入互不重叠的区间
+    void writeAt(uint64_t offset, const void* data, size_t len)
+    {
+        auto p = static_cast<const char*>(data);
+        while (len > 0) {
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+            OVERLAPPED ov{};
+            ov.Offset = (DWORD)offset;
+            ov.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD written = 0;
+            DWORD want = (DWORD)std::min<size_t>(len, 1u << 30);
+            if (!WriteFile(h_, p, want, &written, &ov) || written == 0)
+                throw std::runtime_error("Cannot write temp file: " + path_);
+#else
+            ssize_t written = ::pwrite(fd_, p, len, (off_t)offset);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) throw std::runtime_error("Cannot write temp file: " + path_);
+#endif
+            p += written;
+            len -= (size_t)written;
+            offset += (uint64_t)written;
+        }
+    }
+
+    void close()
+    {
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+        if (h_ != INVALID_HANDLE_VALUE) { CloseHandle(h_); h_ = INVALID_HANDLE_VALUE; }
+#else
+        if (fd_ >= 0) { ::close(fd_); fd_ = -1; }
+#endif
+    }
+
+private:
+    std::string path_;
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+    HANDLE h_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+};
+
+// ──────── 传输层请求描述 ────────
+
+struct RequestSpec
+{
+    std::string method = "GET";
+    UrlParts    url;
+    std::string headers;                ///< "Name: value\r\n" 形式的请求头块 (UTF-8)
+    const void* body      = nullptr;
+    size_t      bodyLen   = 0;
+    BodyStream* bodyStream = nullptr;   ///< 非空时 body 从此流按块发出 (仅同步请求)，bodyLen 为其总长度
+    int         timeoutMs = 0;          ///< 0 = 使用后端默认超时
+    bool        ignoreSslErrors = false;
+    std::string errorPrefix;            ///< 错误消息前缀，如 "Download: "
+    bool        decodeContent = false;  ///< 已自动声明 Accept-Encoding，响应按 Content-Encoding 流式解压
+    std::shared_ptr<const std::vector<uint8_t>> encodedBody;   ///< 压缩后的请求体 (body 指向它)
+    CompressionInfo compression;        ///< 请求体压缩统计，随响应一并返回
+};
+
+// ──────── 内容编码 (Content-Encoding) ────────
+
+/// 当前线程已消耗的 CPU 时间 (ns)。Windows 的线程时间按调度时间片累计、精度不够，
+/// 改用单调时钟 (编解码期间不阻塞，两者基本一致)
+inline uint64_t thread_cpu_ns()
+{
+#if defined(DRX_HTTP_BACKEND_POSIX)
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+enum class ContentCoding { Identity, Gzip, Deflate, Brotli, Zstd, Unsupported };
+
+/// 解析 Content-Encoding。多重编码 ("gzip, br") 与未启用的编码返回 Unsupported，此时 body 原样交给调用方
+inline ContentCoding parse_content_coding(const std::string& value)
+{
+    auto v = to_lower(trim_copy(value));
+    if (v.empty() || v == "identity") return ContentCoding::Identity;
+#if defined(DRX_HTTP_ENABLE_ZLIB)
+    if (v == "gzip" || v == "x-gzip") return ContentCoding::Gzip;
+    if (v == "deflate") return ContentCoding::Deflate;
+#endif
+#if defined(DRX_HTTP_ENABLE_BROTLI)
+    if (v == "br") return ContentCoding::Brotli;
+#endif
+#if defined(DRX_HTTP_ENABLE_ZSTD)
+    if (v == "zstd") return ContentCoding::Zstd;
+#endif
+    return ContentCoding::Unsupported;
+}
+
+inline const char* content_coding_name(ContentCoding coding)
+{
+    switch (coding) {
+        case ContentCoding::Gzip:    return "gzip";
+        case ContentCoding::Deflate: return "deflate";
+        case ContentCoding::Brotli:  return "br";
+        case ContentCoding::Zstd:    return "zstd";
+        default:                     return "";
+    }
+}
+
+/// Accept-Encoding 的值: 已启用的编码；一个都未启用时为空 (不发送该头)
+inline const std::string& accept_encoding_value()
+{
+    static const std::string value = [] {
+        std::string v;
+#if defined(DRX_HTTP_ENABLE_ZLIB)
+        v += "gzip, deflate";
+#endif
+#if defined(DRX_HTTP_ENABLE_BROTLI)
+        v += v.empty() ? "br" : ", br";
+#endif
+#if defined(DRX_HTTP_ENABLE_ZSTD)
+        v += v.empty() ? "zstd" : ", zstd";
+#endif
+        return v;
+    }();
+    return value;
+}
+
+/// 解压后的 body 与这两个头不再对应，交给调用方前移除
+inline void strip_content_coding_headers(Headers& headers)
+{
+    headers.erase("Content-Encoding");
+    headers.erase("Content-Length");
+}
+
+/// 一次性压缩请求体 (请求体已整体在内存中)。level < 0 时用各编码的常用默认级别
+inline std::vector<uint8_t> compress_content(ContentCoding coding, const void* data, size_t len, int level)
+{
+    std::vector<uint8_t> out;
+    switch (coding) {
+#if defined(DRX_HTTP_ENABLE_ZLIB)
+        case ContentCoding::Gzip:
+        case ContentCoding::Deflate: {
+            z_stream z{};
+            // windowBits 15 + 16 写 gzip 头，15 为 zlib 包装 (HTTP 的 "deflate")
+            if (deflateInit2(&z, level < 0 ? 6 : level, Z_DEFLATED, coding == ContentCoding::Gzip ? 15 + 16 : 15,
+                             8, Z_DEFAULT_STRATEGY) != Z_OK)
+                throw std::runtime_error("deflateInit2 failed");
+            out.resize(deflateBound(&z, (uLong)len));
+            z.next_in   = const_cast<Bytef*>(static_cast<const Bytef*>(data));
+            z.avail_in  = (uInt)len;
+            z.next_out  = out.data();
+            z.avail_out = (uInt)out.size();
+            int rc = deflate(&z, Z_FINISH);
+            out.resize(z.total_out);
+            deflateEnd(&z);
+            if (rc != Z_STREAM_END) throw std::runtime_error("deflate failed");
+            return out;
+        }
+#endif
+#if defined(DRX_HTTP_ENABLE_BROTLI)
+        case ContentCoding::Brotli: {
+            size_t outLen = BrotliEncoderMaxCompressedSize(len);
+            out.resize(outLen ? outLen : len + 1024);
+            outLen = out.size();
+            if (!BrotliEncoderCompress(level < 0 ? 5 : level, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC,
+                                       len, static_cast<const uint8_t*>(data), &outLen, out.data()))
+                throw std::runtime_error("BrotliEncoderCompress failed");
+            out.resize(outLen);
+            return out;
+        }
+#endif
+#if defined(DRX_HTTP_ENABLE_ZSTD)
+        case ContentCoding::Zstd: {
+            out.resize(ZSTD_compressBound(len));
+            size_t n = ZSTD_compress(out.data(), out.size(), data, len, level < 0 ? 3 : level);
+            if (ZSTD_isError(n)) throw std::runtime_error(std::string("ZSTD_compress failed: ") + ZSTD_getErrorName(n));
+            out.resize(n);
+            return out;
+        }
+#endif
+        default:
+            break;
+    }
+    (void)data; (void)len; (void)level;
+    throw std::runtime_error("Unsupported request Content-Encoding");
+}
+
+/// 流式解压器。decode 从 in / inLen 消费输入 (输出区有空间时总会消费完) 并前移，返回写入 out 的字节数；
+/// 输出区被填满时解码器内部可能还有待输出数据，须以空输入再次调用。数据损坏时抛出 std::runtime_error
+class ContentDecoder
+{
+public:
+    explicit ContentDecoder(ContentCoding coding) : coding_(coding)
+    {
+        switch (coding) {
+#if defined(DRX_HTTP_ENABLE_ZLIB)
+            case ContentCoding::Gzip:    init_zlib(15 + 32); return;   // +32: 自动识别 gzip / zlib 头
+            case ContentCoding::Deflate: return;                       // 看到前两个字节后再初始化
+#endif
+#if defined(DRX_HTTP_ENABLE_BROTLI)
+            case ContentCoding::Brotli:
+                brotli_ = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+                if (!brotli_) throw std::runtime_error("BrotliDecoderCreateInstance failed");
+                return;
+#endif
+#if defined(DRX_HTTP_ENABLE_ZSTD)
+            case ContentCoding::Zstd:
+                zstd_ = ZSTD_createDCtx();
+                if (!zstd_) throw std::runtime_error("ZSTD_createDCtx failed");
+                return;
+#endif
+            default:
+                throw std::runtime_error("Unsupported Content-Encoding");
+        }
+    }
+
+    ~ContentDecoder()
+    {
+#if defined(DRX_HTTP_ENABLE_ZLIB)
+        if (zlibReady_) inflateEnd(&zlib_);
+#endif
+#if defined(DRX_HTTP_ENABLE_BROTLI)
+        if (brotli_) BrotliDecoderDestroyInstance(brotli_);
+#endif
+#if defined(DRX_HTTP_ENABLE_ZSTD)
+        if (zstd_) ZSTD_freeDCtx(zstd_);
+#endif
+    }
+
+    ContentDecoder(const ContentDecoder&) = delete;
+    ContentDecoder& operator=(const ContentDecoder&) = delete;
+
+    /// 压缩流已完整结束 (zstd 为当前帧结束)
+    bool finished() const { return finished_; }
+
+    size_t decode(const uint8_t*& in, size_t& inLen, uint8_t* out, size_t outCap)
+    {
+        switch (coding_) {
+#if defined(DRX_HTTP_ENABLE_ZLIB)
+            case ContentCoding::Gzip:
+            case ContentCoding::Deflate:
+                return decode_zlib(in, inLen, out, outCap);
+#endif
+#if defined(DRX_HTTP_ENABLE_BROTLI)
+            case ContentCoding::Brotli: {
+                size_t availIn = inLen, availOut = outCap;
+                const uint8_t* nextIn = in;
+                uint8_t* nextOut = out;
+                auto rc = BrotliDecoderDecompressStream(brotli_, &availIn, &nextIn, &availOut, &nextOut, nullptr);
+                in = nextIn;
+                inLen = availIn;
+                if (rc == BROTLI_DECODER_RESULT_ERROR)
+                    throw std::runtime_error(std::string("Content-Encoding br: ")
+                                             + BrotliDecoderErrorString(BrotliDecoderGetErrorCode(brotli_)));
+                if (rc == BROTLI_DECODER_RESULT_SUCCESS) finished_ = true;
+                return outCap - availOut;
+            }
+#endif
+#if defined(DRX_HTTP_ENABLE_ZSTD)
+            case ContentCoding::Zstd: {
+                ZSTD_inBuffer  input  = { in, inLen, 0 };
+                ZSTD_outBuffer output = { out, outCap, 0 };
+                size_t rc = ZSTD_decompressStream(zstd_, &output, &input);
+                if (ZSTD_isError(rc)) throw std::runtime_error(std::string("Content-Encoding zstd: ") + ZSTD_getErrorName(rc));
+                in += input.pos;
+                inLen -= input.pos;
+                finished_ = rc == 0;   // 之后若还有输入则是下一帧，继续解码
+                return output.pos;
+            }
+#endif
+            default:
+                (void)in; (void)inLen; (void)out; (void)outCap;
+                return 0;
+        }
+    }
+
+private:
+#if defined(DRX_HTTP_ENABLE_ZLIB)
+    void init_zlib(int windowBits)
+    {
+        if (inflateInit2(&zlib_, windowBits) != Z_OK) throw std::runtime_error("inflateInit2 failed");
+        zlibReady_ = true;
+    }
+
+    size_t decode_zlib(const uint8_t*& in, size_t& inLen, uint8_t* out, size_t outCap)
+    {
+        if (!zlibReady_) {
+            // "deflate" 按规范是 zlib 包装，但不少服务器发送裸 deflate: 按前两个字节是否构成 zlib 头决定
+            while (sniffLen_ < 2 && inLen > 0) { sniff_[sniffLen_++] = *in++; --inLen; }
+            if (sniffLen_ < 2) return 0;
+            bool zlibHeader = (sniff_[0] & 0x0f) == 8 && ((sniff_[0] << 8) | sniff_[1]) % 31 == 0;
+            init_zlib(zlibHeader ? 15 : -15);
+        }
+        size_t produced = 0;
+        if (sniffPos_ < sniffLen_) {
+            const uint8_t* p = sniff_ + sniffPos_;
+            size_t n = sniffLen_ - sniffPos_;
+            produced = inflate_some(p, n, out, outCap);
+            sniffPos_ = sniffLen_ - n;
+            if (sniffPos_ < sniffLen_ || produced == outCap) return produced;
+        }
+        // gzip 允许多个成员首尾相接；流结束后的其他字节由调用方丢弃
+        if (finished_ && coding_ == ContentCoding::Gzip && inLen > 0 && in[0] == 0x1f) {
+            inflateReset(&zlib_);
+            finished_ = false;
+        }
+        return produced + inflate_some(in, inLen, out + produced, outCap - produced);
+    }
+
+    size_t inflate_some(const uint8_t*& in, size_t& inLen, uint8_t* out, size_t outCap)
+    {
+        if (finished_ || outCap == 0) return 0;
+        uInt availIn = (uInt)std::min<size_t>(inLen, 1u << 30);
+        zlib_.next_in   = const_cast<Bytef*>(in);
+        zlib_.avail_in  = availIn;
+        zlib_.next_out  = out;
+        zlib_.avail_out = (uInt)std::min<size_t>(outCap, 1u << 30);
+        uInt availOut   = zlib_.avail_out;
+        int rc = inflate(&zlib_, Z_NO_FLUSH);
+        in    += availIn - zlib_.avail_in;
+        inLen -= availIn - zlib_.avail_in;
+        if (rc == Z_STREAM_END) finished_ = true;
+        else if (rc != Z_OK && rc != Z_BUF_ERROR)
+            throw std::runtime_error(std::string("Content-Encoding ") + content_coding_name(coding_) + ": "
+                                     + (zlib_.msg ? zlib_.msg : "invalid compressed data"));
+        return availOut - zlib_.avail_out;
+    }
+
+    z_stream zlib_{};
+    bool     zlibReady_ = false;
+    uint8_t  sniff_[2] = {};
+    size_t   sniffLen_ = 0;
+    size_t   sniffPos_ = 0;
+#endif
+#if defined(DRX_HTTP_ENABLE_BROTLI)
+    BrotliDecoderState* brotli_ = nullptr;
+#endif
+#if defined(DRX_HTTP_ENABLE_ZSTD)
+    ZSTD_DCtx* zstd_ = nullptr;
+#endif
+    ContentCoding coding_;
+    bool          finished_ = false;
+};
+
+/// 响应体解码: 包装 ContentDecoder 并统计线上 / 解压后字节与解压 CPU 时间。
+/// read 从传输层拉取 (同步路径，直接解压进调用方缓冲区)；push 接收异步引擎推送的分段
+class ResponseDecoder
+{
+public:
+    /// 请求自动声明了 Accept-Encoding、响应带 body 且 Content-Encoding 为单一已启用编码时创建，否则返回空 (body 原样交出)
+    static std::unique_ptr<ResponseDecoder> create(const RequestSpec& spec, int statusCode, const HeaderList& headers)
+    {
+        if (!spec.decodeContent || spec.method == "HEAD" || statusCode < 200 || statusCode == 204 || statusCode == 304)
+            return nullptr;
+        auto coding = parse_content_coding(find_header(headers, "Content-Encoding"));
+        if (coding == ContentCoding::Identity || coding == ContentCoding::Unsupported) return nullptr;
+        return std::make_unique<ResponseDecoder>(coding);
+    }
+
+    explicit ResponseDecoder(ContentCoding coding) : decoder_(coding) { info_.encoding = content_coding_name(coding); }
+
+    /// 读出至多 size 字节解压后的数据，返回 0 表示 body 结束 (压缩流不完整时抛出)
+    template <class Source>
+    size_t read(Source& source, void* buffer, size_t size)
+    {
+        if (size == 0) return 0;
+        auto* out = static_cast<uint8_t*>(buffer);
+        if (!input_) input_.reset(new uint8_t[kBufferSize]);
+        while (true) {
+            if (inPos_ < inLen_ || pending_) {
+                const uint8_t* p = input_.get() + inPos_;
+                size_t left = inLen_ - inPos_;
+                size_t n = run(p, left, out, size);
+                inPos_ = inLen_ - left;
+                if (n > 0) return n;
+            }
+            if (eof_) {
+                finish();
+                return 0;
+            }
+            inPos_ = 0;
+            inLen_ = source.read(input_.get(), kBufferSize);
+            info_.compressedBytes += inLen_;
+            if (inLen_ == 0) eof_ = true;
+        }
+    }
+
+    /// 推送一段线上数据，解压结果分段交给 sink(const char*, size_t)
+    template <class Sink>
+    void push(const char* data, size_t len, Sink&& sink)
+    {
+        info_.compressedBytes += len;
+        if (!output_) output_.reset(new uint8_t[kBufferSize]);
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+        do {
+            size_t n = run(p, len, output_.get(), kBufferSize);
+            if (n > 0) sink(reinterpret_cast<const char*>(output_.get()), n);
+        } while (len > 0 || pending_);
+    }
+
+    /// 线上数据已全部到达: 压缩流没有正常结束 (连接中途断开等) 时抛出
+    void finish() const
+    {
+        // 空 body 也会带 Content-Encoding (部分服务器如此)，不算截断
+        if (!decoder_.finished() && info_.compressedBytes > 0)
+            throw std::runtime_error("Content-Encoding " + info_.encoding + ": truncated body");
+    }
+
+    const CompressionInfo& info() const { return info_; }
+
+private:
+    static constexpr size_t kBufferSize = 64 * 1024;
+
+    size_t run(const uint8_t*& in, size_t& len, uint8_t* out, size_t size)
+    {
+        uint64_t start = thread_cpu_ns();
+        size_t n = decoder_.decode(in, len, out, size);
+        info_.decodeCpuMs += (double)(thread_cpu_ns() - start) / 1e6;
+        info_.decompressedBytes += n;
+        pending_ = n == size;
+        if (n == 0 && len > 0) {
+            if (!decoder_.finished()) throw std::runtime_error("Content-Encoding " + info_.encoding + ": decoder made no progress");
+            len = 0;   // 压缩流结束后的多余字节
+        }
+        return n;
+    }
+
+    ContentDecoder             decoder_;
+    CompressionInfo            info_;
+    std::unique_ptr<uint8_t[]> input_;
+    std::unique_ptr<uint8_t[]> output_;
+    size_t                     inPos_ = 0;
+    size_t                     inLen_ = 0;
+    bool                       pending_ = false;
+    bool                       eof_ = false;
+};
+
+/// 同步读取路径把 (传输层, 解码器) 当作一个数据源
+template <class Source>
+struct DecodedSource
+{
+    Source&          source;
+    ResponseDecoder& decoder;
+
+    size_t read(void* buffer, size_t size) { return decoder.read(source, buffer, size); }
+};
+
+/// 客户端累计的编解码统计
+class CompressionCounters
+{
+public:
+    void add(const CompressionInfo& info)
+    {
+        if (info.encoding.empty() && info.requestEncoding.empty()) return;
+        std::lock_guard<std::mutex> lock(mu_);
+        if (!info.encoding.empty()) {
+            ++stats_.responsesDecoded;
+            stats_.compressedBytes   += info.compressedBytes;
+            stats_.decompressedBytes += info.decompressedBytes;
+            stats_.decodeCpuMs       += info.decodeCpuMs;
+        }
+        if (!info.requestEncoding.empty()) {
+            ++stats_.requestsEncoded;
+            stats_.requestBytes     += info.requestBytes;
+            stats_.requestWireBytes += info.requestWireBytes;
+            stats_.encodeCpuMs      += info.encodeCpuMs;
+        }
+    }
+
+    CompressionStats snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        return stats_;
+    }
+
+private:
+    mutable std::mutex mu_;
+    CompressionStats   stats_;
+};
+
+// ──────── 不可变快照 (读多写少的配置) ────────
+
+/// 发布不可变对象 T 的快照。写入方加锁复制当前快照、修改后整体替换。
+/// 读取方在本线程的槽位 (Entry，每线程每个 cell 一个，由 cell 与线程共同持有) 里钉住快照:
+/// 版本号一致时只对本线程独占的钉住计数做一次原子加，不加锁，也不碰快照的引用计数，
+/// 多线程读取之间没有共享的缓存行。
+/// 发布新快照时顺带释放其他线程槽位里没有被钉住的旧快照，cell 析构时释放全部槽位，
+/// 因此空闲线程不会让旧快照 (以及日志回调捕获的对象) 一直存活
+template <typename T>
+class SnapshotCell
+{
+    struct Entry;
+
+public:
+    /// load() 返回的读取句柄: 存活期间快照保持有效。只能移动，可在钉住它的线程之外析构
+    class Snapshot
+    {
+    public:
+        Snapshot(Snapshot&& other) noexcept
+            : value_(std::exchange(other.value_, nullptr)), pinned_(std::exchange(other.pinned_, nullptr)),
+              owned_(std::move(other.owned_))
+        {
+        }
+        Snapshot& operator=(Snapshot&&) = delete;
+        Snapshot(const Snapshot&) = delete;
+        ~Snapshot()
+        {
+            if (pinned_) pinned_->pins.fetch_sub(1, std::memory_order_release);
+        }
+
+        const T& operator*() const  { return *value_; }
+        const T* operator->() const { return value_; }
+        const T* get() const        { return value_; }
+
+    private:
+        friend class SnapshotCell;
+        Snapshot(const T* value, Entry* pinned, std::shared_ptr<const T> owned)
+            : value_(value), pinned_(pinned), owned_(std::move(owned))
+        {
+        }
+
+        const T*                 value_;
+        Entry*                   pinned_;   ///< 钉住的槽位；槽位已被本线程的外层句柄钉住旧版本时为空，改为持有 owned_
+        std::shared_ptr<const T> owned_;
+    };
+
+    explicit SnapshotCell(std::shared_ptr<const T> initial = std::make_shared<const T>())
+        : id_(next_version()), current_(std::move(initial)), version_(next_version())
+    {
+    }
+
+    ~SnapshotCell()
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        for (auto& e : entries_) e->release(false);
+    }
+
+    SnapshotCell(const SnapshotCell&) = delete;
+    SnapshotCell& operator=(const SnapshotCell&) = delete;
+
+    Snapshot load() const
+    {
+        Entry* e = entry();
+        for (;;) {
+            uint64_t version = version_.load(std::memory_order_acquire);
+            // 先钉住再核对槽位版本；与 Entry::release() 的"先清版本再查钉住计数"配对 (均为 seq_cst)，
+            // 两边至少有一方看到对方，槽位里的快照不会在钉住期间被释放
+            e->pins.fetch_add(1, std::memory_order_seq_cst);
+            if (e->version.load(std::memory_order_seq_cst) == version)
+                return Snapshot(e->raw.load(std::memory_order_relaxed), e, nullptr);
+            e->pins.fetch_sub(1, std::memory_order_release);
+
+            std::shared_ptr<const T> value;
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                value = current_;
+                version = version_.load(std::memory_order_relaxed);
+            }
+            std::lock_guard<std::mutex> lock(e->mu);
+            if (e->pins.load(std::memory_order_acquire) != 0) {
+                // 本线程的外层句柄仍钉着旧版本 (请求中途配置已更新)，不能替换槽位
+                const T* raw = value.get();
+                return Snapshot(raw, nullptr, std::move(value));
+            }
+            e->value.swap(value);
+            e->raw.store(e->value.get(), std::memory_order_relaxed);
+            e->version.store(version, std::memory_order_seq_cst);
+            // 回到循环开头按版本号钉住
+        }
+    }
+
+    /// 复制当前快照交给 mutate 修改后发布。mutate 抛出异常时不发布
+    template <typename Fn>
+    void update(Fn&& mutate)
+    {
+        std::vector<std::shared_ptr<Entry>> entries;
+        uint64_t version;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            auto next = std::make_shared<T>(*current_);
+            mutate(*next);
+            current_ = std::move(next);
+            version = next_version();
+            version_.store(version, std::memory_order_release);
+            // 线程已退出且没有句柄钉住的槽位不再需要
+            entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [](const std::shared_ptr<Entry>& e) {
+                               return e->gone.load(std::memory_order_acquire) && e->pins.load(std::memory_order_acquire) == 0;
+                           }), entries_.end());
+            entries = entries_;
+        }
+        // 释放各线程槽位中没有被钉住的旧快照；对应线程下次 load() 时重新取
+        for (auto& e : entries) e->release(false, version);
+    }
+
+private:
+    static constexpr size_t kSlots = 4;   ///< 每线程直接索引的 cell 数 (同一线程使用多个客户端时各占一项)
+
+    /// 一个线程在一个 cell 上的槽位。只有所属线程增加 pins；version / raw / value 的写入持有 mu
+    struct alignas(64) Entry
+    {
+        std::mutex               mu;
+        std::atomic<uint64_t>    version{0};    ///< 0 表示槽位无效
+        std::atomic<const T*>    raw{nullptr};  ///< value.get()，供无锁读取
+        std::shared_ptr<const T> value;
+        std::atomic<uint32_t>    pins{0};
+        std::atomic<bool>        gone{false};   ///< 线程已退出或槽位已被挤出
+
+        /// 使槽位失效 (版本为 keep 时保留)，没有被钉住时释放快照；gone 为真时标记槽位不再使用
+        void release(bool retire, uint64_t keep = 0)
+        {
+            std::shared_ptr<const T> old;   // 在锁外析构
+            std::lock_guard<std::mutex> lock(mu);
+            if (retire) gone.store(true, std::memory_order_release);
+            if (keep && version.load(std::memory_order_relaxed) == keep) return;
+            version.store(0, std::memory_order_seq_cst);
+            if (pins.load(std::memory_order_seq_cst) != 0) return;
+            raw.store(nullptr, std::memory_order_relaxed);
+            old.swap(value);
+        }
+    };
+
+    struct Slot
+    {
+        uint64_t               cell = 0;
+        std::shared_ptr<Entry> entry;
+    };
+
+    struct ThreadCache
+    {
+        Slot   slots[kSlots];
+        size_t next = 0;
+
+        ~ThreadCache()
+        {
+            for (auto& slot : slots) if (slot.entry) slot.entry->release(true);
+        }
+    };
+
+    static ThreadCache& thread_cache()
+    {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+
+    static uint64_t next_version()
+    {
+        static std::atomic<uint64_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    /// 本线程在此 cell 上的槽位，首次使用时登记 (cell 标识全局唯一，不会与已析构的 cell 混淆)
+    Entry* entry() const
+    {
+        auto& cache = thread_cache();
+        for (auto& slot : cache.slots)
+            if (slot.cell == id_) return slot.entry.get();
+
+        auto e = std::make_shared<Entry>();
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            entries_.push_back(e);
+        }
+        auto& slot = cache.slots[cache.next++ % kSlots];
+        if (slot.entry) slot.entry->release(true);
+        slot.cell = id_;
+        slot.entry = std::move(e);
+        return slot.entry.get();
+    }
+
+    const uint64_t                              id_;
+    mutable std::mutex                          mu_;        ///< 只在写入、登记槽位与槽位版本过期时使用
+    std::shared_ptr<const T>                    current_;
+    std::atomic<uint64_t>                       version_;
+    mutable std::vector<std::shared_ptr<Entry>> entries_;
+};
+
+// ──────── HTTP/1.1 响应解析器 (增量、零拷贝 body) ────────
+
+/// 增量解析 HTTP/1.1 响应。响应头通过 parseHead() 逐段喂入；
+/// body 通过 parseBody() 取出指向输入缓冲区的数据片段（不复制），
+/// 支持 Content-Length、chunked 与读到连接关闭三种分帧方式。
+class Http1ResponseParser
+{
+public:
+    enum class State { StatusLine, HeaderLines, Body, ChunkSize, ChunkData, ChunkDataEnd, Trailers, UntilClose, Done };
+
+    static constexpr size_t kMaxHeadBytes = 64 * 1024;
+    static constexpr size_t kMaxLineBytes = 8 * 1024;
+
+    int         statusCode    = 0;
+    int         versionMinor  = 1;
+    std::string reasonPhrase;
+    HeaderList  headers;
+    int64_t     contentLength = -1;
+
+    void reset(bool headRequest = false)
+    {
+        state_ = State::StatusLine;
+        headRequest_ = headRequest;
+        line_.clear();
+        headBytes_ = 0;
+        remaining_ = 0;
+        connectionClose_ = false;
+        connectionKeepAlive_ = false;
+        statusCode = 0;
+        versionMinor = 1;
+        reasonPhrase.clear();
+        headers.clear();
+        contentLength = -1;
+    }
+
+    State state() const { return state_; }
+    bool headComplete() const { return state_ != State::StatusLine && state_ != State::HeaderLines; }
+    bool done() const { return state_ == State::Done; }
+
+    /// 响应结束后连接能否复用
+    bool keepAlive() const
+    {
+        if (state_ == State::UntilClose || untilClose_ || connectionClose_) return false;
+        return versionMinor >= 1 || connectionKeepAlive_;
+    }
+
+    /// 解析状态行与响应头，返回消费的字节数
+    size_t parseHead(const char* data, size_t len)
+    {
+        size_t i = 0;
+        while (i < len && !headComplete()) {
+            auto nl = static_cast<const char*>(std::memchr(data + i, '\n', len - i));
+            size_t take = nl ? (size_t)(nl - (data + i)) + 1 : len - i;
+            headBytes_ += take;
+            if (headBytes_ > kMaxHeadBytes)
+                throw std::runtime_error("HTTP response header too large");
+
+            if (!nl) { line_.append(data + i, take); i += take; break; }
+
+            std::string_view line;
+            if (line_.empty()) {
+                line = std::string_view(data + i, take - 1);
+            } else {
+                line_.append(data + i, take - 1);
+                line = line_;
+            }
+            i += take;
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            on_head_line(line);
+            line_.clear();
+        }
+        return i;
+    }
+
+    /// 从输入中取出下一段 body (out 指向 data 内部)，返回消费的字节数。
+    /// 返回值可能大于 outLen —— 差值是 chunked 分帧字节。
+    size_t parseBody(const char* data, size_t len, const char*& out, size_t& outLen, size_t maxOut = SIZE_MAX)
+    {
+        out = nullptr;
+        outLen = 0;
+        if (len == 0) return 0;
+
+        switch (state_) {
+            case State::Body:
+            case State::ChunkData: {
+                size_t n = (size_t)std::min<uint64_t>({ (uint64_t)len, remaining_, (uint64_t)maxOut });
+                out = data;
+                outLen = n;
+                consumeDirect(n);
+                return n;
+            }
+            case State::UntilClose: {
+                size_t n = std::min(len, maxOut);
+                out = data;
+                outLen = n;
+                return n;
+            }
+            case State::ChunkSize:
+            case State::ChunkDataEnd:
+            case State::Trailers: {
+                auto nl = static_cast<const char*>(std::memchr(data, '\n', len));
+                size_t take = nl ? (size_t)(nl - data) + 1 : len;
+                if (line_.size() + take > kMaxLineBytes)
+                    throw std::runtime_error("HTTP chunk framing line too long");
+                line_.append(data, nl ? take - 1 : take);
+                if (nl) {
+                    if (!line_.empty() && line_.back() == '\r') line_.pop_back();
+                    on_framing_line(line_);
+                    line_.clear();
+                }
+                return take;
+            }
+            default:
+                return 0;
+        }
+    }
+
+    /// 当前可以直接读入调用方缓冲区的 body 字节上限 (0 = 需经过 parseBody)
+    uint64_t directBodyLimit() const
+    {
+        if (state_ == State::Body || state_ == State::ChunkData) return remaining_;
+        if (state_ == State::UntilClose) return UINT64_MAX;
+        return 0;
+    }
+
+    /// 通知解析器调用方已直接读取了 n 字节 body
+    void consumeDirect(size_t n)
+    {
+        if (state_ == State::UntilClose) return;
+        remaining_ -= n;
+        if (remaining_ == 0) state_ = (state_ == State::Body) ? State::Done : State::ChunkDataEnd;
+    }
+
+    /// 连接在对端关闭 (EOF) 时调用
+    void finishOnEof()
+    {
+        if (state_ == State::UntilClose) { state_ = State::Done; return; }
+        if (state_ != State::Done)
+            throw std::runtime_error("error=CONNECTION_ERROR connection closed before response completed");
+    }
+
+private:
+    State       state_ = State::StatusLine;
+    bool        headRequest_ = false;
+    bool        untilClose_ = false;
+    bool        connectionClose_ = false;
+    bool        connectionKeepAlive_ = false;
+    std::string line_;
+    size_t      headBytes_ = 0;
+    uint64_t    remaining_ = 0;
+
+    void on_head_line(std::string_view line)
+    {
+        if (state_ == State::StatusLine) {
+            if (line.empty()) return;   // 容忍前导空行
+            if (line.size() < 12 || line.substr(0, 7) != "HTTP/1." || line[8] != ' ')
+                throw std::runtime_error("Invalid HTTP status line: " + std::string(line.substr(0, 64)));
+            versionMinor = line[7] - '0';
+            int code = 0;
+            for (size_t i = 9; i < 12; ++i) {
+                if (line[i] < '0' || line[i] > '9')
+                    throw std::runtime_error("Invalid HTTP status code: " + std::string(line.substr(0, 64)));
+                code = code * 10 + (line[i] - '0');
+            }
+            statusCode = code;
+            reasonPhrase = line.size() > 13 ? std::string(line.substr(13)) : std::string();
+            state_ = State::HeaderLines;
+            return;
+        }
+
+        if (line.empty()) { end_of_head(); return; }
+
+        if ((line[0] == ' ' || line[0] == '\t') && !headers.empty()) {
+            // obs-fold: 续行并入上一个头
+            headers.appendToLast(" " + trim_copy(line));
+            return;
+        }
+
+        auto sep = line.find(':');
+        if (sep == std::string_view::npos) return;
+        headers.add(line.substr(0, sep), trim_view(line.substr(sep + 1)));
+    }
+
+    void end_of_head()
+    {
+        // 1xx 临时响应 (101 除外) 直接丢弃，继续解析最终响应
+        if (statusCode >= 100 && statusCode < 200 && statusCode != 101) {
+            state_ = State::StatusLine;
+            headers.clear();
+            return;
+        }
+
+        bool chunked = false;
+        for (const auto& [k, v] : headers.fields()) {
+            if (iequals(k, "Transfer-Encoding")) {
+                if (to_lower(v).find("chunked") != std::string::npos) chunked = true;
+            } else if (iequals(k, "Content-Length")) {
+                try { contentLength = std::stoll(std::string(v)); } catch (...) { contentLength = -1; }
+            } else if (iequals(k, "Connection")) {
+                auto lv = to_lower(v);
+                if (lv.find("close") != std::string::npos) connectionClose_ = true;
+                if (lv.find("keep-alive") != std::string::npos) connectionKeepAlive_ = true;
+            }
+        }
+
+        untilClose_ = false;
+        if (headRequest_ || statusCode == 204 || statusCode == 304 || statusCode < 200) {
+            state_ = State::Done;
+        } else if (chunked) {
+            state_ = State::ChunkSize;
+        } else if (contentLength >= 0) {
+            remaining_ = (uint64_t)contentLength;
+            state_ = remaining_ > 0 ? State::Body : State::Done;
+        } else {
+            untilClose_ = true;
+            state_ = State::UntilClose;
+        }
+    }
+
+    void on_framing_line(const std::string& line)
+    {
+        if (state_ == State::ChunkSize) {
+            uint64_t size = 0;
+            size_t i = 0;
+            for (; i < line.size(); ++i) {
+                char c = line[i];
+                int v;
+                if (c >= '0' && c <= '9') v = c - '0';
+                else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+                else break;
+                if (size > (UINT64_MAX >> 4)) throw std::runtime_error("HTTP chunk size overflow");
+                size = (size << 4) | (uint64_t)v;
+            }
+            if (i == 0) throw std::runtime_error("Invalid HTTP chunk size line");
+            if (size == 0) { state_ = State::Trailers; return; }
+            remaining_ = size;
+            state_ = State::ChunkData;
+        } else if (state_ == State::ChunkDataEnd) {
+            if (!line.empty()) throw std::runtime_error("Invalid HTTP chunk terminator");
+            state_ = State::ChunkSize;
+        } else if (state_ == State::Trailers) {
+            if (line.empty()) state_ = State::Done;
+        }
+    }
+};
+
+/// "host[:port]"，默认端口省略
+inline std::string host_header_value(const UrlParts& url)
+{
+    bool defaultPort = (url.isHttps && url.port == 443) || (!url.isHttps && url.port == 80);
+    return defaultPort ? url.host : url.host + ":" + std::to_string(url.port);
+}
+
+/// "scheme://host[:port]/path?query"，用作缓存与请求合并的键
+inline std::string url_identity(const UrlParts& url)
+{
+    return (url.isHttps ? "https://" : "http://") + host_header_value(url) + url.path;
+}
+
+/// 幂等方法 (RFC 9110 §9.2.2)：连接在请求写出后断开时可以自动重发
+inline bool is_idempotent_method(std::string_view method)
+{
+    return method == "GET" || method == "HEAD" || method == "OPTIONS" ||
+           method == "PUT" || method == "DELETE" || method == "TRACE";
+}
+
+inline std::string build_http1_request_head(const std::string& method,
+                                            const std::string& target,
+                                            const UrlParts& url,
+                                            const std::string& headerBlock,
+                                            size_t bodyLen,
+                                            const std::string& userAgent)
+{
+    std::string head;
+    head.reserve(128 + target.size() + headerBlock.size());
+    head += method; head += ' '; head += target; head += " HTTP/1.1\r\n";
+    head += "Host: "; head += host_header_value(url); head += "\r\n";
+    if (!userAgent.empty() && !header_block_has(headerBlock, "User-Agent"))
+        head += "User-Agent: " + userAgent + "\r\n";
+    head += headerBlock;
+    bool needsLength = bodyLen > 0 || method == "POST" || method == "PUT" || method == "PATCH";
+    if (needsLength && !header_block_has(headerBlock, "Content-Length"))
+        head += "Content-Length: " + std::to_string(bodyLen) + "\r\n";
+    head += "\r\n";
+    return head;
+}
+
+/// 解析重定向 Location (绝对 / 协议相对 / 绝对路径 / 相对路径)
+inline std::string resolve_redirect(const UrlParts& base, const std::string& location)
+{
+    if (location.find("://") != std::string::npos) return location;
+    std::string scheme = base.isHttps ? "https:" : "http:";
+    if (location.compare(0, 2, "//") == 0) return scheme + location;
+    std::string origin = scheme + "//" + host_header_value(base);
+    if (!location.empty() && location[0] == '/') return origin + location;
+    auto path = base.path.substr(0, base.path.find('?'));
+    return origin + path.substr(0, path.rfind('/') + 1) + location;
+}
+
+/// 按 WinHTTP 默认策略计算重定向的下一跳 (禁止 https -> http；303 及 POST 的 301/302 改为 GET)。
+/// 返回 false 表示不跟随，此时参数保持不变。
+inline bool next_redirect(int status, const HeaderList& headers, UrlParts& url,
+                          std::string& method, const void*& body, size_t& bodyLen)
+{
+    bool isRedirect = status == 301 || status == 302 || status == 303 || status == 307 || status == 308;
+    if (!isRedirect) return false;
+    auto location = find_header(headers, "Location");
+    if (location.empty()) return false;
+    auto next = parse_url(resolve_redirect(url, location));
+    if (url.isHttps && !next.isHttps) return false;
+
+    if (status == 303 || ((status == 301 || status == 302) && method == "POST")) {
+        method = "GET";
+        body = nullptr;
+        bodyLen = 0;
+    }
+    url = next;
+    return true;
+}
+
+// ──────── 有界无锁 MPMC 队列 (Dmitry Vyukov 算法) ────────
+
+/// 每个槽位带序号: 生产者/消费者各自 CAS 推进位置，槽位序号判定空/满，无需互斥锁。
+/// 容量向上取整为 2 的幂。
+template <typename T>
+class BoundedMpmcQueue
+{
+public:
+    explicit BoundedMpmcQueue(size_t capacity)
+    {
+        size_t n = 2;
+        while (n < capacity) n <<= 1;
+        mask_ = n - 1;
+        cells_.reset(new Cell[n]);
+        for (size_t i = 0; i < n; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedMpmcQueue(const BoundedMpmcQueue&) = delete;
+    BoundedMpmcQueue& operator=(const BoundedMpmcQueue&) = delete;
+
+    /// 队列满时返回 false，value 保持不变
+    bool tryPush(T& value)
+    {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// 队列空时返回 false
+    bool tryPop(T& out)
+    {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(cell->value);
+        cell->value = T();
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    /// 近似长度 (并发修改时仅供统计)
+    size_t sizeApprox() const
+    {
+        size_t enq = enqueuePos_.load(std::memory_order_relaxed);
+        size_t deq = dequeuePos_.load(std::memory_order_relaxed);
+        return enq > deq ? std::min(enq - deq, capacity()) : 0;
+    }
+
+private:
+    struct alignas(64) Cell
+    {
+        std::atomic<size_t> seq{0};
+        T                   value{};
+    };
+
+    std::unique_ptr<Cell[]>          cells_;
+    size_t                           mask_ = 0;
+    alignas(64) std::atomic<size_t>  enqueuePos_{0};
+    alignas(64) std::atomic<size_t>  dequeuePos_{0};
+};
+
+// ──────── 固定工作线程池 ────────
+
+/// 固定数量的工作线程消费 BoundedMpmcQueue。入队/出队走无锁快路径，
+/// 只有队列空 (工作线程) 或满 (生产者) 需要休眠时才用 mutex + condition_variable 停靠。
+/// stop() 先执行完已入队的任务再回收线程。
+class WorkerPool
+{
+public:
+    using Task = std::function<void()>;
+
+    WorkerPool(int workers, size_t capacity)
+        : queue_(capacity), workers_(std::max(workers, 1))
+    {
+        threads_.reserve((size_t)workers_);
+        for (int i = 0; i < workers_; ++i)
+            threads_.emplace_back([this]() { worker_loop(); });
+    }
+
+    ~WorkerPool() { stop(); }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// 入队。timeoutMs < 0 一直等待；0 不等待；> 0 最多等待该时长。队列满返回 false
+    bool submit(Task task, int timeoutMs)
+    {
+        Item item{ std::move(task), Clock::now() };
+        if (!push(item, timeoutMs)) {
+            rejected_++;
+            return false;
+        }
+        enqueued_++;
+        wake(notEmpty_, consumersWaiting_);
+        return true;
+    }
+
+    /// 工作线程内的阻塞入队: 队列满时不等待，直接在当前线程执行任务。
+    /// 所有工作线程都在任务里阻塞入队时，没有线程能腾出队列位置，等待会永久卡住
+    void submitOrRun(Task task)
+    {
+        Item item{ std::move(task), Clock::now() };
+        enqueued_++;
+        if (push(item, 0)) {
+            wake(notEmpty_, consumersWaiting_);
+            return;
+        }
+        started_++;
+        try { item.task(); } catch (...) {}
+        completed_++;
+    }
+
+    /// 停止接收新任务，执行完队列中剩余任务后回收线程
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(parkMu_);
+            if (stopping_.exchange(true)) return;
+        }
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+        for (auto& t : threads_) if (t.joinable()) t.join();
+        threads_.clear();
+
+        // 与 stop 并发、在工作线程退出后才入队成功的任务由调用线程执行
+        Item item;
+        while (queue_.tryPop(item)) run(item);
+    }
+
+    /// 当前线程是否为本池的工作线程 (任务里再次阻塞入队会与其他工作线程一起卡在满队列上)
+    bool onWorkerThread() const { return current_pool() == this; }
+
+    QueueStats stats() const
+    {
+        QueueStats s;
+        s.depth         = queue_.sizeApprox();
+        s.capacity      = queue_.capacity();
+        s.workers       = workers_;
+        s.activeWorkers = active_.load();
+        s.enqueued      = enqueued_.load();
+        s.completed     = completed_.load();
+        s.rejected      = rejected_.load();
+        uint64_t started = started_.load();
+        s.avgWaitMs     = started ? waitTotalNs_.load() / 1e6 / (double)started : 0.0;
+        s.maxWaitMs     = waitMaxNs_.load() / 1e6;
+        return s;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Item
+    {
+        Task              task;
+        Clock::time_point enqueuedAt;
+    };
+
+    BoundedMpmcQueue<Item>   queue_;
+    int                      workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex               parkMu_;
+    std::condition_variable  notEmpty_, notFull_;
+    std::atomic<int>         consumersWaiting_{0}, producersWaiting_{0};
+    std::atomic<bool>        stopping_{false};    ///< 置位时持有 parkMu_，保证休眠方不会错过
+
+    std::atomic<int>         active_{0};
+    std::atomic<uint64_t>    enqueued_{0}, completed_{0}, rejected_{0}, started_{0};
+    std::atomic<uint64_t>    waitTotalNs_{0}, waitMaxNs_{0};
+
+    /// 入队后唤醒可能在休眠的对端。先发布数据再检查等待计数 (seq_cst fence)，
+    /// 等待方在 parkMu_ 下先登记再重查队列，因此不会丢失唤醒。
+    void wake(std::condition_variable& cv, std::atomic<int>& waiting)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load() > 0) {
+            std::lock_guard<std::mutex> lock(parkMu_);
+            cv.notify_one();
+        }
+    }
+
+    bool push(Item& item, int timeoutMs)
+    {
+        if (stopping_.load()) throw std::runtime_error("Request queue is stopped");
+        if (queue_.tryPush(item)) return true;
+        if (timeoutMs == 0) return false;
+
+        std::unique_lock<std::mutex> lock(parkMu_);
+        producersWaiting_++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool pushed = false;
+        auto ready = [&]() {
+            if (!pushed) pushed = queue_.tryPush(item);
+            return pushed || stopping_.load();
+        };
+        if (timeoutMs < 0) notFull_.wait(lock, ready);
+        else               notFull_.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+        producersWaiting_--;
+        if (!pushed && stopping_.load()) throw std::runtime_error("Request queue is stopped");
+        return pushed;
+    }
+
+    bool pop(Item& item)
+    {
+        if (queue_.tryPop(item)) return true;
+
+        std::unique_lock<std::mutex> lock(parkMu_);
+        consumersWaiting_++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool got = false;
+        notEmpty_.wait(lock, [&]() { got = queue_.tryPop(item); return got || stopping_.load(); });
+        consumersWaiting_--;
+        return got;
+    }
+
+    static const WorkerPool*& current_pool()
+    {
+        static thread_local const WorkerPool* pool = nullptr;
+        return pool;
+    }
+
+    void worker_loop()
+    {
+        current_pool() = this;
+        Item item;
+        while (pop(item)) {
+            wake(notFull_, producersWaiting_);
+            run(item);
+        }
+    }
+
+    void run(Item& item)
+    {
+        uint64_t waitNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - item.enqueuedAt).count();
+        waitTotalNs_ += waitNs;
+        started_++;
+        uint64_t prevMax = waitMaxNs_.load();
+        while (waitNs > prevMax && !waitMaxNs_.compare_exchange_weak(prevMax, waitNs)) {}
+
+        active_++;
+        try { item.task(); } catch (...) {}
+        active_--;
+        completed_++;
+        item.task = nullptr;
+    }
+};
+
+// ──────── HTTP 响应缓存 (RFC 9111，私有缓存) ────────
+
+inline int64_t unix_time_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/// 公历日期 -> 1970-01-01 起的天数 (Howard Hinnant days_from_civil)
+inline int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    const int64_t  era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+/// 解析 HTTP-date (IMF-fixdate / RFC 850 / asctime)，返回 Unix 秒；无法解析时返回 -1
+inline int64_t parse_http_date(const std::string& value)
+{
+    static const char* kMonths[] = { "jan", "feb", "mar", "apr", "may", "jun",
+                                     "jul", "aug", "sep", "oct", "nov", "dec" };
+    std::vector<std::string> tokens;
+    std::string cur;
+    for (char c : value) {
+        if (c == ' ' || c == ',' || c == '-' || c == ':' || c == '\t') {
+            if (!cur.empty()) tokens.push_back(to_lower(cur));
+            cur.clear();
+        } else {
+            cur += c;
+        }
+    }
+    if (!cur.empty()) tokens.push_back(to_lower(cur));
+    if (tokens.size() < 7) return -1;
+
+    auto month_of = [&](const std::string& t) -> int {
+        for (int i = 0; i < 12; ++i) if (t == kMonths[i]) return i + 1;
+        return 0;
+    };
+    auto number = [](const std::string& t, int64_t& out) {
+        if (t.empty() || t.size() > 4) return false;
+        out = 0;
+        for (char c : t) {
+            if (c < '0' || c > '9') return false;
+            out = out * 10 + (c - '0');
+        }
+        return true;
+    };
+
+    int64_t day = 0, year = 0, hh = 0, mm = 0, ss = 0;
+    int month = month_of(tokens[1]);
+    bool ok;
+    if (month) {   // asctime: "Sun Nov  6 08:49:37 1994"
+        ok = number(tokens[2], day) && number(tokens[3], hh) && number(tokens[4], mm) &&
+             number(tokens[5], ss) && number(tokens[6], year);
+    } else {       // IMF-fixdate / RFC 850: "Sun, 06 Nov 1994 08:49:37 GMT" / "Sunday, 06-Nov-94 08:49:37 GMT"
+        month = month_of(tokens[2]);
+        ok = month && number(tokens[1], day) && number(tokens[3], year) && number(tokens[4], hh) &&
+             number(tokens[5], mm) && number(tokens[6], ss);
+        if (ok && tokens[3].size() == 2) year += year < 70 ? 2000 : 1900;
+    }
+    if (!ok || day < 1 || day > 31 || hh > 23 || mm > 59 || ss > 60) return -1;
+    return days_from_civil(year, (unsigned)month, (unsigned)day) * 86400 + hh * 3600 + mm * 60 + ss;
+}
+
+/// 按 RFC 6265 §5.1.1 解析 Set-Cookie 的 Expires: 按分隔符切成记号，依次认出时间、日、月、年，
+/// 与顺序和星期无关 ("21 Oct 2026 07:28:00 GMT"、"Wed, 21-Oct-26 07:28:00" 都可接受)。返回 Unix 秒；无法解析时返回 -1
+inline int64_t parse_cookie_date(std::string_view value)
+{
+    auto is_delimiter = [](unsigned char c) {
+        return c == 0x09 || (c >= 0x20 && c <= 0x2F) || (c >= 0x3B && c <= 0x40) || (c >= 0x5B && c <= 0x60) ||
+               (c >= 0x7B && c <= 0x7E);
+    };
+    auto is_digit = [](char c) { return c >= '0' && c <= '9'; };
+    // 1*max 位数字，其后若还有字符必须以非数字开头；返回消耗的长度，不匹配时返回 0
+    auto digits = [&](std::string_view t, size_t pos, size_t min, size_t max, int64_t& out) -> size_t {
+        size_t n = 0;
+        out = 0;
+        while (pos + n < t.size() && n < max && is_digit(t[pos + n])) out = out * 10 + (t[pos + n++] - '0');
+        if (n < min || (pos + n < t.size() && is_digit(t[pos + n]))) return 0;
+        return n;
+    };
+
+    static const char kMonths[] = "janfebmaraprmayjunjulaugsepoctnovdec";
+    bool haveTime = false, haveDay = false, haveMonth = false, haveYear = false;
+    int64_t hh = 0, mm = 0, ss = 0, day = 0, month = 0, year = 0;
+    size_t pos = 0;
+    while (pos < value.size()) {
+        while (pos < value.size() && is_delimiter((unsigned char)value[pos])) ++pos;
+        size_t start = pos;
+        while (pos < value.size() && !is_delimiter((unsigned char)value[pos])) ++pos;
+        auto token = value.substr(start, pos - start);
+        if (token.empty()) continue;
+
+        if (!haveTime) {
+            // hms-time = 1*2DIGIT ":" 1*2DIGIT ":" 1*2DIGIT ( non-digit *OCTET )
+            int64_t h, m, sec;
+            size_t a = digits(token, 0, 1, 2, h);
+            size_t b = a && a < token.size() && token[a] == ':' ? digits(token, a + 1, 1, 2, m) : 0;
+            size_t c = b && a + 1 + b < token.size() && token[a + 1 + b] == ':' ? digits(token, a + b + 2, 1, 2, sec) : 0;
+            if (c) {
+                haveTime = true;
+                hh = h; mm = m; ss = sec;
+                continue;
+            }
+        }
+        if (!haveDay && digits(token, 0, 1, 2, day)) { haveDay = true; continue; }
+        if (!haveMonth && token.size() >= 3) {
+            for (int i = 0; i < 12 && !haveMonth; ++i) {
+                if (iequals(token.substr(0, 3), std::string_view(kMonths + i * 3, 3))) {
+                    haveMonth = true;
+                    month = i + 1;
+                }
+            }
+            if (haveMonth) continue;
+        }
+        if (!haveYear && digits(token, 0, 2, 4, year)) haveYear = true;
+    }
+
+    if (!haveTime || !haveDay || !haveMonth || !haveYear) return -1;
+    if (year >= 70 && year <= 99) year += 1900;
+    else if (year >= 0 && year <= 69) year += 2000;
+    if (day < 1 || day > 31 || year < 1601 || hh > 23 || mm > 59 || ss > 59) return -1;
+    return days_from_civil(year, (unsigned)month, (unsigned)day) * 86400 + hh * 3600 + mm * 60 + ss;
+}
+
+/// Cache-Control 指令 (名称小写，值去引号)；无值的指令映射为空串
+inline std::map<std::string, std::string> parse_cache_control(const std::string& value)
+{
+    std::map<std::string, std::string> out;
+    size_t pos = 0;
+    while (pos < value.size()) {
+        size_t end = pos;
+        bool quoted = false;
+        while (end < value.size() && (quoted || value[end] != ',')) {
+            if (value[end] == '"') quoted = !quoted;
+            ++end;
+        }
+        auto part = trim_copy(value.substr(pos, end - pos));
+        if (!part.empty()) {
+            auto eq = part.find('=');
+            auto name = to_lower(trim_copy(part.substr(0, eq)));
+            std::string arg;
+            if (eq != std::string::npos) {
+                arg = trim_copy(part.substr(eq + 1));
+                if (arg.size() >= 2 && arg.front() == '"' && arg.back() == '"') arg = arg.substr(1, arg.size() - 2);
+            }
+            out[name] = arg;
+        }
+        pos = end + 1;
+    }
+    return out;
+}
+
+/// delta-seconds (非负整数秒，过大时截断)；无效时返回 -1
+inline int64_t parse_delta_seconds(const std::string& value)
+{
+    if (value.empty()) return -1;
+    int64_t v = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9') return -1;
+        if (v < INT64_C(1) << 40) v = v * 10 + (c - '0');
+    }
+    return v;
+}
+
+/// delta-seconds 指令的值；缺失或无效时返回 -1
+inline int64_t directive_seconds(const std::map<std::string, std::string>& directives, const char* name)
+{
+    auto it = directives.find(name);
+    return it == directives.end() ? -1 : parse_delta_seconds(it->second);
+}
+
+/// 一条缓存的响应。创建后不再修改 (revalidating 除外)，304 验证后以新条目替换
+struct CacheEntry
+{
+    std::string                                      key;              ///< "GET " + url_identity
+    std::vector<std::pair<std::string, std::string>> vary;             ///< Vary 头名 (小写) -> 存储时请求中的值
+    std::shared_ptr<const HttpResponse>              response;
+    int64_t                                          responseTimeMs = 0;
+    int64_t                                          initialAgeMs   = 0;  ///< 收到时已有的年龄 (RFC 9111 §4.2.3)
+    int64_t                                          freshnessMs    = 0;
+    int64_t                                          swrMs          = 0;  ///< stale-while-revalidate 窗口
+    bool                                             noCache        = false;
+    bool                                             mustRevalidate = false;
+    std::string                                      etag;
+    std::string                                      lastModified;
+    size_t                                           bytes = 0;
+    mutable std::atomic<bool>                        revalidating{false};
+
+    int64_t ageMs(int64_t nowMs) const { return initialAgeMs + std::max<int64_t>(0, nowMs - responseTimeMs); }
+    bool hasValidators() const { return !etag.empty() || !lastModified.empty(); }
+
+    bool matches(const std::string& requestBlock) const
+    {
+        for (const auto& [name, value] : vary)
+            if (header_block_values(requestBlock, name) != value) return false;
+        return true;
+    }
+};
+
+/// 按响应头 policyHeaders 判断 response 能否存储并计算新鲜度；不可存储时返回 nullptr。
+/// policyHeaders 通常就是 response->headers，304 验证时为合并后的头
+inline std::shared_ptr<CacheEntry> make_cache_entry(const std::string& key,
+                                                    std::shared_ptr<const HttpResponse> response,
+                                                    const Headers& policyHeaders,
+                                                    const std::string& requestBlock,
+                                                    int64_t requestTimeMs, int64_t responseTimeMs,
+                                                    bool heuristic)
+{
+    auto cc = parse_cache_control(get_header_ci(policyHeaders, "Cache-Control"));
+    if (cc.count("no-store")) return nullptr;
+
+    static const int kHeuristicStatus[] = { 200, 203, 204, 300, 301, 308, 404, 405, 410, 414, 501 };
+    int status = response->statusCode;
+    bool heuristicStatus = std::find(std::begin(kHeuristicStatus), std::end(kHeuristicStatus), status) != std::end(kHeuristicStatus);
+
+    auto entry = std::make_shared<CacheEntry>();
+    entry->key = key;
+    entry->etag = get_header_ci(policyHeaders, "ETag");
+    entry->lastModified = get_header_ci(policyHeaders, "Last-Modified");
+
+    int64_t maxAge = directive_seconds(cc, "max-age");
+    auto expires = get_header_ci(policyHeaders, "Expires");
+    bool explicitFreshness = maxAge >= 0 || !expires.empty();
+    if (!heuristicStatus && !(explicitFreshness && status >= 200 && status != 206 && status != 304)) return nullptr;
+
+    int64_t date = parse_http_date(get_header_ci(policyHeaders, "Date"));
+    if (date < 0) date = responseTimeMs / 1000;
+
+    if (maxAge >= 0) {
+        entry->freshnessMs = maxAge * 1000;
+    } else if (!expires.empty()) {
+        int64_t e = parse_http_date(expires);   // 无效的 Expires 视为已过期
+        entry->freshnessMs = e < 0 ? 0 : std::max<int64_t>(0, e - date) * 1000;
+    } else if (heuristic && heuristicStatus && !entry->lastModified.empty()) {
+        int64_t lm = parse_http_date(entry->lastModified);
+        if (lm >= 0 && date > lm) entry->freshnessMs = (date - lm) * 1000 / 10;
+    }
+
+    entry->noCache = cc.count("no-cache") > 0;
+    entry->mustRevalidate = cc.count("must-revalidate") > 0;
+    int64_t swr = directive_seconds(cc, "stale-while-revalidate");
+    entry->swrMs = swr > 0 ? swr * 1000 : 0;
+
+    // 既不会新鲜、也无法验证的响应存下来没有意义
+    if ((entry->freshnessMs == 0 || entry->noCache) && !entry->hasValidators()) return nullptr;
+
+    int64_t ageValue = std::max<int64_t>(0, parse_delta_seconds(trim_copy(get_header_ci(policyHeaders, "Age"))));
+    int64_t apparentAge = std::max<int64_t>(0, responseTimeMs - date * 1000);
+    int64_t correctedAge = ageValue * 1000 + std::max<int64_t>(0, responseTimeMs - requestTimeMs);
+    entry->initialAgeMs = std::max(apparentAge, correctedAge);
+    entry->responseTimeMs = responseTimeMs;
+
+    auto varyHeader = get_header_ci(policyHeaders, "Vary");
+    size_t pos = 0;
+    while (pos < varyHeader.size()) {
+        auto comma = varyHeader.find(',', pos);
+        auto name = to_lower(trim_copy(varyHeader.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos)));
+        if (name == "*") return nullptr;
+        if (!name.empty()) entry->vary.push_back({ name, header_block_values(requestBlock, name) });
+        if (comma == std::string::npos) break;
+        pos = comma + 1;
+    }
+
+    entry->response = std::move(response);
+    entry->bytes = key.size() + entry->response->bodyBytes.size() + entry->response->reasonPhrase.size();
+    for (const auto& [name, value] : entry->response->headers.fields()) entry->bytes += name.size() + value.size() + 4;
+    return entry;
+}
+
+/// 304 响应: 以新响应头更新存储的响应头 (RFC 9111 §4.3.4)。
+/// 除 Date / Age 外没有变化时沿用原响应对象，不复制响应体
+inline std::shared_ptr<const HttpResponse> merge_not_modified(const std::shared_ptr<const HttpResponse>& stored,
+                                                              const HttpResponse& notModified,
+                                                              Headers& mergedHeaders)
+{
+    mergedHeaders = stored->headers;
+    bool changed = false;
+    const auto& fresh = notModified.headers;
+    for (auto it = fresh.begin(); it != fresh.end(); ++it) {
+        auto lower = to_lower(it->first);
+        if (lower == "content-length" || lower == "content-encoding" || lower == "transfer-encoding" ||
+            lower == "content-range") continue;
+        if (fresh.find(it->first) == it) {
+            // 该名称在 304 中的第一项: 整组替换存储的同名值
+            if (mergedHeaders.getAll(it->first) != fresh.getAll(it->first) && lower != "date" && lower != "age")
+                changed = true;
+            mergedHeaders.erase(it->first);
+        }
+        mergedHeaders.add(it->first, it->second);
+    }
+    if (!changed) return stored;
+
+    auto merged = std::make_shared<HttpResponse>(*stored);
+    merged->headers = mergedHeaders;
+    return merged;
+}
+
+/// 内存 LRU (按字节预算淘汰) + 可选磁盘目录 (每个 URL 保存最近一个变体，按最久未用淘汰)
+class ResponseCache
+{
+public:
+    void configure(const HttpCacheOptions& options)
+    {
+        namespace fs = std::filesystem;
+        std::lock_guard<std::mutex> lock(mu_);
+        bool diskChanged = options.diskPath != options_.diskPath;
+        options_ = options;
+        enabled_.store(options.enabled);
+        trim_memory_locked();
+
+        if (diskChanged) {
+            diskFiles_.clear();
+            diskBytes_ = 0;
+            if (!options_.diskPath.empty()) {
+                std::error_code ec;
+                fs::create_directories(options_.diskPath, ec);
+                // 已有文件按修改时间排定初始的使用顺序
+                std::vector<std::pair<fs::file_time_type, std::pair<std::string, uint64_t>>> found;
+                for (fs::directory_iterator it(options_.diskPath, ec), end; !ec && it != end; it.increment(ec)) {
+                    if (it->path().extension() != ".drxcache") continue;
+                    std::error_code fec;
+                    auto size = it->file_size(fec);
+                    auto time = it->last_write_time(fec);
+                    if (!fec) found.push_back({ time, { it->path().filename().string(), size } });
+                }
+                std::sort(found.begin(), found.end());
+                for (auto& f : found) {
+                    diskFiles_[f.second.first] = DiskFile{ f.second.second, ++tick_ };
+                    diskBytes_ += f.second.second;
+                }
+            }
+        }
+        trim_disk_locked();
+    }
+
+    HttpCacheOptions options() const
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        return options_;
+    }
+
+    bool enabled() const { return enabled_.load(); }
+
+    bool heuristicFreshness() const
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        return options_.heuristicFreshness;
+    }
+
+    /// 查找与请求头匹配 (Vary) 的变体；内存未命中时尝试磁盘
+    std::shared_ptr<CacheEntry> lookup(const std::string& key, const std::string& requestBlock)
+    {
+        std::string file;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            auto it = index_.find(key);
+            if (it != index_.end()) {
+                for (auto lruIt : it->second) {
+                    if ((*lruIt)->matches(requestBlock)) {
+                        lru_.splice(lru_.begin(), lru_, lruIt);
+                        return *lruIt;
+                    }
+                }
+            }
+            if (options_.diskPath.empty()) return nullptr;
+            auto name = file_name(key);
+            auto df = diskFiles_.find(name);
+            if (df == diskFiles_.end()) return nullptr;
+            df->second.used = ++tick_;
+            file = (std::filesystem::path(options_.diskPath) / name).string();
+        }
+
+        auto entry = read_file(file);
+        if (!entry || entry->key != key || !entry->matches(requestBlock)) return nullptr;
+        std::lock_guard<std::mutex> lock(mu_);
+        insert_locked(entry);
+        return entry;
+    }
+
+    /// 存入内存 (替换同一 Vary 变体) 并在配置了磁盘目录时写盘
+    void store(const std::shared_ptr<CacheEntry>& entry)
+    {
+        std::string dir;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            if (entry->bytes > options_.maxEntryBytes) return;
+            insert_locked(entry);
+            stores_++;
+            dir = options_.diskPath;
+        }
+        if (dir.empty()) return;
+
+        namespace fs = std::filesystem;
+        auto name = file_name(entry->key);
+        auto size = write_file((fs::path(dir) / name).string(), *entry);
+        if (size == 0) return;
+        std::lock_guard<std::mutex> lock(mu_);
+        if (options_.diskPath != dir) return;
+        auto& df = diskFiles_[name];
+        diskBytes_ = diskBytes_ - df.bytes + size;
+        df = DiskFile{ size, ++tick_ };
+        trim_disk_locked();
+    }
+
+    /// 移除 key 的全部变体 (内存与磁盘)
+    void remove(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            for (auto lruIt : it->second) {
+                memoryBytes_ -= (*lruIt)->bytes;
+                lru_.erase(lruIt);
+            }
+            index_.erase(it);
+        }
+        if (!options_.diskPath.empty()) remove_disk_locked(file_name(key));
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        lru_.clear();
+        index_.clear();
+        memoryBytes_ = 0;
+        while (!diskFiles_.empty()) remove_disk_locked(diskFiles_.begin()->first);
+    }
+
+    void recordHit(size_t bodyBytes)         { hits_++;        bytesSaved_ += bodyBytes; }
+    void recordStaleHit(size_t bodyBytes)    { staleHits_++;   bytesSaved_ += bodyBytes; }
+    void recordRevalidated(size_t bodyBytes) { revalidated_++; bytesSaved_ += bodyBytes; }
+    void recordMiss()                        { misses_++; }
+
+    HttpCacheStats stats() const
+    {
+        HttpCacheStats s;
+        s.hits        = hits_.load();
+        s.staleHits   = staleHits_.load();
+        s.revalidated = revalidated_.load();
+        s.misses      = misses_.load();
+        s.bytesSaved  = bytesSaved_.load();
+        std::lock_guard<std::mutex> lock(mu_);
+        s.stores      = stores_;
+        s.evictions   = evictions_;
+        s.entries     = lru_.size();
+        s.memoryBytes = memoryBytes_;
+        s.diskBytes   = diskBytes_;
+        return s;
+    }
+
+private:
+    using Lru = std::list<std::shared_ptr<CacheEntry>>;
+
+    struct DiskFile
+    {
+        uint64_t bytes = 0;
+        uint64_t used  = 0;   ///< 最近使用的逻辑时刻
+    };
+
+    void insert_locked(const std::shared_ptr<CacheEntry>& entry)
+    {
+        auto& variants = index_[entry->key];
+        for (auto it = variants.begin(); it != variants.end(); ++it) {
+            if ((**it)->vary == entry->vary) {
+                memoryBytes_ -= (**it)->bytes;
+                lru_.erase(*it);
+                variants.erase(it);
+                break;
+            }
+        }
+        lru_.push_front(entry);
+        variants.push_back(lru_.begin());
+        memoryBytes_ += entry->bytes;
+        trim_memory_locked();
+    }
+
+    void trim_memory_locked()
+    {
+        while (memoryBytes_ > options_.maxMemoryBytes && !lru_.empty()) {
+            auto victim = std::prev(lru_.end());
+            auto it = index_.find((*victim)->key);
+            auto& variants = it->second;
+            variants.erase(std::find(variants.begin(), variants.end(), victim));
+            if (variants.empty()) index_.erase(it);
+            memoryBytes_ -= (*victim)->bytes;
+            lru_.erase(victim);
+            evictions_++;
+        }
+    }
+
+    void trim_disk_locked()
+    {
+        while (diskBytes_ > options_.maxDiskBytes && !diskFiles_.empty()) {
+            auto oldest = diskFiles_.begin();
+            for (auto it = diskFiles_.begin(); it != diskFiles_.end(); ++it)
+                if (it->second.used < oldest->second.used) oldest = it;
+            remove_disk_locked(oldest->first);
+        }
+    }
+
+    void remove_disk_locked(const std::string& name)
+    {
+        auto it = diskFiles_.find(name);
+        if (it == diskFiles_.end()) return;
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::path(options_.diskPath) / name, ec);
+        diskBytes_ -= it->second.bytes;
+        diskFiles_.erase(it);
+    }
+
+    static std::string file_name(const std::string& key)
+    {
+        uint64_t hash = 1469598103934665603ull;   // FNV-1a 64
+        for (unsigned char c : key) { hash ^= c; hash *= 1099511628211ull; }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%016llx.drxcache", (unsigned long long)hash);
+        return buf;
+    }
+
+    // 文件格式: 文本头 (每行一项) + 原始响应体
+    //   DRXCACHE 1 / key / responseTimeMs initialAgeMs freshnessMs swrMs noCache mustRevalidate /
+    //   vary 数量 + "name\tvalue" 行 / status reason / 响应头数量 + "name\tvalue" 行 / body 长度 / body
+    static uint64_t write_file(const std::string& path, const CacheEntry& entry)
+    {
+        static std::atomic<uint64_t> seq{0};
+        std::ostringstream head;
+        head << "DRXCACHE 1\n" << entry.key << "\n"
+             << entry.responseTimeMs << ' ' << entry.initialAgeMs << ' ' << entry.freshnessMs << ' '
+             << entry.swrMs << ' ' << entry.noCache << ' ' << entry.mustRevalidate << "\n"
+             << entry.vary.size() << "\n";
+        for (const auto& [name, value] : entry.vary) head << name << '\t' << value << "\n";
+        const auto& resp = *entry.response;
+        head << resp.statusCode << ' ' << resp.reasonPhrase << "\n" << resp.headers.size() << "\n";
+        for (const auto& [name, value] : resp.headers.fields()) head << name << '\t' << value << "\n";
+        head << resp.bodyBytes.size() << "\n";
+
+        auto tmp = path + ".tmp" + std::to_string(seq++);
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out) return 0;
+            auto text = head.str();
+            out.write(text.data(), (std::streamsize)text.size());
+            out.write(reinterpret_cast<const char*>(resp.bodyBytes.data()), (std::streamsize)resp.bodyBytes.size());
+            if (!out) { out.close(); std::error_code ec; std::filesystem::remove(tmp, ec); return 0; }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, path, ec);   // 同目录内替换，读者不会看到写了一半的文件
+        if (ec) { std::filesystem::remove(tmp, ec); return 0; }
+        return std::filesystem::file_size(path, ec);
+    }
+
+    static std::shared_ptr<CacheEntry> read_file(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return nullptr;
+        std::string line;
+        auto next_line = [&]() { return (bool)std::getline(in, line); };
+        auto read_pairs = [&](auto&& add) {
+            if (!next_line()) return false;
+            size_t n = (size_t)std::strtoull(line.c_str(), nullptr, 10);
+            for (size_t i = 0; i < n; ++i) {
+                if (!next_line()) return false;
+                auto tab = line.find('\t');
+                if (tab == std::string::npos) return false;
+                add(line.substr(0, tab), line.substr(tab + 1));
+            }
+            return true;
+        };
+
+        if (!next_line() || line != "DRXCACHE 1") return nullptr;
+        auto entry = std::make_shared<CacheEntry>();
+        if (!next_line()) return nullptr;
+        entry->key = line;
+        if (!next_line()) return nullptr;
+        {
+            std::istringstream fields(line);
+            int noCache = 0, mustRevalidate = 0;
+            if (!(fields >> entry->responseTimeMs >> entry->initialAgeMs >> entry->freshnessMs >> entry->swrMs
+                         >> noCache >> mustRevalidate)) return nullptr;
+            entry->noCache = noCache != 0;
+            entry->mustRevalidate = mustRevalidate != 0;
+        }
+        if (!read_pairs([&](std::string n, std::string v) { entry->vary.push_back({ std::move(n), std::move(v) }); }))
+            return nullptr;
+
+        auto resp = std::make_shared<HttpResponse>();
+        if (!next_line()) return nullptr;
+        {
+            auto sp = line.find(' ');
+            resp->statusCode = std::atoi(line.c_str());
+            if (sp != std::string::npos) resp->reasonPhrase = line.substr(sp + 1);
+        }
+        if (!read_pairs([&](std::string n, std::string v) { resp->headers.add(n, v); }))
+            return nullptr;
+        if (!next_line()) return nullptr;
+        size_t bodyLen = (size_t)std::strtoull(line.c_str(), nullptr, 10);
+        resp->bodyBytes.resize(bodyLen);
+        if (bodyLen && !in.read(reinterpret_cast<char*>(resp->bodyBytes.data()), (std::streamsize)bodyLen)) return nullptr;
+
+        entry->etag = get_header_ci(resp->headers, "ETag");
+        entry->lastModified = get_header_ci(resp->headers, "Last-Modified");
+        entry->bytes = entry->key.size() + bodyLen + resp->reasonPhrase.size();
+        for (const auto& [name, value] : resp->headers.fields()) entry->bytes += name.size() + value.size() + 4;
+        entry->response = std::move(resp);
+        return entry;
+    }
+
+    mutable std::mutex                                        mu_;
+    HttpCacheOptions                                          options_;
+    std::atomic<bool>                                         enabled_{false};
+    Lru                                                       lru_;      ///< 头部为最近使用
+    std::unordered_map<std::string, std::vector<Lru::iterator>> index_;  ///< key -> 各 Vary 变体
+    size_t                                                    memoryBytes_ = 0;
+    std::map<std::string, DiskFile>                           diskFiles_;
+    uint64_t                                                  diskBytes_ = 0;
+    uint64_t                                                  tick_ = 0;
+    uint64_t                                                  stores_ = 0;
+    uint64_t                                                  evictions_ = 0;
+    std::atomic<uint64_t>                                     hits_{0};
+    std::atomic<uint64_t>                                     staleHits_{0};
+    std::atomic<uint64_t>                                     revalidated_{0};
+    std::atomic<uint64_t>                                     misses_{0};
+    std::atomic<uint64_t>                                     bytesSaved_{0};
+};
+
+// ──────── Cookie 存储 (RFC 6265) ────────
+
+/// ISO 8601 时间 ("2026-10-16T10:00:00Z"、可带小数秒与 ±hh:mm 偏移，无时区按 UTC)，返回 Unix 秒；无法解析时返回 -1。
+/// 用于与 C# ExportCookies 的 Expires 字段互通
+inline int64_t parse_iso8601(std::string_view s)
+{
+    auto num = [&](size_t pos, size_t len, int64_t& out) {
+        if (pos + len > s.size()) return false;
+        out = 0;
+        for (size_t i = pos; i < pos + len; ++i) {
+            if (s[i] < '0' || s[i] > '9') return false;
+            out = out * 10 + (s[i] - '0');
+        }
+        return true;
+    };
+    int64_t y, mo, d, h = 0, mi = 0, sec = 0;
+    if (!num(0, 4, y) || s.size() < 10 || s[4] != '-' || !num(5, 2, mo) || s[7] != '-' || !num(8, 2, d)) return -1;
+    size_t pos = 10;
+    if (pos < s.size() && (s[pos] == 'T' || s[pos] == 't' || s[pos] == ' ')) {
+        if (!num(pos + 1, 2, h) || s.size() < pos + 9 || s[pos + 3] != ':' || !num(pos + 4, 2, mi) ||
+            s[pos + 6] != ':' || !num(pos + 7, 2, sec)) return -1;
+        pos += 9;
+        if (pos < s.size() && s[pos] == '.') while (++pos < s.size() && s[pos] >= '0' && s[pos] <= '9') {}
+    }
+    if (mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59 || sec > 60) return -1;
+    int64_t t = days_from_civil(y, (unsigned)mo, (unsigned)d) * 86400 + h * 3600 + mi * 60 + sec;
+    if (pos < s.size() && (s[pos] == '+' || s[pos] == '-')) {
+        int64_t oh, om;
+        if (!num(pos + 1, 2, oh) || s.size() < pos + 6 || s[pos + 3] != ':' || !num(pos + 4, 2, om)) return -1;
+        int64_t offset = oh * 3600 + om * 60;
+        t += s[pos] == '+' ? -offset : offset;
+    }
+    return t;
+}
+
+/// Unix 秒 -> "2026-10-16T10:00:00Z"；年份钳制到 0000..9999，保证输出能被 parse_iso8601 读回
+inline std::string format_iso8601(int64_t t)
+{
+    t = std::clamp<int64_t>(t, -62167219200LL /* 0000-01-01T00:00:00Z */, 253402300799LL /* 9999-12-31T23:59:59Z */);
+    int64_t days = t >= 0 ? t / 86400 : (t - 86399) / 86400;
+    const unsigned rem = (unsigned)(t - days * 86400);
+    // Howard Hinnant civil_from_days
+    days += 719468;
+    const int64_t  era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = (unsigned)(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp  = (5 * doy + 2) / 153;
+    const unsigned d   = doy - (153 * mp + 2) / 5 + 1;
+    const unsigned m   = mp < 10 ? mp + 3 : mp - 9;
+    const int64_t  y   = (int64_t)yoe + era * 400 + (m <= 2);
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%04lld-%02u-%02uT%02u:%02u:%02uZ", (long long)y, m, d,
+                  rem / 3600, rem / 60 % 60, rem % 60);
+    return buf;
+}
+
+/// IPv4 / IPv6 字面量 (不做域名匹配，也没有可注册域名)
+inline bool is_ip_literal(std::string_view host)
+{
+    if (host.empty()) return false;
+    if (host.find(':') != std::string_view::npos || host.front() == '[') return true;
+    return std::all_of(host.begin(), host.end(), [](char c) { return (c >= '0' && c <= '9') || c == '.'; });
+}
+
+/// 公共后缀判断。没有内置完整的 Public Suffix List: 单标签 (com、cn、localhost) 与下表中常见的
+/// 多标签后缀视为公共后缀，足以拒绝 Domain=com.cn 这类写给整个后缀的 Cookie
+inline bool is_public_suffix(std::string_view domain)
+{
+    if (domain.find('.') == std::string_view::npos) return true;
+    static const std::unordered_set<std::string_view> kSuffixes = {
+        "co.uk", "org.uk", "ac.uk", "gov.uk", "me.uk", "net.uk", "ltd.uk", "plc.uk",
+        "com.cn", "net.cn", "org.cn", "gov.cn", "edu.cn", "ac.cn",
+        "com.hk", "org.hk", "net.hk", "edu.hk", "com.tw", "org.tw", "net.tw", "edu.tw", "com.mo",
+        "co.jp", "ne.jp", "or.jp", "ac.jp", "go.jp", "co.kr", "or.kr", "ne.kr", "go.kr",
+        "com.au", "net.au", "org.au", "edu.au", "gov.au", "co.nz", "org.nz", "net.nz",
+        "com.sg", "com.my", "co.th", "co.id", "com.vn", "com.ph", "co.in", "net.in", "org.in",
+        "com.br", "com.ar", "com.mx", "co.za", "com.tr", "com.ru", "com.ua", "co.il",
+        "github.io", "gitlab.io", "herokuapp.com", "appspot.com", "blogspot.com", "vercel.app",
+        "netlify.app", "pages.dev", "workers.dev", "azurewebsites.net", "cloudfront.net", "web.app", "firebaseapp.com",
+    };
+    return kSuffixes.count(domain) != 0;
+}
+
+/// 可注册域名 (eTLD+1): 公共后缀再加一级标签。IP 与本身就是公共后缀的主机原样返回
+inline std::string_view registrable_domain(std::string_view host)
+{
+    if (is_ip_literal(host)) return host;
+    size_t dot = host.rfind('.');
+    if (dot == std::string_view::npos) return host;
+    size_t start = dot;
+    while (true) {
+        size_t prev = start == 0 ? std::string_view::npos : host.rfind('.', start - 1);
+        auto suffix = host.substr(start + 1);
+        if (!is_public_suffix(suffix)) return suffix;
+        if (prev == std::string_view::npos) return host;
+        start = prev;
+    }
+}
+
+/// RFC 6265 §5.1.3 domain-match
+inline bool cookie_domain_match(std::string_view host, std::string_view domain)
+{
+    if (host == domain) return true;
+    return host.size() > domain.size() && host.compare(host.size() - domain.size(), domain.size(), domain) == 0 &&
+           host[host.size() - domain.size() - 1] == '.' && !is_ip_literal(host);
+}
+
+/// RFC 6265 §5.1.4 path-match
+inline bool cookie_path_match(std::string_view requestPath, std::string_view cookiePath)
+{
+    if (requestPath.compare(0, cookiePath.size(), cookiePath) != 0) return false;
+    return requestPath.size() == cookiePath.size() || cookiePath.back() == '/' || requestPath[cookiePath.size()] == '/';
+}
+
+/// 请求路径 (去掉查询串与片段，空路径视为 "/")
+inline std::string_view cookie_request_path(const UrlParts& url)
+{
+    std::string_view path = url.path;
+    path = path.substr(0, path.find_first_of("?#"));
+    return path.empty() ? std::string_view("/") : path;
+}
+
+/// RFC 6265 §5.1.4 default-path: 请求路径最后一个 '/' 之前的部分
+inline std::string cookie_default_path(std::string_view requestPath)
+{
+    if (requestPath.empty() || requestPath[0] != '/') return "/";
+    auto slash = requestPath.rfind('/');
+    return slash == 0 ? "/" : std::string(requestPath.substr(0, slash));
+}
+
+/// Cookie 二进制快照 (saveCookies / loadCookies)。小端，可直接内存映射后按需解码:
+///
+///   头部 64 字节  "DRXC" | u16 版本 | u16 头部长度 | u32 字符串数 | u32 记录数 | u32 分组数 | u32 保留 |
+///                 u64 分组表偏移 | u64 记录表偏移 | u64 字符串索引偏移 | u64 字符串数据偏移 | u64 文件长度
+///   分组表        每组 16 字节: u32 可注册域名 (字符串号) | u32 首条记录 | u32 记录数 | u32 保留
+///   记录表        每条 32 字节: u32 name | u32 value | u32 domain | u32 path | i64 expires | u32 标志 | u32 创建顺序
+///   字符串索引    每个字符串 u32，为其在字符串数据区内的偏移
+///   字符串数据    u32 长度 + 字节，相同的字符串只存一份
+///
+/// 记录按可注册域名分组，加载时只读头部与分组表；某个可注册域名的 Cookie 在首次用到时才解码。
+/// 版本号只在布局不兼容时增加，读取方拒绝更高的版本
+class CookieSnapshot
+{
+public:
+    static constexpr uint16_t kVersion      = 1;
+    static constexpr size_t   kHeaderSize   = 64;
+    static constexpr size_t   kGroupSize    = 16;
+    static constexpr size_t   kRecordSize   = 32;
+    static constexpr uint32_t kSecure       = 1;
+    static constexpr uint32_t kHttpOnly     = 2;
+    static constexpr uint32_t kHostOnly     = 4;
+
+    struct Group
+    {
+        std::string key;
+        uint32_t    first = 0;
+        uint32_t    count = 0;
+    };
+
+    /// cookies 按创建先后排列 (记录的创建顺序即其下标)
+    static std::string encode(const std::vector<Cookie>& cookies)
+    {
+        std::vector<std::string_view> strings;
+        std::unordered_map<std::string_view, uint32_t> ids;
+        auto intern = [&](std::string_view s) {
+            auto it = ids.find(s);
+            if (it != ids.end()) return it->second;
+            uint32_t id = (uint32_t)strings.size();
+            strings.push_back(s);
+            ids.emplace(s, id);
+            return id;
+        };
+
+        std::vector<std::pair<std::string_view, uint32_t>> order;   // (可注册域名, 下标)
+        order.reserve(cookies.size());
+        for (uint32_t i = 0; i < (uint32_t)cookies.size(); ++i)
+            order.emplace_back(registrable_domain(cookies[i].domain), i);
+        std::stable_sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        std::string groups, records;
+        records.reserve(cookies.size() * kRecordSize);
+        for (size_t g = 0; g < order.size();) {
+            size_t end = g;
+            while (end < order.size() && order[end].first == order[g].first) ++end;
+            put32(groups, intern(order[g].first));
+            put32(groups, (uint32_t)g);
+            put32(groups, (uint32_t)(end - g));
+            put32(groups, 0);
+            for (size_t k = g; k < end; ++k) {
+                const auto& c = cookies[order[k].second];
+                put32(records, intern(c.name));
+                put32(records, intern(c.value));
+                put32(records, intern(c.domain));
+                put32(records, intern(c.path));
+                put64(records, (uint64_t)c.expires);
+                put32(records, (c.secure ? kSecure : 0) | (c.httpOnly ? kHttpOnly : 0) | (c.hostOnly ? kHostOnly : 0));
+                put32(records, order[k].second);
+            }
+            g = end;
+        }
+
+        std::string index, data;
+        for (auto s : strings) {
+            put32(index, (uint32_t)data.size());
+            put32(data, (uint32_t)s.size());
+            data.append(s.data(), s.size());
+        }
+
+        uint64_t groupsOffset  = kHeaderSize;
+        uint64_t recordsOffset = groupsOffset + groups.size();
+        uint64_t indexOffset   = recordsOffset + records.size();
+        uint64_t dataOffset    = indexOffset + index.size();
+        uint64_t total         = dataOffset + data.size();
+
+        std::string out;
+        out.reserve((size_t)total);
+        out.append("DRXC", 4);
+        put16(out, kVersion);
+        put16(out, (uint16_t)kHeaderSize);
+        put32(out, (uint32_t)strings.size());
+        put32(out, (uint32_t)cookies.size());
+        put32(out, (uint32_t)(groups.size() / kGroupSize));
+        put32(out, 0);
+        put64(out, groupsOffset);
+        put64(out, recordsOffset);
+        put64(out, indexOffset);
+        put64(out, dataOffset);
+        put64(out, total);
+        out += groups;
+        out += records;
+        out += index;
+        out += data;
+        return out;
+    }
+
+    /// 内存映射 path。文件被截断或布局不一致时抛出异常
+    static std::shared_ptr<const CookieSnapshot> map(const std::string& path)
+    {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(std::filesystem::path(path), ec);
+        if (ec) throw std::runtime_error("Cannot open cookie snapshot: " + path);
+        auto snap = std::shared_ptr<CookieSnapshot>(new CookieSnapshot());
+        if (size > 0) {
+            snap->file_ = std::make_unique<BodyFile>(path);
+            snap->view_ = snap->file_->map(0, (size_t)size);
+            snap->data_ = snap->view_.data();
+        }
+        snap->size_ = (size_t)size;
+        snap->validate(path);
+        return snap;
+    }
+
+    /// 从内存中的快照字节加载 (复制一份)
+    static std::shared_ptr<const CookieSnapshot> fromBytes(std::string bytes)
+    {
+        auto snap = std::shared_ptr<CookieSnapshot>(new CookieSnapshot());
+        snap->owned_ = std::move(bytes);
+        snap->data_ = reinterpret_cast<const uint8_t*>(snap->owned_.data());
+        snap->size_ = snap->owned_.size();
+        snap->validate("<memory>");
+        return snap;
+    }
+
+    uint32_t recordCount() const { return records_; }
+
+    std::vector<Group> groups() const
+    {
+        std::vector<Group> out;
+        out.reserve(groups_);
+        for (uint32_t g = 0; g < groups_; ++g) {
+            const uint8_t* p = data_ + groupsOffset_ + (size_t)g * kGroupSize;
+            Group group;
+            group.first = get32(p + 4);
+            group.count = get32(p + 8);
+            if (!string_at(get32(p), group.key) || group.first > records_ || group.count > records_ - group.first)
+                throw std::runtime_error("Corrupt cookie snapshot: bad group " + std::to_string(g));
+            out.push_back(std::move(group));
+        }
+        return out;
+    }
+
+    /// 解码第 index 条记录；字符串号越界时返回 false (该条被跳过)
+    bool record(uint32_t index, Cookie& c, uint32_t& order) const
+    {
+        const uint8_t* p = data_ + recordsOffset_ + (size_t)index * kRecordSize;
+        if (!string_at(get32(p), c.name) || !string_at(get32(p + 4), c.value) ||
+            !string_at(get32(p + 8), c.domain) || !string_at(get32(p + 12), c.path)) return false;
+        c.expires  = (int64_t)get64(p + 16);
+        uint32_t flags = get32(p + 24);
+        c.secure   = (flags & kSecure) != 0;
+        c.httpOnly = (flags & kHttpOnly) != 0;
+        c.hostOnly = (flags & kHostOnly) != 0;
+        order = get32(p + 28);
+        return true;
+    }
+
+private:
+    CookieSnapshot() = default;
+
+    std::unique_ptr<BodyFile> file_;
+    BodyFile::View            view_;
+    std::string               owned_;
+    const uint8_t*            data_ = nullptr;
+    size_t                    size_ = 0;
+    uint32_t                  strings_ = 0, records_ = 0, groups_ = 0;
+    uint64_t                  groupsOffset_ = 0, recordsOffset_ = 0, indexOffset_ = 0, dataOffset_ = 0;
+
+    static void put16(std::string& out, uint16_t v) { for (int i = 0; i < 2; ++i) out += (char)(v >> (8 * i)); }
+    static void put32(std::string& out, uint32_t v) { for (int i = 0; i < 4; ++i) out += (char)(v >> (8 * i)); }
+    static void put64(std::string& out, uint64_t v) { for (int i = 0; i < 8; ++i) out += (char)(v >> (8 * i)); }
+    static uint16_t get16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+    static uint32_t get32(const uint8_t* p) { return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24; }
+    static uint64_t get64(const uint8_t* p) { return (uint64_t)get32(p) | (uint64_t)get32(p + 4) << 32; }
+
+    void validate(const std::string& name)
+    {
+        auto corrupt = [&](const char* what) { return std::runtime_error("Corrupt cookie snapshot " + name + ": " + what); };
+        if (size_ < kHeaderSize || std::memcmp(data_, "DRXC", 4) != 0) throw corrupt("bad magic");
+        uint16_t version = get16(data_ + 4);
+        if (version > kVersion) throw std::runtime_error("Unsupported cookie snapshot version " + std::to_string(version) + ": " + name);
+        if (get16(data_ + 6) < kHeaderSize) throw corrupt("bad header size");
+        strings_       = get32(data_ + 8);
+        records_       = get32(data_ + 12);
+        groups_        = get32(data_ + 16);
+        groupsOffset_  = get64(data_ + 24);
+        recordsOffset_ = get64(data_ + 32);
+        indexOffset_   = get64(data_ + 40);
+        dataOffset_    = get64(data_ + 48);
+        if (get64(data_ + 56) != size_) throw corrupt("truncated");
+        if (groupsOffset_ < kHeaderSize ||
+            groupsOffset_ + (uint64_t)groups_ * kGroupSize > recordsOffset_ ||
+            recordsOffset_ + (uint64_t)records_ * kRecordSize > indexOffset_ ||
+            indexOffset_ + (uint64_t)strings_ * 4 > dataOffset_ || dataOffset_ > size_)
+            throw corrupt("bad section offsets");
+    }
+
+    bool string_at(uint32_t id, std::string& out) const
+    {
+        if (id >= strings_) return false;
+        uint64_t off = dataOffset_ + get32(data_ + indexOffset_ + (size_t)id * 4);
+        if (off + 4 > size_) return false;
+        uint32_t len = get32(data_ + off);
+        if (off + 4 + len > size_) return false;
+        out.assign(reinterpret_cast<const char*>(data_ + off + 4), len);
+        return true;
+    }
+};
+
+/// 按可注册域名分片的 Cookie 存储。每片一把锁，同一可注册域名 (a.example.com、b.example.com、example.com)
+/// 的 Cookie 在同一片的同一个桶里，查找只扫描该桶。
+/// 每个 (scheme, host) 的匹配结果连同排好序的 Cookie 头缓存在所属分片，分片内容变化、
+/// 其中某个 Cookie 到期或无域名 Cookie 变化时失效；路径都为 "/" 时缓存的头块可直接使用。
+/// domain 为空的 Cookie (导入 / setSessionId 时未指定域名且没有 baseAddress) 发送给所有主机。
+/// attach 挂上的二进制快照按可注册域名登记为待解码，该域名首次被读写时才解码进桶
+class CookieJar
+{
+public:
+    static constexpr size_t kShards       = 16;
+    static constexpr size_t kMaxPerDomain = 180;   ///< 每个可注册域名的上限，超出时先淘汰过期的、再淘汰最早创建的
+
+    /// 处理一条 Set-Cookie (RFC 6265 §5.2 解析、§5.3 存储)。url 为收到该响应的请求地址
+    void setFromHeader(std::string_view header, const UrlParts& url, int64_t now)
+    {
+        auto semi = header.find(';');
+        auto pair = header.substr(0, semi);
+        auto eq = pair.find('=');
+        if (eq == std::string_view::npos) return;
+        auto name = trim_view(pair.substr(0, eq));
+        if (name.empty()) return;
+
+        Cookie c;
+        c.name  = std::string(name);
+        c.value = std::string(trim_view(pair.substr(eq + 1)));
+
+        std::string host = to_lower(url.host);
+        std::string domainAttr;
+        bool hasPath = false, hasMaxAge = false, expired = false;
+        int64_t expires = 0;
+        while (semi != std::string_view::npos) {
+            header = header.substr(semi + 1);
+            semi = header.find(';');
+            auto attr = header.substr(0, semi);
+            auto aeq = attr.find('=');
+            auto key = trim_view(attr.substr(0, aeq));
+            auto val = aeq == std::string_view::npos ? std::string_view() : trim_view(attr.substr(aeq + 1));
+            if (iequals(key, "secure")) c.secure = true;
+            else if (iequals(key, "httponly")) c.httpOnly = true;
+            else if (iequals(key, "domain")) {
+                if (!val.empty() && val[0] == '.') val.remove_prefix(1);
+                if (!val.empty()) domainAttr = to_lower(val);
+            } else if (iequals(key, "path")) {
+                if (!val.empty() && val[0] == '/') { c.path = std::string(val); hasPath = true; }
+            } else if (iequals(key, "max-age")) {
+                bool neg = !val.empty() && val[0] == '-';
+                auto digits = neg ? val.substr(1) : val;
+                if (digits.empty() || !std::all_of(digits.begin(), digits.end(), [](char ch) { return ch >= '0' && ch <= '9'; }))
+                    continue;
+                int64_t delta = digits.size() > 12 ? INT64_C(999999999999) : std::stoll(std::string(digits));
+                hasMaxAge = true;
+                expired = neg || delta == 0;
+                expires = expired ? 0 : now + delta;
+            } else if (iequals(key, "expires") && !hasMaxAge) {
+                int64_t t = parse_cookie_date(val);
+                if (t < 0) continue;
+                expired = t <= now;
+                expires = expired ? 0 : t;
+            }
+        }
+        c.expires = expires;
+
+        if (!domainAttr.empty()) {
+            if (is_public_suffix(domainAttr)) {
+                if (domainAttr != host) return;
+                domainAttr.clear();
+            } else if (!cookie_domain_match(host, domainAttr)) {
+                return;
+            }
+        }
+        c.hostOnly = domainAttr.empty();
+        c.domain = c.hostOnly ? host : domainAttr;
+        if (!hasPath) c.path = cookie_default_path(cookie_request_path(url));
+
+        if (expired) remove(c.name, c.domain, c.path);
+        else store(std::move(c), now);
+    }
+
+    /// 存入一个 Cookie，按 (name, domain, path) 替换已有项并保留其创建顺序。domain 以 '.' 开头时
+    /// 视为域 Cookie (同 C# CookieContainer 的写法)，否则按 hostOnly 字段
+    void store(Cookie c, int64_t now)
+    {
+        normalize(c);
+        if (c.expires != 0 && c.expires <= now) { remove(c.name, c.domain, c.path); return; }
+        auto key = std::string(registrable_domain(c.domain));
+        auto& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mu);
+        materialize(shard, key, now);
+        put_locked(shard, key, std::move(c), seq_.fetch_add(1), now);
+        changed(shard, key.empty());
+    }
+
+    void remove(const std::string& name, const std::string& domain, const std::string& path)
+    {
+        auto key = std::string(registrable_domain(domain));
+        auto& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mu);
+        materialize(shard, key, 0);
+        auto it = shard.domains.find(key);
+        if (it == shard.domains.end()) return;
+        auto& bucket = it->second;
+        for (size_t i = 0; i < bucket.size(); ++i) {
+            auto& c = bucket[i].cookie;
+            if (c.name == name && c.domain == domain && c.path == path) {
+                erase_at(bucket, i, key.empty());
+                changed(shard, key.empty());
+                return;
+            }
+        }
+    }
+
+    /// 追加请求 url 应携带的 "Cookie: ...\r\n" 行 (RFC 6265 §5.4: 路径长的在前，同长度按创建先后)；没有匹配时不追加
+    void appendHeader(std::string& out, const UrlParts& url, int64_t now)
+    {
+        if (count_.load(std::memory_order_relaxed) == 0) return;
+        std::string host = to_lower(url.host);
+        std::string originKey = (url.isHttps ? "s:" : "p:") + host;
+        auto key = std::string(registrable_domain(host));
+        auto requestPath = cookie_request_path(url);
+        auto& shard = shard_for(key);
+
+        std::lock_guard<std::mutex> lock(shard.mu);
+        materialize(shard, key, now);
+        uint64_t wildVersion = wildVersion_.load();
+        if (shard.origins.size() >= kMaxOrigins && !shard.origins.count(originKey)) shard.origins.clear();
+        auto& cached = shard.origins[originKey];
+        if (cached.version != shard.version || cached.wildVersion != wildVersion || (cached.expiresAt && cached.expiresAt <= now))
+            rebuild(shard, cached, key, host, url.isHttps, now, wildVersion);
+
+        if (cached.matches.empty()) return;
+        if (cached.rootOnly) {
+            out.append("Cookie: ", 8);
+            out += cached.header;
+            out.append("\r\n", 2);
+            return;
+        }
+        size_t mark = out.size();
+        for (const auto& m : cached.matches) {
+            if (!cookie_path_match(requestPath, m.path)) continue;
+            out.append(out.size() == mark ? "Cookie: " : "; ");
+            out += m.pair;
+        }
+        if (out.size() != mark) out.append("\r\n", 2);
+    }
+
+    /// 全部未过期的 Cookie，按创建先后
+    std::vector<Cookie> all(int64_t now)
+    {
+        std::vector<std::pair<uint64_t, Cookie>> items;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mu);
+            materialize_all(shard, now);
+            for (auto& [key, bucket] : shard.domains)
+                for (auto& e : bucket)
+                    if (e.cookie.expires == 0 || e.cookie.expires > now) items.emplace_back(e.seq, e.cookie);
+        }
+        std::sort(items.begin(), items.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<Cookie> out;
+        out.reserve(items.size());
+        for (auto& item : items) out.push_back(std::move(item.second));
+        return out;
+    }
+
+    /// 最早创建的、名称 (大小写不敏感) 为 name 的未过期 Cookie 的值
+    std::string valueOf(std::string_view name, int64_t now)
+    {
+        if (count_.load(std::memory_order_relaxed) == 0) return {};
+        uint64_t bestSeq = ~uint64_t(0);
+        std::string value;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mu);
+            materialize_all(shard, now);
+            for (auto& [key, bucket] : shard.domains)
+                for (auto& e : bucket)
+                    if (e.seq < bestSeq && iequals(e.cookie.name, name) && (e.cookie.expires == 0 || e.cookie.expires > now)) {
+                        bestSeq = e.seq;
+                        value = e.cookie.value;
+                    }
+        }
+        return value;
+    }
+
+    /// 把所有名称 (大小写不敏感) 为 name 的 Cookie 改为 value，返回是否存在这样的 Cookie
+    bool assignValue(std::string_view name, const std::string& value, int64_t now)
+    {
+        bool found = false;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mu);
+            materialize_all(shard, now);
+            bool touched = false, wild = false;
+            for (auto& [key, bucket] : shard.domains)
+                for (auto& e : bucket)
+                    if (iequals(e.cookie.name, name)) {
+                        e.cookie.value = value;
+                        touched = true;
+                        wild = wild || key.empty();
+                    }
+            if (touched) changed(shard, wild);
+            found = found || touched;
+        }
+        return found;
+    }
+
+    void clear()
+    {
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mu);
+            shard.domains.clear();
+            shard.origins.clear();
+            shard.pending.clear();
+            ++shard.version;
+        }
+        count_.store(0);
+        wildcards_.store(0);
+        wildVersion_.fetch_add(1);
+    }
+
+    /// 挂上二进制快照。已有 Cookie 的可注册域名与无域名 Cookie 立即解码 (同名项以快照为准)，其余首次用到时再解码
+    void attach(const std::shared_ptr<const CookieSnapshot>& snapshot, int64_t now)
+    {
+        auto groups = snapshot->groups();
+        uint64_t seqBase = seq_.fetch_add(snapshot->recordCount());
+        for (auto& group : groups) {
+            if (group.count == 0) continue;
+            auto& shard = shard_for(group.key);
+            std::lock_guard<std::mutex> lock(shard.mu);
+            materialize(shard, group.key, now);
+            Pending pending{ snapshot, group.first, group.count, seqBase };
+            count_.fetch_add(group.count);
+            if (group.key.empty() || shard.domains.count(group.key)) decode(shard, group.key, pending, now);
+            else shard.pending.emplace(std::move(group.key), std::move(pending));
+        }
+    }
+
+    /// Cookie 数 (含尚未解码的快照记录，其中可能有已过期的)
+    size_t size() const { return count_.load(); }
+
+private:
+    struct Entry
+    {
+        Cookie   cookie;
+        uint64_t seq;   ///< 创建顺序
+    };
+
+    struct Match
+    {
+        std::string path;
+        std::string pair;   ///< "name=value"
+    };
+
+    /// 某个 (scheme, host) 的匹配结果
+    struct OriginCache
+    {
+        uint64_t           version     = ~uint64_t(0);
+        uint64_t           wildVersion = 0;
+        int64_t            expiresAt   = 0;     ///< 其中最早到期的时间，0 = 都是会话 Cookie
+        bool               rootOnly    = true;  ///< 全部路径为 "/"，header 可直接使用
+        std::vector<Match> matches;             ///< 已按 RFC 6265 §5.4 排序
+        std::string        header;
+    };
+
+    /// 快照中某个可注册域名尚未解码的记录
+    struct Pending
+    {
+        std::shared_ptr<const CookieSnapshot> snapshot;
+        uint32_t                              first = 0;
+        uint32_t                              count = 0;
+        uint64_t                              seqBase = 0;   ///< 记录的创建顺序加上它得到 seq
+    };
+
+    struct Shard
+    {
+        mutable std::mutex                                  mu;
+        std::unordered_map<std::string, std::vector<Entry>> domains;   ///< 可注册域名 -> Cookie
+        std::unordered_map<std::string, OriginCache>        origins;   ///< "s:host" / "p:host" -> 缓存
+        std::unordered_map<std::string, Pending>            pending;   ///< 可注册域名 -> 快照中待解码的记录
+        uint64_t                                            version = 0;
+    };
+
+    Shard                 shards_[kShards];
+    std::atomic<size_t>   count_{0};
+    std::atomic<size_t>   wildcards_{0};     ///< domain 为空的 Cookie 数
+    std::atomic<uint64_t> wildVersion_{0};   ///< 无域名 Cookie 变化时递增，使所有分片的缓存失效
+    std::atomic<uint64_t> seq_{0};
+
+    static constexpr size_t kMaxOrigins = 1024;   ///< 每片缓存的 origin 数，超出时整体清空
+
+    Shard& shard_for(const std::string& key) { return shards_[std::hash<std::string>()(key) % kShards]; }
+
+    static void normalize(Cookie& c)
+    {
+        c.domain = to_lower(c.domain);
+        if (!c.domain.empty() && c.domain[0] == '.') {
+            c.domain.erase(0, 1);
+            c.hostOnly = false;
+        }
+        if (c.path.empty() || c.path[0] != '/') c.path = "/";
+    }
+
+    /// 在已持有 shard.mu 的情况下写入，按 (name, domain, path) 替换已有项并保留其 seq
+    void put_locked(Shard& shard, const std::string& key, Cookie&& c, uint64_t seq, int64_t now)
+    {
+        auto& bucket = shard.domains[key];
+        for (auto& e : bucket) {
+            if (e.cookie.name == c.name && e.cookie.domain == c.domain && e.cookie.path == c.path) {
+                e.cookie = std::move(c);
+                return;
+            }
+        }
+        if (bucket.size() >= kMaxPerDomain) evict(bucket, now, key.empty());
+        bucket.push_back({ std::move(c), seq });
+        count_.fetch_add(1);
+        if (key.empty()) wildcards_.fetch_add(1);
+    }
+
+    /// 解码 pending 的记录 (跳过已过期与损坏的)，写入 key 的桶
+    void decode(Shard& shard, const std::string& key, const Pending& pending, int64_t now)
+    {
+        count_.fetch_sub(pending.count);
+        Cookie c;
+        uint32_t order = 0;
+        for (uint32_t i = 0; i < pending.count; ++i) {
+            if (!pending.snapshot->record(pending.first + i, c, order)) continue;
+            if (c.expires != 0 && c.expires <= now) continue;
+            put_locked(shard, key, std::move(c), pending.seqBase + order, now);
+            c = Cookie();
+        }
+        changed(shard, key.empty());
+    }
+
+    void materialize(Shard& shard, const std::string& key, int64_t now)
+    {
+        if (shard.pending.empty()) return;
+        auto it = shard.pending.find(key);
+        if (it == shard.pending.end()) return;
+        auto pending = std::move(it->second);
+        shard.pending.erase(it);
+        decode(shard, key, pending, now);
+    }
+
+    void materialize_all(Shard& shard, int64_t now)
+    {
+        while (!shard.pending.empty()) {
+            auto it = shard.pending.begin();
+            auto key = it->first;
+            auto pending = std::move(it->second);
+            shard.pending.erase(it);
+            decode(shard, key, pending, now);
+        }
+    }
+
+    void changed(Shard& shard, bool wildcard)
+    {
+        ++shard.version;
+        if (wildcard) wildVersion_.fetch_add(1);
+    }
+
+    void erase_at(std::vector<Entry>& bucket, size_t i, bool wildcard)
+    {
+        bucket.erase(bucket.begin() + (ptrdiff_t)i);
+        count_.fetch_sub(1);
+        if (wildcard) wildcards_.fetch_sub(1);
+    }
+
+    void evict(std::vector<Entry>& bucket, int64_t now, bool wildcard)
+    {
+        for (size_t i = bucket.size(); i-- > 0;)
+            if (bucket[i].cookie.expires != 0 && bucket[i].cookie.expires <= now) erase_at(bucket, i, wildcard);
+        if (bucket.size() >= kMaxPerDomain) {
+            auto oldest = std::min_element(bucket.begin(), bucket.end(),
+                                           [](const Entry& a, const Entry& b) { return a.seq < b.seq; });
+            erase_at(bucket, (size_t)(oldest - bucket.begin()), wildcard);
+        }
+    }
+
+    /// 在已持有 shard.mu 的情况下重建 host 的匹配结果，顺带清掉桶里过期的 Cookie
+    void rebuild(Shard& shard, OriginCache& cached, const std::string& key, const std::string& host, bool https,
+                 int64_t now, uint64_t wildVersion)
+    {
+        struct Candidate { const Cookie* cookie; uint64_t seq; };
+        std::vector<Candidate> found;
+        std::vector<Entry> wild;
+
+        auto it = shard.domains.find(key);
+        if (it != shard.domains.end()) {
+            auto& bucket = it->second;
+            size_t before = bucket.size();
+            for (size_t i = bucket.size(); i-- > 0;)
+                if (bucket[i].cookie.expires != 0 && bucket[i].cookie.expires <= now) erase_at(bucket, i, key.empty());
+            if (bucket.size() != before) ++shard.version;
+            for (auto& e : bucket) {
+                const auto& c = e.cookie;
+                if (c.secure && !https) continue;
+                if (!c.domain.empty() && (c.hostOnly ? c.domain != host : !cookie_domain_match(host, c.domain))) continue;
+                found.push_back({ &c, e.seq });
+            }
+        }
+        // 无域名 Cookie 的桶: 在本分片时直接取副本；在另一分片时按 (主机分片 → 无域名分片) 的固定顺序加锁
+        if (!key.empty() && wildcards_.load() != 0) {
+            auto& other = shard_for(std::string());
+            std::unique_lock<std::mutex> lock(other.mu, std::defer_lock);
+            if (&other != &shard) lock.lock();
+            auto w = other.domains.find(std::string());
+            if (w != other.domains.end()) wild = w->second;
+        }
+        for (auto& e : wild) {
+            if ((e.cookie.expires != 0 && e.cookie.expires <= now) || (e.cookie.secure && !https)) continue;
+            found.push_back({ &e.cookie, e.seq });
+        }
+
+        std::sort(found.begin(), found.end(), [](const Candidate& a, const Candidate& b) {
+            if (a.cookie->path.size() != b.cookie->path.size()) return a.cookie->path.size() > b.cookie->path.size();
+            return a.seq < b.seq;
+        });
+
+        cached.version     = shard.version;
+        cached.wildVersion = wildVersion;
+        cached.expiresAt   = 0;
+        cached.rootOnly    = true;
+        cached.matches.clear();
+        cached.header.clear();
+        for (auto& f : found) {
+            const auto& c = *f.cookie;
+            if (c.expires && (!cached.expiresAt || c.expires < cached.expiresAt)) cached.expiresAt = c.expires;
+            if (c.path != "/") cached.rootOnly = false;
+            cached.matches.push_back({ c.path, c.name + "=" + c.value });
+            if (!cached.header.empty()) cached.header += "; ";
+            cached.header += cached.matches.back().pair;
+        }
+    }
+};
+
+// ──────── 异步请求描述 (异步引擎共用) ────────
+
+struct AsyncResult
+{
+    int                  statusCode = 0;
+    std::string          reasonPhrase;
+    HeaderList           headers;
+    std::vector<uint8_t> body;
+};
+
+/// 提交给 AsyncEngine 的一次请求。body 为调用方数据的副本，提交时 spec.body 指向它。
+/// done 恰好被调用一次: 成功时 error 为空，失败时 result 无意义。
+struct AsyncCall
+{
+    RequestSpec                                 spec;
+    std::shared_ptr<const std::vector<uint8_t>> body;   ///< 重试时各次提交共享
+    CancelToken                                 cancel;
+    int                  delayMs = 0;     ///< 延迟发起 (重试退避)，期间不占用任何线程
+    std::function<void(AsyncResult&&, std::exception_ptr)> done;
+
+    /// 可选: 最终响应 (跟随重定向之后) 的响应头到达时在 I/O 线程上调用
+    std::function<void(int statusCode, const HeaderList& headers)> onHead;
+    /// 可选: 设置后 body 分段交给它 (I/O 线程)，不再缓存到 result.body；抛出异常即以该错误结束请求
+    std::function<void(const char* data, size_t len)> onBody;
+};
+
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
+
+// ──────── WinHTTP 错误描述 ────────
+
+inline std::string winhttp_error_string(DWORD err)
+{
+    switch (err) {
+        case 12001: return "error=12001 (OUT_OF_HANDLES)";
+        case 12002: return "error=12002 (TIMEOUT)";
+        case 12004: return "error=12004 (INTERNAL_ERROR)";
+        case 12005: return "error=12005 (INVALID_URL)";
+        case 12007: return "error=12007 (NAME_NOT_RESOLVED) DNS lookup failed";
+        case 12009: return "error=12009 (INVALID_OPTION)";
+        case 12029: return "error=12029 (CANNOT_CONNECT) Connection refused or unreachable";
+        case 12030: return "error=12030 (CONNECTION_ERROR)";
+        case 12038: return "error=12038 (SECURE_CERT_CN_INVALID) Certificate CN mismatch";
+        case 12044: return "error=12044 (SECURE_CERT_DATE_INVALID) Certificate expired";
+        case 12045: return "error=12045 (SECURE_CERT_REV_FAILED)";
+        case 12057: return "error=12057 (SECURE_CERT_REVOKED)";
+        case 12157: return "error=12157 (SECURE_CHANNEL_ERROR) TLS/SSL handshake failed";
+        case 12175: return "error=12175 (SECURE_FAILURE) SSL certificate error — try setting ignoreSslErrors=true";
+        case 12178: return "error=12178 (AUTO_PROXY_SERVICE_ERROR)";
+        default:    return "error=" + std::to_string(err);
+    }
+}
+
+// ──────── WinHTTP 请求辅助 (同步 / 异步共用) ────────
+
+inline void apply_proxy(HINTERNET h, const std::string& proxyUrl)
+{
+    auto wProxy = to_wide(proxyUrl);
+    WINHTTP_PROXY_INFO proxyInfo;
+    proxyInfo.dwAccessType = WINHTTP_ACCESS_TYPE_NAMED_PROXY;
+    proxyInfo.lpszProxy = const_cast<LPWSTR>(wProxy.c_str());
+    proxyInfo.lpszProxyBypass = WINHTTP_NO_PROXY_BYPASS;
+    WinHttpSetOption(h, WINHTTP_OPTION_PROXY, &proxyInfo, sizeof(proxyInfo));
+}
+
+/// 启用 WinHTTP 自带的 HTTP/2 (Windows 10 1607+，经 ALPN 协商，不支持 h2c)。旧 SDK 头文件中没有该选项时忽略
+inline void apply_http_version(HINTERNET h, HttpVersion version)
+{
+#if defined(WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL)
+    DWORD flags = version == HttpVersion::Http1_1 ? 0 : WINHTTP_PROTOCOL_FLAG_HTTP2;
+    WinHttpSetOption(h, WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL, &flags, sizeof(flags));
+#else
+    (void)h;
+    (void)version;
+#endif
+}
+
+/// 证书忽略标志、超时与请求头
+inline void configure_request(HINTERNET hRequest, const RequestSpec& spec)
+{
+    if (spec.url.isHttps && spec.ignoreSslErrors) {
+        DWORD sslFlags = SECURITY_FLAG_IGNORE_UNKNOWN_CA |
+                         SECURITY_FLAG_IGNORE_CERT_DATE_INVALID |
+                         SECURITY_FLAG_IGNORE_CERT_CN_INVALID |
+                         SECURITY_FLAG_IGNORE_CERT_WRONG_USAGE;
+        WinHttpSetOption(hRequest, WINHTTP_OPTION_SECURITY_FLAGS, &sslFlags, sizeof(sslFlags));
+    }
+
+    if (spec.timeoutMs > 0)
+        WinHttpSetTimeouts(hRequest, spec.timeoutMs, spec.timeoutMs, spec.timeoutMs, spec.timeoutMs);
+
+    if (!spec.headers.empty()) {
+        auto wHeaders = to_wide(spec.headers);
+        WinHttpAddRequestHeaders(hRequest, wHeaders.c_str(), (DWORD)wHeaders.size(), WINHTTP_ADDREQ_FLAG_ADD);
+    }
+}
+
+/// 读取状态码、reason phrase 与全部响应头 (含重复的 Set-Cookie)
+inline void query_response_head(HINTERNET hRequest, int& statusCode, std::string& reasonPhrase, HeaderList& headers)
+{
+    DWORD code = 0, size = sizeof(code);
+    WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                        WINHTTP_HEADER_NAME_BY_INDEX, &code, &size,
+                        WINHTTP_NO_HEADER_INDEX);
+    statusCode = (int)code;
+
+    // Reason phrase
+    size = 0;
+    WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_TEXT,
+                        WINHTTP_HEADER_NAME_BY_INDEX, nullptr, &size,
+                        WINHTTP_NO_HEADER_INDEX);
+    if (GetLastError() == ERROR_INSUFFICIENT_BUFFER && size > 0) {
+        std::wstring val(size / sizeof(wchar_t), 0);
+        if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_TEXT,
+                                WINHTTP_HEADER_NAME_BY_INDEX, val.data(), &size,
+                                WINHTTP_NO_HEADER_INDEX)) {
+            val.resize(size / sizeof(wchar_t));
+            reasonPhrase = to_utf8(val);
+        }
+    }
+
+    DWORD headerSize = 0;
+    WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+                        WINHTTP_HEADER_NAME_BY_INDEX, nullptr, &headerSize,
+                        WINHTTP_NO_HEADER_INDEX);
+    if (headerSize > 0) {
+        std::wstring rawHeaders(headerSize / sizeof(wchar_t), 0);
+        if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+                                WINHTTP_HEADER_NAME_BY_INDEX, rawHeaders.data(), &headerSize,
+                                WINHTTP_NO_HEADER_INDEX)) {
+            rawHeaders.resize(headerSize / sizeof(wchar_t));
+            parse_raw_header_block(to_utf8(rawHeaders), headers);
+        }
+    }
+}
+
+// ──────── WinHTTP 会话 / 单次请求交换 ────────
+
+class HttpSession
+{
+public:
+    void open(const std::string& userAgent)
+    {
+        userAgent_ = userAgent;
+        auto wAgent = to_wide(userAgent);
+        h_.reset(WinHttpOpen(wAgent.c_str(),
+                             WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                             WINHTTP_NO_PROXY_NAME,
+                             WINHTTP_NO_PROXY_BYPASS, 0));
+        if (!h_)
+            throw std::runtime_error("WinHttpOpen failed");
+    }
+
+    void setProxy(const std::string& proxyUrl)
+    {
+        {
+            std::lock_guard<std::mutex> lock(poolMu_);
+            proxyUrl_ = proxyUrl;
+        }
+        apply_proxy(h_.get(), proxyUrl);
+    }
+
+    void setHttpVersion(HttpVersion version)
+    {
+        {
+            std::lock_guard<std::mutex> lock(poolMu_);
+            httpVersion_ = version;
+        }
+        apply_http_version(h_.get(), version);
+    }
+
+    HttpVersion httpVersion() const
+    {
+        std::lock_guard<std::mutex> lock(poolMu_);
+        return httpVersion_;
+    }
+
+    HINTERNET get() const { return h_.get(); }
+    const std::string& userAgent() const { return userAgent_; }
+
+    std::string proxyUrl() const
+    {
+        std::lock_guard<std::mutex> lock(poolMu_);
+        return proxyUrl_;
+    }
+
+    /// 连接池参数。WinHTTP 自行维护 keep-alive socket 并在复用前检查其状态，
+    /// 这里缓存每个 (scheme, host, port) 的 hConnect 句柄，并把每主机上限交给 WinHTTP。
+    void setPoolOptions(const ConnectionPoolOptions& options)
+    {
+        std::lock_guard<std::mutex> lock(poolMu_);
+        poolOptions_ = options;
+        DWORD maxConns = options.maxConnectionsPerHost > 0 ? (DWORD)options.maxConnectionsPerHost : MAXDWORD;
+        WinHttpSetOption(h_.get(), WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &maxConns, sizeof(maxConns));
+        if (!options.enabled) {
+            stats_.evicted += connects_.size();
+            connects_.clear();
+        } else {
+            evict_idle(std::chrono::steady_clock::now());
+        }
+    }
+
+    ConnectionPoolOptions poolOptions() const
+    {
+        std::lock_guard<std::mutex> lock(poolMu_);
+        return poolOptions_;
+    }
+
+    ConnectionPoolStats poolStats() const
+    {
+        std::lock_guard<std::mutex> lock(poolMu_);
+        ConnectionPoolStats s = stats_;
+        for (const auto& [key, entry] : connects_) {
+            if (entry.handle.use_count() > 1) s.active++;
+            else s.idle++;
+        }
+        return s;
+    }
+
+    void clearPool()
+    {
+        std::lock_guard<std::mutex> lock(poolMu_);
+        connects_.clear();
+    }
+
+    /// 取得 (复用或新建) 目标主机的 hConnect。句柄由 shared_ptr 持有，淘汰时不影响进行中的请求。
+    std::shared_ptr<WinHttpHandle> connectHandle(const UrlParts& url, const std::string& errorPrefix)
+    {
+        std::string key = (url.isHttps ? "https://" : "http://") + url.host + ":" + std::to_string(url.port);
+        auto now = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(poolMu_);
+        evict_idle(now);
+        if (poolOptions_.enabled) {
+            auto it = connects_.find(key);
+            if (it != connects_.end()) {
+                it->second.lastUsed = now;
+                stats_.hits++;
+                return it->second.handle;
+            }
+        }
+
+        auto wHost = to_wide(url.host);
+        auto handle = std::make_shared<WinHttpHandle>(WinHttpConnect(h_.get(), wHost.c_str(), (INTERNET_PORT)url.port, 0));
+        if (!*handle)
+            throw std::runtime_error(errorPrefix + "WinHttpConnect failed: " + url.host);
+        stats_.misses++;
+        if (poolOptions_.enabled) connects_[key] = ConnectEntry{ handle, now };
+        return handle;
+    }
+
+private:
+    struct ConnectEntry
+    {
+        std::shared_ptr<WinHttpHandle>        handle;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    WinHttpHandle                                  h_;
+    std::string                                    userAgent_;
+    std::string                                    proxyUrl_;        ///< 受 poolMu_ 保护
+    HttpVersion                                    httpVersion_ = HttpVersion::Http1_1;   ///< 受 poolMu_ 保护
+    mutable std::mutex                             poolMu_;
+    ConnectionPoolOptions                          poolOptions_;
+    ConnectionPoolStats                            stats_;
+    std::unordered_map<std::string, ConnectEntry>  connects_;
+
+    void evict_idle(std::chrono::steady_clock::time_point now)
+    {
+        auto idleLimit = std::chrono::milliseconds(poolOptions_.idleTimeoutMs);
+        for (auto it = connects_.begin(); it != connects_.end();) {
+            bool unused = it->second.handle.use_count() == 1;
+            if (unused && now - it->second.lastUsed > idleLimit) {
+                stats_.evicted++;
+                it = connects_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        while (connects_.size() > std::max<size_t>(poolOptions_.maxIdleTotal, 1)) {
+            auto oldest = connects_.end();
+            for (auto it = connects_.begin(); it != connects_.end(); ++it) {
+                if (it->second.handle.use_count() == 1 &&
+                    (oldest == connects_.end() || it->second.lastUsed < oldest->second.lastUsed))
+                    oldest = it;
+            }
+            if (oldest == connects_.end()) break;
+            stats_.evicted++;
+            connects_.erase(oldest);
+        }
+    }
+};
+
+/// 一次请求/响应交换: 发送请求、接收响应头，随后通过 read() 拉取 body
+class HttpExchange
+{
+public:
+    static constexpr int kMaxResends = 10;   ///< 流式 body 因重定向 / 认证重发的上限 (与 WinHTTP 默认重定向上限一致)
+
+    explicit HttpExchange(HttpSession& session) : session_(session) {}
+
+    void open(const RequestSpec& spec)
+    {
+        const auto& prefix = spec.errorPrefix;
+        auto wPath   = to_wide(spec.url.path);
+        auto wMethod = to_wide(spec.method);
+
+        hConnect_ = session_.connectHandle(spec.url, prefix);
+
+        DWORD flags = spec.url.isHttps ? WINHTTP_FLAG_SECURE : 0;
+        hRequest_.reset(WinHttpOpenRequest(hConnect_->get(), wMethod.c_str(), wPath.c_str(), nullptr,
+                                           WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags));
+        if (!hRequest_)
+            throw std::runtime_error(prefix + "WinHttpOpenRequest failed");
+
+        configure_request(hRequest_.get(), spec);
+
+        if (spec.bodyStream) {
+            send_stream(*spec.bodyStream, prefix);
+        } else {
+            DWORD bodyLen = (DWORD)spec.bodyLen;
+            if (!WinHttpSendRequest(hRequest_.get(), WINHTTP_NO_ADDITIONAL_HEADERS, 0,
+                                    const_cast<LPVOID>(spec.body), bodyLen, bodyLen, 0))
+                throw std::runtime_error(prefix + "WinHttpSendRequest failed: " + winhttp_error_string(GetLastError()));
+
+            if (!WinHttpReceiveResponse(hRequest_.get(), nullptr))
+                throw std::runtime_error(prefix + "WinHttpReceiveResponse failed: " + winhttp_error_string(GetLastError()));
+        }
+
+        query_response_head(hRequest_.get(), statusCode_, reasonPhrase_, headers_);
+    }
+
+    int statusCode() const { return statusCode_; }
+    const std::string& reasonPhrase() const { return reasonPhrase_; }
+    const HeaderList& headers() const { return headers_; }
+
+    /// 读取 body，返回 0 表示结束
+    size_t read(void* buf, size_t cap)
+    {
+        DWORD bytesRead = 0;
+        if (!WinHttpReadData(hRequest_.get(), buf, (DWORD)std::min<size_t>(cap, MAXDWORD), &bytesRead)) return 0;
+        return bytesRead;
+    }
+
+private:
+    /// 流式 body: 显式 Content-Length (可超过 4 GB) 后用 WinHttpWriteData 分块写出，
+    /// 文件段映射为内存直接交给 WinHTTP。需要重发 body 的重定向 / 认证由 WinHTTP 以
+    /// ERROR_WINHTTP_RESEND_REQUEST 告知，回到流开头重来
+    void send_stream(BodyStream& stream, const std::string& prefix)
+    {
+        auto lengthHeader = to_wide("Content-Length: " + std::to_string(stream.size()) + "\r\n");
+        for (int resends = 0; ; ++resends) {
+            if (!WinHttpSendRequest(hRequest_.get(), lengthHeader.c_str(), (DWORD)-1L,
+                                    WINHTTP_NO_REQUEST_DATA, 0, WINHTTP_IGNORE_REQUEST_TOTAL_LENGTH, 0))
+                throw std::runtime_error(prefix + "WinHttpSendRequest failed: " + winhttp_error_string(GetLastError()));
+
+            stream.sendTo(
+                [&](const void* data, size_t len) {
+                    DWORD written = 0;
+                    if (!WinHttpWriteData(hRequest_.get(), data, (DWORD)len, &written))
+                        throw std::runtime_error(prefix + "WinHttpWriteData failed: " + winhttp_error_string(GetLastError()));
+                },
+                [](const BodyFile&, uint64_t, size_t) { return false; });
+
+            if (WinHttpReceiveResponse(hRequest_.get(), nullptr)) return;
+            DWORD err = GetLastError();
+            if (err != ERROR_WINHTTP_RESEND_REQUEST || resends >= kMaxResends)
+                throw std::runtime_error(prefix + "WinHttpReceiveResponse failed: " + winhttp_error_string(err));
+        }
+    }
+
+    HttpSession&                   session_;
+    std::shared_ptr<WinHttpHandle> hConnect_;   ///< 必须先于 hRequest_ 声明 (后析构)
+    WinHttpHandle                  hRequest_;
+    int           statusCode_ = 0;
+    std::string   reasonPhrase_;
+    HeaderList    headers_;
+};
+
+// ──────── WinHTTP 异步引擎 (WINHTTP_FLAG_ASYNC + 状态回调) ────────
+
+/// 独立的异步 WinHTTP 会话: 请求由 WinHTTP 线程池通过状态回调推进，调用线程不阻塞。
+/// 另有一个维护线程负责延迟发起 (重试退避) 与取消轮询。完成回调在 WinHTTP 回调线程上执行。
+class AsyncEngine
+{
+public:
+    explicit AsyncEngine(HttpSession& session) : session_(session) {}
+    ~AsyncEngine() { stop(); }
+
+    AsyncEngine(const AsyncEngine&) = delete;
+    AsyncEngine& operator=(const AsyncEngine&) = delete;
+
+    void submit(std::unique_ptr<AsyncCall> call)
+    {
+        call->spec.body    = (call->body && !call->body->empty()) ? call->body->data() : nullptr;
+        call->spec.bodyLen = call->body ? call->body->size() : 0;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            if (stopping_) throw std::runtime_error("Async engine stopped");
+            ensure_open();
+            if (call->delayMs > 0) {
+                auto due = Clock::now() + std::chrono::milliseconds(call->delayMs);
+                delayed_.push_back({ std::move(call), due });
+                cv_.notify_all();
+                return;
+            }
+        }
+        // 立即发起: 在调用线程打开并发送 (异步模式下 WinHttpSendRequest 不阻塞)
+        start(std::move(call));
+    }
+
+    /// 以 "Async engine stopped" 结束全部未完成请求，等待句柄关闭后回收会话
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            if (stopping_) return;
+            stopping_ = true;
+            cv_.notify_all();
+        }
+        if (housekeeper_.joinable()) housekeeper_.join();
+
+        std::vector<std::unique_ptr<AsyncCall>> delayed;
+        std::vector<Finished> finished;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            for (auto& d : delayed_) delayed.push_back(std::move(d.call));
+            delayed_.clear();
+            for (auto* r : active_) take_finish(r, finished);
+        }
+        auto stopped = std::make_exception_ptr(std::runtime_error("Async engine stopped"));
+        for (auto& call : delayed) invoke(call->done, AsyncResult(), stopped);
+        for (auto& f : finished) deliver(f, stopped);
+
+        // 等待全部请求句柄的 HANDLE_CLOSING，之后回调不再引用本对象
+        std::unique_lock<std::mutex> lock(mu_);
+        closedCv_.wait_for(lock, std::chrono::seconds(10), [this]() { return active_.empty(); });
+        connects_.clear();
+        h_.reset();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Request
+    {
+        AsyncEngine*                   engine = nullptr;
+        std::unique_ptr<AsyncCall>     call;
+        std::shared_ptr<WinHttpHandle> hConnect;
+        std::atomic<HINTERNET>         hRequest{ nullptr };
+        std::atomic<bool>              finished{ false };
+        std::atomic<int>               readDepth{ 0 };
+        std::atomic<int>               refs{ 2 };      ///< 句柄 (HANDLE_CLOSING 释放) + start() 发送期间
+        AsyncResult                    result;
+        std::vector<uint8_t>           buf = std::vector<uint8_t>(64 * 1024);
+    };
+
+    struct Delayed
+    {
+        std::unique_ptr<AsyncCall> call;
+        Clock::time_point          due;
+    };
+
+    /// 已抢到完成权的请求: 回调与句柄在锁外处理
+    struct Finished
+    {
+        std::function<void(AsyncResult&&, std::exception_ptr)> done;
+        AsyncResult result;
+        HINTERNET   hRequest = nullptr;
+    };
+
+    HttpSession&                                                     session_;
+    WinHttpHandle                                                    h_;
+    std::unordered_map<std::string, std::shared_ptr<WinHttpHandle>>  connects_;
+    std::mutex                                                       mu_;
+    std::condition_variable                                          cv_, closedCv_;
+    std::vector<Delayed>                                             delayed_;
+    std::vector<Request*>                                            active_;
+    std::thread                                                      housekeeper_;
+    bool                                                             stopping_ = false;
+    DWORD                                                            maxConns_ = 0;
+    std::string                                                      proxyUrl_;
+    HttpVersion                                                      httpVersion_ = HttpVersion::Http1_1;
+
+    // ──────── 会话 ────────
+
+    void ensure_open()
+    {
+        if (h_) return;
+        auto wAgent = to_wide(session_.userAgent());
+        h_.reset(WinHttpOpen(wAgent.c_str(), WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                             WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, WINHTTP_FLAG_ASYNC));
+        if (!h_) throw std::runtime_error("WinHttpOpen (async) failed: " + winhttp_error_string(GetLastError()));
+
+        if (WinHttpSetStatusCallback(h_.get(), &AsyncEngine::on_status,
+                                     WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS | WINHTTP_CALLBACK_FLAG_HANDLES,
+                                     0) == WINHTTP_INVALID_STATUS_CALLBACK) {
+            h_.reset();
+            throw std::runtime_error("WinHttpSetStatusCallback failed: " + winhttp_error_string(GetLastError()));
+        }
+
+        housekeeper_ = std::thread([this]() { housekeeping_loop(); });
+    }
+
+    /// 代理、每主机连接上限与 HTTP 版本跟随同步会话的当前设置；调用方持有 mu_
+    void sync_session_options()
+    {
+        auto options = session_.poolOptions();
+        DWORD maxConns = options.maxConnectionsPerHost > 0 ? (DWORD)options.maxConnectionsPerHost : MAXDWORD;
+        if (maxConns != maxConns_) {
+            WinHttpSetOption(h_.get(), WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &maxConns, sizeof(maxConns));
+            maxConns_ = maxConns;
+        }
+        auto proxy = session_.proxyUrl();
+        if (proxy != proxyUrl_) {
+            apply_proxy(h_.get(), proxy);
+            proxyUrl_ = proxy;
+        }
+        auto version = session_.httpVersion();
+        if (version != httpVersion_) {
+            apply_http_version(h_.get(), version);
+            httpVersion_ = version;
+        }
+    }
+
+    /// hConnect 按主机缓存 (只是目标描述，实际 socket 由 WinHTTP 复用)；调用方持有 mu_
+    std::shared_ptr<WinHttpHandle> connect_handle(const UrlParts& url)
+    {
+        std::string key = (url.isHttps ? "https://" : "http://") + url.host + ":" + std::to_string(url.port);
+        auto it = connects_.find(key);
+        if (it != connects_.end()) return it->second;
+
+        auto wHost = to_wide(url.host);
+        auto handle = std::make_shared<WinHttpHandle>(WinHttpConnect(h_.get(), wHost.c_str(), (INTERNET_PORT)url.port, 0));
+        if (!*handle) throw std::runtime_error("WinHttpConnect failed: " + url.host);
+        if (connects_.size() >= 256) connects_.clear();
+        connects_[key] = handle;
+        return handle;
+    }
+
+    // ──────── 发起 ────────
+
+    void start(std::unique_ptr<AsyncCall> call)
+    {
+        auto r = std::make_unique<Request>();
+        r->engine = this;
+        r->call = std::move(call);
+        const auto& spec = r->call->spec;
+        HINTERNET hRequest = nullptr;
+        try {
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                if (stopping_) throw std::runtime_error("Async engine stopped");
+                sync_session_options();
+                r->hConnect = connect_handle(spec.url);
+            }
+            auto wPath   = to_wide(spec.url.path);
+            auto wMethod = to_wide(spec.method);
+            DWORD flags = spec.url.isHttps ? WINHTTP_FLAG_SECURE : 0;
+            hRequest = WinHttpOpenRequest(r->hConnect->get(), wMethod.c_str(), wPath.c_str(), nullptr,
+                                          WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
+            if (!hRequest)
+                throw std::runtime_error("WinHttpOpenRequest failed: " + winhttp_error_string(GetLastError()));
+        } catch (...) {
+            invoke(r->call->done, AsyncResult(), prefixed(spec, std::current_exception()));
+            return;
+        }
+
+        // 上下文在发送前绑定到句柄: 之后的每个回调 (含 HANDLE_CLOSING) 都能找到 Request
+        Request* raw = r.release();
+        raw->hRequest.store(hRequest);
+        DWORD_PTR context = reinterpret_cast<DWORD_PTR>(raw);
+        WinHttpSetOption(hRequest, WINHTTP_OPTION_CONTEXT_VALUE, &context, sizeof(context));
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            active_.push_back(raw);
+        }
+
+        configure_request(hRequest, raw->call->spec);
+        DWORD bodyLen = (DWORD)raw->call->spec.bodyLen;
+        if (!WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
+                                const_cast<LPVOID>(raw->call->spec.body), bodyLen, bodyLen, context))
+            fail(raw, "WinHttpSendRequest failed: " + winhttp_error_string(GetLastError()));
+        release(raw);
+    }
+
+    // ──────── 状态回调 ────────
+
+    static void CALLBACK on_status(HINTERNET hInternet, DWORD_PTR context, DWORD status, LPVOID info, DWORD infoLen)
+    {
+        auto r = reinterpret_cast<Request*>(context);
+        if (!r) return;   // 会话 / hConnect 句柄
+        (void)hInternet;
+
+        switch (status) {
+            case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
+                if (r->finished.load()) break;
+                if (!WinHttpReceiveResponse(r->hRequest.load(), nullptr))
+                    r->engine->fail(r, "WinHttpReceiveResponse failed: " + winhttp_error_string(GetLastError()));
+                break;
+
+            case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE:
+                if (r->finished.load()) break;
+                query_response_head(r->hRequest.load(), r->result.statusCode, r->result.reasonPhrase, r->result.headers);
+                try {
+                    if (r->call->onHead) r->call->onHead(r->result.statusCode, r->result.headers);
+                } catch (const std::exception& ex) {
+                    r->engine->fail(r, ex.what());
+                    break;
+                }
+                if (!r->call->onBody) {
+                    int64_t length = content_length_of(r->result.headers);
+                    if (length > 0) r->result.body.reserve((size_t)std::min<int64_t>(length, 64ll << 20));
+                }
+                r->engine->read_next(r);
+                break;
+
+            case WINHTTP_CALLBACK_STATUS_READ_COMPLETE:
+                if (r->finished.load()) break;
+                if (infoLen == 0) { r->engine->succeed(r); break; }
+                try {
+                    if (r->call->onBody) r->call->onBody(reinterpret_cast<const char*>(r->buf.data()), infoLen);
+                    else r->result.body.insert(r->result.body.end(), r->buf.data(), r->buf.data() + infoLen);
+                } catch (const std::exception& ex) {
+                    r->engine->fail(r, ex.what());
+                    break;
+                }
+                if (r->call->cancel.isCancelled()) { r->engine->fail(r, "Request cancelled"); break; }
+                r->engine->read_next(r);
+                break;
+
+            case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR: {
+                auto res = static_cast<WINHTTP_ASYNC_RESULT*>(info);
+                if (res->dwError == ERROR_WINHTTP_OPERATION_CANCELLED) break;   // 由我们关闭句柄引起
+                r->engine->fail(r, "WinHTTP async request failed: " + winhttp_error_string(res->dwError));
+                break;
+            }
+
+            case WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING:
+                r->engine->release(r);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    /// READ_COMPLETE 可能在 WinHttpReadData 内同步回调: 只由最外层发起读取，避免递归过深
+    void read_next(Request* r)
+    {
+        if (r->readDepth++ > 0) return;
+        do {
+            HINTERNET h = r->hRequest.load();
+            if (!h || r->finished.load()) return;
+            if (!WinHttpReadData(h, r->buf.data(), (DWORD)r->buf.size(), nullptr)) {
+                fail(r, "WinHttpReadData failed: " + winhttp_error_string(GetLastError()));
+                return;
+            }
+        } while (--r->readDepth > 0);
+    }
+
+    // ──────── 完成 ────────
+
+    /// 抢占完成权并取出回调与句柄 (恰好一次)
+    static bool take_finish(Request* r, std::vector<Finished>& out)
+    {
+        if (r->finished.exchange(true)) return false;
+        Finished f;
+        f.done = std::move(r->call->done);
+        f.result = std::move(r->result);
+        f.hRequest = r->hRequest.exchange(nullptr);
+        out.push_back(std::move(f));
+        return true;
+    }
+
+    /// 先关闭句柄 (连接回到 WinHTTP 的 keep-alive 池) 再调用回调
+    static void deliver(Finished& f, std::exception_ptr error)
+    {
+        if (f.hRequest) WinHttpCloseHandle(f.hRequest);
+        invoke(f.done, std::move(f.result), error);
+    }
+
+    void succeed(Request* r)
+    {
+        std::vector<Finished> f;
+        if (take_finish(r, f)) deliver(f.front(), nullptr);
+    }
+
+    void fail(Request* r, const std::string& message)
+    {
+        auto error = prefixed(r->call->spec, std::make_exception_ptr(std::runtime_error(message)));
+        std::vector<Finished> f;
+        if (take_finish(r, f)) deliver(f.front(), error);
+    }
+
+    /// 请求可能在 WinHttpSendRequest 返回前就已完成并关闭: 引用计数归零才释放
+    void release(Request* r)
+    {
+        if (--r->refs > 0) return;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            active_.erase(std::remove(active_.begin(), active_.end(), r), active_.end());
+            closedCv_.notify_all();
+        }
+        delete r;
+    }
+
+    static std::exception_ptr prefixed(const RequestSpec& spec, std::exception_ptr error)
+    {
+        if (spec.errorPrefix.empty()) return error;
+        try { std::rethrow_exception(error); }
+        catch (const std::exception& ex) { return std::make_exception_ptr(std::runtime_error(spec.errorPrefix + ex.what())); }
+        catch (...) { return error; }
+    }
+
+    static void invoke(std::function<void(AsyncResult&&, std::exception_ptr)>& done, AsyncResult&& result, std::exception_ptr error)
+    {
+        if (!done) return;
+        try { done(std::move(result), error); } catch (...) {}
+    }
+
+    // ──────── 维护线程: 延迟发起 + 取消轮询 ────────
+
+    void housekeeping_loop()
+    {
+        std::unique_lock<std::mutex> lock(mu_);
+        while (!stopping_) {
+            cv_.wait_for(lock, std::chrono::milliseconds(50));
+            if (stopping_) break;
+
+            auto now = Clock::now();
+            std::vector<std::unique_ptr<AsyncCall>> due, cancelledCalls;
+            for (auto it = delayed_.begin(); it != delayed_.end();) {
+                if (it->call->cancel.isCancelled()) { cancelledCalls.push_back(std::move(it->call)); it = delayed_.erase(it); }
+                else if (it->due <= now)            { due.push_back(std::move(it->call));            it = delayed_.erase(it); }
+                else ++it;
+            }
+            std::vector<Finished> cancelled;
+            for (auto* r : active_) {
+                if (r->call->cancel.isCancelled()) take_finish(r, cancelled);
+            }
+
+            lock.unlock();
+            auto cancelError = std::make_exception_ptr(std::runtime_error("Request cancelled"));
+            for (auto& call : cancelledCalls) invoke(call->done, AsyncResult(), cancelError);
+            for (auto& f : cancelled) deliver(f, cancelError);
+            for (auto& call : due) start(std::move(call));
+            lock.lock();
+        }
+    }
+};
+
+#else // DRX_HTTP_BACKEND_POSIX
+
+inline std::string errno_message(int err)
+{
+    return std::generic_category().message(err);
+}
+
+/// I/O 超时 (与其他传输错误区分: 超时的请求不会在新连接上自动重发)
+struct TransportTimeout : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+// ──────── POSIX 连接 (非阻塞 socket + epoll，可选 TLS) ────────
+
+/// 非阻塞原语需要等待的事件
+enum class IoWant : uint32_t { None = 0, Read = EPOLLIN, Write = EPOLLOUT };
+
+/// 单条 TCP 连接。socket 始终为非阻塞模式:
+/// - try* / begin* / continue* 为非阻塞原语，返回需要等待的事件，由异步引擎的事件循环驱动
+/// - connect / startTls / sendAll / recvSome 为阻塞接口，在原语之上用连接私有的 epoll + 超时等待
+/// 启用 DRX_HTTP_ENABLE_OPENSSL 时 TLS 通过内存 BIO 驱动，网络 I/O 仍由本类完成。
+class PosixConnection
+{
+public:
+    PosixConnection() = default;
+    ~PosixConnection() { close(); }
+
+    PosixConnection(const PosixConnection&) = delete;
+    PosixConnection& operator=(const PosixConnection&) = delete;
+
+    int fd() const { return fd_; }
+
+    // ──────── 非阻塞原语 ────────
+
+    /// 解析地址并发起非阻塞 connect。返回 true 表示已连上，否则等待可写后调用 finishConnect()。
+    /// 注意: DNS 解析 (getaddrinfo) 仍是同步的。
+    bool beginConnect(const std::string& host, uint16_t port)
+    {
+        std::string name = host;
+        if (name.size() > 2 && name.front() == '[' && name.back() == ']') name = name.substr(1, name.size() - 2);
+
+        addrinfo hints{};
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+        addrinfo* res = nullptr;
+        int rc = getaddrinfo(name.c_str(), std::to_string(port).c_str(), &hints, &res);
+        if (rc != 0 || !res)
+            throw std::runtime_error("error=NAME_NOT_RESOLVED DNS lookup failed: " + host + " (" + gai_strerror(rc) + ")");
+        std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> guard(res, &freeaddrinfo);
+
+        addrs_.clear();
+        for (auto ai = res; ai; ai = ai->ai_next) {
+            Address a;
+            std::memcpy(&a.storage, ai->ai_addr, ai->ai_addrlen);
+            a.len = ai->ai_addrlen;
+            a.family = ai->ai_family;
+            addrs_.push_back(a);
+        }
+        nextAddr_ = 0;
+        lastErr_ = 0;
+        where_ = host + ":" + std::to_string(port);
+        return connect_next();
+    }
+
+    /// 连接中的 socket 可写后调用: 成功返回 true；当前地址失败时改连下一个地址并返回 false
+    /// (fd 可能已变化，需重新等待可写)；全部地址失败时抛出。
+    bool finishConnect()
+    {
+        int soErr = 0;
+        socklen_t sl = sizeof(soErr);
+        getsockopt(fd_, SOL_SOCKET, SO_ERROR, &soErr, &sl);
+        if (soErr == 0) { configure(); return true; }
+        return failAddress(soErr);
+    }
+
+    /// 当前地址连接失败 (如超时): 改连下一个地址，语义同 finishConnect()
+    bool failAddress(int err)
+    {
+        lastErr_ = err;
+        close();
+        return connect_next();
+    }
+
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+    /// alpn: ALPN 协议列表 (长度前缀编码，如 "\x02h2\x08http/1.1")，nullptr 表示不协商
+    void beginTls(SSL_CTX* ctx, const std::string& host, bool verifyPeer, const char* alpn = nullptr)
+    {
+        ssl_ = SSL_new(ctx);
+        if (!ssl_) throw std::runtime_error("error=SECURE_FAILURE SSL_new failed");
+        if (alpn) SSL_set_alpn_protos(ssl_, reinterpret_cast<const unsigned char*>(alpn), (unsigned)std::strlen(alpn));
+        rbio_ = BIO_new(BIO_s_mem());
+        wbio_ = BIO_new(BIO_s_mem());
+        SSL_set_bio(ssl_, rbio_, wbio_);
+        SSL_set_connect_state(ssl_);
+
+        in6_addr addr6;
+        in_addr  addr4;
+        bool isIp = inet_pton(AF_INET, host.c_str(), &addr4) == 1 || inet_pton(AF_INET6, host.c_str(), &addr6) == 1;
+        if (!isIp) SSL_set_tlsext_host_name(ssl_, host.c_str());
+
+        if (verifyPeer) {
+            SSL_set_verify(ssl_, SSL_VERIFY_PEER, nullptr);
+            if (isIp) X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl_), host.c_str());
+            else      SSL_set1_host(ssl_, host.c_str());
+        } else {
+            SSL_set_verify(ssl_, SSL_VERIFY_NONE, nullptr);
+        }
+    }
+
+    /// 握手完成后服务器选定的 ALPN 协议 (未协商时为空)
+    std::string alpnSelected() const
+    {
+        const unsigned char* proto = nullptr;
+        unsigned len = 0;
+        if (ssl_) SSL_get0_alpn_selected(ssl_, &proto, &len);
+        return proto ? std::string(reinterpret_cast<const char*>(proto), len) : std::string();
+    }
+
+    /// 推进 TLS 握手，完成返回 true
+    bool continueTls(IoWant& want)
+    {
+        while (true) {
+            int rc = SSL_do_handshake(ssl_);
+            drain_tls_output();
+            if (!flushOutput(want)) return false;
+            if (rc == 1) return true;
+
+            int err = SSL_get_error(ssl_, rc);
+            if (err == SSL_ERROR_WANT_READ) {
+                int n = feed_tls(want);
+                if (n > 0) continue;
+                if (n == 0) throw std::runtime_error("error=SECURE_CHANNEL_ERROR TLS handshake failed: connection closed");
+                return false;
+            }
+            if (err == SSL_ERROR_WANT_WRITE) continue;
+
+            long vr = SSL_get_verify_result(ssl_);
+            std::string detail = (vr != X509_V_OK) ? X509_verify_cert_error_string(vr) : tls_error_string();
+            throw std::runtime_error("error=SECURE_FAILURE TLS handshake failed: " + detail
+                                     + " — try setting ignoreSslErrors=true");
+        }
+    }
+#endif
+
+    /// 发送尽可能多的数据，返回接受的字节数。返回 0 时按 want 等待 (None = 立即重试)。
+    /// TLS 下已接受的明文可能仍有密文在缓冲中，发送结束前需调用 flushOutput()。
+    size_t trySend(const void* data, size_t len, IoWant& want)
+    {
+        want = IoWant::None;
+        if (!flushOutput(want)) return 0;
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+        if (ssl_) {
+            int n = SSL_write(ssl_, data, (int)std::min<size_t>(len, 64 * 1024));
+            if (n <= 0) {
+                int err = SSL_get_error(ssl_, n);
+                if (err == SSL_ERROR_WANT_READ) {
+                    int r = feed_tls(want);
+                    if (r == 0) throw std::runtime_error("error=CONNECTION_ERROR TLS connection closed");
+                    return 0;
+                }
+                throw std::runtime_error("error=CONNECTION_ERROR TLS write failed: " + tls_error_string());
+            }
+            drain_tls_output();
+            IoWant ignored;
+            flushOutput(ignored);
+            return (size_t)n;
+        }
+#endif
+        ssize_t n = ::send(fd_, data, len, MSG_NOSIGNAL);
+        if (n > 0) return (size_t)n;
+        if (n < 0 && errno == EINTR) return 0;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) { want = IoWant::Write; return 0; }
+        throw std::runtime_error("error=CONNECTION_ERROR send failed: " + errno_message(errno));
+    }
+
+    /// 写出缓冲中的 TLS 密文，全部写出返回 true (明文连接恒为 true)
+    bool flushOutput(IoWant& want)
+    {
+        while (outPos_ < out_.size()) {
+            ssize_t n = ::send(fd_, out_.data() + outPos_, out_.size() - outPos_, MSG_NOSIGNAL);
+            if (n > 0) { outPos_ += (size_t)n; continue; }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) { want = IoWant::Write; return false; }
+            throw std::runtime_error("error=CONNECTION_ERROR send failed: " + errno_message(errno));
+        }
+        out_.clear();
+        outPos_ = 0;
+        return true;
+    }
+
+    /// 读取若干字节。返回 0 时: eof = 对端关闭，否则按 want 等待 (None = 立即重试)
+    size_t tryRecv(void* buf, size_t cap, IoWant& want, bool& eof)
+    {
+        want = IoWant::None;
+        eof = false;
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+        if (ssl_) {
+            while (true) {
+                int n = SSL_read(ssl_, buf, (int)std::min<size_t>(cap, INT32_MAX));
+                if (n > 0) return (size_t)n;
+                int err = SSL_get_error(ssl_, n);
+                if (err == SSL_ERROR_WANT_READ) {
+                    drain_tls_output();
+                    IoWant ignored;
+                    flushOutput(ignored);
+                    int r = feed_tls(want);
+                    if (r > 0) continue;
+                    if (r == 0) eof = true;
+                    return 0;
+                }
+                if (err == SSL_ERROR_ZERO_RETURN) { eof = true; return 0; }
+                throw std::runtime_error("error=CONNECTION_ERROR TLS read failed: " + tls_error_string());
+            }
+        }
+#endif
+        while (true) {
+            ssize_t n = ::recv(fd_, buf, cap, 0);
+            if (n > 0) return (size_t)n;
+            if (n == 0) { eof = true; return 0; }
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { want = IoWant::Read; return 0; }
+            throw std::runtime_error("error=CONNECTION_ERROR recv failed: " + errno_message(errno));
+        }
+    }
+
+    // ──────── 阻塞接口 ────────
+
+    void connect(const std::string& host, uint16_t port, int timeoutMs)
+    {
+        if (beginConnect(host, port)) return;
+        while (true) {
+            bool done = wait(IoWant::Write, timeoutMs) ? finishConnect() : failAddress(ETIMEDOUT);
+            if (done) return;
+        }
+    }
+
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+    void startTls(SSL_CTX* ctx, const std::string& host, bool verifyPeer, int timeoutMs)
+    {
+        beginTls(ctx, host, verifyPeer);
+        IoWant want;
+        while (!continueTls(want)) {
+            if (!wait(want, timeoutMs)) throw TransportTimeout("error=TIMEOUT TLS handshake timed out");
+        }
+    }
+#endif
+
+    void sendAll(const void* data, size_t len, int timeoutMs)
+    {
+        auto p = static_cast<const char*>(data);
+        IoWant want;
+        while (len > 0) {
+            size_t n = trySend(p, len, want);
+            p += n;
+            len -= n;
+            if (n == 0 && want != IoWant::None && !wait(want, timeoutMs))
+                throw TransportTimeout("error=TIMEOUT send timed out");
+        }
+        while (!flushOutput(want)) {
+            if (!wait(want, timeoutMs)) throw TransportTimeout("error=TIMEOUT send timed out");
+        }
+    }
+
+    /// 明文连接上用 sendfile(2) 把文件区间直接交给内核发送，数据不经过用户态。
+    /// TLS 连接或文件系统不支持时返回 false (尚未发出任何字节)，由调用方改走内存映射
+    bool sendFile(int fileFd, uint64_t offset, size_t len, int timeoutMs)
+    {
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+        if (ssl_) return false;
+#endif
+        SigpipeBlock noSigpipe;   // sendfile 没有 MSG_NOSIGNAL
+        off_t pos = (off_t)offset;
+        size_t remaining = len;
+        while (remaining > 0) {
+            ssize_t n = ::sendfile(fd_, fileFd, &pos, remaining);
+            if (n > 0) { remaining -= (size_t)n; continue; }
+            if (n == 0) throw std::runtime_error("Body file truncated while sending");
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!wait(IoWant::Write, timeoutMs)) throw TransportTimeout("error=TIMEOUT send timed out");
+                continue;
+            }
+            if ((errno == EINVAL || errno == ENOSYS) && remaining == len) return false;
+            throw std::runtime_error("error=CONNECTION_ERROR sendfile failed: " + errno_message(errno));
+        }
+        return true;
+    }
+
+    /// 读取若干字节，返回 0 表示对端关闭
+    size_t recvSome(void* buf, size_t cap, int timeoutMs)
+    {
+        IoWant want;
+        bool eof;
+        while (true) {
+            size_t n = tryRecv(buf, cap, want, eof);
+            if (n > 0) return n;
+            if (eof) return 0;
+            if (want != IoWant::None && !wait(want, timeoutMs))
+                throw TransportTimeout("error=TIMEOUT receive timed out");
+        }
+    }
+
+    /// TLS 引擎中是否还有已解密未取走的数据 (epoll 不会再为这部分数据报告可读)
+    bool hasBufferedInput() const
+    {
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+        return ssl_ && (SSL_pending(ssl_) > 0 || BIO_ctrl_pending(rbio_) > 0);
+#else
+        return false;
+#endif
+    }
+
+    /// 复用前的健康检查: 空闲连接上不应有可读数据，读到 EOF / 数据 / 错误都视为失效
+    bool isAlive()
+    {
+        if (fd_ < 0) return false;
+        char probe;
+        ssize_t n = ::recv(fd_, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+        if (n == 0) return false;
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+        // TLS 1.3 的 NewSessionTicket 等握手后消息可能晚到，交给 TLS 引擎处理后再判断
+        if (ssl_) return drain_tls_idle();
+#endif
+        return false;
+    }
+
+    void close()
+    {
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+        if (ssl_) { SSL_free(ssl_); ssl_ = nullptr; rbio_ = wbio_ = nullptr; }
+#endif
+        if (ep_ >= 0) { ::close(ep_); ep_ = -1; }
+        if (fd_ >= 0) { ::close(fd_); fd_ = -1; }
+        out_.clear();
+        outPos_ = 0;
+    }
+
+private:
+    /// 在当前线程屏蔽 SIGPIPE，析构时取走期间挂起的 SIGPIPE 并恢复信号掩码
+    class SigpipeBlock
+    {
+    public:
+        SigpipeBlock()
+        {
+            sigemptyset(&set_);
+            sigaddset(&set_, SIGPIPE);
+            sigset_t pending;
+            sigpending(&pending);
+            wasPending_ = sigismember(&pending, SIGPIPE) == 1;
+            pthread_sigmask(SIG_BLOCK, &set_, &old_);
+        }
+
+        ~SigpipeBlock()
+        {
+            if (!wasPending_) {
+                sigset_t pending;
+                sigpending(&pending);
+                if (sigismember(&pending, SIGPIPE) == 1) {
+                    timespec zero{ 0, 0 };
+                    while (sigtimedwait(&set_, nullptr, &zero) < 0 && errno == EINTR) {}
+                }
+            }
+            pthread_sigmask(SIG_SETMASK, &old_, nullptr);
+        }
+
+        SigpipeBlock(const SigpipeBlock&) = delete;
+        SigpipeBlock& operator=(const SigpipeBlock&) = delete;
+
+    private:
+        sigset_t set_;
+        sigset_t old_;
+        bool     wasPending_ = false;
+    };
+
+    struct Address
+    {
+        sockaddr_storage storage;
+        socklen_t        len;
+        int              family;
+    };
+
+    int                  fd_    = -1;
+    int                  ep_    = -1;      ///< 阻塞接口使用的私有 epoll，按需创建
+    uint32_t             armed_ = 0;
+    std::vector<Address> addrs_;
+    size_t               nextAddr_ = 0;
+    int                  lastErr_ = 0;
+    std::string          where_;
+    std::string          out_;             ///< 待写出的 TLS 密文
+    size_t               outPos_ = 0;
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+    SSL*                 ssl_   = nullptr;
+    BIO*                 rbio_  = nullptr;
+    BIO*                 wbio_  = nullptr;
+#endif
+
+    /// 依次尝试剩余地址，已连上返回 true，连接进行中返回 false，全部失败抛出
+    bool connect_next()
+    {
+        while (nextAddr_ < addrs_.size()) {
+            const auto& a = addrs_[nextAddr_++];
+            int fd = ::socket(a.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+            if (fd < 0) { lastErr_ = errno; continue; }
+            fd_ = fd;
+            if (::connect(fd, reinterpret_cast<const sockaddr*>(&a.storage), a.len) == 0) { configure(); return true; }
+            if (errno == EINPROGRESS) return false;
+            lastErr_ = errno;
+            close();
+        }
+
+        std::string where = where_ + " (" + errno_message(lastErr_) + ")";
+        if (lastErr_ == ETIMEDOUT) throw TransportTimeout("error=TIMEOUT connect timed out: " + where);
+        throw std::runtime_error("error=CANNOT_CONNECT Connection refused or unreachable: " + where);
+    }
+
+    void configure()
+    {
+        int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    /// 等待可读/可写，超时返回 false
+    bool wait(IoWant want, int timeoutMs)
+    {
+        uint32_t events = (uint32_t)want;
+        if (ep_ < 0) {
+            ep_ = epoll_create1(EPOLL_CLOEXEC);
+            if (ep_ < 0) throw std::runtime_error("epoll_create1 failed: " + errno_message(errno));
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = fd_;
+            epoll_ctl(ep_, EPOLL_CTL_ADD, fd_, &ev);
+            armed_ = events;
+        } else if (armed_ != events) {
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = fd_;
+            epoll_ctl(ep_, EPOLL_CTL_MOD, fd_, &ev);
+            armed_ = events;
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (true) {
+            int remaining = timeoutMs <= 0 ? -1 : (int)std::max<int64_t>(0,
+                std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+            epoll_event ev{};
+            int n = epoll_wait(ep_, &ev, 1, remaining);
+            if (n > 0) return true;
+            if (n == 0) return false;
+            if (errno != EINTR) throw std::runtime_error("epoll_wait failed: " + errno_message(errno));
+        }
+    }
+
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+    static std::string tls_error_string()
+    {
+        unsigned long e = ERR_get_error();
+        if (e == 0) return "unknown TLS error";
+        char buf[256];
+        ERR_error_string_n(e, buf, sizeof(buf));
+        return buf;
+    }
+
+    /// 把 TLS 引擎产生的密文移入发送缓冲
+    void drain_tls_output()
+    {
+        char tmp[16 * 1024];
+        int n;
+        while ((n = BIO_read(wbio_, tmp, sizeof(tmp))) > 0) out_.append(tmp, (size_t)n);
+    }
+
+    /// 从 socket 读取密文喂给 TLS 引擎: > 0 已读入，0 对端关闭，-1 需等待可读
+    int feed_tls(IoWant& want)
+    {
+        char tmp[16 * 1024];
+        while (true) {
+            ssize_t n = ::recv(fd_, tmp, sizeof(tmp), 0);
+            if (n > 0) { BIO_write(rbio_, tmp, (int)n); return (int)n; }
+            if (n == 0) return 0;
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { want = IoWant::Read; return -1; }
+            throw std::runtime_error("error=CONNECTION_ERROR recv failed: " + errno_message(errno));
+        }
+    }
+
+    /// 非阻塞地读入空闲连接上的全部密文；只有握手后消息 (无应用数据、未关闭) 时连接仍可用
+    bool drain_tls_idle()
+    {
+        IoWant want;
+        int n;
+        try {
+            while ((n = feed_tls(want)) > 0) {}
+        } catch (const std::runtime_error&) {
+            return false;
+        }
+        if (n == 0) return false;
+        char probe;
+        int rc = SSL_peek(ssl_, &probe, 1);
+        if (rc > 0) return false;
+        bool idle = SSL_get_error(ssl_, rc) == SSL_ERROR_WANT_READ;
+        ERR_clear_error();
+        return idle;
+    }
+#endif
+};
+
+// ──────── POSIX 连接池 (按 scheme/host/port 复用 keep-alive 连接) ────────
+
+/// 空闲连接按主机分组 (LIFO，最近归还的先复用)，借出前做健康检查。
+/// 每主机连接数达到上限时 acquire() 等待其他请求归还，超过连接超时则报 TIMEOUT。
+class ConnectionPool
+{
+public:
+    /// 借出的连接。recycle() 归还到池；未归还而析构时关闭连接并释放主机名额。
+    class Lease
+    {
+    public:
+        Lease() = default;
+        Lease(Lease&& o) noexcept { *this = std::move(o); }
+        Lease& operator=(Lease&& o) noexcept
+        {
+            if (this != &o) {
+                release();
+                pool_ = o.pool_; key_ = std::move(o.key_); conn_ = std::move(o.conn_); reused_ = o.reused_;
+                o.pool_ = nullptr;
+            }
+            return *this;
+        }
+        ~Lease() { release(); }
+
+        PosixConnection* operator->() const { return conn_.get(); }
+        PosixConnection& operator*() const { return *conn_; }
+        explicit operator bool() const { return conn_ != nullptr; }
+
+        /// 是否复用了池中的空闲连接
+        bool reused() const { return reused_; }
+
+        /// 未命中时由调用方建立新连接后挂上
+        void attach(std::unique_ptr<PosixConnection> conn) { conn_ = std::move(conn); }
+
+        /// 响应已完整读完且连接可保持: 归还到池
+        void recycle()
+        {
+            if (pool_) pool_->put_back(key_, std::move(conn_));
+            pool_ = nullptr;
+            conn_.reset();
+        }
+
+        /// 关闭连接并释放主机名额; stale = 复用的连接已被对端关闭
+        void release(bool stale = false)
+        {
+            conn_.reset();
+            if (pool_) pool_->drop(key_, stale);
+            pool_ = nullptr;
+        }
+
+    private:
+        friend class ConnectionPool;
+        ConnectionPool*                  pool_ = nullptr;
+        std::string                      key_;
+        std::unique_ptr<PosixConnection> conn_;
+        bool                             reused_ = false;
+    };
+
+    ~ConnectionPool() { clear(); }
+
+    void setOptions(const ConnectionPoolOptions& options)
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        options_ = options;
+        evict(Clock::now(), true);
+        cv_.notify_all();
+    }
+
+    ConnectionPoolOptions options() const
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        return options_;
+    }
+
+    ConnectionPoolStats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        ConnectionPoolStats s = stats_;
+        s.idle = idleTotal_;
+        for (const auto& [key, host] : hosts_) s.active += host.active;
+        return s;
+    }
+
+    /// 关闭全部空闲连接
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        for (auto& [key, host] : hosts_) host.idle.clear();
+        idleTotal_ = 0;
+    }
+
+    /// 借出 key 对应的连接: 命中时 Lease 已持有连接，否则 Lease 为空、名额已预留
+    Lease acquire(const std::string& key, int timeoutMs)
+    {
+        std::unique_lock<std::mutex> lock(mu_);
+        auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 60000);
+
+        Lease lease;
+        while (!acquire_locked(key, lease)) {
+            if (cv_.wait_until(lock, deadline) == std::cv_status::timeout && Clock::now() >= deadline)
+                throw TransportTimeout("error=TIMEOUT connection pool exhausted for " + key
+                                       + " (maxConnectionsPerHost=" + std::to_string(options_.maxConnectionsPerHost) + ")");
+        }
+        return lease;
+    }
+
+    /// 非阻塞借出 (异步引擎使用): 每主机连接数已达上限时返回 false
+    bool tryAcquire(const std::string& key, Lease& out)
+    {
+        out.release();
+        std::lock_guard<std::mutex> lock(mu_);
+        return acquire_locked(key, out);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct IdleConnection
+    {
+        std::unique_ptr<PosixConnection> conn;
+        Clock::time_point                since;
+    };
+
+    struct Host
+    {
+        std::vector<IdleConnection> idle;     ///< 按归还时间升序
+        size_t                      active = 0;
+    };
+
+    mutable std::mutex                     mu_;
+    std::condition_variable                cv_;
+    ConnectionPoolOptions                  options_;
+    ConnectionPoolStats                    stats_;
+    std::unordered_map<std::string, Host>  hosts_;
+    size_t                                 idleTotal_ = 0;
+    Clock::time_point                      lastSweep_;
+
+    bool acquire_locked(const std::string& key, Lease& out)
+    {
+        evict(Clock::now(), false);
+        auto& host = hosts_[key];
+
+        while (options_.enabled && !host.idle.empty()) {
+            auto conn = std::move(host.idle.back().conn);
+            host.idle.pop_back();
+            idleTotal_--;
+            if (conn->isAlive()) {
+                stats_.hits++;
+                out = make_lease(host, key, std::move(conn));
+                return true;
+            }
+            stats_.stale++;
+        }
+
+        if (options_.maxConnectionsPerHost == 0 || host.active < options_.maxConnectionsPerHost) {
+            stats_.misses++;
+            out = make_lease(host, key, nullptr);
+            return true;
+        }
+        return false;
+    }
+
+    Lease make_lease(Host& host, const std::string& key, std::unique_ptr<PosixConnection> conn)
+    {
+        host.active++;
+        Lease lease;
+        lease.pool_ = this;
+        lease.key_ = key;
+        lease.reused_ = conn != nullptr;
+        lease.conn_ = std::move(conn);
+        return lease;
+    }
+
+    void put_back(const std::string& key, std::unique_ptr<PosixConnection> conn)
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto& host = hosts_[key];
+        host.active--;
+        if (conn && options_.enabled && options_.maxIdlePerHost > 0) {
+            host.idle.push_back({ std::move(conn), Clock::now() });
+            idleTotal_++;
+            evict(Clock::now(), true);
+        }
+        cv_.notify_all();
+    }
+
+    void drop(const std::string& key, bool stale)
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        hosts_[key].active--;
+        if (stale) stats_.stale++;
+        cv_.notify_all();
+    }
+
+    /// 淘汰超时空闲连接并执行容量上限; force = false 时全表扫描每秒最多一次
+    void evict(Clock::time_point now, bool force)
+    {
+        if (!force && now - lastSweep_ < std::chrono::seconds(1)) return;
+        lastSweep_ = now;
+
+        auto idleLimit = std::chrono::milliseconds(options_.idleTimeoutMs);
+        size_t perHost = options_.enabled ? options_.maxIdlePerHost : 0;
+        for (auto it = hosts_.begin(); it != hosts_.end();) {
+            auto& idle = it->second.idle;
+            size_t expired = 0;
+            while (expired < idle.size() && now - idle[expired].since > idleLimit) ++expired;
+            size_t excess = idle.size() - expired > perHost ? idle.size() - expired - perHost : 0;
+            size_t n = expired + excess;
+            if (n > 0) {
+                idle.erase(idle.begin(), idle.begin() + (ptrdiff_t)n);
+                idleTotal_ -= n;
+                stats_.evicted += n;
+            }
+            if (idle.empty() && it->second.active == 0) it = hosts_.erase(it);
+            else ++it;
+        }
+
+        while (idleTotal_ > options_.maxIdleTotal) {
+            Host* oldest = nullptr;
+            for (auto& [key, host] : hosts_) {
+                if (!host.idle.empty() && (!oldest || host.idle.front().since < oldest->idle.front().since))
+                    oldest = &host;
+            }
+            if (!oldest) break;
+            oldest->idle.erase(oldest->idle.begin());
+            idleTotal_--;
+            stats_.evicted++;
+        }
+    }
+};
+
+/// 池键: 同一 (scheme, host, port)、同一代理与证书校验设置的连接才可互相复用
+inline std::string pool_key(const UrlParts& url, const UrlParts* proxy, bool ignoreSslErrors)
+{
+    std::string key = (url.isHttps ? "https://" : "http://") + url.host + ":" + std::to_string(url.port);
+    if (proxy) key += " via " + proxy->host + ":" + std::to_string(proxy->port);
+    if (url.isHttps && ignoreSslErrors) key += " (no-verify)";
+    return key;
+}
+
+// ──────── HPACK (RFC 7541) ────────
+
+struct HpackEntry
+{
+    std::string name;
+    std::string value;
+};
+
+inline const std::vector<HpackEntry>& hpack_static_table()
+{
+    static const std::vector<HpackEntry> table = {
+        { ":authority", "" }, { ":method", "GET" }, { ":method", "POST" }, { ":path", "/" },
+        { ":path", "/index.html" }, { ":scheme", "http" }, { ":scheme", "https" }, { ":status", "200" },
+        { ":status", "204" }, { ":status", "206" }, { ":status", "304" }, { ":status", "400" },
+        { ":status", "404" }, { ":status", "500" }, { "accept-charset", "" }, { "accept-encoding", "gzip, deflate" },
+        { "accept-language", "" }, { "accept-ranges", "" }, { "accept", "" }, { "access-control-allow-origin", "" },
+        { "age", "" }, { "allow", "" }, { "authorization", "" }, { "cache-control", "" },
+        { "content-disposition", "" }, { "content-encoding", "" }, { "content-language", "" }, { "content-length", "" },
+        { "content-location", "" }, { "content-range", "" }, { "content-type", "" }, { "cookie", "" },
+        { "date", "" }, { "etag", "" }, { "expect", "" }, { "expires", "" },
+        { "from", "" }, { "host", "" }, { "if-match", "" }, { "if-modified-since", "" },
+        { "if-none-match", "" }, { "if-range", "" }, { "if-unmodified-since", "" }, { "last-modified", "" },
+        { "link", "" }, { "location", "" }, { "max-forwards", "" }, { "proxy-authenticate", "" },
+        { "proxy-authorization", "" }, { "range", "" }, { "referer", "" }, { "refresh", "" },
+        { "retry-after", "" }, { "server", "" }, { "set-cookie", "" }, { "strict-transport-security", "" },
+        { "transfer-encoding", "" }, { "user-agent", "" }, { "vary", "" }, { "via", "" },
+        { "www-authenticate", "" },
+    };
+    return table;
+}
+
+/// Huffman 解码。RFC 7541 附录 B 的编码是规范 Huffman 码，只需每个符号的码长即可按码长逐位匹配
+inline bool hpack_huffman_decode(const uint8_t* p, size_t n, std::string& out)
+{
+    static const uint8_t kLengths[257] = {
+        13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+        6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6, 5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+        13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+        15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5, 6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+        20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23, 24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+        22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23, 21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+        26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25, 19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+        20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23, 26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+        30,
+    };
+    struct Tables
+    {
+        uint32_t first[31]  = {};
+        uint16_t count[31]  = {};
+        uint16_t offset[31] = {};
+        uint16_t symbols[257] = {};
+    };
+    static const Tables t = []() {
+        Tables tables;
+        uint32_t code = 0;
+        uint16_t index = 0;
+        for (int len = 1; len <= 30; ++len) {
+            tables.first[len] = code;
+            tables.offset[len] = index;
+            for (uint16_t sym = 0; sym < 257; ++sym) {
+                if (kLengths[sym] == len) { tables.symbols[index++] = sym; tables.count[len]++; }
+            }
+            code = (code + tables.count[len]) << 1;
+        }
+        return tables;
+    }();
+
+    uint32_t code = 0;
+    int len = 0;
+    for (size_t i = 0; i < n; ++i) {
+        for (int bit = 7; bit >= 0; --bit) {
+            code = (code << 1) | ((p[i] >> bit) & 1u);
+            if (++len > 30) return false;
+            if (code >= t.first[len] && code - t.first[len] < t.count[len]) {
+                uint16_t sym = t.symbols[t.offset[len] + code - t.first[len]];
+                if (sym == 256) return false;   // EOS 不得出现在数据中
+                out.push_back((char)sym);
+                code = 0;
+                len = 0;
+            }
+        }
+    }
+    // 末尾填充必须是 EOS 码的前缀 (全 1) 且不足 8 位
+    return len < 8 && code == (1u << len) - 1;
+}
+
+inline void hpack_encode_int(std::string& out, uint8_t flags, int prefixBits, uint64_t value)
+{
+    uint64_t max = (1u << prefixBits) - 1;
+    if (value < max) { out.push_back((char)(flags | value)); return; }
+    out.push_back((char)(flags | max));
+    value -= max;
+    while (value >= 128) { out.push_back((char)(0x80 | (value & 0x7f))); value >>= 7; }
+    out.push_back((char)value);
+}
+
+/// 编码一个请求头字段。不使用动态表 (编码端无状态，多线程发起的流可以任意顺序编码)；
+/// 与静态表完全匹配时用索引，否则用字面量 (敏感字段标记为 never-indexed)
+inline void hpack_encode_header(std::string& out, const std::string& name, const std::string& value)
+{
+    const auto& table = hpack_static_table();
+    size_t nameIndex = 0;
+    for (size_t i = 0; i < table.size(); ++i) {
+        if (table[i].name != name) continue;
+        if (table[i].value == value && !value.empty()) { hpack_encode_int(out, 0x80, 7, i + 1); return; }
+        if (!nameIndex) nameIndex = i + 1;
+    }
+    bool sensitive = name == "authorization" || name == "cookie" || name == "proxy-authorization";
+    hpack_encode_int(out, sensitive ? 0x10 : 0x00, 4, nameIndex);
+    if (!nameIndex) { hpack_encode_int(out, 0, 7, name.size()); out += name; }
+    hpack_encode_int(out, 0, 7, value.size());
+    out += value;
+}
+
+/// HPACK 解码器 (每条连接一个，维护服务器端写入的动态表)。解码错误抛出，属于连接级错误
+class HpackDecoder
+{
+public:
+    void decode(const uint8_t* p, size_t n, HeaderList& out)
+    {
+        const uint8_t* end = p + n;
+        while (p < end) {
+            uint8_t b = *p;
+            if (b & 0x80) {                           // 索引字段
+                const auto& e = lookup(read_int(p, end, 7));
+                out.add(e.name, e.value);
+            } else if (b & 0x40) {                    // 字面量，加入动态表
+                HpackEntry e = read_literal(p, end, 6);
+                out.add(e.name, e.value);
+                insert(std::move(e));
+            } else if (b & 0x20) {                    // 动态表大小更新
+                uint64_t size = read_int(p, end, 5);
+                if (size > kMaxTableSize) fail("table size update too large");
+                maxSize_ = (size_t)size;
+                evict(0);
+            } else {                                  // 字面量，不加入动态表 / 永不索引
+                HpackEntry e = read_literal(p, end, 4);
+                out.add(e.name, e.value);
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kMaxTableSize = 4096;     ///< 与我们通告的 SETTINGS_HEADER_TABLE_SIZE 默认值一致
+
+    std::deque<HpackEntry> dynamic_;
+    size_t                 size_    = 0;
+    size_t                 maxSize_ = kMaxTableSize;
+
+    [[noreturn]] static void fail(const char* what)
+    {
+        throw std::runtime_error(std::string("error=INVALID_SERVER_RESPONSE HPACK decoding failed: ") + what);
+    }
+
+    static uint64_t read_int(const uint8_t*& p, const uint8_t* end, int prefixBits)
+    {
+        uint64_t max = (1u << prefixBits) - 1;
+        uint64_t value = *p++ & max;
+        if (value < max) return value;
+        for (int shift = 0; ; shift += 7) {
+            if (p >= end || shift > 28) fail("bad integer");
+            uint8_t b = *p++;
+            value += (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) return value;
+        }
+    }
+
+    static std::string read_string(const uint8_t*& p, const uint8_t* end)
+    {
+        if (p >= end) fail("truncated string");
+        bool huffman = (*p & 0x80) != 0;
+        uint64_t len = read_int(p, end, 7);
+        if (len > (uint64_t)(end - p)) fail("truncated string");
+        std::string s;
+        if (huffman) {
+            s.reserve((size_t)len * 8 / 5);
+            if (!hpack_huffman_decode(p, (size_t)len, s)) fail("bad huffman code");
+        } else {
+            s.assign(reinterpret_cast<const char*>(p), (size_t)len);
+        }
+        p += len;
+        return s;
+    }
+
+    HpackEntry read_literal(const uint8_t*& p, const uint8_t* end, int prefixBits)
+    {
+        uint64_t index = read_int(p, end, prefixBits);
+        HpackEntry e;
+        e.name  = index ? lookup(index).name : read_string(p, end);
+        e.value = read_string(p, end);
+        return e;
+    }
+
+    const HpackEntry& lookup(uint64_t index) const
+    {
+        const auto& table = hpack_static_table();
+        if (index >= 1 && index <= table.size()) return table[(size_t)index - 1];
+        index -= table.size() + 1;
+        if (index >= dynamic_.size()) fail("index out of range");
+        return dynamic_[(size_t)index];
+    }
+
+    void insert(HpackEntry e)
+    {
+        size_t entrySize = e.name.size() + e.value.size() + 32;
+        evict(entrySize);
+        if (entrySize > maxSize_) return;   // 比整个表还大: 清空表且不插入
+        size_ += entrySize;
+        dynamic_.push_front(std::move(e));
+    }
+
+    void evict(size_t incoming)
+    {
+        while (!dynamic_.empty() && size_ + incoming > maxSize_) {
+            size_ -= dynamic_.back().name.size() + dynamic_.back().value.size() + 32;
+            dynamic_.pop_back();
+        }
+    }
+};
+
+// ──────── HTTP/2 连接与流 (RFC 7540) ────────
+
+/// 对端不支持 HTTP/2 (ALPN 未选中 h2 / h2c 收到 HTTP/1.x 响应)，调用方应改用 HTTP/1.1
+class Http2Unavailable : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/// 一条 h2 流的回调，全部在 HTTP/2 事件循环线程上调用。onDone 恰好一次，之后不再有回调
+struct Http2Handler
+{
+    std::function<void(int statusCode, HeaderList& headers)> onHead;   ///< 最终 (非 1xx) 响应头
+    std::function<void(const char* data, size_t len)>       onData;
+    std::function<void()>                                    onSent;   ///< 请求 body 已全部交给连接
+    std::function<void(std::exception_ptr error)>            onDone;
+    CancelToken                                              cancel;
+    /// false: 数据交给 onData 后立即归还接收窗口；true: 由调用方读取后通过 consume() 归还 (同步读取的背压)
+    bool                                                     manualWindow = false;
+};
+
+/// 全部 h2 / h2c 连接由一个 epoll 事件循环线程驱动。同一 origin 的并发请求作为多条流
+/// 复用同一条连接，流数受对端 SETTINGS_MAX_CONCURRENT_STREAMS 限制，超出的排队等待。
+/// 发送与接收都遵循连接级与流级流控窗口。
+class Http2Engine
+{
+public:
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+    using TlsContextProvider = std::function<SSL_CTX*()>;
+    explicit Http2Engine(TlsContextProvider tls) : tls_(std::move(tls)) {}
+#else
+    Http2Engine() = default;
+#endif
+    ~Http2Engine() { stop(); }
+
+    Http2Engine(const Http2Engine&) = delete;
+    Http2Engine& operator=(const Http2Engine&) = delete;
+
+    /// 发起一条流，返回用于 consume / abort 的标识。spec.body 须保持有效直到 onSent 或 onDone
+    uint64_t start(const RequestSpec& spec, const std::string& userAgent, Http2Handler handler)
+    {
+        auto s = std::make_unique<Stream>();
+        s->handler     = std::move(handler);
+        s->url         = spec.url;
+        s->key         = pool_key(spec.url, nullptr, spec.ignoreSslErrors);
+        s->verifyPeer  = !spec.ignoreSslErrors;
+        s->body        = static_cast<const char*>(spec.body);
+        s->bodyLen     = spec.body ? spec.bodyLen : 0;
+        s->ioTimeoutMs = spec.timeoutMs > 0 ? spec.timeoutMs : kDefaultIoTimeoutMs;
+        s->connectTimeoutMs = spec.timeoutMs > 0 ? spec.timeoutMs : kDefaultConnectTimeoutMs;
+        s->block       = encode_request_head(spec, userAgent);
+
+        std::lock_guard<std::mutex> lock(inboxMu_);
+        if (stopping_) throw std::runtime_error("HTTP/2 engine stopped");
+        ensure_started();
+        s->token = ++nextToken_;
+        uint64_t token = s->token;
+        inbox_.push_back(std::move(s));
+        wake();
+        return token;
+    }
+
+    /// 调用方已取走 n 字节 (manualWindow 流)，归还接收窗口
+    void consume(uint64_t token, size_t n) { post({ token, n, nullptr }); }
+
+    /// 以 error 结束流 (未完成时发送 RST_STREAM)；error 为空时为 "Request cancelled"
+    void abort(uint64_t token, std::exception_ptr error = nullptr)
+    {
+        if (!error) error = std::make_exception_ptr(std::runtime_error("Request cancelled"));
+        post({ token, 0, error });
+    }
+
+    /// 该 origin 已确认不支持 HTTP/2
+    bool unavailable(const std::string& key) const
+    {
+        std::lock_guard<std::mutex> lock(inboxMu_);
+        return h1Only_.count(key) > 0;
+    }
+
+    void setIdleTimeoutMs(int ms) { idleTimeoutMs_.store(ms > 0 ? ms : 60000); }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(inboxMu_);
+            if (stopping_) return;
+            stopping_ = true;
+        }
+        if (loop_.joinable()) {
+            wake();
+            loop_.join();
+        }
+        if (evfd_ >= 0) { ::close(evfd_); evfd_ = -1; }
+        if (ep_ >= 0) { ::close(ep_); ep_ = -1; }
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int      kDefaultConnectTimeoutMs = 60000;
+    static constexpr int      kDefaultIoTimeoutMs      = 30000;
+    static constexpr uint32_t kStreamWindow     = 1u << 20;    ///< 通告的流级接收窗口
+    static constexpr uint32_t kConnectionWindow = 16u << 20;   ///< 通告的连接级接收窗口
+    static constexpr uint32_t kMaxFrameSize     = 16384;       ///< 接收的最大帧 (协议默认值，不通告更大值)
+    static constexpr uint32_t kMaxHeaderList    = 256u << 10;  ///< 通告的 MAX_HEADER_LIST_SIZE，也是 HEADERS + CONTINUATION 累积块的上限
+
+    enum FrameType : uint8_t
+    {
+        kData = 0, kHeaders = 1, kPriority = 2, kRstStream = 3, kSettings = 4,
+        kPushPromise = 5, kPing = 6, kGoaway = 7, kWindowUpdate = 8, kContinuation = 9,
+    };
+    static constexpr uint8_t kFlagEndStream  = 0x1;
+    static constexpr uint8_t kFlagAck        = 0x1;
+    static constexpr uint8_t kFlagEndHeaders = 0x4;
+    static constexpr uint8_t kFlagPadded     = 0x8;
+    static constexpr uint8_t kFlagPriority   = 0x20;
+
+    static constexpr uint32_t kErrProtocol   = 0x1;
+    static constexpr uint32_t kErrFlowControl = 0x3;
+    static constexpr uint32_t kErrRefused    = 0x7;
+    static constexpr uint32_t kErrCancel     = 0x8;
+
+    struct Conn;
+
+    struct Stream
+    {
+        uint64_t          token = 0;
+        Http2Handler      handler;
+        UrlParts          url;
+        std::string       key;
+        bool              verifyPeer = true;
+        std::string       block;              ///< HPACK 编码后的请求头
+        const char*       body = nullptr;
+        size_t            bodyLen = 0;
+        size_t            bodyPos = 0;
+        bool              sent = false;       ///< 请求已发完 (END_STREAM)
+        int               ioTimeoutMs = 0;
+        int               connectTimeoutMs = 0;
+
+        Conn*             conn = nullptr;
+        uint32_t          id = 0;
+        int64_t           sendWindow = 0;
+        uint32_t          unacked = 0;        ///< 已消费、尚未通过 WINDOW_UPDATE 归还的字节
+        bool              headSeen = false;
+        int               attempts = 0;
+        Clock::time_point deadline;
+    };
+
+    enum class ConnState { Connecting, Handshaking, Open };
+
+    struct Conn
+    {
+        std::string                     key;
+        UrlParts                        url;
+        bool                            verifyPeer = true;
+        std::unique_ptr<PosixConnection> conn;
+        ConnState                       state = ConnState::Connecting;
+        int                             fd = -1;
+        uint32_t                        armed = 0;
+        std::string                     out;
+        size_t                          outPos = 0;
+        std::string                     in;
+        size_t                          inPos = 0;
+        bool                            gotFrame = false;
+        HpackDecoder                    decoder;
+
+        std::map<uint32_t, Stream*>     streams;
+        std::deque<Stream*>             pending;
+        uint32_t                        nextId = 1;
+        int64_t                         sendWindow = 65535;
+        int64_t                         peerInitialWindow = 65535;
+        uint32_t                        peerMaxFrame = 16384;
+        uint32_t                        peerMaxStreams = 100;   ///< 收到 SETTINGS 前的保守值
+        uint32_t                        connUnacked = 0;
+        bool                            goaway = false;
+        uint64_t                        completed = 0;          ///< 已完成的流数 (用于判断是否为复用连接)
+
+        uint32_t                        contStream = 0;         ///< 等待 CONTINUATION 的流
+        bool                            contEndStream = false;
+        std::string                     contBlock;
+
+        int                             connectTimeoutMs = 0;
+        Clock::time_point               deadline;               ///< 连接 / 握手超时
+        Clock::time_point               idleSince;
+    };
+
+    struct Command
+    {
+        uint64_t           token;
+        size_t             consumed;
+        std::exception_ptr abort;
+    };
+
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+    TlsContextProvider                                    tls_;
+#endif
+    int                                                   ep_   = -1;
+    int                                                   evfd_ = -1;
+    std::thread                                           loop_;
+    mutable std::mutex                                    inboxMu_;
+    std::vector<std::unique_ptr<Stream>>                  inbox_;      ///< 受 inboxMu_ 保护
+    std::vector<Command>                                  commands_;   ///< 受 inboxMu_ 保护
+    std::unordered_map<std::string, bool>                 h1Only_;     ///< 受 inboxMu_ 保护
+    uint64_t                                              nextToken_ = 0;
+    bool                                                  stopping_ = false;
+    std::atomic<int>                                      idleTimeoutMs_{ 60000 };
+
+    // 以下只由事件循环线程访问
+    std::unordered_map<uint64_t, std::unique_ptr<Stream>> streams_;
+    std::vector<std::unique_ptr<Conn>>                    conns_;
+    std::vector<Conn*>                                    ready_;      ///< TLS 引擎中仍有未读数据的连接
+    std::vector<char>                                     rbuf_;
+    Clock::time_point                                     now_;
+
+    // ──────── 请求头编码 ────────
+
+    static std::string encode_request_head(const RequestSpec& spec, const std::string& userAgent)
+    {
+        std::string block;
+        hpack_encode_header(block, ":method", spec.method);
+        hpack_encode_header(block, ":scheme", spec.url.isHttps ? "https" : "http");
+        hpack_encode_header(block, ":authority", host_header_value(spec.url));
+        hpack_encode_header(block, ":path", spec.url.path.empty() ? "/" : spec.url.path);
+        if (!userAgent.empty() && !header_block_has(spec.headers, "User-Agent"))
+            hpack_encode_header(block, "user-agent", userAgent);
+
+        // "Name: value\r\n" 行 -> 小写名称；去掉 HTTP/2 禁止的连接级字段
+        size_t pos = 0;
+        while (pos < spec.headers.size()) {
+            size_t end = spec.headers.find("\r\n", pos);
+            if (end == std::string::npos) end = spec.headers.size();
+            auto line = spec.headers.substr(pos, end - pos);
+            pos = end + 2;
+            auto colon = line.find(':');
+            if (colon == std::string::npos || colon == 0) continue;
+            auto name = to_lower(line.substr(0, colon));
+            auto value = trim_copy(line.substr(colon + 1));
+            if (name == "host" || name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+                name == "transfer-encoding" || name == "upgrade") continue;
+            if (name == "te" && value != "trailers") continue;
+            hpack_encode_header(block, name, value);
+        }
+
+        bool needsLength = spec.bodyLen > 0 || spec.method == "POST" || spec.method == "PUT" || spec.method == "PATCH";
+        if (needsLength && !header_block_has(spec.headers, "Content-Length"))
+            hpack_encode_header(block, "content-length", std::to_string(spec.body ? spec.bodyLen : 0));
+        return block;
+    }
+
+    // ──────── 事件循环 ────────
+
+    void ensure_started()
+    {
+        if (loop_.joinable()) return;
+        rbuf_.resize(64 * 1024);
+        ep_ = epoll_create1(EPOLL_CLOEXEC);
+        if (ep_ < 0) throw std::runtime_error("epoll_create1 failed: " + errno_message(errno));
+        evfd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (evfd_ < 0) throw std::runtime_error("eventfd failed: " + errno_message(errno));
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;   // nullptr = 唤醒 fd
+        epoll_ctl(ep_, EPOLL_CTL_ADD, evfd_, &ev);
+        loop_ = std::thread([this]() { run_loop(); });
+    }
+
+    void wake()
+    {
+        uint64_t one = 1;
+        if (evfd_ >= 0) { ssize_t n = ::write(evfd_, &one, sizeof(one)); (void)n; }
+    }
+
+    void post(Command cmd)
+    {
+        {
+            std::lock_guard<std::mutex> lock(inboxMu_);
+            if (!loop_.joinable()) return;
+            commands_.push_back(std::move(cmd));
+        }
+        wake();
+    }
+
+    void run_loop()
+    {
+        epoll_event events[64];
+        now_ = Clock::now();
+        auto lastTick = now_;
+        bool exiting = false;
+        while (!exiting) {
+            int timeoutMs = !ready_.empty() ? 0 : (streams_.empty() && conns_.empty()) ? -1 : 10;
+            int n = epoll_wait(ep_, events, 64, timeoutMs);
+            now_ = Clock::now();
+            if (n < 0 && errno != EINTR) break;
+
+            for (int i = 0; i < n; ++i) {
+                auto c = static_cast<Conn*>(events[i].data.ptr);
+                if (!c) { exiting = intake(); continue; }
+                if (alive(c)) guarded(c, [&]() { on_event(c, events[i].events); });
+            }
+
+            std::vector<Conn*> ready;
+            ready.swap(ready_);
+            for (auto c : ready) {
+                if (alive(c) && c->state == ConnState::Open) guarded(c, [&]() { pump_recv(c); });
+            }
+
+            if (now_ - lastTick >= std::chrono::milliseconds(10)) {
+                tick();
+                lastTick = now_;
+            }
+        }
+        shutdown_all();
+    }
+
+    /// 取入新流与跨线程命令，返回是否应退出
+    bool intake()
+    {
+        uint64_t counter;
+        while (::read(evfd_, &counter, sizeof(counter)) > 0) {}
+
+        std::vector<std::unique_ptr<Stream>> incoming;
+        std::vector<Command> commands;
+        bool exiting;
+        {
+            std::lock_guard<std::mutex> lock(inboxMu_);
+            incoming.swap(inbox_);
+            commands.swap(commands_);
+            exiting = stopping_;
+        }
+        for (auto& owned : incoming) {
+            Stream* s = owned.get();
+            streams_.emplace(s->token, std::move(owned));
+            s->deadline = now_ + std::chrono::milliseconds(s->connectTimeoutMs);
+            assign(s);
+        }
+        for (auto& cmd : commands) {
+            auto it = streams_.find(cmd.token);
+            if (it == streams_.end()) continue;
+            Stream* s = it->second.get();
+            if (cmd.abort) {
+                reset_stream(s, kErrCancel);
+                complete(s, cmd.abort);
+            } else {
+                give_back(s, cmd.consumed);
+            }
+        }
+        return exiting;
+    }
+
+    void tick()
+    {
+        std::vector<Stream*> snapshot;
+        snapshot.reserve(streams_.size());
+        for (const auto& [token, owned] : streams_) snapshot.push_back(owned.get());
+        for (auto s : snapshot) {
+            if (!streams_.count(s->token)) continue;
+            if (s->handler.cancel.isCancelled()) {
+                reset_stream(s, kErrCancel);
+                complete(s, std::make_exception_ptr(std::runtime_error("Request cancelled")));
+            } else if (now_ >= s->deadline && !(s->handler.manualWindow && s->headSeen && s->sent)) {
+                // manualWindow 流发完请求、读到响应头后由调用方的 read() 自行计时 (窗口耗尽时对端暂停发送属正常)
+                reset_stream(s, kErrCancel);
+                complete(s, std::make_exception_ptr(TransportTimeout(
+                    s->headSeen ? "error=TIMEOUT receive timed out" : "error=TIMEOUT request timed out")));
+            }
+        }
+
+        int idleMs = idleTimeoutMs_.load();
+        std::vector<Conn*> conns;
+        for (auto& c : conns_) conns.push_back(c.get());
+        for (auto c : conns) {
+            if (!alive(c)) continue;
+            if (c->state != ConnState::Open) {
+                if (now_ >= c->deadline) {
+                    fail_conn(c, std::make_exception_ptr(TransportTimeout(c->state == ConnState::Connecting
+                        ? "error=TIMEOUT connect timed out" : "error=TIMEOUT TLS handshake timed out")), false);
+                }
+            } else if (c->streams.empty() && c->pending.empty() &&
+                       (c->goaway || now_ - c->idleSince >= std::chrono::milliseconds(idleMs))) {
+                close_conn(c);
+            }
+        }
+    }
+
+    void shutdown_all()
+    {
+        auto stopped = std::make_exception_ptr(std::runtime_error("HTTP/2 engine stopped"));
+        std::vector<Stream*> remaining;
+        for (const auto& [token, owned] : streams_) remaining.push_back(owned.get());
+        for (auto s : remaining) complete(s, stopped);
+        while (!conns_.empty()) close_conn(conns_.back().get());
+
+        std::vector<std::unique_ptr<Stream>> incoming;
+        {
+            std::lock_guard<std::mutex> lock(inboxMu_);
+            incoming.swap(inbox_);
+        }
+        for (auto& s : incoming) {
+            try { if (s->handler.onDone) s->handler.onDone(stopped); } catch (...) {}
+        }
+    }
+
+    bool alive(Conn* c) const
+    {
+        for (const auto& owned : conns_) if (owned.get() == c) return true;
+        return false;
+    }
+
+    template <typename F>
+    void guarded(Conn* c, F&& f)
+    {
+        try {
+            f();
+        } catch (const Http2Unavailable&) {
+            mark_h1_only(c->key);
+            fail_conn(c, std::current_exception(), false);
+        } catch (...) {
+            fail_conn(c, std::current_exception(), true);
+        }
+    }
+
+    void mark_h1_only(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(inboxMu_);
+        h1Only_[key] = true;
+    }
+
+    // ──────── 连接 ────────
+
+    /// 把流交给该 origin 的可用连接 (没有则新建)，连接就绪且有空闲流额度时立即发出
+    void assign(Stream* s)
+    {
+        Conn* c = nullptr;
+        for (auto& owned : conns_) {
+            if (owned->key == s->key && !owned->goaway) { c = owned.get(); break; }
+        }
+        if (!c) {
+            try {
+                c = open_conn(s);
+            } catch (...) {
+                complete(s, std::current_exception());
+                return;
+            }
+        }
+        s->conn = c;
+        c->pending.push_back(s);
+        if (c->state == ConnState::Open) {
+            activate_pending(c);
+            flush(c);
+        }
+    }
+
+    Conn* open_conn(Stream* s)
+    {
+        auto owned = std::make_unique<Conn>();
+        Conn* c = owned.get();
+        c->key = s->key;
+        c->url = s->url;
+        c->verifyPeer = s->verifyPeer;
+        c->connectTimeoutMs = s->connectTimeoutMs;
+        c->deadline = now_ + std::chrono::milliseconds(c->connectTimeoutMs);
+        c->conn = std::make_unique<PosixConnection>();
+#if !defined(DRX_HTTP_ENABLE_OPENSSL)
+        if (c->url.isHttps)
+            throw std::runtime_error("HTTPS on Linux requires DRX_HTTP_ENABLE_OPENSSL (link -lssl -lcrypto)");
+#endif
+        bool connected = c->conn->beginConnect(c->url.host, c->url.port);
+        conns_.push_back(std::move(owned));
+        if (connected) on_connected(c);
+        else arm(c, IoWant::Write);
+        return c;
+    }
+
+    void on_event(Conn* c, uint32_t events)
+    {
+        switch (c->state) {
+            case ConnState::Connecting:
+                unregister(c);
+                if (c->conn->finishConnect()) on_connected(c);
+                else {
+                    c->deadline = now_ + std::chrono::milliseconds(c->connectTimeoutMs);
+                    arm(c, IoWant::Write);
+                }
+                break;
+            case ConnState::Handshaking:
+                continue_tls(c);
+                break;
+            case ConnState::Open:
+                if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) pump_recv(c);
+                if (alive(c) && (events & EPOLLOUT)) flush(c);
+                break;
+        }
+    }
+
+    void on_connected(Conn* c)
+    {
+        if (c->url.isHttps) {
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+            c->state = ConnState::Handshaking;
+            c->conn->beginTls(tls_(), c->url.host, c->verifyPeer, "\x02h2\x08http/1.1");
+            continue_tls(c);
+#endif
+            return;
+        }
+        start_session(c);
+    }
+
+    void continue_tls(Conn* c)
+    {
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+        IoWant want;
+        if (!c->conn->continueTls(want)) { arm(c, want); return; }
+        if (c->conn->alpnSelected() != "h2")
+            throw Http2Unavailable("server did not negotiate h2 via ALPN: " + c->key);
+        start_session(c);
+#else
+        (void)c;
+#endif
+    }
+
+    /// 连接前言 + SETTINGS + 扩大连接级接收窗口
+    void start_session(Conn* c)
+    {
+        c->state = ConnState::Open;
+        c->idleSince = now_;
+        c->out.append("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", 24);
+
+        std::string settings;
+        auto put_setting = [&](uint16_t id, uint32_t value) {
+            settings.push_back((char)(id >> 8)); settings.push_back((char)id);
+            for (int shift = 24; shift >= 0; shift -= 8) settings.push_back((char)(value >> shift));
+        };
+        put_setting(0x2, 0);               // ENABLE_PUSH
+        put_setting(0x4, kStreamWindow);   // INITIAL_WINDOW_SIZE
+        put_setting(0x6, kMaxHeaderList);  // MAX_HEADER_LIST_SIZE
+        write_frame(c, kSettings, 0, 0, settings.data(), settings.size());
+        write_window_update(c, 0, kConnectionWindow - 65535);
+
+        activate_pending(c);
+        flush(c);
+    }
+
+    void close_conn(Conn* c)
+    {
+        unregister(c);
+        for (auto it = conns_.begin(); it != conns_.end(); ++it) {
+            if (it->get() == c) { conns_.erase(it); break; }
+        }
+        ready_.erase(std::remove(ready_.begin(), ready_.end(), c), ready_.end());
+    }
+
+    /// 连接级失败: 尚未收到响应的流在复用连接上失败时换新连接重试一次，其余以 error 结束
+    void fail_conn(Conn* c, std::exception_ptr error, bool retryable)
+    {
+        std::vector<Stream*> affected(c->pending.begin(), c->pending.end());
+        for (auto& [id, s] : c->streams) affected.push_back(s);
+        bool reused = c->completed > 0;
+        close_conn(c);
+
+        for (auto s : affected) {
+            s->conn = nullptr;
+            s->id = 0;
+            if (retryable && reused && !s->headSeen && s->attempts == 0) {
+                retry(s);
+            } else {
+                complete(s, error);
+            }
+        }
+    }
+
+    /// 流未被对端处理 (GOAWAY 之后 / REFUSED_STREAM / 复用连接被关闭): 重置状态后重新分配连接
+    void retry(Stream* s)
+    {
+        if (s->conn) {
+            s->conn->streams.erase(s->id);
+            auto& pending = s->conn->pending;
+            pending.erase(std::remove(pending.begin(), pending.end(), s), pending.end());
+        }
+        s->attempts++;
+        s->conn = nullptr;
+        s->id = 0;
+        s->bodyPos = 0;
+        s->sent = false;
+        s->unacked = 0;
+        assign(s);
+    }
+
+    // ──────── epoll ────────
+
+    void arm(Conn* c, IoWant want)
+    {
+        int fd = c->conn->fd();
+        uint32_t events = (uint32_t)want;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.ptr = c;
+        if (c->fd != fd) {
+            unregister(c);
+            if (epoll_ctl(ep_, EPOLL_CTL_ADD, fd, &ev) != 0)
+                throw std::runtime_error("epoll_ctl failed: " + errno_message(errno));
+        } else if (c->armed != events) {
+            if (epoll_ctl(ep_, EPOLL_CTL_MOD, fd, &ev) != 0)
+                throw std::runtime_error("epoll_ctl failed: " + errno_message(errno));
+        }
+        c->fd = fd;
+        c->armed = events;
+    }
+
+    void unregister(Conn* c)
+    {
+        if (c->fd >= 0) epoll_ctl(ep_, EPOLL_CTL_DEL, c->fd, nullptr);
+        c->fd = -1;
+        c->armed = 0;
+    }
+
+    // ──────── 发送 ────────
+
+    static void put_u32(std::string& out, uint32_t v)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8) out.push_back((char)(v >> shift));
+    }
+
+    void write_frame(Conn* c, uint8_t type, uint8_t flags, uint32_t streamId, const char* payload, size_t len)
+    {
+        auto& out = c->out;
+        out.push_back((char)(len >> 16));
+        out.push_back((char)(len >> 8));
+        out.push_back((char)len);
+        out.push_back((char)type);
+        out.push_back((char)flags);
+        put_u32(out, streamId & 0x7fffffffu);
+        if (len) out.append(payload, len);
+    }
+
+    void write_window_update(Conn* c, uint32_t streamId, uint32_t increment)
+    {
+        std::string payload;
+        put_u32(payload, increment & 0x7fffffffu);
+        write_frame(c, kWindowUpdate, 0, streamId, payload.data(), payload.size());
+    }
+
+    /// 写出缓冲的帧；仍有剩余时等待可写
+    void flush(Conn* c)
+    {
+        if (c->state != ConnState::Open) return;
+        IoWant want = IoWant::None;
+        while (c->outPos < c->out.size()) {
+            size_t n = c->conn->trySend(c->out.data() + c->outPos, c->out.size() - c->outPos, want);
+            c->outPos += n;
+            if (n == 0 && want != IoWant::None) break;
+        }
+        if (c->outPos == c->out.size()) {
+            c->out.clear();
+            c->outPos = 0;
+            if (!c->conn->flushOutput(want)) { arm(c, IoWant::Write); return; }
+            arm(c, IoWant::Read);
+            return;
+        }
+        if (c->outPos > (1u << 20)) { c->out.erase(0, c->outPos); c->outPos = 0; }
+        arm(c, want == IoWant::Read ? IoWant::Read : IoWant::Write);
+    }
+
+    /// 在对端允许的并发流数内，为排队的流分配流 ID 并发出 HEADERS
+    void activate_pending(Conn* c)
+    {
+        while (!c->pending.empty() && !c->goaway && c->streams.size() < c->peerMaxStreams) {
+            Stream* s = c->pending.front();
+            c->pending.pop_front();
+            if (c->nextId > 0x7fffffffu) { c->goaway = true; c->pending.push_front(s); break; }
+
+            s->id = c->nextId;
+            c->nextId += 2;
+            s->sendWindow = c->peerInitialWindow;
+            s->deadline = now_ + std::chrono::milliseconds(s->ioTimeoutMs);
+            c->streams[s->id] = s;
+
+            // 头块超过对端帧上限时拆成 HEADERS + CONTINUATION
+            bool endStream = s->bodyLen == 0;
+            size_t max = c->peerMaxFrame;
+            size_t first = std::min(s->block.size(), max);
+            uint8_t flags = (endStream ? kFlagEndStream : 0) | (first == s->block.size() ? kFlagEndHeaders : 0);
+            write_frame(c, kHeaders, flags, s->id, s->block.data(), first);
+            for (size_t pos = first; pos < s->block.size(); pos += max) {
+                size_t n = std::min(max, s->block.size() - pos);
+                write_frame(c, kContinuation, pos + n == s->block.size() ? kFlagEndHeaders : 0, s->id, s->block.data() + pos, n);
+            }
+            if (endStream) mark_sent(s);
+        }
+        pump_bodies(c);
+        // 仍有排队的流但本连接已不接受新流 (GOAWAY / 流 ID 耗尽): 交给新连接
+        if (c->goaway && !c->pending.empty()) {
+            std::vector<Stream*> moved(c->pending.begin(), c->pending.end());
+            c->pending.clear();
+            for (auto s : moved) { s->conn = nullptr; assign(s); }
+        }
+    }
+
+    /// 按连接级与流级发送窗口发出请求 body
+    void pump_bodies(Conn* c)
+    {
+        for (auto& [id, s] : c->streams) {
+            while (!s->sent && s->bodyPos < s->bodyLen && c->sendWindow > 0 && s->sendWindow > 0) {
+                size_t n = std::min<size_t>({ s->bodyLen - s->bodyPos, (size_t)c->sendWindow,
+                                              (size_t)s->sendWindow, (size_t)c->peerMaxFrame });
+                bool last = s->bodyPos + n == s->bodyLen;
+                write_frame(c, kData, last ? kFlagEndStream : 0, s->id, s->body + s->bodyPos, n);
+                s->bodyPos += n;
+                c->sendWindow -= (int64_t)n;
+                s->sendWindow -= (int64_t)n;
+                s->deadline = now_ + std::chrono::milliseconds(s->ioTimeoutMs);
+                if (last) mark_sent(s);
+            }
+        }
+    }
+
+    void mark_sent(Stream* s)
+    {
+        s->sent = true;
+        if (s->handler.onSent) s->handler.onSent();
+    }
+
+    void reset_stream(Stream* s, uint32_t code)
+    {
+        if (!s->conn || !s->id) return;
+        std::string payload;
+        put_u32(payload, code);
+        write_frame(s->conn, kRstStream, 0, s->id, payload.data(), payload.size());
+        flush_later(s->conn);
+    }
+
+    void flush_later(Conn* c)
+    {
+        // 在当前事件处理结束后写出 (此处可能在遍历连接的流)
+        if (std::find(ready_.begin(), ready_.end(), c) == ready_.end()) ready_.push_back(c);
+    }
+
+    /// 归还流级与连接级接收窗口 (累计超过窗口一半时才发 WINDOW_UPDATE)
+    void give_back(Stream* s, size_t n)
+    {
+        if (!s->conn || !s->id) return;
+        Conn* c = s->conn;
+        s->unacked += (uint32_t)n;
+        if (s->unacked >= kStreamWindow / 2) {
+            write_window_update(c, s->id, s->unacked);
+            s->unacked = 0;
+            flush_later(c);
+        }
+    }
+
+    // ──────── 接收 ────────
+
+    void pump_recv(Conn* c)
+    {
+        for (int reads = 0; reads < 16; ++reads) {
+            IoWant want;
+            bool eof;
+            size_t n = c->conn->tryRecv(rbuf_.data(), rbuf_.size(), want, eof);
+            if (n == 0) {
+                if (eof) {
+                    // h2c 首帧之前即被关闭: 对端多半是不认识连接前言的 HTTP/1.x 服务器
+                    if (!c->gotFrame && !c->url.isHttps) throw Http2Unavailable("server closed h2c connection before SETTINGS: " + c->key);
+                    fail_conn(c, std::make_exception_ptr(std::runtime_error(
+                        "error=CONNECTION_ERROR HTTP/2 connection closed by server")), true);
+                    return;
+                }
+                break;
+            }
+            c->in.append(rbuf_.data(), n);
+            parse_frames(c);
+            if (!alive(c)) return;
+        }
+        if (c->conn->hasBufferedInput()) ready_.push_back(c);
+        flush(c);
+    }
+
+    void parse_frames(Conn* c)
+    {
+        if (!c->gotFrame && c->in.size() - c->inPos >= 5 && c->in.compare(c->inPos, 5, "HTTP/") == 0)
+            throw Http2Unavailable("server answered h2c with HTTP/1.x: " + c->key);
+
+        while (c->in.size() - c->inPos >= 9) {
+            auto h = reinterpret_cast<const uint8_t*>(c->in.data() + c->inPos);
+            uint32_t len = ((uint32_t)h[0] << 16) | ((uint32_t)h[1] << 8) | h[2];
+            uint8_t type = h[3], flags = h[4];
+            uint32_t sid = (((uint32_t)h[5] << 24) | ((uint32_t)h[6] << 16) | ((uint32_t)h[7] << 8) | h[8]) & 0x7fffffffu;
+            if (len > kMaxFrameSize) protocol_error("frame too large");
+            if (c->in.size() - c->inPos < 9 + (size_t)len) break;
+
+            c->gotFrame = true;
+            const uint8_t* payload = h + 9;
+            c->inPos += 9 + len;
+            on_frame(c, type, flags, sid, payload, len);
+            if (!alive(c)) return;
+        }
+        if (c->inPos == c->in.size()) { c->in.clear(); c->inPos = 0; }
+        else if (c->inPos > 64 * 1024) { c->in.erase(0, c->inPos); c->inPos = 0; }
+    }
+
+    [[noreturn]] static void protocol_error(const std::string& what)
+    {
+        throw std::runtime_error("error=INVALID_SERVER_RESPONSE HTTP/2 protocol error: " + what);
+    }
+
+    Stream* find_stream(Conn* c, uint32_t sid)
+    {
+        auto it = c->streams.find(sid);
+        return it == c->streams.end() ? nullptr : it->second;
+    }
+
+    /// 去掉 PADDED 帧的填充，返回有效载荷长度
+    static size_t strip_padding(uint8_t flags, const uint8_t*& p, size_t len)
+    {
+        if (!(flags & kFlagPadded)) return len;
+        if (len < 1 || p[0] >= len) protocol_error("bad padding");
+        size_t pad = p[0];
+        p += 1;
+        return len - 1 - pad;
+    }
+
+    void on_frame(Conn* c, uint8_t type, uint8_t flags, uint32_t sid, const uint8_t* p, size_t len)
+    {
+        if (c->contStream && type != kContinuation) protocol_error("expected CONTINUATION");
+
+        switch (type) {
+            case kData: {
+                if (!sid) protocol_error("DATA on stream 0");
+                // 连接级窗口按帧长 (含填充) 计算，收到即归还，流之间互不阻塞
+                c->connUnacked += (uint32_t)len;
+                if (c->connUnacked >= kConnectionWindow / 2) {
+                    write_window_update(c, 0, c->connUnacked);
+                    c->connUnacked = 0;
+                }
+                Stream* s = find_stream(c, sid);
+                if (!s) break;   // 已重置的流，丢弃
+                size_t n = strip_padding(flags, p, len);
+                s->deadline = now_ + std::chrono::milliseconds(s->ioTimeoutMs);
+                if (len > n) give_back(s, len - n);
+                if (n > 0) {
+                    if (s->handler.onData) s->handler.onData(reinterpret_cast<const char*>(p), n);
+                    if (!streams_.count(s->token)) break;     // 回调中已中止
+                    if (!s->handler.manualWindow) give_back(s, n);
+                }
+                if (flags & kFlagEndStream) finish_stream(c, s);
+                break;
+            }
+            case kHeaders: {
+                if (!sid) protocol_error("HEADERS on stream 0");
+                size_t n = strip_padding(flags, p, len);
+                if (flags & kFlagPriority) {
+                    if (n < 5) protocol_error("bad HEADERS priority");
+                    p += 5;
+                    n -= 5;
+                }
+                c->contBlock.assign(reinterpret_cast<const char*>(p), n);
+                c->contEndStream = (flags & kFlagEndStream) != 0;
+                if (flags & kFlagEndHeaders) on_header_block(c, sid);
+                else c->contStream = sid;
+                break;
+            }
+            case kContinuation:
+                if (!c->contStream || sid != c->contStream) protocol_error("unexpected CONTINUATION");
+                // 不设上限的话，对端可以用无穷多个 CONTINUATION 耗尽内存
+                if (c->contBlock.size() + len > kMaxHeaderList) protocol_error("header block exceeds MAX_HEADER_LIST_SIZE");
+                c->contBlock.append(reinterpret_cast<const char*>(p), len);
+                if (flags & kFlagEndHeaders) {
+                    c->contStream = 0;
+                    on_header_block(c, sid);
+                }
+                break;
+            case kRstStream: {
+                if (len != 4) protocol_error("bad RST_STREAM");
+                Stream* s = find_stream(c, sid);
+                if (!s) break;
+                uint32_t code = read_u32(p);
+                if (code == kErrRefused && !s->headSeen && s->attempts == 0) { retry(s); break; }
+                complete(s, std::make_exception_ptr(std::runtime_error(
+                    "error=CONNECTION_ERROR HTTP/2 stream reset by server (code " + std::to_string(code) + ")")));
+                break;
+            }
+            case kSettings:
+                if (sid) protocol_error("SETTINGS on non-zero stream");
+                if (flags & kFlagAck) break;
+                if (len % 6) protocol_error("bad SETTINGS length");
+                for (size_t i = 0; i < len; i += 6) apply_setting(c, (uint16_t)((p[i] << 8) | p[i + 1]), read_u32(p + i + 2));
+                write_frame(c, kSettings, kFlagAck, 0, nullptr, 0);
+                activate_pending(c);
+                break;
+            case kPing:
+                if (len != 8) protocol_error("bad PING");
+                if (!(flags & kFlagAck)) write_frame(c, kPing, kFlagAck, 0, reinterpret_cast<const char*>(p), 8);
+                break;
+            case kGoaway: {
+                if (len < 8) protocol_error("bad GOAWAY");
+                uint32_t lastId = read_u32(p) & 0x7fffffffu;
+                c->goaway = true;
+                // 编号大于 lastId 的流未被处理，可安全地在新连接上重发
+                std::vector<Stream*> unprocessed;
+                for (auto& [id, s] : c->streams) if (id > lastId) unprocessed.push_back(s);
+                for (auto s : unprocessed) {
+                    if (s->attempts == 0) retry(s);
+                    else complete(s, std::make_exception_ptr(std::runtime_error("error=CONNECTION_ERROR HTTP/2 connection going away")));
+                }
+                activate_pending(c);
+                break;
+            }
+            case kWindowUpdate: {
+                if (len != 4) protocol_error("bad WINDOW_UPDATE");
+                int64_t increment = read_u32(p) & 0x7fffffffu;
+                if (!sid) {
+                    c->sendWindow += increment;
+                    if (c->sendWindow > 0x7fffffff) throw std::runtime_error("error=INVALID_SERVER_RESPONSE HTTP/2 flow control window overflow");
+                } else if (Stream* s = find_stream(c, sid)) {
+                    s->sendWindow += increment;
+                }
+                pump_bodies(c);
+                break;
+            }
+            case kPushPromise:
+                protocol_error("PUSH_PROMISE received although push is disabled");
+            default:
+                break;   // PRIORITY 与未知帧类型忽略
+        }
+    }
+
+    static uint32_t read_u32(const uint8_t* p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    void apply_setting(Conn* c, uint16_t id, uint32_t value)
+    {
+        switch (id) {
+            case 0x3: c->peerMaxStreams = value; break;
+            case 0x4: {
+                if (value > 0x7fffffffu) throw std::runtime_error("error=INVALID_SERVER_RESPONSE HTTP/2 bad INITIAL_WINDOW_SIZE");
+                int64_t delta = (int64_t)value - c->peerInitialWindow;
+                c->peerInitialWindow = value;
+                for (auto& [sid, s] : c->streams) s->sendWindow += delta;
+                break;
+            }
+            case 0x5:
+                if (value < 16384 || value > 16777215) protocol_error("bad MAX_FRAME_SIZE");
+                c->peerMaxFrame = value;
+                break;
+            default:
+                break;   // HEADER_TABLE_SIZE 只约束编码端的动态表，我们不使用动态表
+        }
+    }
+
+    void on_header_block(Conn* c, uint32_t sid)
+    {
+        // 即使流已不存在也必须解码，保持 HPACK 动态表同步
+        HeaderList headers;
+        c->decoder.decode(reinterpret_cast<const uint8_t*>(c->contBlock.data()), c->contBlock.size(), headers);
+        c->contBlock.clear();
+        bool endStream = c->contEndStream;
+
+        Stream* s = find_stream(c, sid);
+        if (!s) return;
+        s->deadline = now_ + std::chrono::milliseconds(s->ioTimeoutMs);
+
+        if (!s->headSeen) {
+            int status = 0;
+            HeaderList regular;
+            regular.reserve(headers.size());
+            for (const auto& [name, value] : headers.fields()) {
+                if (name == ":status") status = std::atoi(std::string(value).c_str());
+                else if (!name.empty() && name[0] != ':') regular.add(name, value);
+            }
+            if (status == 0) protocol_error("response without :status");
+            if (status >= 100 && status < 200) return;   // 信息性响应 (100-continue 等)
+            s->headSeen = true;
+            if (s->handler.onHead) s->handler.onHead(status, regular);
+            if (!streams_.count(s->token)) return;
+        }
+        // 第二个头块为 trailers，忽略内容
+        if (endStream) finish_stream(c, s);
+    }
+
+    void finish_stream(Conn* c, Stream* s)
+    {
+        if (!s->headSeen) protocol_error("stream ended without response headers");
+        if (!s->sent) reset_stream(s, 0);   // 对端提前给出完整响应: 不再发送剩余 body
+        c->completed++;
+        complete(s, nullptr);
+    }
+
+    /// 结束流并回调 onDone；释放流额度后继续发出排队的流
+    void complete(Stream* s, std::exception_ptr error)
+    {
+        auto it = streams_.find(s->token);
+        if (it == streams_.end()) return;
+        std::unique_ptr<Stream> owned = std::move(it->second);
+        streams_.erase(it);
+
+        if (Conn* c = s->conn) {
+            c->streams.erase(s->id);
+            c->pending.erase(std::remove(c->pending.begin(), c->pending.end(), s), c->pending.end());
+            if (c->streams.empty()) c->idleSince = now_;
+            if (c->state == ConnState::Open && alive(c)) {
+                activate_pending(c);
+                flush_later(c);
+            }
+        }
+        try {
+            if (owned->handler.onDone) owned->handler.onDone(error);
+        } catch (...) {}
+    }
+};
+
+// ──────── POSIX 会话 ────────
+
+class HttpSession
+{
+public:
+    HttpSession() = default;
+    ~HttpSession()
+    {
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+        if (tlsCtx_) SSL_CTX_free(tlsCtx_);
+#endif
+    }
+
+    HttpSession(const HttpSession&) = delete;
+    HttpSession& operator=(const HttpSession&) = delete;
+
+    void open(const std::string& userAgent) { userAgent_ = userAgent; }
+    const std::string& userAgent() const { return userAgent_; }
+
+    /// 代理地址格式与 WinHTTP 一致: "host:port" 或 "http://host:port" (userinfo 部分忽略)
+    void setProxy(const std::string& proxyUrl)
+    {
+        std::string url = proxyUrl.find("://") == std::string::npos ? "http://" + proxyUrl : proxyUrl;
+        auto authStart = url.find("://") + 3;
+        auto at = url.find('@', authStart);
+        if (at != std::string::npos && url.find('/', authStart) > at) url.erase(authStart, at + 1 - authStart);
+
+        std::lock_guard<std::mutex> lock(mu_);
+        proxy_ = parse_url(url);
+        hasProxy_ = true;
+    }
+
+    bool proxy(UrlParts& out) const
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (!hasProxy_) return false;
+        out = proxy_;
+        return true;
+    }
+
+    ConnectionPool& pool() { return pool_; }
+
+    void setPoolOptions(const ConnectionPoolOptions& options)
+    {
+        pool_.setOptions(options);
+        http2_.setIdleTimeoutMs(options.idleTimeoutMs);
+    }
+    ConnectionPoolOptions poolOptions() const { return pool_.options(); }
+    ConnectionPoolStats poolStats() const { return pool_.stats(); }
+    void clearPool() { pool_.clear(); }
+
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+    SSL_CTX* tlsContext()
+    {
+        std::call_once(tlsOnce_, [this]() {
+            SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+            if (!ctx) throw std::runtime_error("error=SECURE_FAILURE SSL_CTX_new failed");
+            SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+            SSL_CTX_set_default_verify_paths(ctx);
+            tlsCtx_ = ctx;
+        });
+        return tlsCtx_;
+    }
+#endif
+
+    void setHttpVersion(HttpVersion version) { httpVersion_.store(version); }
+    HttpVersion httpVersion() const { return httpVersion_.load(); }
+
+    /// 该请求是否走 HTTP/2: 版本设置允许、未配置代理、且该 origin 尚未被确认为仅支持 HTTP/1.1
+    bool useHttp2(const UrlParts& url, bool ignoreSslErrors) const
+    {
+        auto version = httpVersion_.load();
+        if (version == HttpVersion::Http1_1) return false;
+        if (!url.isHttps && version != HttpVersion::Http2PriorKnowledge) return false;
+#if !defined(DRX_HTTP_ENABLE_OPENSSL)
+        if (url.isHttps) return false;
+#endif
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            if (hasProxy_) return false;
+        }
+        return !http2_.unavailable(pool_key(url, nullptr, ignoreSslErrors));
+    }
+
+    Http2Engine& http2() { return http2_; }
+
+private:
+    std::string              userAgent_;
+    mutable std::mutex       mu_;
+    UrlParts                 proxy_;
+    bool                     hasProxy_ = false;
+    std::atomic<HttpVersion> httpVersion_{ HttpVersion::Http1_1 };
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+    std::once_flag           tlsOnce_;
+    SSL_CTX*                 tlsCtx_ = nullptr;
+#endif
+    ConnectionPool           pool_;              ///< 声明在 tlsCtx_ 之后: 先关闭连接再释放 SSL_CTX
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+    Http2Engine              http2_{ [this]() { return tlsContext(); } };
+#else
+    Http2Engine              http2_;
+#endif
+};
+
+// ──────── POSIX 单次请求交换 ────────
+
+/// 同步读取一条 h2 流: HTTP/2 引擎线程写入，调用 read() 的线程取出
+struct Http2SyncState
+{
+    std::mutex              mu;
+    std::condition_variable cv;
+    std::deque<std::string> chunks;
+    size_t                  frontPos = 0;
+    bool                    head = false;
+    bool                    sent = false;
+    bool                    done = false;
+    int                     statusCode = 0;
+    HeaderList              headers;
+    std::exception_ptr      error;
+};
+
+/// 同步交换的 64 KB 接收缓冲，按线程回收复用，避免每个请求分配并清零一次
+class ExchangeBuffer
+{
+public:
+    static constexpr size_t kSize = 64 * 1024;
+
+    ExchangeBuffer()
+    {
+        auto& pool = free_list();
+        if (!pool.empty()) { data_ = std::move(pool.back()); pool.pop_back(); }
+        else data_.reset(new char[kSize]);
+    }
+
+    ~ExchangeBuffer()
+    {
+        auto& pool = free_list();
+        if (data_ && pool.size() < 4) pool.push_back(std::move(data_));
+    }
+
+    ExchangeBuffer(const ExchangeBuffer&) = delete;
+    ExchangeBuffer& operator=(const ExchangeBuffer&) = delete;
+
+    char*  data() { return data_.get(); }
+    size_t size() const { return kSize; }
+
+private:
+    static std::vector<std::unique_ptr<char[]>>& free_list()
+    {
+        static thread_local std::vector<std::unique_ptr<char[]>> pool;
+        return pool;
+    }
+
+    std::unique_ptr<char[]> data_;
+};
+
+/// 与 WinHTTP 后端语义一致: open() 建立连接、发送请求并读完响应头
+/// (自动跟随重定向，禁止 https -> http)，随后通过 read() 拉取 body。
+/// 连接从会话的连接池借出，body 读完且可保持时归还。
+/// 会话启用 HTTP/2 时改为在共享的 h2 连接上开一条流，body 由 HTTP/2 引擎转交。
+class HttpExchange
+{
+public:
+    static constexpr int kDefaultConnectTimeoutMs = 60000;   ///< 与 WinHTTP 默认值一致
+    static constexpr int kDefaultIoTimeoutMs      = 30000;
+    static constexpr int kMaxRedirects            = 10;
+
+    explicit HttpExchange(HttpSession& session) : session_(session) {}
+    ~HttpExchange() { cancel_h2(); }
+
+    void open(const RequestSpec& spec)
+    {
+        try {
+            open_following_redirects(spec);
+        } catch (const std::runtime_error& ex) {
+            if (spec.errorPrefix.empty()) throw;
+            throw std::runtime_error(spec.errorPrefix + ex.what());
+        }
+    }
+
+    int statusCode() const { return h2_ ? h2_->statusCode : parser_.statusCode; }
+    /// HTTP/2 没有原因短语，此时为空
+    const std::string& reasonPhrase() const { return h2_ ? h2Reason_ : parser_.reasonPhrase; }
+    const HeaderList& headers() const { return h2_ ? h2_->headers : parser_.headers; }
+
+    /// 读取 body，返回 0 表示结束
+    size_t read(void* buf, size_t cap)
+    {
+        if (h2_) return read_h2(buf, cap);
+        auto out = static_cast<char*>(buf);
+        while (!parser_.done() && conn_) {
+            if (rpos_ < rlen_) {
+                const char* p = nullptr;
+                size_t n = 0;
+                rpos_ += parser_.parseBody(rbuf_.data() + rpos_, rlen_ - rpos_, p, n, cap);
+                if (n > 0) { std::memcpy(out, p, n); return n; }
+                continue;
+            }
+
+            // 缓冲区已空: 纯 body 段直接读入调用方缓冲区，省去一次复制
+            rpos_ = rlen_ = 0;
+            uint64_t direct = parser_.directBodyLimit();
+            if (direct > 0) {
+                size_t want = (size_t)std::min<uint64_t>(direct, cap);
+                size_t got = conn_->recvSome(out, want, ioTimeoutMs_);
+                if (got == 0) { conn_.release(); parser_.finishOnEof(); return 0; }
+                parser_.consumeDirect(got);
+                return got;
+            }
+
+            rlen_ = conn_->recvSome(rbuf_.data(), rbuf_.size(), ioTimeoutMs_);
+            if (rlen_ == 0) { conn_.release(); parser_.finishOnEof(); return 0; }
+        }
+        finish_response();
+        return 0;
+    }
+
+private:
+    HttpSession&                      session_;
+    ConnectionPool::Lease             conn_;
+    Http1ResponseParser               parser_;
+    ExchangeBuffer                    rbuf_;
+    size_t                            rpos_ = 0;
+    size_t                            rlen_ = 0;
+    size_t                            headBytes_ = 0;
+    int                               ioTimeoutMs_ = kDefaultIoTimeoutMs;
+    std::shared_ptr<Http2SyncState>   h2_;
+    uint64_t                          h2Token_ = 0;
+    size_t                            h2Unacked_ = 0;   ///< 已读出、尚未归还给接收窗口的字节
+    std::string                       h2Reason_;
+
+    void open_following_redirects(const RequestSpec& spec)
+    {
+        ioTimeoutMs_ = spec.timeoutMs > 0 ? spec.timeoutMs : kDefaultIoTimeoutMs;
+        int connectTimeoutMs = spec.timeoutMs > 0 ? spec.timeoutMs : kDefaultConnectTimeoutMs;
+
+        std::string method  = spec.method;
+        UrlParts    url     = spec.url;
+        const void* body    = spec.body;
+        size_t      bodyLen = spec.bodyLen;
+        BodyStream* stream  = spec.bodyStream;
+
+        for (int redirects = 0; ; ++redirects) {
+            // 流式 body 只走 HTTP/1.1: h2 引擎在自己的线程上发送，不从调用方的流拉取
+            if (stream || !exchange_h2(method, url, spec, body, bodyLen))
+                exchange_once(method, url, spec, body, bodyLen, connectTimeoutMs, stream);
+
+            if (redirects >= kMaxRedirects ||
+                !next_redirect(statusCode(), headers(), url, method, body, bodyLen)) {
+                finish_response();
+                return;
+            }
+            // 303 等改为 GET 的重定向丢弃 body；307 / 308 由 exchange_once 回到流开头重发
+            if (bodyLen == 0) stream = nullptr;
+            discard_body();
+        }
+    }
+
+    /// 会话启用 HTTP/2 时在 h2 连接上发出请求并等待响应头；对端不支持 h2 时返回 false 改走 HTTP/1.1
+    bool exchange_h2(const std::string& method, const UrlParts& url, const RequestSpec& spec,
+                     const void* body, size_t bodyLen)
+    {
+        if (!session_.useHttp2(url, spec.ignoreSslErrors)) return false;
+
+        RequestSpec request = spec;
+        request.method  = method;
+        request.url     = url;
+        request.body    = body;
+        request.bodyLen = bodyLen;
+
+        auto state = std::make_shared<Http2SyncState>();
+        Http2Handler handler;
+        handler.manualWindow = true;
+        handler.onHead = [state](int statusCode, HeaderList& headers) {
+            std::lock_guard<std::mutex> lock(state->mu);
+            state->statusCode = statusCode;
+            state->headers = std::move(headers);
+            state->head = true;
+            state->cv.notify_all();
+        };
+        handler.onData = [state](const char* data, size_t len) {
+            std::lock_guard<std::mutex> lock(state->mu);
+            state->chunks.emplace_back(data, len);
+            state->cv.notify_all();
+        };
+        handler.onSent = [state]() {
+            std::lock_guard<std::mutex> lock(state->mu);
+            state->sent = true;
+            state->cv.notify_all();
+        };
+        handler.onDone = [state](std::exception_ptr error) {
+            std::lock_guard<std::mutex> lock(state->mu);
+            state->error = error;
+            state->done = true;
+            state->cv.notify_all();
+        };
+
+        auto token = session_.http2().start(request, session_.userAgent(), std::move(handler));
+        // 请求 body 属于调用方，发送完毕 (或流结束) 前不能返回
+        std::unique_lock<std::mutex> lock(state->mu);
+        state->cv.wait(lock, [&]() { return (state->head && state->sent) || state->done; });
+        if (!state->head) {
+            if (!state->error) throw std::runtime_error("error=INVALID_SERVER_RESPONSE HTTP/2 stream ended without a response");
+            try { std::rethrow_exception(state->error); }
+            catch (const Http2Unavailable&) { return false; }
+        }
+        lock.unlock();
+
+        h2_ = std::move(state);
+        h2Token_ = token;
+        h2Unacked_ = 0;
+        return true;
+    }
+
+    size_t read_h2(void* buf, size_t cap)
+    {
+        auto& state = *h2_;
+        std::unique_lock<std::mutex> lock(state.mu);
+        if (!state.cv.wait_for(lock, std::chrono::milliseconds(ioTimeoutMs_),
+                               [&]() { return !state.chunks.empty() || state.done; })) {
+            lock.unlock();
+            cancel_h2();
+            throw TransportTimeout("error=TIMEOUT receive timed out");
+        }
+        if (state.chunks.empty()) {
+            if (state.error) std::rethrow_exception(state.error);
+            return 0;
+        }
+
+        auto& front = state.chunks.front();
+        size_t n = std::min(cap, front.size() - state.frontPos);
+        std::memcpy(buf, front.data() + state.frontPos, n);
+        state.frontPos += n;
+        if (state.frontPos == front.size()) { state.chunks.pop_front(); state.frontPos = 0; }
+        bool done = state.done;
+        lock.unlock();
+
+        // 攒够一定量再归还接收窗口，避免每次 read 都唤醒 HTTP/2 引擎
+        h2Unacked_ += n;
+        if (!done && h2Unacked_ >= 64 * 1024) {
+            session_.http2().consume(h2Token_, h2Unacked_);
+            h2Unacked_ = 0;
+        }
+        return n;
+    }
+
+    /// 放弃未读完的 h2 流 (RST_STREAM)；连接本身继续供其它流使用
+    void cancel_h2()
+    {
+        if (!h2_) return;
+        bool done;
+        {
+            std::lock_guard<std::mutex> lock(h2_->mu);
+            done = h2_->done;
+        }
+        if (!done) session_.http2().abort(h2Token_);
+    }
+
+    void exchange_once(const std::string& method, const UrlParts& url, const RequestSpec& spec,
+                       const void* body, size_t bodyLen, int connectTimeoutMs, BodyStream* stream = nullptr)
+    {
+        UrlParts proxy;
+        bool viaProxy = session_.proxy(proxy);
+
+        // 经 HTTP 代理的明文请求使用 absolute-form 请求目标
+        std::string requestTarget = (viaProxy && !url.isHttps)
+            ? "http://" + host_header_value(url) + url.path
+            : url.path;
+        auto head = build_http1_request_head(method, requestTarget, url, spec.headers, bodyLen, session_.userAgent());
+
+        // 小 body 与请求头合并为一次 send
+        bool coalesce = body && bodyLen > 0 && bodyLen <= 16 * 1024;
+        if (coalesce) head.append(static_cast<const char*>(body), bodyLen);
+
+        auto key = pool_key(url, viaProxy ? &proxy : nullptr, spec.ignoreSslErrors);
+        const bool idempotent = is_idempotent_method(method);
+        while (true) {
+            conn_ = session_.pool().acquire(key, connectTimeoutMs);
+            if (!conn_) connect(url, viaProxy ? &proxy : nullptr, spec, connectTimeoutMs);
+
+            bool written = false;
+            headBytes_ = 0;
+            try {
+                conn_->sendAll(head.data(), head.size(), ioTimeoutMs_);
+                if (stream) send_stream(*stream);
+                else if (!coalesce && body && bodyLen > 0) conn_->sendAll(body, bodyLen, ioTimeoutMs_);
+                written = true;
+                parser_.reset(method == "HEAD");
+                read_head();
+                return;
+            } catch (const TransportTimeout&) {
+                throw;
+            } catch (const std::runtime_error&) {
+                // 复用的空闲连接可能恰好被服务器关闭: 尚未收到任何响应字节时换新连接重发一次。
+                // 请求已完整写出时服务器可能已经处理过，只重发幂等方法 (RFC 9110 §9.2.2)
+                if (!conn_.reused() || headBytes_ > 0 || (written && !idempotent)) throw;
+                conn_.release(true);
+            }
+        }
+    }
+
+    /// 流式 body: 内存段直接发出；文件段在明文连接上走 sendfile，TLS 连接上映射后交给 TLS 加密
+    void send_stream(BodyStream& stream)
+    {
+        stream.sendTo(
+            [this](const void* data, size_t len) { conn_->sendAll(data, len, ioTimeoutMs_); },
+            [this](const BodyFile& file, uint64_t offset, size_t len) {
+                return conn_->sendFile(file.fd(), offset, len, ioTimeoutMs_);
+            });
+    }
+
+    void connect(const UrlParts& url, const UrlParts* proxy, const RequestSpec& spec, int connectTimeoutMs)
+    {
+        const UrlParts& target = proxy ? *proxy : url;
+        conn_.attach(std::make_unique<PosixConnection>());
+        conn_->connect(target.host, target.port, connectTimeoutMs);
+
+        if (url.isHttps) {
+            if (proxy) open_tunnel(url);
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+            conn_->startTls(session_.tlsContext(), url.host, !spec.ignoreSslErrors, ioTimeoutMs_);
+#else
+            (void)spec;
+            throw std::runtime_error("HTTPS on Linux requires DRX_HTTP_ENABLE_OPENSSL (link -lssl -lcrypto)");
+#endif
+        }
+    }
+
+    void read_head()
+    {
+        rpos_ = rlen_ = 0;
+        headBytes_ = 0;
+        while (!parser_.headComplete()) {
+            if (rpos_ == rlen_) {
+                rpos_ = 0;
+                rlen_ = conn_->recvSome(rbuf_.data(), rbuf_.size(), ioTimeoutMs_);
+                if (rlen_ == 0)
+                    throw std::runtime_error("error=CONNECTION_ERROR connection closed before response headers");
+                headBytes_ += rlen_;
+            }
+            rpos_ += parser_.parseHead(rbuf_.data() + rpos_, rlen_ - rpos_);
+        }
+    }
+
+    /// 响应结束: 完整读完、可保持且没有多余字节时归还连接，否则关闭
+    void finish_response()
+    {
+        if (h2_ || !conn_) return;
+        if (parser_.done() && parser_.keepAlive() && rpos_ == rlen_) conn_.recycle();
+        else if (parser_.done()) conn_.release();
+    }
+
+    /// 跟随重定向前丢弃小的重定向 body，使连接仍可复用 (h2 流直接重置，不影响连接)
+    void discard_body()
+    {
+        if (h2_) {
+            cancel_h2();
+            h2_.reset();
+            return;
+        }
+        char scratch[4096];
+        size_t discarded = 0;
+        while (conn_ && !parser_.done() && discarded < 64 * 1024) {
+            size_t n = read(scratch, sizeof(scratch));
+            if (n == 0) break;
+            discarded += n;
+        }
+        if (!parser_.done()) conn_.release();
+        finish_response();
+    }
+
+    /// 通过 HTTP 代理建立 CONNECT 隧道
+    void open_tunnel(const UrlParts& url)
+    {
+        auto authority = url.host + ":" + std::to_string(url.port);
+        std::string req = "CONNECT " + authority + " HTTP/1.1\r\nHost: " + authority + "\r\n\r\n";
+        conn_->sendAll(req.data(), req.size(), ioTimeoutMs_);
+        parser_.reset(true);
+        read_head();
+        if (parser_.statusCode < 200 || parser_.statusCode >= 300)
+            throw std::runtime_error("Proxy CONNECT failed: " + std::to_string(parser_.statusCode) + " " + parser_.reasonPhrase);
+    }
+};
+
+// ──────── POSIX 异步引擎 (单线程 epoll 事件循环) ────────
+
+/// 一个事件循环线程驱动全部异步请求: 连接、TLS 握手、发送与接收都是非阻塞状态机，
+/// 连接从会话的连接池借出 (与同步请求共享)。每主机连接数已满的请求按主机排队，
+/// 有连接归还时依次发起。完成回调在事件循环线程上执行，回调中不应做阻塞操作。
+/// 注意: DNS 解析 (getaddrinfo) 仍是同步的，会短暂占用事件循环。
+class AsyncEngine
+{
+public:
+    explicit AsyncEngine(HttpSession& session) : session_(session), rbuf_(64 * 1024) {}
+    ~AsyncEngine() { stop(); }
+
+    AsyncEngine(const AsyncEngine&) = delete;
+    AsyncEngine& operator=(const AsyncEngine&) = delete;
+
+    void submit(std::unique_ptr<AsyncCall> call)
+    {
+        call->spec.body    = (call->body && !call->body->empty()) ? call->body->data() : nullptr;
+        call->spec.bodyLen = call->body ? call->body->size() : 0;
+
+        auto op = std::make_unique<Op>();
+        op->method    = call->spec.method;
+        op->url       = call->spec.url;
+        op->body      = call->spec.body;
+        op->bodyLen   = call->spec.bodyLen;
+        op->connectTimeoutMs = call->spec.timeoutMs > 0 ? call->spec.timeoutMs : HttpExchange::kDefaultConnectTimeoutMs;
+        op->ioTimeoutMs      = call->spec.timeoutMs > 0 ? call->spec.timeoutMs : HttpExchange::kDefaultIoTimeoutMs;
+        op->notBefore = Clock::now() + std::chrono::milliseconds(std::max(call->delayMs, 0));
+        op->call      = std::move(call);
+        {
+            std::lock_guard<std::mutex> lock(inboxMu_);
+            if (stopping_) throw std::runtime_error("Async engine stopped");
+            ensure_started();
+            inbox_.push_back(std::move(op));
+        }
+        wake();
+    }
+
+    /// 停止事件循环，未完成的请求以 "Async engine stopped" 结束
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(inboxMu_);
+            if (stopping_) return;
+            stopping_ = true;
+        }
+        if (loop_.joinable()) {
+            wake();
+            loop_.join();
+        }
+        if (evfd_ >= 0) { ::close(evfd_); evfd_ = -1; }
+        if (ep_ >= 0) { ::close(ep_); ep_ = -1; }
+
+        // 交给 HTTP/2 引擎的请求同样以 "Async engine stopped" 结束，等待其回调全部完成
+        std::unique_lock<std::mutex> lock(h2Mu_);
+        for (const auto& [raw, h2op] : h2Ops_) {
+            if (h2op->token) session_.http2().abort(h2op->token, std::make_exception_ptr(std::runtime_error("Async engine stopped")));
+        }
+        h2Cv_.wait(lock, [&]() { return h2Ops_.empty(); });
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Phase { Delayed, Queued, Connecting, Handshaking, Sending, Receiving };
+
+    struct Op;
+
+    /// 走 HTTP/2 的请求: Op 移交给 HTTP/2 引擎的回调 (在其事件循环线程上执行)，
+    /// 需要跟随重定向或回退 HTTP/1.1 时重新放回本引擎的 inbox
+    struct Http2Op
+    {
+        std::unique_ptr<Op> op;
+        uint64_t            token = 0;   ///< 受 h2Mu_ 保护
+    };
+
+    struct Op
+    {
+        std::unique_ptr<AsyncCall> call;
+        Phase                 phase = Phase::Delayed;
+        std::string           method;
+        UrlParts              url;
+        const void*           body = nullptr;
+        size_t                bodyLen = 0;
+        int                   redirects = 0;
+        int                   connectTimeoutMs = 0;
+        int                   ioTimeoutMs = 0;
+
+        UrlParts              proxy;
+        bool                  viaProxy  = false;
+        bool                  tunneling = false;   ///< CONNECT 隧道请求进行中
+        std::string           key;                 ///< 连接池键
+        bool                  waiting = false;     ///< 在 waiting_[key] 中排队
+        ConnectionPool::Lease conn;
+        int                   fd = -1;             ///< 当前注册在 epoll 中的 fd
+        uint32_t              armed = 0;
+
+        std::string           out;                 ///< 请求头 (+ 合并的小 body)
+        size_t                outPos = 0;
+        size_t                bodyPos = 0;         ///< 未合并 body 的已发送字节
+        bool                  coalesced = false;
+        Http1ResponseParser   parser;
+        size_t                headBytes = 0;
+        bool                  redirect = false;    ///< 当前响应将被跟随，body 丢弃
+        size_t                discarded = 0;
+        AsyncResult           result;
+
+        Clock::time_point     notBefore;
+        Clock::time_point     deadline;            ///< 当前阶段的超时时刻
+    };
+
+    HttpSession&                                  session_;
+    int                                           ep_   = -1;
+    int                                           evfd_ = -1;
+    std::thread                                   loop_;
+    std::mutex                                    inboxMu_;
+    std::vector<std::unique_ptr<Op>>              inbox_;          ///< 受 inboxMu_ 保护
+    bool                                          stopping_ = false;
+    std::atomic<bool>                             exit_{ false };
+
+    // 以下只由事件循环线程访问
+    std::unordered_map<Op*, std::unique_ptr<Op>>  ops_;
+    std::unordered_map<std::string, std::deque<Op*>> waiting_;
+    std::vector<std::string>                      dirtyKeys_;      ///< 有连接归还、需重试排队请求的主机
+    std::vector<Op*>                              ready_;          ///< TLS 引擎中仍有未读数据的请求
+    std::vector<char>                             rbuf_;           ///< 所有请求共用的接收缓冲
+    Clock::time_point                             now_;
+    Clock::time_point                             lastTick_;
+
+    std::mutex                                    h2Mu_;
+    std::condition_variable                       h2Cv_;
+    std::unordered_map<Http2Op*, std::shared_ptr<Http2Op>> h2Ops_;   ///< 受 h2Mu_ 保护
+
+    // ──────── 事件循环 ────────
+
+    void ensure_started()
+    {
+        if (loop_.joinable()) return;
+        ep_ = epoll_create1(EPOLL_CLOEXEC);
+        if (ep_ < 0) throw std::runtime_error("epoll_create1 failed: " + errno_message(errno));
+        evfd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (evfd_ < 0) throw std::runtime_error("eventfd failed: " + errno_message(errno));
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;   // nullptr = 唤醒 fd
+        epoll_ctl(ep_, EPOLL_CTL_ADD, evfd_, &ev);
+        loop_ = std::thread([this]() { run_loop(); });
+    }
+
+    void wake()
+    {
+        uint64_t one = 1;
+        if (evfd_ >= 0) { ssize_t n = ::write(evfd_, &one, sizeof(one)); (void)n; }
+    }
+
+    void run_loop()
+    {
+        epoll_event events[256];
+        now_ = lastTick_ = Clock::now();
+        while (true) {
+            int timeoutMs = (!ready_.empty() || !dirtyKeys_.empty()) ? 0 : ops_.empty() ? -1 : 10;
+            int n = epoll_wait(ep_, events, 256, timeoutMs);
+            now_ = Clock::now();
+            if (n < 0 && errno != EINTR) break;
+
+            for (int i = 0; i < n; ++i) {
+                auto op = static_cast<Op*>(events[i].data.ptr);
+                if (!op) { intake(); continue; }
+                if (ops_.count(op)) guarded(op, [&]() { on_event(op); });
+            }
+            if (exit_.load()) break;
+
+            std::vector<Op*> ready;
+            ready.swap(ready_);
+            for (auto op : ready) {
+                if (ops_.count(op) && op->phase == Phase::Receiving) guarded(op, [&]() { pump_recv(op); });
+            }
+
+            pump_dirty();
+            if (now_ - lastTick_ >= std::chrono::milliseconds(10)) {
+                tick();
+                lastTick_ = now_;
+            }
+        }
+        shutdown_ops();
+    }
+
+    void intake()
+    {
+        uint64_t counter;
+        while (::read(evfd_, &counter, sizeof(counter)) > 0) {}
+
+        std::vector<std::unique_ptr<Op>> incoming;
+        {
+            std::lock_guard<std::mutex> lock(inboxMu_);
+            incoming.swap(inbox_);
+            if (stopping_) exit_.store(true);
+        }
+        for (auto& owned : incoming) {
+            Op* op = owned.get();
+            ops_.emplace(op, std::move(owned));
+            if (op->notBefore <= now_) guarded(op, [&]() { start(op); });
+        }
+    }
+
+    /// 取消、超时与延迟发起；连接池被同步请求释放时也在这里重试排队的请求
+    void tick()
+    {
+        std::vector<Op*> snapshot;
+        snapshot.reserve(ops_.size());
+        for (const auto& [op, owned] : ops_) snapshot.push_back(op);
+
+        for (auto op : snapshot) {
+            if (!ops_.count(op)) continue;
+            if (op->call->cancel.isCancelled()) {
+                complete(op, std::make_exception_ptr(std::runtime_error("Request cancelled")));
+            } else if (op->phase == Phase::Delayed) {
+                if (now_ >= op->notBefore) guarded(op, [&]() { start(op); });
+            } else if (now_ >= op->deadline) {
+                guarded(op, [&]() { on_timeout(op); });
+            }
+        }
+
+        for (const auto& [key, queue] : waiting_) dirtyKeys_.push_back(key);
+        pump_dirty();
+    }
+
+    void shutdown_ops()
+    {
+        auto stopped = std::make_exception_ptr(std::runtime_error("Async engine stopped"));
+        std::vector<Op*> remaining;
+        for (const auto& [op, owned] : ops_) remaining.push_back(op);
+        for (auto op : remaining) complete(op, stopped);
+
+        std::vector<std::unique_ptr<Op>> incoming;
+        {
+            std::lock_guard<std::mutex> lock(inboxMu_);
+            incoming.swap(inbox_);
+        }
+        for (auto& op : incoming) invoke(op->call->done, AsyncResult(), stopped);
+    }
+
+    template <typename F>
+    void guarded(Op* op, F&& f)
+    {
+        try {
+            f();
+        } catch (const TransportTimeout&) {
+            on_error(op, std::current_exception(), true);
+        } catch (...) {
+            on_error(op, std::current_exception(), false);
+        }
+    }
+
+    // ──────── epoll 注册 ────────
+
+    void arm(Op* op, IoWant want)
+    {
+        int fd = op->conn->fd();
+        uint32_t events = (uint32_t)want;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.ptr = op;
+        if (op->fd != fd) {
+            unregister(op);
+            if (epoll_ctl(ep_, EPOLL_CTL_ADD, fd, &ev) != 0)
+                throw std::runtime_error("epoll_ctl failed: " + errno_message(errno));
+        } else if (op->armed != events) {
+            if (epoll_ctl(ep_, EPOLL_CTL_MOD, fd, &ev) != 0) {
+                if (errno != ENOENT || epoll_ctl(ep_, EPOLL_CTL_ADD, fd, &ev) != 0)
+                    throw std::runtime_error("epoll_ctl failed: " + errno_message(errno));
+            }
+        }
+        op->fd = fd;
+        op->armed = events;
+    }
+
+    /// 在任何可能关闭 fd 的操作之前调用 (fd 号可能被新 socket 复用)
+    void unregister(Op* op)
+    {
+        if (op->fd >= 0) epoll_ctl(ep_, EPOLL_CTL_DEL, op->fd, nullptr);
+        op->fd = -1;
+        op->armed = 0;
+    }
+
+    // ──────── 连接 ────────
+
+    /// 借出连接并开始连接或发送；每主机连接数已满时按主机排队
+    void start(Op* op)
+    {
+        const auto& spec = op->call->spec;
+        bool wasWaiting = op->waiting;
+        if (!wasWaiting && session_.useHttp2(op->url, spec.ignoreSslErrors)) {
+            start_h2(op);
+            return;
+        }
+        if (!wasWaiting) {
+            op->phase    = Phase::Queued;
+            op->viaProxy = session_.proxy(op->proxy);
+            op->key      = pool_key(op->url, op->viaProxy ? &op->proxy : nullptr, spec.ignoreSslErrors);
+            op->deadline = now_ + std::chrono::milliseconds(op->connectTimeoutMs);
+        }
+
+        auto& queue = waiting_[op->key];
+        bool turn = wasWaiting ? queue.front() == op : queue.empty();
+        if (!turn || !session_.pool().tryAcquire(op->key, op->conn)) {
+            if (!wasWaiting) { queue.push_back(op); op->waiting = true; }
+            return;
+        }
+        if (wasWaiting) queue.pop_front();
+        if (queue.empty()) waiting_.erase(op->key);
+        op->waiting = false;
+
+        if (op->conn) { begin_request(op); return; }
+
+        const UrlParts& target = op->viaProxy ? op->proxy : op->url;
+        op->conn.attach(std::make_unique<PosixConnection>());
+        op->phase = Phase::Connecting;
+        if (op->conn->beginConnect(target.host, target.port)) { on_connected(op); return; }
+        arm(op, IoWant::Write);
+    }
+
+    void start_h2(Op* op)
+    {
+        auto h2op = std::make_shared<Http2Op>();
+        auto it = ops_.find(op);
+        h2op->op = std::move(it->second);
+        ops_.erase(it);
+
+        RequestSpec spec = op->call->spec;
+        spec.method  = op->method;
+        spec.url     = op->url;
+        spec.body    = op->body;
+        spec.bodyLen = op->bodyLen;
+
+        Http2Handler handler;
+        handler.cancel = op->call->cancel;
+        handler.onHead = [op](int statusCode, HeaderList& headers) {
+            if (op->redirects < HttpExchange::kMaxRedirects) {
+                UrlParts    url     = op->url;
+                std::string method  = op->method;
+                const void* body    = op->body;
+                size_t      bodyLen = op->bodyLen;
+                op->redirect = next_redirect(statusCode, headers, url, method, body, bodyLen);
+            }
+            op->result.statusCode = statusCode;
+            op->result.headers    = std::move(headers);
+            if (op->redirect) return;
+            if (op->call->onHead) op->call->onHead(statusCode, op->result.headers);
+            auto length = content_length_of(op->result.headers);
+            if (!op->call->onBody && length > 0)
+                op->result.body.reserve((size_t)std::min<int64_t>(length, 64ll << 20));
+        };
+        handler.onData = [op](const char* data, size_t len) {
+            if (op->redirect) return;
+            if (op->call->onBody) op->call->onBody(data, len);
+            else op->result.body.insert(op->result.body.end(), data, data + len);
+        };
+        handler.onDone = [this, h2op](std::exception_ptr error) { finish_h2(h2op, error); };
+
+        std::lock_guard<std::mutex> lock(h2Mu_);
+        h2Ops_[h2op.get()] = h2op;
+        try {
+            h2op->token = session_.http2().start(spec, session_.userAgent(), std::move(handler));
+        } catch (...) {
+            h2Ops_.erase(h2op.get());
+            ops_.emplace(op, std::move(h2op->op));
+            throw;
+        }
+    }
+
+    /// HTTP/2 引擎线程上: 完成、跟随重定向，或在对端不支持 h2 时交回本引擎按 HTTP/1.1 发送
+    void finish_h2(const std::shared_ptr<Http2Op>& h2op, std::exception_ptr error)
+    {
+        std::unique_ptr<Op> op = std::move(h2op->op);
+        bool fallback = false;
+        if (error) {
+            try { std::rethrow_exception(error); }
+            catch (const Http2Unavailable&) { fallback = true; }
+            catch (...) {}
+        }
+
+        if (fallback || (!error && op->redirect)) {
+            if (!fallback) {
+                next_redirect(op->result.statusCode, op->result.headers, op->url, op->method, op->body, op->bodyLen);
+                op->redirects++;
+            }
+            op->redirect  = false;
+            op->result    = AsyncResult();
+            op->phase     = Phase::Delayed;
+            op->notBefore = Clock::time_point();
+            std::unique_lock<std::mutex> lock(inboxMu_);
+            if (!stopping_) {
+                inbox_.push_back(std::move(op));
+                lock.unlock();
+                wake();
+            } else {
+                lock.unlock();
+                error = std::make_exception_ptr(std::runtime_error("Async engine stopped"));
+            }
+        }
+
+        if (op) {
+            error = with_prefix(error, op->call->spec.errorPrefix);
+            auto done = std::move(op->call->done);
+            AsyncResult result = std::move(op->result);
+            op.reset();
+            invoke(done, std::move(result), error);
+        }
+
+        std::lock_guard<std::mutex> lock(h2Mu_);
+        h2Ops_.erase(h2op.get());
+        h2Cv_.notify_all();
+    }
+
+    void on_event(Op* op)
+    {
+        switch (op->phase) {
+            case Phase::Connecting:
+                unregister(op);   // finishConnect 失败时会关闭当前 fd 并改连下一个地址
+                if (op->conn->finishConnect()) on_connected(op);
+                else {
+                    op->deadline = now_ + std::chrono::milliseconds(op->connectTimeoutMs);
+                    arm(op, IoWant::Write);
+                }
+                break;
+            case Phase::Handshaking: continue_tls(op); break;
+            case Phase::Sending:     pump_send(op);    break;
+            case Phase::Receiving:   pump_recv(op);    break;
+            default: break;
+        }
+    }
+
+    void on_connected(Op* op)
+    {
+        if (!op->url.isHttps) { begin_request(op); return; }
+        if (!op->viaProxy) { start_tls(op); return; }
+
+        // 经 HTTP 代理的 https: 先建立 CONNECT 隧道
+        auto authority = op->url.host + ":" + std::to_string(op->url.port);
+        op->out = "CONNECT " + authority + " HTTP/1.1\r\nHost: " + authority + "\r\n\r\n";
+        op->tunneling = true;
+        begin_send(op, true);
+    }
+
+    void start_tls(Op* op)
+    {
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+        op->conn->beginTls(session_.tlsContext(), op->url.host, !op->call->spec.ignoreSslErrors);
+        op->phase = Phase::Handshaking;
+        op->deadline = now_ + std::chrono::milliseconds(op->ioTimeoutMs);
+        continue_tls(op);
+#else
+        (void)op;
+        throw std::runtime_error("HTTPS on Linux requires DRX_HTTP_ENABLE_OPENSSL (link -lssl -lcrypto)");
+#endif
+    }
+
+    void continue_tls(Op* op)
+    {
+#if defined(DRX_HTTP_ENABLE_OPENSSL)
+        IoWant want = IoWant::None;
+        if (op->conn->continueTls(want)) { begin_request(op); return; }
+        op->deadline = now_ + std::chrono::milliseconds(op->ioTimeoutMs);
+        arm(op, want);
+#else
+        (void)op;
+#endif
+    }
+
+    void on_timeout(Op* op)
+    {
+        switch (op->phase) {
+            case Phase::Queued:
+                throw TransportTimeout("error=TIMEOUT connection pool exhausted for " + op->key);
+            case Phase::Connecting:
+                unregister(op);
+                if (op->conn->failAddress(ETIMEDOUT)) { on_connected(op); return; }
+                op->deadline = now_ + std::chrono::milliseconds(op->connectTimeoutMs);
+                arm(op, IoWant::Write);
+                return;
+            case Phase::Handshaking: throw TransportTimeout("error=TIMEOUT TLS handshake timed out");
+            case Phase::Sending:     throw TransportTimeout("error=TIMEOUT send timed out");
+            case Phase::Receiving:   throw TransportTimeout("error=TIMEOUT receive timed out");
+            default: return;
+        }
+    }
+
+    // ──────── 发送 ────────
+
+    void begin_request(Op* op)
+    {
+        // 经 HTTP 代理的明文请求使用 absolute-form 请求目标
+        const auto& spec = op->call->spec;
+        std::string target = (op->viaProxy && !op->url.isHttps)
+            ? "http://" + host_header_value(op->url) + op->url.path
+            : op->url.path;
+        op->out = build_http1_request_head(op->method, target, op->url, spec.headers, op->bodyLen, session_.userAgent());
+        op->tunneling = false;
+
+        // 小 body 与请求头合并为一次 send
+        bool coalesce = op->body && op->bodyLen > 0 && op->bodyLen <= 16 * 1024;
+        if (coalesce) op->out.append(static_cast<const char*>(op->body), op->bodyLen);
+        begin_send(op, coalesce || !op->body);
+    }
+
+    void begin_send(Op* op, bool headOnly)
+    {
+        op->outPos = op->bodyPos = 0;
+        op->coalesced = headOnly;
+        op->parser.reset(op->tunneling || op->method == "HEAD");
+        op->headBytes = 0;
+        op->redirect = false;
+        op->discarded = 0;
+        op->result = AsyncResult();
+        op->phase = Phase::Sending;
+        op->deadline = now_ + std::chrono::milliseconds(op->ioTimeoutMs);
+        pump_send(op);
+    }
+
+    void pump_send(Op* op)
+    {
+        IoWant want = IoWant::None;
+        auto send_from = [&](const char* p, size_t len, size_t& pos) {
+            while (pos < len) {
+                size_t n = op->conn->trySend(p + pos, len - pos, want);
+                if (n == 0) {
+                    if (want == IoWant::None) continue;
+                    return false;
+                }
+                pos += n;
+                op->deadline = now_ + std::chrono::milliseconds(op->ioTimeoutMs);
+            }
+            return true;
+        };
+
+        if (!send_from(op->out.data(), op->out.size(), op->outPos) ||
+            (!op->coalesced && !send_from(static_cast<const char*>(op->body), op->bodyLen, op->bodyPos)) ||
+            !op->conn->flushOutput(want)) {
+            arm(op, want);
+            return;
+        }
+        op->phase = Phase::Receiving;
+        arm(op, IoWant::Read);
+    }
+
+    // ──────── 接收 ────────
+
+    void pump_recv(Op* op)
+    {
+        // 每次事件最多读 16 次，避免大响应独占事件循环 (水平触发，剩余数据下一轮继续)
+        for (int i = 0; i < 16; ++i) {
+            IoWant want = IoWant::None;
+            bool eof = false;
+            size_t n = op->conn->tryRecv(rbuf_.data(), rbuf_.size(), want, eof);
+            if (n == 0) {
+                if (eof) { on_eof(op); return; }
+                if (want == IoWant::None) continue;
+                arm(op, want);
+                return;
+            }
+            op->deadline = now_ + std::chrono::milliseconds(op->ioTimeoutMs);
+            if (!on_data(op, rbuf_.data(), n)) return;
+        }
+        if (op->conn->hasBufferedInput()) ready_.push_back(op);
+        arm(op, IoWant::Read);
+    }
+
+    /// 喂入收到的字节。返回 false 表示本次响应已结束或请求已转入其他阶段
+    bool on_data(Op* op, const char* data, size_t len)
+    {
+        auto& parser = op->parser;
+        size_t pos = 0;
+        if (!parser.headComplete()) {
+            op->headBytes += len;
+            pos = parser.parseHead(data, len);
+            if (!parser.headComplete()) return true;
+
+            if (op->tunneling) {
+                if (parser.statusCode < 200 || parser.statusCode >= 300)
+                    throw std::runtime_error("Proxy CONNECT failed: " + std::to_string(parser.statusCode) + " " + parser.reasonPhrase);
+                op->tunneling = false;
+                start_tls(op);
+                return false;
+            }
+            on_head(op);
+        }
+
+        while (pos < len && !parser.done()) {
+            const char* p = nullptr;
+            size_t n = 0;
+            pos += parser.parseBody(data + pos, len - pos, p, n);
+            if (n == 0) continue;
+            if (!op->redirect) {
+                if (op->call->onBody) op->call->onBody(p, n);
+                else op->result.body.insert(op->result.body.end(), p, p + n);
+            } else if ((op->discarded += n) > 64 * 1024) {
+                // 重定向 body 过大: 放弃这条连接，直接跟随
+                release(op);
+                follow_redirect(op);
+                return false;
+            }
+        }
+        if (!parser.done()) return true;
+        finish(op, pos == len);
+        return false;
+    }
+
+    void on_head(Op* op)
+    {
+        const auto& parser = op->parser;
+        if (op->redirects < HttpExchange::kMaxRedirects) {
+            UrlParts    url     = op->url;
+            std::string method  = op->method;
+            const void* body    = op->body;
+            size_t      bodyLen = op->bodyLen;
+            op->redirect = next_redirect(parser.statusCode, parser.headers, url, method, body, bodyLen);
+        }
+        if (op->redirect) return;
+        if (op->call->onHead) op->call->onHead(parser.statusCode, parser.headers);
+        if (!op->call->onBody && parser.contentLength > 0)
+            op->result.body.reserve((size_t)std::min<int64_t>(parser.contentLength, 64ll << 20));
+    }
+
+    void on_eof(Op* op)
+    {
+        if (!op->parser.headComplete())
+            throw std::runtime_error("error=CONNECTION_ERROR connection closed before response headers");
+        release(op);
+        op->parser.finishOnEof();
+        finish(op, false);
+    }
+
+    /// 响应结束: 完整读完、可保持且没有多余字节时归还连接，否则关闭
+    void finish(Op* op, bool clean)
+    {
+        if (op->conn && op->parser.keepAlive() && clean) recycle(op);
+        else release(op);
+
+        if (op->redirect) { follow_redirect(op); return; }
+
+        op->result.statusCode   = op->parser.statusCode;
+        op->result.reasonPhrase = std::move(op->parser.reasonPhrase);
+        op->result.headers      = std::move(op->parser.headers);
+        complete(op, nullptr);
+    }
+
+    void follow_redirect(Op* op)
+    {
+        next_redirect(op->parser.statusCode, op->parser.headers, op->url, op->method, op->body, op->bodyLen);
+        op->redirects++;
+        start(op);
+    }
+
+    // ──────── 连接归还 / 完成 ────────
+
+    /// 归还的连接立即交给同一主机排队中的下一个请求 (发起过程不会同步完成请求，不会递归)
+    void recycle(Op* op)
+    {
+        unregister(op);
+        op->conn.recycle();
+        pump_waiting(op->key);
+    }
+
+    void release(Op* op, bool stale = false)
+    {
+        unregister(op);
+        if (!op->conn) return;
+        op->conn.release(stale);
+        dirtyKeys_.push_back(op->key);
+    }
+
+    /// 让有连接释放的主机上排队的请求依次发起
+    void pump_dirty()
+    {
+        while (!dirtyKeys_.empty()) {
+            std::vector<std::string> keys;
+            keys.swap(dirtyKeys_);
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+            for (const auto& key : keys) pump_waiting(key);
+        }
+    }
+
+    void pump_waiting(const std::string& key)
+    {
+        while (true) {
+            auto it = waiting_.find(key);
+            if (it == waiting_.end() || it->second.empty()) return;
+            Op* op = it->second.front();
+            guarded(op, [&]() { start(op); });
+            if (ops_.count(op) && op->waiting) return;
+        }
+    }
+
+    void on_error(Op* op, std::exception_ptr error, bool timeout)
+    {
+        // 复用的空闲连接可能恰好被服务器关闭: 尚未收到任何响应字节时换新连接重发；
+        // 进入 Receiving 说明请求已完整写出，服务器可能已处理，只重发幂等方法
+        bool stale = !timeout && op->conn && op->conn.reused() && op->headBytes == 0 && !op->tunneling &&
+                     (op->phase == Phase::Sending || (op->phase == Phase::Receiving && is_idempotent_method(op->method)));
+        if (stale) {
+            release(op, true);
+            guarded(op, [&]() { start(op); });
+            return;
+        }
+        complete(op, error);
+    }
+
+    void complete(Op* op, std::exception_ptr error)
+    {
+        release(op);
+        if (op->waiting) {
+            auto it = waiting_.find(op->key);
+            if (it != waiting_.end()) {
+                it->second.erase(std::remove(it->second.begin(), it->second.end(), op), it->second.end());
+                if (it->second.empty()) waiting_.erase(it);
+            }
+        }
+        ready_.erase(std::remove(ready_.begin(), ready_.end(), op), ready_.end());
+
+        auto it = ops_.find(op);
+        if (it == ops_.end()) return;
+        std::unique_ptr<Op> owned = std::move(it->second);
+        ops_.erase(it);
+
+        error = with_prefix(error, owned->call->spec.errorPrefix);
+        auto done = std::move(owned->call->done);
+        AsyncResult result = std::move(owned->result);
+        owned.reset();
+        invoke(done, std::move(result), error);
+    }
+
+    static std::exception_ptr with_prefix(std::exception_ptr error, const std::string& prefix)
+    {
+        if (!error || prefix.empty()) return error;
+        try { std::rethrow_exception(error); }
+        catch (const std::exception& ex) { return std::make_exception_ptr(std::runtime_error(prefix + ex.what())); }
+        catch (...) { return error; }
+    }
+
+    static void invoke(std::function<void(AsyncResult&&, std::exception_ptr)>& done, AsyncResult&& result, std::exception_ptr error)
+    {
+        if (!done) return;
+        try { done(std::move(result), error); } catch (...) {}
+    }
+};
+
+#endif
+
+} // namespace detail
+
+#if defined(DRX_HTTP_HAS_COROUTINES)
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  协程支持 (C++20，编译器支持 <coroutine> 时启用)
+// ═══════════════════════════════════════════════════════════════════════════
+
+/// 协程恢复执行的位置。post() 必须线程安全
+class Executor
+{
+public:
+    virtual ~Executor() = default;
+    virtual void post(std::function<void()> fn) = 0;
+
+    /// co_await executor.schedule(): 把当前协程切换到该执行器上继续
+    auto schedule() noexcept
+    {
+        struct Awaiter
+        {
+            Executor* executor;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> h) { executor->post([h]() { h.resume(); }); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{ this };
+    }
+};
+
+/// 由调用方线程驱动的执行器: run() 在当前线程依次执行投递的任务，直到 stop()。
+/// 所有协程在同一线程上恢复，用户代码无需加锁
+class SingleThreadExecutor : public Executor
+{
+public:
+    void post(std::function<void()> fn) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            tasks_.push_back(std::move(fn));
+        }
+        cv_.notify_one();
+    }
+
+    /// 执行任务直到 stop() 且队列清空
+    void run()
+    {
+        while (auto fn = take(true)) fn();
+    }
+
+    /// 执行当前已排队的任务后立即返回，返回执行数
+    size_t poll()
+    {
+        size_t n = 0;
+        while (auto fn = take(false)) { fn(); ++n; }
+        return n;
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stopped_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    /// stop() 之后重新允许 run()
+    void restart()
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stopped_ = false;
+    }
+
+private:
+    std::mutex                        mu_;
+    std::condition_variable           cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool                              stopped_ = false;
+
+    std::function<void()> take(bool wait)
+    {
+        std::unique_lock<std::mutex> lock(mu_);
+        if (wait) cv_.wait(lock, [this]() { return stopped_ || !tasks_.empty(); });
+        if (tasks_.empty()) return nullptr;
+        auto fn = std::move(tasks_.front());
+        tasks_.pop_front();
+        return fn;
+    }
+};
+
+/// 固定线程数的执行器，投递的任务由任一工作线程执行。析构时执行完已投递的任务后 join
+class ThreadPoolExecutor : public Executor
+{
+public:
+    explicit ThreadPoolExecutor(int threads = (int)std::max(1u, std::thread::hardware_concurrency()))
+    {
+        for (int i = 0; i < std::max(threads, 1); ++i)
+            threads_.emplace_back([this]() { queue_.run(); });
+    }
+
+    ~ThreadPoolExecutor() override
+    {
+        queue_.stop();
+        for (auto& t : threads_) if (t.joinable()) t.join();
+    }
+
+    ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+    ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+    void post(std::function<void()> fn) override { queue_.post(std::move(fn)); }
+
+    int threadCount() const { return (int)threads_.size(); }
+
+private:
+    SingleThreadExecutor     queue_;     // 多个线程同时 run() 同一队列
+    std::vector<std::thread> threads_;
+};
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase
+{
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr      error;
+
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            return h.promise().continuation;   // 对称转移，避免链式 co_await 栈增长
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase
+{
+    std::optional<T> value;
+
+    Task<T> get_return_object() noexcept;
+    template <typename U>
+    void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+
+    T result()
+    {
+        if (error) std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase
+{
+    Task<void> get_return_object() noexcept;
+    void return_void() const noexcept {}
+
+    void result()
+    {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+/// 立即开始、结束后自动销毁的协程 (syncWait / spawn 的驱动)
+struct DetachedCoroutine
+{
+    struct promise_type
+    {
+        DetachedCoroutine get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept {}
+    };
+};
+
+} // namespace detail
+
+/// 惰性协程任务: 被 co_await (或 syncWait / spawn) 时才开始执行
+template <typename T>
+class [[nodiscard]] Task
+{
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+    Task() = default;
+    explicit Task(std::coroutine_handle<promise_type> h) : handle_(h) {}
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    ~Task() { if (handle_) handle_.destroy(); }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    auto operator co_await() const noexcept
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+            bool await_ready() const noexcept { return !handle || handle.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume()
+            {
+                if (!handle) throw std::runtime_error("Task is empty");
+                return handle.promise().result();
+            }
+        };
+        return Awaiter{ handle_ };
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+template <typename T>
+DetachedCoroutine sync_wait_driver(Task<T>& task, std::promise<T>& promise)
+{
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await task;
+            promise.set_value();
+        } else {
+            promise.set_value(co_await task);
+        }
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
+}
+
+inline DetachedCoroutine spawn_driver(Task<void> task, Executor* executor,
+                                      std::function<void(std::exception_ptr)> onError)
+{
+    try {
+        if (executor) co_await executor->schedule();
+        co_await task;
+    } catch (...) {
+        if (onError) onError(std::current_exception());
+    }
+}
+
+} // namespace detail
+
+/// 在当前线程阻塞等待任务完成并返回结果 (异常原样抛出)。不要在 I/O 线程或执行器线程上调用
+template <typename T>
+T syncWait(Task<T> task)
+{
+    std::promise<T> promise;
+    auto future = promise.get_future();
+    detail::sync_wait_driver(task, promise);
+    return future.get();
+}
+
+/// 后台启动任务，不等待结果。executor 非空时在其上开始执行；异常交给 onError (未设置则忽略)
+inline void spawn(Task<void> task, Executor* executor = nullptr,
+                  std::function<void(std::exception_ptr)> onError = nullptr)
+{
+    detail::spawn_driver(std::move(task), executor, std::move(onError));
+}
+
+/// 单次异步操作的 awaitable: co_await 时才发起，完成后在 I/O 线程 (executor 为空) 或 executor 上恢复。
+/// 失败时 co_await 抛出对应异常
+template <typename T>
+class [[nodiscard]] AsyncOperation
+{
+public:
+    using Completion = std::function<void(T value, std::exception_ptr error)>;
+    using Starter    = std::function<void(Completion complete)>;
+
+    AsyncOperation(Starter start, Executor* executor) : start_(std::move(start)), executor_(executor) {}
+
+    AsyncOperation(const AsyncOperation&) = delete;
+    AsyncOperation& operator=(const AsyncOperation&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+        start_([this, h](T value, std::exception_ptr error) {
+            value_.emplace(std::move(value));
+            error_ = error;
+            // 先到者让位: 若 await_suspend 尚未返回，由它决定如何恢复
+            if (completed_.exchange(true, std::memory_order_acq_rel)) resume(h);
+        });
+        if (!completed_.exchange(true, std::memory_order_acq_rel)) return true;
+        // 发起过程中已同步完成
+        if (!executor_) return false;
+        resume(h);
+        return true;
+    }
+
+    T await_resume()
+    {
+        if (error_) std::rethrow_exception(error_);
+        return std::move(*value_);
+    }
+
+private:
+    Starter            start_;
+    Executor*          executor_ = nullptr;
+    std::atomic<bool>  completed_{false};
+    std::optional<T>   value_;
+    std::exception_ptr error_;
+
+    void resume(std::coroutine_handle<> h)
+    {
+        if (executor_) executor_->post([h]() { h.resume(); });
+        else h.resume();
+    }
+};
+
+/// SSE 异步事件流: while (auto ev = co_await stream.next()) { ... }
+/// 销毁或 close() 时断开连接。next() 同一时间只能有一个等待者
+class SseStream
+{
+public:
+    struct State
+    {
+        std::mutex              mu;
+        std::deque<SseEvent>    events;
+        bool                    finished = false;
+        std::exception_ptr      error;
+        std::coroutine_handle<> waiter;
+        Executor*               executor = nullptr;
+        CancelToken             cancel;
+
+        /// 由 I/O 线程调用: 追加事件或结束流，唤醒等待中的 next()
+        void push(SseEvent* event, bool finish, std::exception_ptr err)
+        {
+            std::coroutine_handle<> h;
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                if (finished) return;
+                if (event) events.push_back(std::move(*event));
+                if (finish) {
+                    finished = true;
+                    error = err;
+                }
+                h = std::exchange(waiter, {});
+            }
+            wake(h);
+        }
+
+        /// 由 close() 调用: 丢弃未取出的事件并结束流；挂起中的 next() 随即返回 std::nullopt
+        void close()
+        {
+            std::coroutine_handle<> h;
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                events.clear();
+                finished = true;
+                error = nullptr;
+                h = std::exchange(waiter, {});
+            }
+            wake(h);
+        }
+
+        void wake(std::coroutine_handle<> h)
+        {
+            if (!h) return;
+            if (executor) executor->post([h]() { h.resume(); });
+            else h.resume();
+        }
+    };
+
+    explicit SseStream(std::shared_ptr<State> state) : state_(std::move(state)) {}
+    SseStream(SseStream&&) noexcept = default;
+    SseStream& operator=(SseStream&& other) noexcept
+    {
+        if (this != &other) {
+            close();
+            state_ = std::move(other.state_);
+        }
+        return *this;
+    }
+    ~SseStream() { close(); }
+
+    /// 等待下一个事件。连接正常结束或已 close() 时返回 std::nullopt；连接出错时抛出
+    auto next()
+    {
+        struct Awaiter
+        {
+            std::shared_ptr<State> state;   // 等待期间 SseStream 可能被另一线程 close() 或销毁
+            bool await_ready()
+            {
+                std::lock_guard<std::mutex> lock(state->mu);
+                return !state->events.empty() || state->finished;
+            }
+            bool await_suspend(std::coroutine_handle<> h)
+            {
+                std::lock_guard<std::mutex> lock(state->mu);
+                if (!state->events.empty() || state->finished) return false;
+                state->waiter = h;
+                return true;
+            }
+            std::optional<SseEvent> await_resume()
+            {
+                std::lock_guard<std::mutex> lock(state->mu);
+                if (!state->events.empty()) {
+                    SseEvent ev = std::move(state->events.front());
+                    state->events.pop_front();
+                    return ev;
+                }
+                if (state->error) std::rethrow_exception(state->error);
+                return std::nullopt;
+            }
+        };
+        if (!state_) throw std::runtime_error("SseStream is empty");
+        return Awaiter{ state_ };
+    }
+
+    /// 断开连接并丢弃尚未取出的事件，之后 next() 返回 std::nullopt
+    void close()
+    {
+        if (!state_) return;
+        state_->cancel.cancel();
+        state_->close();
+    }
+
+private:
+    std::shared_ptr<State> state_;
+};
+
+#endif // DRX_HTTP_HAS_COROUTINES
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  请求体来源
+// ═══════════════════════════════════════════════════════════════════════════
+
+/// send / post / put 的流式请求体: 文件区间或内存，可用 then() 依次拼接。
+/// 文件内容在发送时才读取 —— Linux 明文 HTTP 经 sendfile 由内核直接发送，
+/// TLS 与 WinHTTP 下映射为只读内存后发送，都不经过 istream 复制。可复制，副本共享内存段
+class BodySource
+{
+public:
+    static constexpr uint64_t npos = UINT64_MAX;
+
+    /// 文件 [offset, offset + length)，length 为 npos 时取到文件末尾；文件不存在或区间越界时抛出
+    static BodySource fromFile(const std::string& path, uint64_t offset = 0, uint64_t length = npos)
+    {
+        return BodySource(detail::BodySegment::file(path, offset, length));
+    }
+
+    /// 引用调用方内存 (不复制)，请求完成前必须保持有效
+    static BodySource fromMemory(const void* data, size_t size)
+    {
+        return BodySource(detail::BodySegment::borrowed(data, size));
+    }
+
+    /// 持有一份字节串
+    static BodySource fromString(std::string bytes)
+    {
+        return BodySource(detail::BodySegment::memory(std::move(bytes)));
+    }
+
+    /// 在末尾追加另一个来源
+    BodySource& then(const BodySource& next)
+    {
+        segments_.insert(segments_.end(), next.segments_.begin(), next.segments_.end());
+        size_ += next.size_;
+        return *this;
+    }
+
+    uint64_t size() const { return size_; }
+
+private:
+    friend class DrxHttpClient;
+
+    explicit BodySource(detail::BodySegment segment) : size_(segment.length)
+    {
+        segments_.push_back(std::move(segment));
+    }
+
+    std::vector<detail::BodySegment> segments_;
+    uint64_t                         size_ = 0;
+};
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  流式响应
+// ═══════════════════════════════════════════════════════════════════════════
+
+/// BodyReader::chunks() 产出的一段 body，指向读取器内部缓冲，迭代到下一块后失效
+struct BodyChunk
+{
+    const uint8_t* data = nullptr;
+    size_t         size = 0;
+
+    std::string_view view() const { return std::string_view(reinterpret_cast<const char*>(data), size); }
+};
+
+/// sendStreaming 返回的响应体读取器 (只能移动，不得比创建它的客户端存活更久)。
+/// body 读完时连接归还连接池；未读完就销毁或 close() 时关闭连接
+class BodyReader
+{
+public:
+    BodyReader() = default;
+    BodyReader(BodyReader&&) noexcept = default;
+    BodyReader& operator=(BodyReader&&) noexcept = default;
+    BodyReader(const BodyReader&) = delete;
+    BodyReader& operator=(const BodyReader&) = delete;
+
+    /// 读取至多 size 字节，阻塞到有数据；返回 0 表示 body 已结束。
+    /// 超时、连接错误或取消时抛出 std::runtime_error，此后读取器处于结束状态
+    size_t read(void* buffer, size_t size)
+    {
+        if (!exchange_ || size == 0) return 0;
+        if (cancel_.isCancelled()) {
+            exchange_.reset();
+            throw std::runtime_error("Request cancelled");
+        }
+        size_t n = 0;
+        try {
+            n = decoder_ ? decoder_->read(*exchange_, buffer, size) : exchange_->read(buffer, size);
+        } catch (...) {
+            exchange_.reset();
+            throw;
+        }
+        if (n == 0) {
+            exchange_.reset();
+            if (counters_) counters_->add(compression());
+        }
+        bytesRead_ += n;
+        return n;
+    }
+
+#if defined(DRX_HTTP_HAS_SPAN)
+    size_t read(std::span<uint8_t> buffer) { return read(buffer.data(), buffer.size()); }
+#endif
+
+    /// 读取剩余的全部 body
+    std::vector<uint8_t> readAll()
+    {
+        std::vector<uint8_t> out;
+        size_t size = 0;
+        while (true) {
+            out.resize(size + 64 * 1024);
+            size_t n = read(out.data() + size, out.size() - size);
+            if (n == 0) break;
+            size += n;
+        }
+        out.resize(size);
+        return out;
+    }
+
+    /// 已读到结束 (read 返回 0)、出错或已关闭
+    bool done() const { return !exchange_; }
+
+    /// 已读出的 body 字节数 (已解压时为解压后的字节)
+    uint64_t bytesRead() const { return bytesRead_; }
+
+    /// 请求体压缩与响应解压统计，解压部分随读取累积
+    CompressionInfo compression() const
+    {
+        CompressionInfo info = compression_;
+        if (decoder_) {
+            const auto& decoded = decoder_->info();
+            info.encoding          = decoded.encoding;
+            info.compressedBytes   = decoded.compressedBytes;
+            info.decompressedBytes = decoded.decompressedBytes;
+            info.decodeCpuMs       = decoded.decodeCpuMs;
+        }
+        return info;
+    }
+
+    /// 放弃剩余 body 并关闭连接
+    void close() { exchange_.reset(); }
+
+    /// 逐块迭代: for (BodyChunk chunk : reader.chunks()) { ... }
+    class ChunkIterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type        = BodyChunk;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const BodyChunk*;
+        using reference         = const BodyChunk&;
+
+        ChunkIterator() = default;
+        explicit ChunkIterator(BodyReader* reader) : reader_(reader) { advance(); }
+
+        reference operator*() const { return chunk_; }
+        pointer operator->() const { return &chunk_; }
+        ChunkIterator& operator++() { advance(); return *this; }
+        bool operator==(const ChunkIterator& o) const { return reader_ == o.reader_; }
+        bool operator!=(const ChunkIterator& o) const { return reader_ != o.reader_; }
+
+    private:
+        void advance()
+        {
+            size_t n = reader_->read(reader_->chunkBuffer_.get(), reader_->chunkSize_);
+            if (n == 0) reader_ = nullptr;
+            else chunk_ = BodyChunk{ reader_->chunkBuffer_.get(), n };
+        }
+
+        BodyReader* reader_ = nullptr;
+        BodyChunk   chunk_;
+    };
+
+    struct ChunkRange
+    {
+        BodyReader* reader;
+        ChunkIterator begin() const { return ChunkIterator(reader); }
+        ChunkIterator end() const { return ChunkIterator(); }
+    };
+
+    /// 以 chunkSize 为单块上限逐块读取 (块缓冲由读取器持有，迭代期间不得移动读取器)
+    ChunkRange chunks(size_t chunkSize = 64 * 1024)
+    {
+        chunkSize = std::max<size_t>(chunkSize, 1);
+        if (chunkSize_ != chunkSize) {
+            chunkBuffer_.reset(new uint8_t[chunkSize]);
+            chunkSize_ = chunkSize;
+        }
+        return ChunkRange{ this };
+    }
+
+private:
+    friend class DrxHttpClient;
+
+    BodyReader(std::unique_ptr<detail::HttpExchange> exchange, const CancelToken* cancel,
+               std::unique_ptr<detail::ResponseDecoder> decoder = nullptr,
+               const CompressionInfo& compression = {}, detail::CompressionCounters* counters = nullptr)
+        : exchange_(std::move(exchange)), decoder_(std::move(decoder)), compression_(compression), counters_(counters)
+    {
+        if (cancel) cancel_ = *cancel;
+    }
+
+    std::unique_ptr<detail::HttpExchange>    exchange_;
+    std::unique_ptr<detail::ResponseDecoder> decoder_;       ///< 响应已压缩时边读边解压
+    CompressionInfo                          compression_;   ///< 请求体压缩部分
+    detail::CompressionCounters*             counters_ = nullptr;
+    CancelToken                              cancel_;
+    std::unique_ptr<uint8_t[]>            chunkBuffer_;
+    size_t                                chunkSize_ = 0;
+    uint64_t                              bytesRead_ = 0;
+};
+
+/// sendStreaming 的结果: 响应头已就绪，body 由 body 读取器按需拉取
+struct StreamingResponse
+{
+    int         statusCode = 0;
+    std::string reasonPhrase;
+    Headers     headers;
+    BodyReader  body;
+
+    bool ok() const { return statusCode >= 200 && statusCode < 300; }
+};
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  DrxHttpClient
+// ═══════════════════════════════════════════════════════════════════════════
+
+class DrxHttpClient
+{
+public:
+    // ──────────────────────────── 构造 / 析构 ────────────────────────────
+
+    DrxHttpClient()
+    {
+        init_session();
+    }
+
+    explicit DrxHttpClient(const std::string& baseAddress)
+        : baseAddress_(baseAddress)
+    {
+        init_session();
+    }
+
+    ~DrxHttpClient()
+    {
+        stop_queue();
+        stop_async();
+        // session_ 由 RAII 自动关闭
+    }
+
+    // 不可复制，不可移动（队列线程绑定了 this）
+    DrxHttpClient(const DrxHttpClient&) = delete;
+    DrxHttpClient& operator=(const DrxHttpClient&) = delete;
+    DrxHttpClient(DrxHttpClient&&) = delete;
+    DrxHttpClient& operator=(DrxHttpClient&&) = delete;
+
+    // ──────────────────────────── 日志 ──────────────────────────────────
+
+    /// 设置日志回调
+    void setLogCallback(LogCallback cb)
+    {
+        config_.update([&](Config& cfg) { cfg.logCallback = std::move(cb); });
+    }
+
+    // ──────────────────────────── 属性 (线程安全) ───────────────────────
+
+    void setAutoManageCookies(bool v) { autoManageCookies_.store(v); }
+    bool getAutoManageCookies() const { return autoManageCookies_.load(); }
 
     void setIgnoreSslErrors(bool v) { ignoreSslErrors_.store(v); }
     bool getIgnoreSslErrors() const { return ignoreSslErrors_.load(); }
 
     void setSessionCookieName(const std::string& name)
     {
-        std::lock_guard<std::mutex> lock(mu_);
-        sessionCookieName_ = name;
-    }
-    std::string getSessionCookieName() const
-    {
-        std::lock_guard<std::mutex> lock(mu_);
-        return sessionCookieName_;
+        config_.update([&](Config& cfg) { cfg.sessionCookieName = name; });
     }
+    std::string getSessionCookieName() const { return config()->sessionCookieName; }
 
     void setSessionHeaderName(const std::string& name)
     {
-        std::lock_guard<std::mutex> lock(mu_);
-        sessionHeaderName_ = name;
-    }
-    std::string getSessionHeaderName() const
-    {
-        std::lock_guard<std::mutex> lock(mu_);
-        return sessionHeaderName_;
+        config_.update([&](Config& cfg) { cfg.sessionHeaderName = name; });
     }
+    std::string getSessionHeaderName() const { return config()->sessionHeaderName; }
 
     // 兼容旧代码：public 字段已移除，改用 get/set 方法。
     // 如需快速迁移可用宏，但推荐使用 get/set。
@@ -848,22 +11197,27 @@ public:
     /// 设置默认请求头
     void setDefaultHeader(const std::string& name, const std::string& value)
     {
-        std::lock_guard<std::mutex> lock(mu_);
-        defaultHeaders_[name] = detail::ensure_ascii_header(value);
+        auto encoded = detail::ensure_ascii_header(value);
+        config_.update([&](Config& cfg) {
+            cfg.defaultHeaders.set(name, encoded);
+            reencode_default_headers(cfg);
+        });
         log(LogLevel::Debug, "Set default header: " + name);
     }
 
     /// 移除默认请求头
     void removeDefaultHeader(const std::string& name)
     {
-        std::lock_guard<std::mutex> lock(mu_);
-        defaultHeaders_.erase(name);
+        config_.update([&](Config& cfg) {
+            cfg.defaultHeaders.erase(name);
+            reencode_default_headers(cfg);
+        });
     }
 
     /// 设置超时 (毫秒)
     void setTimeout(int timeoutMs)
     {
-        timeoutMs_.store(timeoutMs);
+        config_.update([&](Config& cfg) { cfg.timeoutMs = timeoutMs; });
         log(LogLevel::Debug, "Timeout set to " + std::to_string(timeoutMs) + "ms");
     }
 
@@ -876,8 +11230,7 @@ public:
     /// 设置重试策略
     void setRetryPolicy(const RetryPolicy& policy)
     {
-        std::lock_guard<std::mutex> lock(mu_);
-        retryPolicy_ = policy;
+        config_.update([&](Config& cfg) { cfg.retryPolicy = policy; });
     }
 
     void setRetryPolicy(int maxRetries, int baseDelayMs = 500, bool exponentialBackoff = true)
@@ -893,15 +11246,97 @@ public:
     void setProxy(const std::string& proxyUrl)
     {
         if (proxyUrl.empty()) return;
-        auto wProxy = detail::to_wide(proxyUrl);
-        WINHTTP_PROXY_INFO proxyInfo;
-        proxyInfo.dwAccessType = WINHTTP_ACCESS_TYPE_NAMED_PROXY;
-        proxyInfo.lpszProxy = const_cast<LPWSTR>(wProxy.c_str());
-        proxyInfo.lpszProxyBypass = WINHTTP_NO_PROXY_BYPASS;
-        WinHttpSetOption(hSession_.get(), WINHTTP_OPTION_PROXY, &proxyInfo, sizeof(proxyInfo));
+        session_.setProxy(proxyUrl);
         log(LogLevel::Info, "Proxy set to: " + proxyUrl);
     }
 
+    // ──────────────────────────── 连接池 ────────────────────────────────
+
+    /// 设置连接池参数 (空闲上限、每主机上限、空闲超时)
+    void setConnectionPoolOptions(const ConnectionPoolOptions& options)
+    {
+        session_.setPoolOptions(options);
+        log(LogLevel::Debug, "Connection pool: maxIdlePerHost=" + std::to_string(options.maxIdlePerHost) +
+                             " maxConnectionsPerHost=" + std::to_string(options.maxConnectionsPerHost) +
+                             " idleTimeoutMs=" + std::to_string(options.idleTimeoutMs));
+    }
+
+    ConnectionPoolOptions getConnectionPoolOptions() const { return session_.poolOptions(); }
+
+    /// 连接池命中 / 未命中 / 淘汰计数与当前连接数
+    ConnectionPoolStats getConnectionPoolStats() const { return session_.poolStats(); }
+
+    /// 关闭所有空闲连接
+    void clearConnectionPool() { session_.clearPool(); }
+
+    // ──────────────────────────── HTTP 版本 ────────────────────────────────
+
+    /// 设置请求使用的 HTTP 版本 (默认 HTTP/1.1)。
+    /// Windows 下交给 WinHTTP 自带的 HTTP/2 (仅 https，经 ALPN 协商)；
+    /// Linux 下由内置的 h2 帧层处理，Http2PriorKnowledge 时 http:// 也以 h2c 发送。
+    void setHttpVersion(HttpVersion version)
+    {
+        session_.setHttpVersion(version);
+        log(LogLevel::Debug, std::string("HTTP version: ") +
+            (version == HttpVersion::Http1_1 ? "HTTP/1.1" : version == HttpVersion::Http2 ? "HTTP/2" : "HTTP/2 (prior knowledge)"));
+    }
+
+    HttpVersion getHttpVersion() const { return session_.httpVersion(); }
+
+    // ──────────────────────────── 请求合并 ────────────────────────────────
+
+    /// 开启后，并发的相同 GET / HEAD (方法 + 完整 URL + varyHeaders 中各头的值相同) 只发出一次请求
+    void setCoalescingOptions(const CoalescingOptions& options)
+    {
+        config_.update([&](Config& cfg) { cfg.coalescing = options; });
+    }
+
+    CoalescingOptions getCoalescingOptions() const { return config()->coalescing; }
+
+    CoalescingStats getCoalescingStats() const
+    {
+        CoalescingStats stats;
+        stats.leaders   = coalesceLeaders_.load();
+        stats.coalesced = coalesceHits_.load();
+        std::lock_guard<std::mutex> lock(flightsMu_);
+        stats.inFlight = flights_.size();
+        return stats;
+    }
+
+    // ──────────────────────────── 内容编码 ────────────────────────────────
+
+    /// 响应解压 (默认开启，只在编译时启用了编解码器时生效) 与请求体压缩 (默认关闭)。
+    /// 用户自行设置 Accept-Encoding 时不再自动解压，body 原样返回
+    void setCompressionOptions(const CompressionOptions& options)
+    {
+        config_.update([&](Config& cfg) { cfg.compression = options; });
+    }
+
+    CompressionOptions getCompressionOptions() const { return config()->compression; }
+
+    /// 全部请求累计的压缩前后字节与编解码 CPU 时间 (单个响应见 HttpResponse::compression)
+    CompressionStats getCompressionStats() const { return compressionCounters_.snapshot(); }
+
+    // ──────────────────────────── 响应缓存 ────────────────────────────────
+
+    /// 开启后 GET 按 Cache-Control / Expires / Vary 缓存，过期条目自动以 If-None-Match /
+    /// If-Modified-Since 验证，304 时返回缓存的响应体。diskPath 变化时重新扫描该目录
+    void setCacheOptions(const HttpCacheOptions& options) { cache_.configure(options); }
+    HttpCacheOptions getCacheOptions() const { return cache_.options(); }
+
+    /// 命中率、节省字节数与内存 / 磁盘占用
+    HttpCacheStats getCacheStats() const { return cache_.stats(); }
+
+    /// 清空内存与磁盘缓存
+    void clearCache() { cache_.clear(); }
+
+    /// 移除 url 的缓存 (全部 Vary 变体)
+    void invalidateCache(const std::string& url, const QueryParams& query = {})
+    {
+        auto parts = detail::parse_url(detail::resolve_url(baseAddress_, detail::build_url(url, query)));
+        cache_.remove("GET " + detail::url_identity(parts));
+    }
+
     // ══════════════════════════════════════════════════════════════════════
     //  便捷请求方法
     // ══════════════════════════════════════════════════════════════════════
@@ -940,6 +11375,16 @@ public:
         return send("POST", url, "", bodyBytes, headers, query, cancel);
     }
 
+    HttpResponse post(const std::string& url,
+                      const BodySource& body,
+                      const Headers& headers = {},
+                      const QueryParams& query = {},
+                      CancelToken* cancel = nullptr,
+                      ProgressCallback progress = nullptr)
+    {
+        return send("POST", url, body, headers, query, cancel, progress);
+    }
+
     HttpResponse put(const std::string& url,
                      const std::string& body = "",
                      const Headers& headers = {},
@@ -958,6 +11403,16 @@ public:
         return send("PUT", url, "", bodyBytes, headers, query, cancel);
     }
 
+    HttpResponse put(const std::string& url,
+                     const BodySource& body,
+                     const Headers& headers = {},
+                     const QueryParams& query = {},
+                     CancelToken* cancel = nullptr,
+                     ProgressCallback progress = nullptr)
+    {
+        return send("PUT", url, body, headers, query, cancel, progress);
+    }
+
     HttpResponse del(const std::string& url,
                      const Headers& headers = {},
                      const QueryParams& query = {},
@@ -987,11 +11442,97 @@ public:
                       const QueryParams& query = {},
                       CancelToken* cancel = nullptr)
     {
-        RetryPolicy policy;
-        {
-            std::lock_guard<std::mutex> lock(mu_);
-            policy = retryPolicy_;
-        }
+        // 经响应缓存或请求合并的 GET / HEAD 得到共享的响应，按值返回需复制一份
+        if (body.empty() && bodyBytes.empty() && (cacheable(method) || coalescable(method)))
+            return *send_shared(method, url, headers, query, cancel);
+        auto resp = send_with_retry(method, url, body, bodyBytes, headers, query, cancel);
+        invalidate_after(method, url, query, resp.statusCode);
+        return resp;
+    }
+
+    HttpResponse send(const HttpRequest& req, CancelToken* cancel = nullptr)
+    {
+        return send(req.method, req.url, req.body, req.bodyBytes, req.headers, req.query, cancel);
+    }
+
+    /// 以 BodySource 为请求体发送: body 按块发出，不整体读入内存 (Content-Type 默认 application/octet-stream)。
+    /// progress 在数据真正写出后回调；重试时 body 从头重发
+    HttpResponse send(const std::string& method,
+                      const std::string& url,
+                      const BodySource& body,
+                      const Headers& headers = {},
+                      const QueryParams& query = {},
+                      CancelToken* cancel = nullptr,
+                      ProgressCallback progress = nullptr)
+    {
+        Headers sendHeaders = headers;
+        if (detail::get_header_ci(headers, "Content-Type").empty())
+            sendHeaders["Content-Type"] = "application/octet-stream";
+        detail::BodyStream stream(body.segments_);
+        return send_body_stream(method, url, stream, sendHeaders, query, progress, cancel);
+    }
+
+    /// 与 send() 相同，但返回共享的只读响应: 开启请求合并时，并发的相同 GET / HEAD
+    /// 调用拿到的是同一个对象；开启响应缓存时，命中的 GET 直接返回缓存中的对象。body 均不复制
+    std::shared_ptr<const HttpResponse> sendShared(const std::string& method,
+                                                   const std::string& url,
+                                                   const Headers& headers = {},
+                                                   const QueryParams& query = {},
+                                                   CancelToken* cancel = nullptr)
+    {
+        auto resp = send_shared(method, url, headers, query, cancel);
+        invalidate_after(method, url, query, resp->statusCode);
+        return resp;
+    }
+
+    std::shared_ptr<const HttpResponse> getShared(const std::string& url,
+                                                  const Headers& headers = {},
+                                                  const QueryParams& query = {},
+                                                  CancelToken* cancel = nullptr)
+    {
+        return sendShared("GET", url, headers, query, cancel);
+    }
+
+    /// 与 send() 相同，但结果写入调用方的 response，并复用其 bodyBytes 已有的容量:
+    /// 热路径上循环使用同一个 HttpResponse 时，容量足够后读取响应体不再分配内存。
+    /// 不经过响应缓存与请求合并；失败时 response 的内容与容量均不保留
+    HttpResponse& sendInto(HttpResponse& response,
+                           const std::string& method,
+                           const std::string& url,
+                           const std::string& body = "",
+                           const std::vector<uint8_t>& bodyBytes = {},
+                           const Headers& headers = {},
+                           const QueryParams& query = {},
+                           CancelToken* cancel = nullptr)
+    {
+        auto storage = std::move(response.bodyBytes);
+        response = send_with_retry(method, url, body, bodyBytes, headers, query, cancel, std::move(storage));
+        invalidate_after(method, url, query, response.statusCode);
+        return response;
+    }
+
+    HttpResponse& getInto(HttpResponse& response,
+                          const std::string& url,
+                          const Headers& headers = {},
+                          const QueryParams& query = {},
+                          CancelToken* cancel = nullptr)
+    {
+        return sendInto(response, "GET", url, "", {}, headers, query, cancel);
+    }
+
+private:
+    HttpResponse send_with_retry(const std::string& method,
+                                 const std::string& url,
+                                 const std::string& body,
+                                 const std::vector<uint8_t>& bodyBytes,
+                                 const Headers& headers,
+                                 const QueryParams& query,
+                                 CancelToken* cancel,
+                                 std::vector<uint8_t> bodyStorage = {},
+                                 detail::BodyStream* bodyStream = nullptr)
+    {
+        auto cfg = config();
+        const RetryPolicy& policy = cfg->retryPolicy;
 
         int attempt = 0;
         while (true) {
@@ -999,13 +11540,14 @@ public:
                 throw std::runtime_error("Request cancelled");
 
             try {
-                auto resp = send_internal(method, url, body, bodyBytes, headers, query, cancel);
+                auto resp = send_internal(*cfg, method, url, body, bodyBytes, headers, query, cancel, bodyStorage, bodyStream);
 
                 // 检查是否需要重试
                 if (attempt < policy.maxRetries && policy.shouldRetry && policy.shouldRetry(resp.statusCode)) {
+                    bodyStorage = std::move(resp.bodyBytes);
                     int delay = policy.baseDelayMs;
                     if (policy.exponentialBackoff) delay *= (1 << attempt);
-                    log(LogLevel::Warn, "Retrying [" + std::to_string(attempt + 1) + "/" + std::to_string(policy.maxRetries)
+                    log(*cfg, LogLevel::Warn, "Retrying [" + std::to_string(attempt + 1) + "/" + std::to_string(policy.maxRetries)
                                         + "] after " + std::to_string(delay) + "ms, status=" + std::to_string(resp.statusCode));
                     std::this_thread::sleep_for(std::chrono::milliseconds(delay));
                     ++attempt;
@@ -1016,7 +11558,7 @@ public:
                 if (attempt < policy.maxRetries) {
                     int delay = policy.baseDelayMs;
                     if (policy.exponentialBackoff) delay *= (1 << attempt);
-                    log(LogLevel::Warn, "Retrying [" + std::to_string(attempt + 1) + "/" + std::to_string(policy.maxRetries)
+                    log(*cfg, LogLevel::Warn, "Retrying [" + std::to_string(attempt + 1) + "/" + std::to_string(policy.maxRetries)
                                         + "] after " + std::to_string(delay) + "ms, error: " + ex.what());
                     std::this_thread::sleep_for(std::chrono::milliseconds(delay));
                     ++attempt;
@@ -1027,15 +11569,282 @@ public:
         }
     }
 
-    HttpResponse send(const HttpRequest& req, CancelToken* cancel = nullptr)
+public:
+
+    // ══════════════════════════════════════════════════════════════════════
+    //  流式响应 (按需拉取 body)
+    // ══════════════════════════════════════════════════════════════════════
+
+    /// 发出请求，收到响应头后立即返回，body 由 StreamingResponse::body 按需读取，内存占用与 body 大小无关。
+    /// 重试策略只作用于拿到响应头之前 (连接错误与可重试状态码)；不经过响应缓存与请求合并。
+    /// cancel 在读取 body 期间同样生效
+    StreamingResponse sendStreaming(const std::string& method,
+                                    const std::string& url,
+                                    const std::string& body = "",
+                                    const std::vector<uint8_t>& bodyBytes = {},
+                                    const Headers& headers = {},
+                                    const QueryParams& query = {},
+                                    CancelToken* cancel = nullptr)
     {
-        return send(req.method, req.url, req.body, req.bodyBytes, req.headers, req.query, cancel);
+        auto cfg = config();
+        const RetryPolicy& policy = cfg->retryPolicy;
+
+        int attempt = 0;
+        while (true) {
+            if (cancel && cancel->isCancelled())
+                throw std::runtime_error("Request cancelled");
+
+            std::string retryReason;
+            try {
+                auto spec = make_request_spec(*cfg, method, url, body, bodyBytes, headers, query);
+                auto exchange = std::make_unique<detail::HttpExchange>(session_);
+                exchange->open(spec);
+
+                if (autoManageCookies_.load())
+                    parse_set_cookies(exchange->headers(), spec.url);
+
+                int status = exchange->statusCode();
+                if (!(attempt < policy.maxRetries && policy.shouldRetry && policy.shouldRetry(status))) {
+                    log(*cfg, LogLevel::Debug, "Response: " + std::to_string(status) + " " + exchange->reasonPhrase() + " (streaming)");
+                    invalidate_after(method, spec.url, status);
+                    auto head = make_response(status, exchange->reasonPhrase(), exchange->headers(), {});
+                    auto decoder = detail::ResponseDecoder::create(spec, status, exchange->headers());
+                    if (decoder) detail::strip_content_coding_headers(head.headers);
+                    StreamingResponse resp;
+                    resp.statusCode   = status;
+                    resp.reasonPhrase = std::move(head.reasonPhrase);
+                    resp.headers      = std::move(head.headers);
+                    resp.body         = BodyReader(std::move(exchange), cancel, std::move(decoder), spec.compression,
+                                                   &compressionCounters_);
+                    return resp;
+                }
+                retryReason = "status=" + std::to_string(status);
+            } catch (const std::runtime_error& ex) {
+                if (attempt >= policy.maxRetries) throw;
+                retryReason = std::string("error: ") + ex.what();
+            }
+
+            int delay = policy.baseDelayMs;
+            if (policy.exponentialBackoff) delay *= (1 << attempt);
+            log(LogLevel::Warn, "Retrying [" + std::to_string(attempt + 1) + "/" + std::to_string(policy.maxRetries)
+                                + "] after " + std::to_string(delay) + "ms, " + retryReason);
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+            ++attempt;
+        }
+    }
+
+    StreamingResponse getStreaming(const std::string& url,
+                                   const Headers& headers = {},
+                                   const QueryParams& query = {},
+                                   CancelToken* cancel = nullptr)
+    {
+        return sendStreaming("GET", url, "", {}, headers, query, cancel);
     }
 
+    // ══════════════════════════════════════════════════════════════════════
+    //  异步请求 (事件驱动，不占用调用线程)
+    // ══════════════════════════════════════════════════════════════════════
+
+    /// 完成回调: 成功时 error 为空；失败 (含取消) 时 response 无意义
+    using ResponseCallback = std::function<void(HttpResponse response, std::exception_ptr error)>;
+
+    /// 异步发送，返回的 future 在完成时就绪 (失败时 get() 抛出)。重试策略与 send() 相同
+    std::future<HttpResponse> sendAsync(const HttpRequest& req, CancelToken* cancel = nullptr)
+    {
+        auto promise = std::make_shared<std::promise<HttpResponse>>();
+        auto future = promise->get_future();
+        sendAsync(req, [promise](HttpResponse resp, std::exception_ptr error) {
+            if (error) promise->set_exception(error);
+            else promise->set_value(std::move(resp));
+        }, cancel);
+        return future;
+    }
+
+    /// 异步发送，完成时调用 callback (Windows: WinHTTP 回调线程；Linux: 事件循环线程)。
+    /// callback 中不应执行阻塞操作，也不应销毁本客户端。
+    void sendAsync(const HttpRequest& req, ResponseCallback callback, CancelToken* cancel = nullptr)
+    {
+        auto state = make_async_state(req, cancel ? *cancel : CancelToken());
+        state->callback = std::move(callback);
+
+        if (state->cancel.isCancelled()) {
+            deliver_async(*state, HttpResponse(), std::make_exception_ptr(std::runtime_error("Request cancelled")));
+            return;
+        }
+        submit_async(state, 0);
+    }
+
+    // ══════════════════════════════════════════════════════════════════════
+    //  批量请求
+    // ══════════════════════════════════════════════════════════════════════
+
+    /// 批量发送并等待全部完成，结果与 requests 一一对应 (提交顺序)。
+    /// 请求按 origin (scheme + host + port) 分组，每组最多 connectionsPerOrigin 个请求同时在途，
+    /// 一个完成后同组下一个立即复用其 keep-alive 连接。整批共享一个截止时间与取消令牌；
+    /// 单项失败不影响其他项，错误记录在 BatchResult::error
+    std::vector<BatchResult> sendBatch(const std::vector<HttpRequest>& requests,
+                                       CancelToken* cancel = nullptr,
+                                       const BatchOptions& options = {})
+    {
+        using Clock = std::chrono::steady_clock;
+        auto batch = std::make_shared<BatchState>();
+        batch->results.resize(requests.size());
+        batch->remaining = requests.size();
+        if (options.timeoutMs > 0) batch->deadline = Clock::now() + std::chrono::milliseconds(options.timeoutMs);
+
+        // URL 只解析一次: 规格在这里生成，分组与发送共用
+        std::map<std::string, size_t> originIndex;
+        batch->states.reserve(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            std::shared_ptr<AsyncState> state;
+            try {
+                state = make_async_state(requests[i], batch->cancel);
+            } catch (const std::exception& ex) {
+                // 生成规格时的异常 (如请求体压缩失败) 只记入该项，不影响其他项
+                batch->results[i].error = ex.what();
+                batch->remaining--;
+                batch->states.emplace_back();
+                continue;
+            }
+            const auto& url = state->spec.url;
+            auto origin = (url.isHttps ? "https://" : "http://") + url.host + ":" + std::to_string(url.port);
+            auto it = originIndex.find(origin);
+            if (it == originIndex.end()) {
+                it = originIndex.emplace(origin, batch->origins.size()).first;
+                batch->origins.emplace_back();
+            }
+            batch->origins[it->second].push_back(i);
+            batch->states.push_back(std::move(state));
+        }
+        log(LogLevel::Debug, "Batch: " + std::to_string(requests.size()) + " requests, "
+                             + std::to_string(batch->origins.size()) + " origins");
+
+        // 车道数不超过连接池上限: 超出 maxIdlePerHost 的连接归还时会被关闭，反而反复建连
+        size_t lanes = std::max<size_t>(options.connectionsPerOrigin, 1);
+        auto pool = session_.poolOptions();
+        if (pool.enabled) {
+            lanes = std::min(lanes, std::max<size_t>(pool.maxIdlePerHost, 1));
+            if (pool.maxConnectionsPerHost > 0) lanes = std::min(lanes, pool.maxConnectionsPerHost);
+        }
+        for (size_t o = 0; o < batch->origins.size(); ++o) {
+            for (size_t lane = 0; lane < lanes; ++lane) launch_batch(batch, o);
+        }
+
+        // 等待全部完成；期间把调用方取消与截止时间转为批内取消 (在途请求随之结束)
+        std::unique_lock<std::mutex> lock(batch->mu);
+        while (batch->remaining > 0) {
+            batch->cv.wait_for(lock, std::chrono::milliseconds(20));
+            if (batch->cancel.isCancelled()) continue;
+            if (cancel && cancel->isCancelled()) {
+                batch->cancel.cancel();
+            } else if (batch->deadline != Clock::time_point::max() && Clock::now() >= batch->deadline) {
+                batch->deadlineHit = true;
+                batch->cancel.cancel();
+            }
+        }
+        return std::move(batch->results);
+    }
+
+#if defined(DRX_HTTP_HAS_COROUTINES)
+    // ══════════════════════════════════════════════════════════════════════
+    //  协程接口 (C++20)
+    // ══════════════════════════════════════════════════════════════════════
+
+    /// 协程恢复的位置: nullptr (默认) 直接在 I/O 线程上恢复，延迟最低但恢复后的代码不应阻塞；
+    /// 否则投递到该执行器。执行器的生命周期须长于所有在途请求
+    void setExecutor(Executor* executor) { executor_.store(executor); }
+    Executor* getExecutor() const { return executor_.load(); }
+
+    /// co_await client.sendAwait(req) —— 基于 sendAsync，重试策略相同，失败时抛出
+    AsyncOperation<HttpResponse> sendAwait(const HttpRequest& req, CancelToken* cancel = nullptr)
+    {
+        CancelToken token = cancel ? *cancel : CancelToken();
+        return AsyncOperation<HttpResponse>([this, req, token](AsyncOperation<HttpResponse>::Completion complete) mutable {
+            sendAsync(req, std::move(complete), &token);
+        }, executor_.load());
+    }
+
+    AsyncOperation<HttpResponse> getAsync(const std::string& url,
+                                          const Headers& headers = {},
+                                          const QueryParams& query = {},
+                                          CancelToken* cancel = nullptr)
+    {
+        HttpRequest req;
+        req.url = url;
+        req.headers = headers;
+        req.query = query;
+        return sendAwait(req, cancel);
+    }
+
+    /// 异步下载到文件: body 在 I/O 线程上直接写入 destPath.download.tmp，完成后原子替换。
+    /// 与 downloadFileWithMetadata 相同的结果字段 (fileHash 除外，避免在 I/O 线程上重读文件)
+    AsyncOperation<DownloadResult> downloadFileAsync(const std::string& url,
+                                                     const std::string& destPath,
+                                                     const Headers& headers = {},
+                                                     const QueryParams& query = {},
+                                                     ProgressCallback progress = nullptr,
+                                                     CancelToken* cancel = nullptr)
+    {
+        CancelToken token = cancel ? *cancel : CancelToken();
+        return AsyncOperation<DownloadResult>([=, this](AsyncOperation<DownloadResult>::Completion complete) {
+            start_download_async(url, destPath, headers, query, progress, token, std::move(complete));
+        }, executor_.load());
+    }
+
+    /// SSE 异步事件流，连接立即发起:
+    ///   auto stream = client.connectSseAsync("/events");
+    ///   while (auto ev = co_await stream.next()) { ... }
+    SseStream connectSseAsync(const std::string& url, const Headers& headers = {}, CancelToken* cancel = nullptr)
+    {
+        auto state = std::make_shared<SseStream::State>();
+        state->executor = executor_.load();
+        if (cancel) state->cancel = *cancel;
+
+        auto parts   = detail::parse_url(detail::resolve_url(baseAddress_, url));
+        auto parser  = std::make_shared<detail::SseParser>();
+        auto decoder = std::make_shared<std::unique_ptr<detail::ResponseDecoder>>();
+
+        auto call = std::make_unique<detail::AsyncCall>();
+        call->spec   = sse_spec(parts, headers);
+        call->cancel = state->cancel;
+        call->onHead = [this, url, decoder, spec = call->spec](int statusCode, const detail::HeaderList& head) {
+            *decoder = detail::ResponseDecoder::create(spec, statusCode, head);
+            log(LogLevel::Info, "SSE connected: " + url);
+        };
+        call->onBody = [state, parser, decoder](const char* data, size_t len) {
+            auto deliver = [&](const char* p, size_t n) {
+                parser->feed(p, n, [&](const SseEventView& view) {
+                    SseEvent ev = view.toEvent();
+                    state->push(&ev, false, nullptr);
+                });
+            };
+            if (*decoder) (*decoder)->push(data, len, deliver);
+            else deliver(data, len);
+            if (state->cancel.isCancelled()) throw std::runtime_error("Request cancelled");
+        };
+        call->done = [this, state, url, decoder](detail::AsyncResult&&, std::exception_ptr error) {
+            if (*decoder) compressionCounters_.add((*decoder)->info());
+            // 主动 close() / 取消视为正常结束
+            if (state->cancel.isCancelled()) error = nullptr;
+            log(LogLevel::Info, "SSE disconnected: " + url);
+            state->push(nullptr, true, error);
+        };
+        try {
+            async_engine().submit(std::move(call));
+        } catch (const std::exception&) {
+            state->push(nullptr, true, std::current_exception());
+        }
+        return SseStream(state);
+    }
+#endif
+
     // ══════════════════════════════════════════════════════════════════════
     //  文件上传
     // ══════════════════════════════════════════════════════════════════════
 
+    /// 以 multipart/form-data 上传文件。body 由分隔头、文件内容与结尾分隔符拼成的流按块发出，
+    /// 文件不整体读入内存；Content-Length 预先算出。progress 在数据真正写出后回调
+    /// (current / total 为已发送 / 总 body 字节，含 multipart 分隔部分)
     HttpResponse uploadFile(const std::string& url,
                             const std::string& filePath,
                             const std::string& fieldName = "file",
@@ -1048,13 +11857,20 @@ public:
         if (!fs::exists(filePath))
             throw std::runtime_error("Upload file not found: " + filePath);
 
-        std::ifstream ifs(filePath, std::ios::binary);
-        std::vector<uint8_t> fileData((std::istreambuf_iterator<char>(ifs)),
-                                       std::istreambuf_iterator<char>());
         auto fileName = fs::path(filePath).filename().string();
-        return uploadFile(url, fileData.data(), fileData.size(), fileName, fieldName, headers, query, progress, cancel);
+        auto fileSize = fs::file_size(filePath);
+        auto boundary = detail::generate_boundary();
+
+        detail::BodyStream stream;
+        stream.addMemory(multipart_file_header(boundary, fieldName, fileName));
+        stream.addFile(filePath, 0, fileSize);
+        stream.addMemory("\r\n--" + boundary + "--\r\n");
+
+        log(LogLevel::Info, "Uploading file: " + fileName + " (" + std::to_string(fileSize) + " bytes)");
+        return send_upload(url, boundary, stream, headers, query, progress, cancel);
     }
 
+    /// 上传内存中的数据: data 直接作为流的一段发出，不复制
     HttpResponse uploadFile(const std::string& url,
                             const uint8_t* data, size_t dataSize,
                             const std::string& fileName,
@@ -1065,26 +11881,14 @@ public:
                             CancelToken* cancel = nullptr)
     {
         auto boundary = detail::generate_boundary();
-        std::vector<uint8_t> multipartBody;
-
-        {
-            std::string header = "--" + boundary + "\r\n"
-                + "Content-Disposition: form-data; name=\"" + fieldName + "\"; filename=\"" + fileName + "\"\r\n"
-                + "Content-Type: application/octet-stream\r\n\r\n";
-            multipartBody.insert(multipartBody.end(), header.begin(), header.end());
-        }
-        multipartBody.insert(multipartBody.end(), data, data + dataSize);
-        {
-            std::string tail = "\r\n--" + boundary + "--\r\n";
-            multipartBody.insert(multipartBody.end(), tail.begin(), tail.end());
-        }
 
-        Headers uploadHeaders = headers;
-        uploadHeaders["Content-Type"] = "multipart/form-data; boundary=" + boundary;
+        detail::BodyStream stream;
+        stream.addMemory(multipart_file_header(boundary, fieldName, fileName));
+        stream.addBorrowed(data, dataSize);
+        stream.addMemory("\r\n--" + boundary + "--\r\n");
 
-        if (progress) progress((int64_t)dataSize, (int64_t)dataSize);
         log(LogLevel::Info, "Uploading file: " + fileName + " (" + std::to_string(dataSize) + " bytes)");
-        return send("POST", url, "", multipartBody, uploadHeaders, query, cancel);
+        return send_upload(url, boundary, stream, headers, query, progress, cancel);
     }
 
     HttpResponse uploadFileWithMetadata(const std::string& url,
@@ -1098,42 +11902,66 @@ public:
         if (!fs::exists(filePath))
             throw std::runtime_error("Upload file not found: " + filePath);
 
-        std::ifstream ifs(filePath, std::ios::binary);
-        std::vector<uint8_t> fileData((std::istreambuf_iterator<char>(ifs)),
-                                       std::istreambuf_iterator<char>());
         auto fileName = fs::path(filePath).filename().string();
         auto boundary = detail::generate_boundary();
 
-        std::vector<uint8_t> body;
-        {
-            std::string s = "--" + boundary + "\r\n"
-                + "Content-Disposition: form-data; name=\"file\"; filename=\"" + fileName + "\"\r\n"
-                + "Content-Type: application/octet-stream\r\n\r\n";
-            body.insert(body.end(), s.begin(), s.end());
-        }
-        body.insert(body.end(), fileData.begin(), fileData.end());
-        {
-            std::string s = "\r\n--" + boundary + "\r\n"
-                + "Content-Disposition: form-data; name=\"metadata\"\r\n"
-                + "Content-Type: application/json; charset=utf-8\r\n\r\n"
-                + metadataJson
-                + "\r\n--" + boundary + "--\r\n";
-            body.insert(body.end(), s.begin(), s.end());
-        }
+        detail::BodyStream stream;
+        stream.addMemory(multipart_file_header(boundary, "file", fileName));
+        stream.addFile(filePath, 0, fs::file_size(filePath));
+        stream.addMemory("\r\n--" + boundary + "\r\n"
+                         + "Content-Disposition: form-data; name=\"metadata\"\r\n"
+                         + "Content-Type: application/json; charset=utf-8\r\n\r\n"
+                         + metadataJson
+                         + "\r\n--" + boundary + "--\r\n");
 
         Headers uploadHeaders = headers;
-        uploadHeaders["Content-Type"] = "multipart/form-data; boundary=" + boundary;
-        uploadHeaders["X-File-Name"]  = fileName;
+        uploadHeaders["X-File-Name"] = fileName;
 
-        if (progress) progress((int64_t)fileData.size(), (int64_t)fileData.size());
         log(LogLevel::Info, "Uploading file with metadata: " + fileName);
-        return send("POST", url, "", body, uploadHeaders, {}, cancel);
+        return send_upload(url, boundary, stream, uploadHeaders, {}, progress, cancel);
+    }
+
+private:
+    static std::string multipart_file_header(const std::string& boundary, const std::string& fieldName,
+                                             const std::string& fileName)
+    {
+        return "--" + boundary + "\r\n"
+            + "Content-Disposition: form-data; name=\"" + fieldName + "\"; filename=\"" + fileName + "\"\r\n"
+            + "Content-Type: application/octet-stream\r\n\r\n";
+    }
+
+    HttpResponse send_upload(const std::string& url, const std::string& boundary, detail::BodyStream& stream,
+                             const Headers& headers, const QueryParams& query,
+                             ProgressCallback progress, CancelToken* cancel)
+    {
+        Headers uploadHeaders = headers;
+        uploadHeaders["Content-Type"] = "multipart/form-data; boundary=" + boundary;
+        return send_body_stream("POST", url, stream, uploadHeaders, query, progress, cancel);
+    }
+
+    HttpResponse send_body_stream(const std::string& method, const std::string& url, detail::BodyStream& stream,
+                                  const Headers& headers, const QueryParams& query,
+                                  const ProgressCallback& progress, CancelToken* cancel)
+    {
+        if (progress)
+            stream.setProgress([&progress](uint64_t sent, uint64_t total) { progress((int64_t)sent, (int64_t)total); });
+        stream.setCancel(cancel);
+
+        auto resp = send_with_retry(method, url, "", {}, headers, query, cancel, {}, &stream);
+        invalidate_after(method, url, query, resp.statusCode);
+        return resp;
     }
 
+public:
+
     // ══════════════════════════════════════════════════════════════════════
     //  文件下载
     // ══════════════════════════════════════════════════════════════════════
 
+    /// 下载到文件。body 先写入 destPath + ".download.tmp"，完成后原子替换。
+    /// 取消或失败时保留临时文件与旁路记录 (".download.meta": ETag / Last-Modified / 已写入字节)，
+    /// 下次调用以 Range + If-Range 从断点续传；资源已变化时服务器回 200，自动从头开始。
+    /// 连接错误与可重试状态码按重试策略重试，重试同样从断点续传
     void downloadFile(const std::string& url,
                       const std::string& destPath,
                       const Headers& headers = {},
@@ -1141,46 +11969,11 @@ public:
                       ProgressCallback progress = nullptr,
                       CancelToken* cancel = nullptr)
     {
-        auto fullUrl = detail::resolve_url(baseAddress_, detail::build_url(url, query));
-        auto parts   = detail::parse_url(fullUrl);
-
-        detail::WinHttpHandle hConnect, hRequest;
-        open_download_request(parts, headers, hConnect, hRequest);
-
-        int64_t totalBytes = get_content_length(hRequest.get());
-
-        namespace fs = std::filesystem;
-        auto dir = fs::path(destPath).parent_path();
-        if (!dir.empty()) fs::create_directories(dir);
-
-        auto tempFile = destPath + ".download.tmp";
-        {
-            std::ofstream ofs(tempFile, std::ios::binary);
-            if (!ofs)
-                throw std::runtime_error("Cannot create temp file: " + tempFile);
-
-            char buf[81920];
-            DWORD bytesRead = 0;
-            int64_t totalRead = 0;
-            while (WinHttpReadData(hRequest.get(), buf, sizeof(buf), &bytesRead) && bytesRead > 0) {
-                if (cancel && cancel->isCancelled()) {
-                    ofs.close();
-                    fs::remove(tempFile);
-                    throw std::runtime_error("Download cancelled");
-                }
-                ofs.write(buf, bytesRead);
-                totalRead += bytesRead;
-                if (progress) progress(totalRead, totalBytes);
-                bytesRead = 0;
-            }
-        }
-
-        if (autoManageCookies_.load()) parse_set_cookies(hRequest.get(), parts.host);
-
-        atomic_file_replace(tempFile, destPath);
+        download_resumable(url, destPath, headers, query, progress, cancel);
         log(LogLevel::Info, "Downloaded: " + url + " -> " + destPath);
     }
 
+    /// 下载并返回 SHA-256。见下方指定算法的重载
     std::string downloadFileWithHash(const std::string& url,
                                      const std::string& destPath,
                                      const std::string& expectedHash = "",
@@ -1189,75 +11982,47 @@ public:
                                      ProgressCallback progress = nullptr,
                                      CancelToken* cancel = nullptr)
     {
-        downloadFile(url, destPath, headers, query, progress, cancel);
-        auto fileHash = detail::sha256_file(destPath);
-
-        if (!expectedHash.empty() && !detail::iequals(fileHash, expectedHash)) {
-            std::filesystem::remove(destPath);
-            throw std::runtime_error("Hash mismatch: expected " + expectedHash + ", got " + fileHash);
-        }
-        log(LogLevel::Info, "Download hash verified: " + fileHash);
-        return fileHash;
+        return downloadFileWithHash(url, destPath, HashAlgorithm::Sha256, expectedHash, headers, query, progress, cancel);
     }
 
-    DownloadResult downloadFileWithMetadata(const std::string& url,
-                                            const std::string& destPath,
-                                            const Headers& headers = {},
-                                            const QueryParams& query = {},
-                                            ProgressCallback progress = nullptr,
-                                            CancelToken* cancel = nullptr)
-    {
-        auto fullUrl = detail::resolve_url(baseAddress_, detail::build_url(url, query));
-        auto parts   = detail::parse_url(fullUrl);
-
-        detail::WinHttpHandle hConnect, hRequest;
-        open_download_request(parts, headers, hConnect, hRequest);
-
-        DownloadResult result;
-        result.statusCode = get_status_code(hRequest.get());
-        result.totalBytes = get_content_length(hRequest.get());
-        result.contentType = get_header(hRequest.get(), L"Content-Type");
-        result.etag = get_header(hRequest.get(), L"ETag");
-
-        auto meta = get_header(hRequest.get(), L"X-MetaData");
-        if (!meta.empty()) result.serverMetadata["X-MetaData"] = meta;
-
-        namespace fs = std::filesystem;
-        auto dir = fs::path(destPath).parent_path();
-        if (!dir.empty()) fs::create_directories(dir);
-
-        auto tempFile = destPath + ".download.tmp";
-        {
-            std::ofstream ofs(tempFile, std::ios::binary);
-            if (!ofs)
-                throw std::runtime_error("Cannot create temp file: " + tempFile);
-
-            char buf[81920];
-            DWORD bytesRead = 0;
-            int64_t totalRead = 0;
-            while (WinHttpReadData(hRequest.get(), buf, sizeof(buf), &bytesRead) && bytesRead > 0) {
-                if (cancel && cancel->isCancelled()) {
-                    ofs.close();
-                    fs::remove(tempFile);
-                    throw std::runtime_error("Download cancelled");
-                }
-                ofs.write(buf, bytesRead);
-                totalRead += bytesRead;
-                if (progress) progress(totalRead, result.totalBytes);
-                bytesRead = 0;
-            }
-            result.downloadedBytes = totalRead;
-        }
-
-        if (autoManageCookies_.load()) parse_set_cookies(hRequest.get(), parts.host);
+    /// 下载并返回摘要 (小写十六进制)。摘要在接收过程中由独立线程计算，不回读文件；
+    /// expectedHash 非空且不一致时删除临时文件并抛出 "Hash mismatch"，destPath 保持原样
+    std::string downloadFileWithHash(const std::string& url,
+                                     const std::string& destPath,
+                                     HashAlgorithm algorithm,
+                                     const std::string& expectedHash = "",
+                                     const Headers& headers = {},
+                                     const QueryParams& query = {},
+                                     ProgressCallback progress = nullptr,
+                                     CancelToken* cancel = nullptr)
+    {
+        auto result = download_resumable(url, destPath, headers, query, progress, cancel, algorithm, expectedHash);
+        log(LogLevel::Info, (expectedHash.empty() ? "Download hash: " : "Download hash verified: ") + result.fileHash);
+        return result.fileHash;
+    }
 
-        atomic_file_replace(tempFile, destPath);
+    DownloadResult downloadFileWithMetadata(const std::string& url,
+                                            const std::string& destPath,
+                                            const Headers& headers = {},
+                                            const QueryParams& query = {},
+                                            ProgressCallback progress = nullptr,
+                                            CancelToken* cancel = nullptr)
+    {
+        namespace fs = std::filesystem;
+        DownloadResult result = download_resumable(url, destPath, headers, query, progress, cancel, HashAlgorithm::Sha256);
         result.savedFilePath = destPath;
-        result.fileHash = detail::sha256_file(destPath);
         result.fileName = fs::path(destPath).filename().string();
         return result;
     }
 
+    /// 删除 destPath 未完成下载留下的临时文件与续传记录，下次下载从头开始
+    static void discardPartialDownload(const std::string& destPath)
+    {
+        std::error_code ec;
+        std::filesystem::remove(destPath + ".download.tmp", ec);
+        std::filesystem::remove(destPath + ".download.meta", ec);
+    }
+
     void downloadToStream(const std::string& url,
                           std::ostream& destination,
                           const Headers& headers = {},
@@ -1268,23 +12033,105 @@ public:
         auto fullUrl = detail::resolve_url(baseAddress_, detail::build_url(url, query));
         auto parts   = detail::parse_url(fullUrl);
 
-        detail::WinHttpHandle hConnect, hRequest;
-        open_download_request(parts, headers, hConnect, hRequest);
+        // 写入流的下载不涉及续传与区间，可以声明 Accept-Encoding 并边收边解压
+        auto cfg = config();
+        auto spec = download_spec(*cfg, parts, headers);
+        std::string acceptEncoding;
+        add_accept_encoding(*cfg, spec, headers, acceptEncoding);
+        spec.headers += acceptEncoding;
 
-        int64_t totalBytes = get_content_length(hRequest.get());
+        detail::HttpExchange exchange(session_);
+        exchange.open(spec);
+        auto decoder = detail::ResponseDecoder::create(spec, exchange.statusCode(), exchange.headers());
+
+        // 解压时 Content-Length 是压缩后的长度，总字节数按未知报告
+        int64_t totalBytes = decoder ? -1 : detail::content_length_of(exchange.headers());
         char buf[81920];
-        DWORD bytesRead = 0;
+        size_t bytesRead = 0;
         int64_t totalRead = 0;
 
-        while (WinHttpReadData(hRequest.get(), buf, sizeof(buf), &bytesRead) && bytesRead > 0) {
+        while ((bytesRead = decoder ? decoder->read(exchange, buf, sizeof(buf)) : exchange.read(buf, sizeof(buf))) > 0) {
             if (cancel && cancel->isCancelled()) throw std::runtime_error("Download cancelled");
-            destination.write(buf, bytesRead);
-            totalRead += bytesRead;
+            destination.write(buf, (std::streamsize)bytesRead);
+            totalRead += (int64_t)bytesRead;
             if (progress) progress(totalRead, totalBytes);
-            bytesRead = 0;
         }
 
-        if (autoManageCookies_.load()) parse_set_cookies(hRequest.get(), parts.host);
+        if (decoder) compressionCounters_.add(decoder->info());
+        if (autoManageCookies_.load()) parse_set_cookies(exchange.headers(), parts);
+    }
+
+    /// 分段下载: 先发一个 Range 请求探测 (同时取回第一段)。服务器支持区间 (206 且给出总长度) 时预分配临时文件，
+    /// 多条连接并行领取后续区间并按偏移写入，并发数按测得吞吐自适应；不支持时退化为单流下载。
+    /// 后续区间带 If-Range，资源在下载途中变化时抛出。progress 在调用线程上回调
+    DownloadResult downloadFileSegmented(const std::string& url,
+                                         const std::string& destPath,
+                                         const SegmentedDownloadOptions& options = {},
+                                         const Headers& headers = {},
+                                         const QueryParams& query = {},
+                                         ProgressCallback progress = nullptr,
+                                         CancelToken* cancel = nullptr)
+    {
+        namespace fs = std::filesystem;
+        auto fullUrl = detail::resolve_url(baseAddress_, detail::build_url(url, query));
+        auto parts   = detail::parse_url(fullUrl);
+        int64_t chunk = std::max<int64_t>(options.chunkSize, 64 * 1024);
+
+        auto probe = std::make_unique<detail::HttpExchange>(session_);
+        probe->open(range_spec(parts, headers, 0, chunk - 1, ""));
+
+        int64_t first = 0, last = 0, total = -1;
+        bool ranged = probe->statusCode() == 206
+            && detail::parse_content_range(detail::find_header(probe->headers(), "Content-Range"), first, last, total)
+            && first == 0 && total >= 0;
+        if ((probe->statusCode() == 206 && !ranged) || probe->statusCode() == 416) {
+            // 区间响应不可用 (总长度未知、空文件等): 重新整体请求
+            probe = std::make_unique<detail::HttpExchange>(session_);
+            open_download_request(parts, headers, *probe);
+        }
+        if (probe->statusCode() != 200 && !ranged)
+            throw std::runtime_error("Download failed: HTTP " + std::to_string(probe->statusCode()) + " " + probe->reasonPhrase());
+
+        if (autoManageCookies_.load()) parse_set_cookies(probe->headers(), parts);
+
+        DownloadResult result;
+        result.statusCode  = 200;
+        result.contentType = detail::find_header(probe->headers(), "Content-Type");
+        result.etag        = detail::find_header(probe->headers(), "ETag");
+        auto meta = detail::find_header(probe->headers(), "X-MetaData");
+        if (!meta.empty()) result.serverMetadata["X-MetaData"] = meta;
+
+        auto dir = fs::path(destPath).parent_path();
+        if (!dir.empty()) fs::create_directories(dir);
+        auto tempFile = destPath + ".download.tmp";
+
+        try {
+            if (ranged) {
+                // If-Range 只接受强 ETag，否则用 Last-Modified
+                std::string validator = result.etag;
+                if (validator.empty() || validator.rfind("W/", 0) == 0)
+                    validator = detail::find_header(probe->headers(), "Last-Modified");
+
+                SegmentPlan plan{ parts, headers, validator, tempFile, total, chunk };
+                result.totalBytes = total;
+                result.downloadedBytes = download_segments(plan, std::move(probe), last + 1, options, progress, cancel);
+            } else {
+                log(LogLevel::Info, "Server does not support ranges, downloading as a single stream: " + url);
+                result.totalBytes = detail::content_length_of(probe->headers());
+                result.downloadedBytes = download_single(*probe, tempFile, result.totalBytes, progress, cancel);
+            }
+        } catch (...) {
+            discardPartialDownload(destPath);
+            throw;
+        }
+
+        std::error_code ec;
+        fs::remove(destPath + ".download.meta", ec);   // 之前 downloadFile 留下的续传记录已无效
+        atomic_file_replace(tempFile, destPath);
+        result.savedFilePath = destPath;
+        result.fileName = fs::path(destPath).filename().string();
+        log(LogLevel::Info, "Downloaded (segmented): " + url + " -> " + destPath);
+        return result;
     }
 
     // ══════════════════════════════════════════════════════════════════════
@@ -1296,98 +12143,142 @@ public:
                     std::function<bool()> shouldStop = nullptr,
                     const Headers& headers = {},
                     CancelToken* cancel = nullptr)
+    {
+        SseEvent event;   // 逐事件复用，字符串容量跨事件保留
+        connectSseView(url, [&](const SseEventView& view) {
+            view.copyTo(event);
+            onEvent(event);
+        }, std::move(shouldStop), headers, cancel);
+    }
+
+    /// 同 connectSse，但回调直接收到指向解析缓冲区的 SseEventView (不复制事件)，视图只在回调期间有效
+    void connectSseView(const std::string& url,
+                        std::function<void(const SseEventView&)> onEvent,
+                        std::function<bool()> shouldStop = nullptr,
+                        const Headers& headers = {},
+                        CancelToken* cancel = nullptr)
     {
         auto fullUrl = detail::resolve_url(baseAddress_, url);
         auto parts   = detail::parse_url(fullUrl);
 
-        auto wHost = detail::to_wide(parts.host);
-        detail::WinHttpHandle hConnect(WinHttpConnect(hSession_.get(), wHost.c_str(), (INTERNET_PORT)parts.port, 0));
-        if (!hConnect) throw std::runtime_error("SSE: WinHttpConnect failed");
-
-        auto wPath = detail::to_wide(parts.path);
-        DWORD flags = parts.isHttps ? WINHTTP_FLAG_SECURE : 0;
-        detail::WinHttpHandle hRequest(WinHttpOpenRequest(hConnect.get(), L"GET", wPath.c_str(), nullptr,
-                                       WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags));
-        if (!hRequest) throw std::runtime_error("SSE: WinHttpOpenRequest failed");
-
-        // SSL
-        apply_ssl_flags(hRequest.get(), parts.isHttps);
-
-        // Headers: defaultHeaders + SSE headers + user headers + cookies
-        std::wstring wHeaders;
-        {
-            std::lock_guard<std::mutex> lock(mu_);
-            for (auto& [k, v] : defaultHeaders_)
-                wHeaders += detail::to_wide(k) + L": " + detail::to_wide(v) + L"\r\n";
-        }
-        wHeaders += L"Accept: text/event-stream\r\nCache-Control: no-cache\r\n";
-        for (auto& [k, v] : headers)
-            wHeaders += detail::to_wide(k) + L": " + detail::to_wide(v) + L"\r\n";
-
-        auto cookieHdr = build_cookie_header(parts.host);
-        if (!cookieHdr.empty()) wHeaders += L"Cookie: " + detail::to_wide(cookieHdr) + L"\r\n";
-
-        // Session header
-        apply_session_header(wHeaders);
-
-        if (!wHeaders.empty())
-            WinHttpAddRequestHeaders(hRequest.get(), wHeaders.c_str(), (DWORD)wHeaders.size(), WINHTTP_ADDREQ_FLAG_ADD);
-
-        if (!WinHttpSendRequest(hRequest.get(), WINHTTP_NO_ADDITIONAL_HEADERS, 0, nullptr, 0, 0, 0) ||
-            !WinHttpReceiveResponse(hRequest.get(), nullptr)) {
-            throw std::runtime_error("SSE: send/receive failed: " + detail::winhttp_error_string(GetLastError()));
-        }
+        auto spec = sse_spec(parts, headers);
+        detail::HttpExchange exchange(session_);
+        exchange.open(spec);
+        auto decoder = detail::ResponseDecoder::create(spec, exchange.statusCode(), exchange.headers());
 
         log(LogLevel::Info, "SSE connected: " + url);
 
-        // 逐行读取 (优化: 用 consumed 偏移避免 O(n²))
-        std::string lineBuffer;
-        SseEvent currentEvent;
-        char buf[4096];
-        DWORD bytesRead = 0;
+        detail::SseParser parser;
+        char buf[16384];
+        size_t bytesRead = 0;
 
-        while (WinHttpReadData(hRequest.get(), buf, sizeof(buf), &bytesRead) && bytesRead > 0) {
+        while ((bytesRead = decoder ? decoder->read(exchange, buf, sizeof(buf)) : exchange.read(buf, sizeof(buf))) > 0) {
             if ((shouldStop && shouldStop()) || (cancel && cancel->isCancelled())) break;
+            parser.feed(buf, bytesRead, onEvent);
+        }
 
-            lineBuffer.append(buf, bytesRead);
-            bytesRead = 0;
+        if (decoder) compressionCounters_.add(decoder->info());
+        log(LogLevel::Info, "SSE disconnected: " + url);
+    }
 
-            size_t consumed = 0;
-            size_t pos;
-            while ((pos = lineBuffer.find('\n', consumed)) != std::string::npos) {
-                auto line = lineBuffer.substr(consumed, pos - consumed);
-                consumed = pos + 1;
-                if (!line.empty() && line.back() == '\r') line.pop_back();
+    /// 托管 SSE 订阅: 连接断开 (正常结束或出错) 后按 options 退避重连，请求带 Last-Event-ID 让服务器从断点继续，
+    /// 连接经连接池获取。shouldStop / cancel 触发或服务器返回 204 时正常返回统计；
+    /// 不可重试的状态码 (4xx，408 / 429 除外)、超过 maxAttempts 或 onEvent 抛出时向外抛出
+    SseSubscriptionStats subscribeSse(const std::string& url,
+                                      std::function<void(const SseEventView&)> onEvent,
+                                      std::function<bool()> shouldStop = nullptr,
+                                      const Headers& headers = {},
+                                      CancelToken* cancel = nullptr,
+                                      const SseReconnectOptions& options = {})
+    {
+        using Clock = std::chrono::steady_clock;
+        auto parts = detail::parse_url(detail::resolve_url(baseAddress_, url));
+        auto stopped = [&] { return (shouldStop && shouldStop()) || (cancel && cancel->isCancelled()); };
+
+        SseSubscriptionStats stats;
+        detail::SseParser parser;
+        parser.setLastEventId(options.lastEventId);
+        int failures = 0;
+        bool disconnected = false;
+        Clock::time_point disconnectedAt;
+        char buf[16384];
+
+        while (!stopped()) {
+            bool fatal = false, connected = false, gotEvent = false;
+            try {
+                Headers reqHeaders = headers;
+                if (!parser.lastEventId().empty()) reqHeaders["Last-Event-ID"] = parser.lastEventId();
+                auto spec = sse_spec(parts, reqHeaders);
+                detail::HttpExchange exchange(session_);
+                exchange.open(spec);
+
+                int status = exchange.statusCode();
+                if (status == 204) {
+                    log(LogLevel::Info, "SSE closed by server (204): " + url);
+                    break;
+                }
+                if (status != 200) {
+                    fatal = status >= 400 && status < 500 && status != 408 && status != 429;
+                    throw std::runtime_error("SSE: HTTP " + std::to_string(status));
+                }
 
-                if (line.empty()) {
-                    if (!currentEvent.data.empty()) {
-                        if (currentEvent.event.empty()) currentEvent.event = "message";
-                        onEvent(currentEvent);
-                    }
-                    currentEvent = {};
-                } else if (line.size() >= 5 && line.substr(0, 5) == "data:") {
-                    auto data = line.substr(5);
-                    if (!data.empty() && data[0] == ' ') data = data.substr(1);
-                    if (!currentEvent.data.empty()) currentEvent.data += "\n";
-                    currentEvent.data += data;
-                } else if (line.size() >= 6 && line.substr(0, 6) == "event:") {
-                    auto ev = line.substr(6);
-                    if (!ev.empty() && ev[0] == ' ') ev = ev.substr(1);
-                    currentEvent.event = ev;
-                } else if (line.size() >= 3 && line.substr(0, 3) == "id:") {
-                    auto id = line.substr(3);
-                    if (!id.empty() && id[0] == ' ') id = id.substr(1);
-                    currentEvent.id = id;
-                } else if (line.size() >= 6 && line.substr(0, 6) == "retry:") {
-                    auto r = line.substr(6);
-                    if (!r.empty() && r[0] == ' ') r = r.substr(1);
-                    try { currentEvent.retry = std::stoi(r); } catch (...) {}
+                connected = true;
+                ++stats.connects;
+                if (disconnected) {
+                    ++stats.reconnects;
+                    stats.lastGapMs = std::chrono::duration<double, std::milli>(Clock::now() - disconnectedAt).count();
+                    stats.totalGapMs += stats.lastGapMs;
+                    stats.maxGapMs = std::max(stats.maxGapMs, stats.lastGapMs);
+                    disconnected = false;
+                    log(LogLevel::Info, "SSE reconnected after " + std::to_string((int)stats.lastGapMs) + "ms: " + url);
+                    if (options.onReconnect) options.onReconnect(stats);
+                } else {
+                    log(LogLevel::Info, "SSE connected: " + url);
                 }
+
+                auto decoder = detail::ResponseDecoder::create(spec, status, exchange.headers());
+                auto deliver = [&](const SseEventView& view) {
+                    ++stats.events;
+                    gotEvent = true;
+                    fatal = true;   // 回调自身抛出的异常不触发重连
+                    onEvent(view);
+                    fatal = false;
+                };
+                size_t n;
+                while ((n = decoder ? decoder->read(exchange, buf, sizeof(buf)) : exchange.read(buf, sizeof(buf))) > 0) {
+                    if (stopped()) break;
+                    parser.feed(buf, n, deliver);
+                }
+                if (decoder) compressionCounters_.add(decoder->info());
+                if (stopped()) break;
+                log(LogLevel::Warn, "SSE stream ended: " + url);
+            } catch (const std::exception& ex) {
+                if (fatal || stopped()) throw;
+                if (!connected) ++stats.failedAttempts;
+                log(LogLevel::Warn, std::string("SSE connection lost: ") + ex.what());
+            }
+
+            if (connected && !disconnected) {
+                disconnected = true;
+                disconnectedAt = Clock::now();
             }
-            lineBuffer.erase(0, consumed);
+            stats.lastEventId = parser.lastEventId();
+            stats.retryMs     = parser.retryMs();
+            failures = gotEvent ? 0 : failures + 1;
+            if (options.maxAttempts >= 0 && failures > options.maxAttempts)
+                throw std::runtime_error("SSE: giving up after " + std::to_string(failures) + " failed attempts: " + url);
+
+            int delay = sse_reconnect_delay(options, parser.retryMs(), failures);
+            log(LogLevel::Info, "SSE reconnecting in " + std::to_string(delay) + "ms: " + url);
+            auto wakeAt = Clock::now() + std::chrono::milliseconds(delay);
+            while (!stopped() && Clock::now() < wakeAt)
+                std::this_thread::sleep_for(std::min<Clock::duration>(wakeAt - Clock::now(), std::chrono::milliseconds(50)));
+            parser.reset();   // 丢弃断线时未完成的事件，保留 lastEventId / retry
         }
 
-        log(LogLevel::Info, "SSE disconnected: " + url);
+        stats.lastEventId = parser.lastEventId();
+        stats.retryMs     = parser.retryMs();
+        return stats;
     }
 
     // ══════════════════════════════════════════════════════════════════════
@@ -1396,50 +12287,51 @@ public:
 
     std::string getSessionId() const
     {
-        std::lock_guard<std::mutex> lock(mu_);
-        for (auto& c : cookies_) {
-            if (detail::iequals(c.name, sessionCookieName_)) return c.value;
-        }
-        return {};
+        return session_id(*config());
     }
 
+    /// 写入会话 Cookie: 已有同名 Cookie 时只改值；否则新建，domain 为空时用 baseAddress 的主机 (只发给该主机)，
+    /// 指定 domain 时同时发给其子域名，都没有时发给所有主机
     void setSessionId(const std::string& sessionId, const std::string& domain = "", const std::string& path = "/")
     {
         if (sessionId.empty()) return;
-        std::lock_guard<std::mutex> lock(mu_);
-        for (auto& c : cookies_) {
-            if (detail::iequals(c.name, sessionCookieName_)) {
-                c.value = sessionId;
-                return;
-            }
-        }
+        auto cfg = config();
+        if (cookies_.assignValue(cfg->sessionCookieName, sessionId, unix_now())) return;
         Cookie c;
-        c.name = sessionCookieName_;
+        c.name = cfg->sessionCookieName;
         c.value = sessionId;
         c.domain = domain.empty() ? extract_host(baseAddress_) : domain;
+        c.hostOnly = domain.empty();
         c.path = path;
-        cookies_.push_back(c);
+        cookies_.store(std::move(c), unix_now());
     }
 
     void clearCookies()
     {
-        std::lock_guard<std::mutex> lock(mu_);
         cookies_.clear();
     }
 
+    /// 全部未过期的 Cookie，按创建先后
+    std::vector<Cookie> getCookies() const
+    {
+        return cookies_.all(unix_now());
+    }
+
+    /// 导出为 JSON，格式与 C# ExportCookies 相同: 域 Cookie 的 Domain 带前导 '.'，Expires 为 ISO 8601 (UTC) 或 null
     std::string exportCookies() const
     {
-        std::lock_guard<std::mutex> lock(mu_);
+        auto cookies = cookies_.all(unix_now());
         std::ostringstream oss;
         oss << "[";
-        for (size_t i = 0; i < cookies_.size(); ++i) {
-            auto& c = cookies_[i];
+        for (size_t i = 0; i < cookies.size(); ++i) {
+            auto& c = cookies[i];
             if (i > 0) oss << ",";
             oss << "{\"Name\":\"" << detail::json_escape(c.name)
                 << "\",\"Value\":\"" << detail::json_escape(c.value)
-                << "\",\"Domain\":\"" << detail::json_escape(c.domain)
+                << "\",\"Domain\":\"" << (c.hostOnly || c.domain.empty() ? "" : ".") << detail::json_escape(c.domain)
                 << "\",\"Path\":\"" << detail::json_escape(c.path)
-                << "\",\"Secure\":" << (c.secure ? "true" : "false")
+                << "\",\"Expires\":" << (c.expires ? "\"" + detail::format_iso8601(c.expires) + "\"" : std::string("null"))
+                << ",\"Secure\":" << (c.secure ? "true" : "false")
                 << ",\"HttpOnly\":" << (c.httpOnly ? "true" : "false")
                 << "}";
         }
@@ -1447,467 +12339,1208 @@ public:
         return oss.str();
     }
 
+    /// 导入 exportCookies / C# ExportCookies 的 JSON (单遍解析，支持转义字符与 \uXXXX)。
+    /// 没有 Domain 的项归入 baseAddress 的主机；已过期的项被忽略；JSON 格式错误时抛出异常，之前的项已导入
     void importCookies(const std::string& json)
     {
         if (json.empty()) return;
-        std::lock_guard<std::mutex> lock(mu_);
-        size_t pos = 0;
-        while (true) {
-            auto start = json.find('{', pos);
-            if (start == std::string::npos) break;
-            auto end = json.find('}', start);
-            if (end == std::string::npos) break;
+        auto now = unix_now();
+        auto baseHost = extract_host(baseAddress_);
+        Cookie c;
+        detail::parse_json_object_array(json,
+            [&](std::string_view key, const detail::JsonScalar& v) {
+                using Kind = detail::JsonScalar::Kind;
+                if (key == "Name")          c.name = v.text;
+                else if (key == "Value")    c.value = v.text;
+                else if (key == "Domain")   c.domain = v.text;
+                else if (key == "Path")     c.path = v.text;
+                else if (key == "Secure")   c.secure = v.kind == Kind::Bool && v.boolean;
+                else if (key == "HttpOnly") c.httpOnly = v.kind == Kind::Bool && v.boolean;
+                else if (key == "Expires" && v.kind == Kind::String) {
+                    int64_t t = detail::parse_iso8601(v.text);
+                    if (t > 0) c.expires = t;
+                }
+            },
+            [&]() {
+                if (c.domain.empty()) c.domain = baseHost;
+                c.hostOnly = c.domain.empty() || c.domain[0] != '.';
+                if (!c.name.empty()) cookies_.store(std::move(c), now);
+                c = Cookie();
+            });
+    }
 
-            auto item = json.substr(start, end - start + 1);
-            Cookie c;
-            c.name     = detail::json_get_string(item, "Name");
-            c.value    = detail::json_get_string(item, "Value");
-            c.domain   = detail::json_get_string(item, "Domain");
-            c.path     = detail::json_get_string(item, "Path");
-            c.secure   = detail::json_get_bool(item, "Secure");
-            c.httpOnly = detail::json_get_bool(item, "HttpOnly");
-            if (c.path.empty()) c.path = "/";
-            if (!c.name.empty()) cookies_.push_back(c);
-            pos = end + 1;
+    /// 保存为二进制快照 (先写 path.tmp 再替换 path)。格式见 detail::CookieSnapshot，只有 C++ 端读取；
+    /// 与 C# 交换 Cookie 请使用 exportCookies
+    void saveCookies(const std::string& path) const
+    {
+        auto bytes = detail::CookieSnapshot::encode(cookies_.all(unix_now()));
+        auto temp = path + ".tmp";
+        {
+            std::ofstream out(std::filesystem::path(temp), std::ios::binary | std::ios::trunc);
+            if (!out || !out.write(bytes.data(), (std::streamsize)bytes.size()) || !out.flush())
+                throw std::runtime_error("Cannot write cookie snapshot: " + temp);
         }
+        std::error_code ec;
+        std::filesystem::rename(temp, path, ec);
+        if (ec) {
+            std::filesystem::remove(temp, ec);
+            throw std::runtime_error("Cannot replace cookie snapshot: " + path);
+        }
+        log(LogLevel::Debug, "Saved " + std::to_string(bytes.size()) + " bytes of cookies to " + path);
+    }
+
+    /// 加载 saveCookies 写出的快照并合并进当前 Cookie (同名项以快照为准)。文件被内存映射，
+    /// 只读取分组表，各可注册域名的 Cookie 在首次发往 / 收到该域名时才解码。
+    /// 文件损坏或版本不支持时抛出异常且不做任何改动
+    void loadCookies(const std::string& path)
+    {
+        cookies_.attach(detail::CookieSnapshot::map(path), unix_now());
     }
 
     // ══════════════════════════════════════════════════════════════════════
     //  请求队列
     // ══════════════════════════════════════════════════════════════════════
 
-    /// 启动后台请求队列
-    void startQueue(int maxConcurrent = 10)
+    /// 启动后台请求队列: maxConcurrent 个常驻工作线程 + 容量为 capacity 的有界队列。
+    /// 启动前 (或 stopQueue 之后) 入队的请求此时按入队顺序交给工作线程
+    void startQueue(int maxConcurrent = 10, size_t capacity = 1024)
     {
-        if (queueRunning_.load()) return;
-        queueRunning_.store(true);
-        maxConcurrent_ = maxConcurrent;
-        activeTasks_.store(0);
-        queueThread_ = std::thread([this]() { queue_worker(); });
+        std::shared_ptr<detail::WorkerPool> pool;
+        std::vector<QueuedTask> backlog;
+        {
+            std::lock_guard<std::mutex> lock(queueMu_);
+            if (queuePool_) return;
+            pool = queuePool_ = std::make_shared<detail::WorkerPool>(maxConcurrent, capacity);
+            backlog.swap(queueBacklog_);
+        }
+        log(LogLevel::Debug, "Request queue started: workers=" + std::to_string(maxConcurrent) +
+                             " capacity=" + std::to_string(capacity));
+        // 在锁外提交: 积压多于容量时在这里等待工作线程腾出位置
+        for (auto& task : backlog) pool->submit(std::move(task), -1);
     }
 
-    /// 排入队列
+    /// 排入队列。队列已满时阻塞等待 (背压)；队列未启动时先缓存，startQueue() 时再执行。
+    /// 在队列回调里调用且队列已满时不等待，直接在当前线程执行该请求 (否则所有工作线程可能互相等待)
     void enqueue(const HttpRequest& req, std::function<void(HttpResponse)> callback)
     {
-        {
-            std::lock_guard<std::mutex> lock(queueMu_);
-            queue_.push({req, std::move(callback)});
-        }
-        queueCv_.notify_one();
+        submit_queued(req, std::move(callback), -1);
+    }
+
+    /// 尝试排入队列。timeoutMs = 0 不等待；> 0 队列满时最多等待该时长。返回 false 表示未入队。
+    /// 队列未启动时与 enqueue 相同，先缓存并返回 true
+    bool tryEnqueue(const HttpRequest& req, std::function<void(HttpResponse)> callback, int timeoutMs = 0)
+    {
+        return submit_queued(req, std::move(callback), std::max(timeoutMs, 0));
+    }
+
+    /// 队列深度、活跃工作线程与排队等待时间
+    QueueStats getQueueStats() const
+    {
+        std::lock_guard<std::mutex> lock(queueMu_);
+        return queuePool_ ? queuePool_->stats() : QueueStats();
     }
 
-    /// 停止队列（等待所有进行中的请求完成）
+    /// 停止队列（等待所有已入队请求完成）
     void stopQueue()
     {
         stop_queue();
     }
 
-private:
+private:
+
+    // ──────────────────────────── 字段 ──────────────────────────────────
+
+    detail::HttpSession     session_;
+    std::string             baseAddress_;
+
+    /// 请求路径读取的全部配置。setter 复制 → 修改 → 整体发布，读取方不加锁
+    struct Config
+    {
+        Headers            defaultHeaders;
+        std::string        defaultHeaderBlock;     ///< defaultHeaders 预先序列化的 "Name: value\r\n" 头块
+        bool               defaultAcceptEncoding = false;   ///< 默认头中已有 Accept-Encoding
+        RetryPolicy        retryPolicy;
+        int                timeoutMs = 0;
+        std::string        sessionCookieName = "session_id";
+        std::string        sessionHeaderName;
+        LogCallback        logCallback;
+        CoalescingOptions  coalescing;
+        CompressionOptions compression;
+    };
+    using ConfigPtr = detail::SnapshotCell<Config>::Snapshot;
+    detail::SnapshotCell<Config> config_;
+
+    // Cookie (内部按可注册域名分片加锁；组装请求头时会刷新按 origin 缓存的 Cookie 头)
+    mutable detail::CookieJar cookies_;
+
+    // 线程安全属性
+    std::atomic<bool>       autoManageCookies_{true};
+    std::atomic<bool>       ignoreSslErrors_{false};
+
+    // 请求合并: 合并键 -> 在途请求 (结果由首个调用方写入，其余调用方等待)
+    struct Flight
+    {
+        std::mutex                          mu;
+        std::condition_variable             cv;
+        bool                                done = false;
+        bool                                leaderCancelled = false;
+        std::shared_ptr<const HttpResponse> response;
+        std::exception_ptr                  error;
+    };
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights_;
+    mutable std::mutex                                       flightsMu_;
+    std::atomic<uint64_t>                                    coalesceLeaders_{0};
+    std::atomic<uint64_t>                                    coalesceHits_{0};
+
+    // 响应缓存 (内部自带锁)
+    detail::ResponseCache   cache_;
+
+    // 内容编码
+    detail::CompressionCounters compressionCounters_;
+
+    // 请求队列 (固定工作线程池，stop 时 join 全部线程)
+    using QueuedTask = std::function<void()>;
+
+    std::shared_ptr<detail::WorkerPool> queuePool_;
+    std::vector<QueuedTask>             queueBacklog_;   ///< startQueue() 之前入队的请求
+    mutable std::mutex                  queueMu_;
+
+    // 异步引擎 (首次 sendAsync 时创建)
+    std::unique_ptr<detail::AsyncEngine> asyncEngine_;
+    std::mutex                           asyncMu_;
+    bool                                 asyncStopped_ = false;   ///< 析构中，不再创建引擎
+
+#if defined(DRX_HTTP_HAS_COROUTINES)
+    std::atomic<Executor*>               executor_{nullptr};      ///< 协程恢复位置 (nullptr = I/O 线程)
+#endif
+
+    // ──────────────────────────── 日志 ──────────────────────────────────
+
+    ConfigPtr config() const { return config_.load(); }
+
+    /// 回调在调用线程上执行、不持有任何锁，多个请求线程可能同时调用它
+    static void log(const Config& cfg, LogLevel level, const std::string& message)
+    {
+        if (cfg.logCallback) {
+            try { cfg.logCallback(level, message); } catch (...) {}
+        }
+    }
+
+    void log(LogLevel level, const std::string& message) const
+    {
+        log(*config(), level, message);
+    }
+
+    // ──────────────────────────── 初始化 ────────────────────────────────
+
+    void init_session()
+    {
+        session_.open("DrxHttpClient/2.0");
+    }
+
+    // ──────────────────── 请求头组装 ───────────────────────────────────
+
+    /// defaultHeaders + 用户 headers + extra + Cookie + Session header，
+    /// 输出 "Name: value\r\n" 形式的头块，由传输层按平台转换。
+    std::string build_request_headers(const Config& cfg,
+                                      const Headers& headers,
+                                      const detail::UrlParts& url,
+                                      const std::string& extra = {},
+                                      bool asciiValues = true) const
+    {
+        std::string out = cfg.defaultHeaderBlock;
+        out += extra;
+        for (const auto& [k, v] : headers.fields()) {
+            out.append(k);
+            out.append(": ", 2);
+            if (asciiValues) out += detail::ensure_ascii_header(v);
+            else             out.append(v);
+            out.append("\r\n", 2);
+        }
+
+        cookies_.appendHeader(out, url, unix_now());
+
+        apply_session_header(cfg, out);
+        return out;
+    }
+
+    static void reencode_default_headers(Config& cfg)
+    {
+        cfg.defaultHeaderBlock.clear();
+        cfg.defaultHeaders.serialize(cfg.defaultHeaderBlock);
+        cfg.defaultAcceptEncoding = cfg.defaultHeaders.contains("Accept-Encoding");
+    }
+
+    // ──────────────────── 内容编码 ─────────────────────────────────────
+
+    /// 开启了响应解压且调用方 / 默认头都没有自行设置 Accept-Encoding 时，声明已启用的编码并标记 spec 需要解压
+    static void add_accept_encoding(const Config& cfg, detail::RequestSpec& spec, const Headers& headers,
+                                    std::string& extra)
+    {
+        const auto& value = detail::accept_encoding_value();
+        if (value.empty()) return;
+        if (!cfg.compression.decompressResponses || cfg.defaultAcceptEncoding) return;
+        if (headers.contains("Accept-Encoding")) return;
+        extra += "Accept-Encoding: " + value + "\r\n";
+        spec.decodeContent = true;
+    }
+
+    /// 请求体达到 requestMinBytes 且 Content-Type 可压缩时压缩，spec.body 改指向压缩结果并追加 Content-Encoding。
+    /// 调用方已自行设置 Content-Encoding、或压缩后没有变小时按原样发送
+    static void encode_request_body(const Config& cfg, detail::RequestSpec& spec, const Headers& headers,
+                                    std::string& extra)
+    {
+        if (!spec.body || spec.bodyLen == 0 || spec.bodyLen > 0x7fffffff) return;
+        const CompressionOptions& options = cfg.compression;
+        if (options.requestMinBytes == 0 || spec.bodyLen < options.requestMinBytes) return;
+        auto coding = detail::parse_content_coding(options.requestEncoding);
+        if (coding == detail::ContentCoding::Identity || coding == detail::ContentCoding::Unsupported) return;
+        if (headers.contains("Content-Encoding")) return;
+
+        auto contentType = detail::to_lower(detail::get_header_ci(headers, "Content-Type"));
+        if (contentType.empty() && extra.find("Content-Type:") != std::string::npos) contentType = "application/json";
+        bool compressible = std::any_of(options.compressibleTypes.begin(), options.compressibleTypes.end(),
+            [&](const std::string& type) { return !type.empty() && contentType.find(detail::to_lower(type)) != std::string::npos; });
+        if (!compressible) return;
+
+        uint64_t start = detail::thread_cpu_ns();
+        auto encoded = std::make_shared<const std::vector<uint8_t>>(
+            detail::compress_content(coding, spec.body, spec.bodyLen, options.level));
+        double cpuMs = (double)(detail::thread_cpu_ns() - start) / 1e6;
+        if (encoded->size() >= spec.bodyLen) return;
+
+        spec.compression.requestEncoding  = detail::content_coding_name(coding);
+        spec.compression.requestBytes     = spec.bodyLen;
+        spec.compression.requestWireBytes = encoded->size();
+        spec.compression.encodeCpuMs      = cpuMs;
+        spec.encodedBody = std::move(encoded);
+        spec.body        = spec.encodedBody->data();
+        spec.bodyLen     = spec.encodedBody->size();
+        extra += "Content-Encoding: " + spec.compression.requestEncoding + "\r\n";
+    }
+
+    // ──────────────────── Session Header 注入 ──────────────────────────
+
+    void apply_session_header(const Config& cfg, std::string& outHeaders) const
+    {
+        if (!cfg.sessionHeaderName.empty()) {
+            auto sid = session_id(cfg);
+            if (!sid.empty()) {
+                outHeaders += cfg.sessionHeaderName + ": " + detail::ensure_ascii_header(sid) + "\r\n";
+            }
+        }
+    }
+
+    std::string session_id(const Config& cfg) const
+    {
+        return cookies_.valueOf(cfg.sessionCookieName, unix_now());
+    }
+
+    static int64_t unix_now() { return detail::unix_time_ms() / 1000; }
+
+    // ──────────────────── 共享响应 (缓存 → 合并 → 网络) ───────────────
+
+    std::shared_ptr<const HttpResponse> send_shared(const std::string& method, const std::string& url,
+                                                    const Headers& headers, const QueryParams& query,
+                                                    CancelToken* cancel)
+    {
+        if (cacheable(method)) return send_cached(url, headers, query, cancel);
+        return send_network(method, url, headers, query, cancel);
+    }
+
+    std::shared_ptr<const HttpResponse> send_network(const std::string& method, const std::string& url,
+                                                     const Headers& headers, const QueryParams& query,
+                                                     CancelToken* cancel)
+    {
+        if (coalescable(method)) return send_coalesced(method, url, headers, query, cancel);
+        return std::make_shared<const HttpResponse>(send_with_retry(method, url, "", {}, headers, query, cancel));
+    }
+
+    // ──────────────────── 响应缓存 ─────────────────────────────────────
+
+    bool cacheable(const std::string& method) const { return method == "GET" && cache_.enabled(); }
+
+    /// 不安全方法成功后使该 URL 的缓存失效 (RFC 9111 §4.4)
+    void invalidate_after(const std::string& method, const detail::UrlParts& url, int statusCode)
+    {
+        if (!cache_.enabled() || statusCode < 200 || statusCode >= 400) return;
+        if (method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "TRACE") return;
+        cache_.remove("GET " + detail::url_identity(url));
+    }
+
+    void invalidate_after(const std::string& method, const std::string& url, const QueryParams& query, int statusCode)
+    {
+        if (!cache_.enabled()) return;
+        invalidate_after(method, detail::parse_url(detail::resolve_url(baseAddress_, detail::build_url(url, query))), statusCode);
+    }
+
+    /// 经响应缓存发送 GET: 新鲜命中直接返回缓存的响应；过期时带验证头发送条件请求，
+    /// 304 时返回缓存的响应体；stale-while-revalidate 窗口内先返回旧响应并在后台刷新
+    std::shared_ptr<const HttpResponse> send_cached(const std::string& url, const Headers& headers,
+                                                    const QueryParams& query, CancelToken* cancel)
+    {
+        auto parts = detail::parse_url(detail::resolve_url(baseAddress_, detail::build_url(url, query)));
+        auto block = build_request_headers(*config(), headers, parts);
+        auto key = "GET " + detail::url_identity(parts);
+
+        // 调用方自己发送条件 / 范围请求或要求 no-store 时绕过缓存
+        auto reqCc = detail::parse_cache_control(detail::header_block_values(block, "Cache-Control"));
+        for (const char* name : { "If-None-Match", "If-Modified-Since", "If-Match", "If-Unmodified-Since", "If-Range", "Range" }) {
+            if (detail::header_block_has(block, name)) return send_network("GET", url, headers, query, cancel);
+        }
+        if (reqCc.count("no-store")) return send_network("GET", url, headers, query, cancel);
+        bool reqNoCache = reqCc.count("no-cache") > 0 ||
+                          (reqCc.empty() && detail::iequals(detail::header_block_values(block, "Pragma"), "no-cache"));
+        int64_t reqMaxAge = detail::directive_seconds(reqCc, "max-age");
+
+        auto entry = cache_.lookup(key, block);
+        Headers conditional = headers;
+        if (entry) {
+            int64_t age = entry->ageMs(detail::unix_time_ms());
+            bool usable = !entry->noCache && !reqNoCache && (reqMaxAge < 0 || age <= reqMaxAge * 1000);
+            if (usable && age < entry->freshnessMs) {
+                cache_.recordHit(entry->response->bodyBytes.size());
+                return entry->response;
+            }
+            if (usable && !entry->mustRevalidate && age < entry->freshnessMs + entry->swrMs) {
+                cache_.recordStaleHit(entry->response->bodyBytes.size());
+                revalidate_in_background(entry, url, headers, query, block);
+                return entry->response;
+            }
+            if (!entry->etag.empty())         conditional["If-None-Match"] = entry->etag;
+            if (!entry->lastModified.empty()) conditional["If-Modified-Since"] = entry->lastModified;
+        }
+
+        int64_t requestTimeMs = detail::unix_time_ms();
+        auto resp = send_network("GET", url, conditional, query, cancel);
+        return absorb_response(key, entry, std::move(resp), block, requestTimeMs, true);
+    }
+
+    /// 用网络响应更新缓存，返回交给调用方的响应 (304 时为缓存的响应)
+    std::shared_ptr<const HttpResponse> absorb_response(const std::string& key,
+                                                        const std::shared_ptr<detail::CacheEntry>& entry,
+                                                        std::shared_ptr<const HttpResponse> resp,
+                                                        const std::string& block, int64_t requestTimeMs,
+                                                        bool countStats)
+    {
+        int64_t responseTimeMs = detail::unix_time_ms();
+        bool heuristic = cache_.heuristicFreshness();
+        if (resp->statusCode == 304 && entry) {
+            Headers merged;
+            auto served = detail::merge_not_modified(entry->response, *resp, merged);
+            if (auto updated = detail::make_cache_entry(key, served, merged, block, requestTimeMs, responseTimeMs, heuristic))
+                cache_.store(updated);
+            if (countStats) cache_.recordRevalidated(served->bodyBytes.size());
+            return served;
+        }
+
+        if (countStats) cache_.recordMiss();
+        if (auto fresh = detail::make_cache_entry(key, resp, resp->headers, block, requestTimeMs, responseTimeMs, heuristic))
+            cache_.store(fresh);
+        return resp;
+    }
+
+    /// stale-while-revalidate: 经异步引擎发送条件请求，完成后更新缓存。同一条目同时只刷新一次
+    void revalidate_in_background(const std::shared_ptr<detail::CacheEntry>& entry, const std::string& url,
+                                  const Headers& headers, const QueryParams& query, const std::string& block)
+    {
+        if (entry->revalidating.exchange(true)) return;
+
+        HttpRequest req;
+        req.url = url;
+        req.headers = headers;
+        req.query = query;
+        if (!entry->etag.empty())         req.headers["If-None-Match"] = entry->etag;
+        if (!entry->lastModified.empty()) req.headers["If-Modified-Since"] = entry->lastModified;
+        int64_t requestTimeMs = detail::unix_time_ms();
+        try {
+            sendAsync(req, [this, entry, block, requestTimeMs](HttpResponse resp, std::exception_ptr error) {
+                if (!error) {
+                    absorb_response(entry->key, entry, std::make_shared<const HttpResponse>(std::move(resp)),
+                                    block, requestTimeMs, false);
+                }
+                entry->revalidating.store(false);
+            });
+        } catch (const std::exception& ex) {
+            log(LogLevel::Warn, std::string("Background revalidation failed: ") + ex.what());
+            entry->revalidating.store(false);
+        }
+    }
+
+    // ──────────────────── 请求合并 ─────────────────────────────────────
+
+    bool coalescable(const std::string& method) const
+    {
+        if (method != "GET" && method != "HEAD") return false;
+        return config()->coalescing.enabled;
+    }
+
+    /// 合并键: 方法 + 解析后的完整 URL + 选定请求头在最终头块 (含默认头与 Cookie) 中的值
+    std::string coalesce_key(const std::string& method, const std::string& url,
+                             const Headers& headers, const QueryParams& query) const
+    {
+        auto fullUrl = detail::resolve_url(baseAddress_, detail::build_url(url, query));
+        auto parts   = detail::parse_url(fullUrl);
+        auto cfg     = config();
+        auto block   = build_request_headers(*cfg, headers, parts);
+
+        std::vector<std::string> vary = cfg->coalescing.varyHeaders;
+        // 响应缓存发出的条件请求只与验证头相同的请求合并
+        vary.push_back("If-None-Match");
+        vary.push_back("If-Modified-Since");
+        std::string key = method + " " + detail::url_identity(parts);
+        for (const auto& name : vary) {
+            key += '\n';
+            key += detail::to_lower(name);
+            key += ": ";
+            key += detail::header_block_values(block, name);
+        }
+        return key;
+    }
+
+    /// 首个调用方 (leader) 发出请求 (含重试)，同键的并发调用方等待并共享其结果。
+    /// 等待中的调用方可各自取消；leader 因自身取消而失败时，其余调用方重新发起
+    std::shared_ptr<const HttpResponse> send_coalesced(const std::string& method, const std::string& url,
+                                                       const Headers& headers, const QueryParams& query,
+                                                       CancelToken* cancel)
+    {
+        auto key = coalesce_key(method, url, headers, query);
+        while (true) {
+            std::shared_ptr<Flight> flight;
+            bool leader = false;
+            {
+                std::lock_guard<std::mutex> lock(flightsMu_);
+                auto& slot = flights_[key];
+                if (!slot) { slot = std::make_shared<Flight>(); leader = true; }
+                flight = slot;
+            }
+
+            if (leader) {
+                coalesceLeaders_++;
+                std::shared_ptr<const HttpResponse> response;
+                std::exception_ptr error;
+                try {
+                    response = std::make_shared<const HttpResponse>(send_with_retry(method, url, "", {}, headers, query, cancel));
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                {
+                    // 先摘除再公布结果: 此后到达的调用方发起新的请求，不会拿到过时的结果
+                    std::lock_guard<std::mutex> lock(flightsMu_);
+                    flights_.erase(key);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(flight->mu);
+                    flight->response = response;
+                    flight->error = error;
+                    flight->leaderCancelled = error && cancel && cancel->isCancelled();
+                    flight->done = true;
+                }
+                flight->cv.notify_all();
+                if (error) std::rethrow_exception(error);
+                return response;
+            }
+
+            coalesceHits_++;
+            std::unique_lock<std::mutex> lock(flight->mu);
+            while (!flight->done) {
+                if (cancel && cancel->isCancelled()) throw std::runtime_error("Request cancelled");
+                flight->cv.wait_for(lock, std::chrono::milliseconds(cancel ? 10 : 1000));
+            }
+            if (!flight->error) return flight->response;
+            if (flight->leaderCancelled) continue;
+            std::rethrow_exception(flight->error);
+        }
+    }
+
+    // ──────────────────── 核心发送 ─────────────────────────────────────
+
+    /// 解析 URL、组装请求头；spec.body 指向 body / bodyBytes (调用方保证其生命周期)。
+    /// cfg 由调用方在请求开始时取一次，重试的各次尝试共用同一份快照
+    detail::RequestSpec make_request_spec(const Config& cfg,
+                                          const std::string& method,
+                                          const std::string& url,
+                                          const std::string& body,
+                                          const std::vector<uint8_t>& bodyBytes,
+                                          const Headers& headers,
+                                          const QueryParams& query) const
+    {
+        auto fullUrl = detail::resolve_url(baseAddress_, detail::build_url(url, query));
+        auto parts   = detail::parse_url(fullUrl);
+
+        log(cfg, LogLevel::Debug, method + " " + fullUrl);
+
+        // Content-Type 默认 JSON
+        std::string extra;
+        if (!body.empty() && !headers.contains("Content-Type"))
+            extra = "Content-Type: application/json; charset=utf-8\r\n";
+
+        detail::RequestSpec spec;
+        spec.method = method;
+        spec.url = parts;
+        spec.timeoutMs = cfg.timeoutMs;
+        spec.ignoreSslErrors = ignoreSslErrors_.load();
+        if (!bodyBytes.empty()) { spec.body = bodyBytes.data(); spec.bodyLen = bodyBytes.size(); }
+        else if (!body.empty()) { spec.body = body.data(); spec.bodyLen = body.size(); }
+        encode_request_body(cfg, spec, headers, extra);
+        add_accept_encoding(cfg, spec, headers, extra);
+        spec.headers = build_request_headers(cfg, headers, parts, extra);
+        return spec;
+    }
+
+    HttpResponse send_internal(const Config& cfg,
+                               const std::string& method,
+                               const std::string& url,
+                               const std::string& body,
+                               const std::vector<uint8_t>& bodyBytes,
+                               const Headers& headers,
+                               const QueryParams& query,
+                               CancelToken* cancel,
+                               std::vector<uint8_t>& bodyStorage,
+                               detail::BodyStream* bodyStream = nullptr)
+    {
+        auto spec = make_request_spec(cfg, method, url, body, bodyBytes, headers, query);
+        if (bodyStream) {
+            spec.bodyStream = bodyStream;
+            spec.bodyLen = (size_t)bodyStream->size();
+        }
+
+        // 检查取消
+        if (cancel && cancel->isCancelled())
+            throw std::runtime_error("Request cancelled");
 
-    // ──────────────────────────── 字段 ──────────────────────────────────
+        // 发送
+        detail::HttpExchange exchange(session_);
+        exchange.open(spec);
 
-    detail::WinHttpHandle   hSession_;
-    std::string             baseAddress_;
-    Headers                 defaultHeaders_;
-    mutable std::mutex      mu_;
-    LogCallback             logCallback_;
+        HttpResponse resp = read_response(exchange, spec, bodyStorage);
+        compressionCounters_.add(resp.compression);
 
-    // Cookie
-    std::vector<Cookie>     cookies_;
-    std::string             sessionCookieName_ = "session_id";
-    std::string             sessionHeaderName_;
+        if (autoManageCookies_.load())
+            parse_set_cookies(exchange.headers(), spec.url);
 
-    // 线程安全属性
-    std::atomic<bool>       autoManageCookies_{true};
-    std::atomic<bool>       ignoreSslErrors_{false};
-    std::atomic<int>        timeoutMs_{0};
-
-    // 重试
-    RetryPolicy             retryPolicy_;
-
-    // 请求队列
-    struct QueueEntry {
-        HttpRequest                         request;
-        std::function<void(HttpResponse)>   callback;
-    };
-    std::queue<QueueEntry>          queue_;
-    std::mutex                      queueMu_;
-    std::condition_variable         queueCv_;
-    std::thread                     queueThread_;
-    std::atomic<bool>               queueRunning_{false};
-    int                             maxConcurrent_ = 10;
-    std::atomic<int>                activeTasks_{0};
-    std::mutex                      concurrencyMu_;
-    std::condition_variable         concurrencyCv_;
-
-    // 工作线程追踪 (防止 UAF)
-    std::vector<std::thread>        workerThreads_;
-    std::mutex                      workerMu_;
+        log(cfg, LogLevel::Debug, "Response: " + std::to_string(resp.statusCode) + " " + resp.reasonPhrase);
+        return resp;
+        // RAII: exchange 析构时关闭连接
+    }
 
-    // ──────────────────────────── 日志 ──────────────────────────────────
+    // ──────────────────── 响应读取 ─────────────────────────────────────
 
-    void log(LogLevel level, const std::string& message) const
+    /// 响应体读入 storage (复用其容量) 后移入响应。压缩的响应边读边解压进 storage，
+    /// 此时 Content-Length 是压缩后的长度，只作预分配的下限
+    static HttpResponse read_response(detail::HttpExchange& exchange, const detail::RequestSpec& spec,
+                                      std::vector<uint8_t>& storage)
     {
-        std::lock_guard<std::mutex> lock(mu_);
-        if (logCallback_) {
-            try { logCallback_(level, message); } catch (...) {}
+        int status = exchange.statusCode();
+        bool noBody = spec.method == "HEAD" || status == 204 || status == 304 || (status >= 100 && status < 200);
+        int64_t length = noBody ? 0 : detail::content_length_of(exchange.headers());
+        auto decoder = detail::ResponseDecoder::create(spec, status, exchange.headers());
+        if (decoder) {
+            detail::DecodedSource<detail::HttpExchange> source{ exchange, *decoder };
+            read_body(source, storage, length);
+        } else {
+            read_body(exchange, storage, length);
         }
+        auto resp = make_response(status, exchange.reasonPhrase(), exchange.headers(), std::move(storage));
+        resp.compression = spec.compression;
+        if (decoder) apply_decoded(resp, *decoder);
+        return resp;
     }
 
-    // ──────────────────────────── 初始化 ────────────────────────────────
-
-    void init_session()
+    /// 已解压响应: 记录解压统计并移除与 body 不再对应的 Content-Encoding / Content-Length
+    static void apply_decoded(HttpResponse& resp, const detail::ResponseDecoder& decoder)
     {
-        hSession_.reset(WinHttpOpen(L"DrxHttpClient/2.0",
-                                    WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-                                    WINHTTP_NO_PROXY_NAME,
-                                    WINHTTP_NO_PROXY_BYPASS, 0));
-        if (!hSession_)
-            throw std::runtime_error("WinHttpOpen failed");
+        const auto& info = decoder.info();
+        resp.compression.encoding          = info.encoding;
+        resp.compression.compressedBytes   = info.compressedBytes;
+        resp.compression.decompressedBytes = info.decompressedBytes;
+        resp.compression.decodeCpuMs       = info.decodeCpuMs;
+        detail::strip_content_coding_headers(resp.headers);
     }
 
-    // ──────────────────── SSL 标志 ─────────────────────────────────────
-
-    void apply_ssl_flags(HINTERNET hRequest, bool isHttps) const
+    /// 读取全部响应体到 body。Content-Length 已知时按长度一次分配 (上限 64 MB)，直接读入最终位置；
+    /// 长度未知时先填满 body 已有的容量，其余读入倍增的块链，结束时一次拼接。
+    /// 传输层能直接读入调用方缓冲区 (Linux 纯 body 段、WinHTTP) 时，每个字节只复制一次。
+    /// Source 为 HttpExchange 或 DecodedSource (解压后的数据同样直接写入最终位置)
+    template <class Source>
+    static void read_body(Source& exchange, std::vector<uint8_t>& body, int64_t expectedLength)
     {
-        if (isHttps && ignoreSslErrors_.load()) {
-            DWORD sslFlags = SECURITY_FLAG_IGNORE_UNKNOWN_CA |
-                             SECURITY_FLAG_IGNORE_CERT_DATE_INVALID |
-                             SECURITY_FLAG_IGNORE_CERT_CN_INVALID |
-                             SECURITY_FLAG_IGNORE_CERT_WRONG_USAGE;
-            WinHttpSetOption(hRequest, WINHTTP_OPTION_SECURITY_FLAGS, &sslFlags, sizeof(sslFlags));
+        constexpr size_t kFirstBlock = 64 * 1024;
+        constexpr size_t kMaxBlock   = 8 * 1024 * 1024;
+
+        size_t target = expectedLength >= 0 ? (size_t)std::min<int64_t>(expectedLength, 64ll << 20) : body.capacity();
+        body.resize(target);
+        size_t size = 0;
+        while (size < target) {
+            size_t n = exchange.read(body.data() + size, target - size);
+            if (n == 0) { body.resize(size); return; }
+            size += n;
         }
-    }
-
-    // ──────────────────── Session Header 注入 ──────────────────────────
 
-    void apply_session_header(std::wstring& outHeaders) const
-    {
-        std::string headerName;
+        struct Block
         {
-            std::lock_guard<std::mutex> lock(mu_);
-            headerName = sessionHeaderName_;
+            std::unique_ptr<uint8_t[]> data;
+            size_t                     capacity = 0;
+            size_t                     used = 0;
+        };
+        std::vector<Block> blocks;
+        size_t chained = 0;
+
+        // 已按 Content-Length 读满: 再读一次确认结束 (HTTP/1.1 连接由此归还连接池)，正常不会再有数据
+        if (expectedLength >= 0) {
+            uint8_t probe[1024];
+            size_t n = exchange.read(probe, sizeof(probe));
+            if (n == 0) return;
+            blocks.push_back(Block{ std::unique_ptr<uint8_t[]>(new uint8_t[kFirstBlock]), kFirstBlock, n });
+            std::memcpy(blocks.back().data.get(), probe, n);
+            chained = n;
         }
-        if (!headerName.empty()) {
-            auto sid = getSessionId();
-            if (!sid.empty()) {
-                outHeaders += detail::to_wide(headerName) + L": " + detail::to_wide(detail::ensure_ascii_header(sid)) + L"\r\n";
+
+        while (true) {
+            if (blocks.empty() || blocks.back().used == blocks.back().capacity) {
+                size_t next = blocks.empty() ? std::max(kFirstBlock, std::min(size, kMaxBlock))
+                                             : std::min(blocks.back().capacity * 2, kMaxBlock);
+                blocks.push_back(Block{ std::unique_ptr<uint8_t[]>(new uint8_t[next]), next, 0 });
             }
+            auto& block = blocks.back();
+            size_t n = exchange.read(block.data.get() + block.used, block.capacity - block.used);
+            if (n == 0) break;
+            block.used += n;
+            chained += n;
         }
-    }
+        if (chained == 0) return;
 
-    // ──────────────────── 核心发送 ─────────────────────────────────────
+        body.resize(size + chained);
+        for (const auto& block : blocks) {
+            std::memcpy(body.data() + size, block.data.get(), block.used);
+            size += block.used;
+        }
+    }
 
-    HttpResponse send_internal(const std::string& method,
-                               const std::string& url,
-                               const std::string& body,
-                               const std::vector<uint8_t>& bodyBytes,
-                               const Headers& headers,
-                               const QueryParams& query,
-                               CancelToken* cancel)
+    static HttpResponse make_response(int statusCode, const std::string& reasonPhrase,
+                                      const detail::HeaderList& headers, std::vector<uint8_t> body)
     {
-        auto fullUrl = detail::resolve_url(baseAddress_, detail::build_url(url, query));
-        auto parts   = detail::parse_url(fullUrl);
+        HttpResponse resp;
+        resp.statusCode   = statusCode;
+        resp.reasonPhrase = reasonPhrase;
+
+        resp.headers = headers;   // 同一种容器，整体复制两块连续内存
 
-        log(LogLevel::Debug, method + " " + fullUrl);
+        resp.bodyBytes = std::move(body);
+        return resp;
+    }
 
-        auto wHost   = detail::to_wide(parts.host);
-        auto wPath   = detail::to_wide(parts.path);
-        auto wMethod = detail::to_wide(method);
+    // ──────────────────── 下载辅助 ─────────────────────────────────────
 
-        detail::WinHttpHandle hConnect(WinHttpConnect(hSession_.get(), wHost.c_str(),
-                                                       (INTERNET_PORT)parts.port, 0));
-        if (!hConnect)
-            throw std::runtime_error("WinHttpConnect failed: " + parts.host);
+    detail::RequestSpec download_spec(const detail::UrlParts& parts, const Headers& headers) const
+    {
+        return download_spec(*config(), parts, headers);
+    }
 
-        DWORD flags = parts.isHttps ? WINHTTP_FLAG_SECURE : 0;
-        detail::WinHttpHandle hRequest(WinHttpOpenRequest(hConnect.get(), wMethod.c_str(),
-                                                           wPath.c_str(), nullptr,
-                                                           WINHTTP_NO_REFERER,
-                                                           WINHTTP_DEFAULT_ACCEPT_TYPES, flags));
-        if (!hRequest)
-            throw std::runtime_error("WinHttpOpenRequest failed");
+    detail::RequestSpec download_spec(const Config& cfg, const detail::UrlParts& parts, const Headers& headers) const
+    {
+        detail::RequestSpec spec;
+        spec.method = "GET";
+        spec.url = parts;
+        spec.headers = build_request_headers(cfg, headers, parts);
+        spec.timeoutMs = cfg.timeoutMs;
+        spec.ignoreSslErrors = ignoreSslErrors_.load();
+        spec.errorPrefix = "Download: ";
+        return spec;
+    }
 
-        // SSL
-        apply_ssl_flags(hRequest.get(), parts.isHttps);
+    void open_download_request(const detail::UrlParts& parts, const Headers& headers, detail::HttpExchange& exchange)
+    {
+        exchange.open(download_spec(parts, headers));
+    }
 
-        // 超时
-        int timeout = timeoutMs_.load();
-        if (timeout > 0)
-            WinHttpSetTimeouts(hRequest.get(), timeout, timeout, timeout, timeout);
+    // ──────────────────── 断点续传 ─────────────────────────────────────
 
-        // Headers
-        std::wstring allHeaders;
+    /// ".download.meta" 旁路记录: 续传所需的校验器与已确认写入临时文件的字节数
+    struct PartialDownload
+    {
+        std::string url;
+        std::string etag;
+        std::string lastModified;
+        int64_t     offset = 0;
+        int64_t     total  = -1;
+
+        /// If-Range 只接受强 ETag，否则用 Last-Modified；都没有时不能安全续传
+        std::string validator() const
         {
-            std::lock_guard<std::mutex> lock(mu_);
-            for (auto& [k, v] : defaultHeaders_)
-                allHeaders += detail::to_wide(k) + L": " + detail::to_wide(v) + L"\r\n";
+            if (!etag.empty() && etag.rfind("W/", 0) != 0) return etag;
+            return lastModified;
         }
-        for (auto& [k, v] : headers)
-            allHeaders += detail::to_wide(k) + L": " + detail::to_wide(detail::ensure_ascii_header(v)) + L"\r\n";
 
-        // Content-Type 默认 JSON
-        if (!body.empty() && headers.find("Content-Type") == headers.end())
-            allHeaders += L"Content-Type: application/json; charset=utf-8\r\n";
+        static bool load(const std::string& metaFile, PartialDownload& out)
+        {
+            std::ifstream ifs(metaFile);
+            if (!ifs) return false;
+            std::string line;
+            while (std::getline(ifs, line)) {
+                auto eq = line.find('=');
+                if (eq == std::string::npos) continue;
+                auto key = line.substr(0, eq), value = line.substr(eq + 1);
+                try {
+                    if (key == "url")                out.url = value;
+                    else if (key == "etag")          out.etag = value;
+                    else if (key == "last-modified") out.lastModified = value;
+                    else if (key == "offset")        out.offset = std::stoll(value);
+                    else if (key == "total")         out.total = std::stoll(value);
+                } catch (...) {
+                    return false;
+                }
+            }
+            return !out.url.empty();
+        }
 
-        // Cookie header
-        auto cookieHeader = build_cookie_header(parts.host);
-        if (!cookieHeader.empty())
-            allHeaders += L"Cookie: " + detail::to_wide(cookieHeader) + L"\r\n";
+        /// 先写临时名再改名，中途崩溃不会留下半截记录
+        void save(const std::string& metaFile) const
+        {
+            auto tmp = metaFile + ".new";
+            {
+                std::ofstream ofs(tmp, std::ios::trunc);
+                ofs << "url=" << url << "\n"
+                    << "etag=" << etag << "\n"
+                    << "last-modified=" << lastModified << "\n"
+                    << "offset=" << offset << "\n"
+                    << "total=" << total << "\n";
+                if (!ofs) return;
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmp, metaFile, ec);
+        }
+    };
 
-        // Session header
-        apply_session_header(allHeaders);
+    /// downloadFile / downloadFileWithHash / downloadFileWithMetadata 的实现。每次尝试: 有可用的断点时带 Range + If-Range，
+    /// 206 追加、200 从头写、416 丢弃断点重来；body 每写入 4 MB 落盘并更新旁路记录，
+    /// 失败或取消时记录当前位置后抛出 (可重试的错误按重试策略从断点继续)。
+    /// 指定 hashAlgorithm 时边接收边计算摘要写入 result.fileHash，与 expectedHash 不符则在替换目标文件前失败
+    DownloadResult download_resumable(const std::string& url, const std::string& destPath, const Headers& headers,
+                                      const QueryParams& query, const ProgressCallback& progress, CancelToken* cancel,
+                                      std::optional<HashAlgorithm> hashAlgorithm = std::nullopt,
+                                      const std::string& expectedHash = {})
+    {
+        namespace fs = std::filesystem;
+        constexpr int64_t kCheckpointBytes = 4 * 1024 * 1024;
 
-        if (!allHeaders.empty())
-            WinHttpAddRequestHeaders(hRequest.get(), allHeaders.c_str(), (DWORD)allHeaders.size(), WINHTTP_ADDREQ_FLAG_ADD);
+        auto fullUrl = detail::resolve_url(baseAddress_, detail::build_url(url, query));
+        auto parts   = detail::parse_url(fullUrl);
 
-        // 检查取消
-        if (cancel && cancel->isCancelled())
-            throw std::runtime_error("Request cancelled");
+        auto dir = fs::path(destPath).parent_path();
+        if (!dir.empty()) fs::create_directories(dir);
+        auto tempFile = destPath + ".download.tmp";
+        auto metaFile = destPath + ".download.meta";
 
-        // 发送
-        const void* bodyPtr = nullptr;
-        DWORD bodyLen = 0;
-        if (!bodyBytes.empty()) { bodyPtr = bodyBytes.data(); bodyLen = (DWORD)bodyBytes.size(); }
-        else if (!body.empty()) { bodyPtr = body.data(); bodyLen = (DWORD)body.size(); }
+        auto cfg = config();
+        const RetryPolicy& policy = cfg->retryPolicy;
 
-        BOOL ok = WinHttpSendRequest(hRequest.get(),
-                                      WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-                                      (LPVOID)bodyPtr, bodyLen, bodyLen, 0);
-        if (!ok)
-            throw std::runtime_error("WinHttpSendRequest failed: " + detail::winhttp_error_string(GetLastError()));
+        for (int attempt = 0; ; ++attempt) {
+            if (cancel && cancel->isCancelled()) throw std::runtime_error("Download cancelled");
 
-        ok = WinHttpReceiveResponse(hRequest.get(), nullptr);
-        if (!ok)
-            throw std::runtime_error("WinHttpReceiveResponse failed: " + detail::winhttp_error_string(GetLastError()));
+            // 可续传的断点: 临时文件与记录都在、URL 一致且有校验器
+            PartialDownload partial;
+            std::error_code ec;
+            int64_t onDisk = fs::exists(tempFile, ec) ? (int64_t)fs::file_size(tempFile, ec) : 0;
+            bool resume = onDisk > 0 && PartialDownload::load(metaFile, partial) && partial.url == fullUrl
+                          && !partial.validator().empty() && partial.offset > 0;
+            int64_t offset = resume ? std::min(onDisk, partial.offset) : 0;
+
+            Headers requestHeaders = headers;
+            if (resume) {
+                requestHeaders["Range"] = "bytes=" + std::to_string(offset) + "-";
+                requestHeaders["If-Range"] = partial.validator();
+            }
 
-        HttpResponse resp = read_response(hRequest.get());
+            DownloadResult result;
+            PartialDownload record;
+            try {
+                detail::HttpExchange exchange(session_);
+                exchange.open(download_spec(parts, requestHeaders));
+                int status = exchange.statusCode();
 
-        if (autoManageCookies_.load())
-            parse_set_cookies(hRequest.get(), parts.host);
+                if (resume && status == 416) {
+                    log(LogLevel::Warn, "Download: stale partial file discarded (416): " + tempFile);
+                    discardPartialDownload(destPath);
+                    continue;
+                }
+                if (attempt < policy.maxRetries && policy.shouldRetry && policy.shouldRetry(status))
+                    throw std::runtime_error("Download: HTTP " + std::to_string(status));
+
+                int64_t first = 0, last = 0, total = -1;
+                bool append = resume && status == 206
+                    && detail::parse_content_range(detail::find_header(exchange.headers(), "Content-Range"), first, last, total)
+                    && first == offset;
+                if (resume && !append && status >= 200 && status < 300)
+                    log(LogLevel::Info, "Download: resource changed or range ignored, restarting: " + url);
+                else if (resume && !append)
+                    throw std::runtime_error("Download failed: HTTP " + std::to_string(status) + " " + exchange.reasonPhrase());
+                if (!append) {
+                    offset = 0;
+                    total = detail::content_length_of(exchange.headers());
+                }
 
-        log(LogLevel::Debug, "Response: " + std::to_string(resp.statusCode) + " " + resp.reasonPhrase);
-        return resp;
-        // RAII: hRequest 和 hConnect 自动关闭
-    }
+                result.statusCode  = append ? 200 : status;
+                result.totalBytes  = total;
+                result.contentType = detail::find_header(exchange.headers(), "Content-Type");
+                result.etag        = detail::find_header(exchange.headers(), "ETag");
+                auto meta = detail::find_header(exchange.headers(), "X-MetaData");
+                if (!meta.empty()) result.serverMetadata["X-MetaData"] = meta;
+
+                record.url          = fullUrl;
+                record.etag         = result.etag;
+                record.lastModified = detail::find_header(exchange.headers(), "Last-Modified");
+                record.offset       = offset;
+                record.total        = total;
+
+                if (append) {
+                    fs::resize_file(tempFile, (uintmax_t)offset);
+                    log(LogLevel::Info, "Resuming download at byte " + std::to_string(offset) + ": " + url);
+                }
+                std::ofstream ofs(tempFile, append ? std::ios::binary | std::ios::app : std::ios::binary | std::ios::trunc);
+                if (!ofs)
+                    throw std::runtime_error("Cannot create temp file: " + tempFile);
+                record.save(metaFile);
+
+                // 有摘要时 body 直接读进流水线的块，写盘后交给摘要线程
+                std::unique_ptr<detail::HashPipeline> hasher;
+                if (hashAlgorithm) hasher = std::make_unique<detail::HashPipeline>(*hashAlgorithm, tempFile, offset);
+
+                char buf[81920];
+                size_t bytesRead = 0;
+                int64_t written = offset, checkpoint = offset;
+                try {
+                    for (;;) {
+                        char* dst = hasher ? hasher->space() : buf;
+                        bytesRead = exchange.read(dst, hasher ? hasher->capacity() : sizeof(buf));
+                        if (bytesRead == 0) break;
+                        if (cancel && cancel->isCancelled()) throw std::runtime_error("Download cancelled");
+                        ofs.write(dst, (std::streamsize)bytesRead);
+                        if (!ofs) throw std::runtime_error("Cannot write temp file: " + tempFile);
+                        if (hasher) hasher->commit(bytesRead);
+                        written += (int64_t)bytesRead;
+                        if (written - checkpoint >= kCheckpointBytes) {
+                            ofs.flush();
+                            record.offset = checkpoint = written;
+                            record.save(metaFile);
+                        }
+                        if (progress) progress(written, total);
+                    }
+                    if (total >= 0 && written < total)
+                        throw std::runtime_error("Download: connection closed at byte " + std::to_string(written) + " of " + std::to_string(total));
+                } catch (...) {
+                    ofs.flush();
+                    if (ofs) {
+                        record.offset = written;
+                        record.save(metaFile);
+                    }
+                    throw;
+                }
+                ofs.close();
+                result.downloadedBytes = written;
+                if (hasher) result.fileHash = hasher->finish();
 
-    // ──────────────────── 响应读取 ─────────────────────────────────────
+                if (autoManageCookies_.load()) parse_set_cookies(exchange.headers(), parts);
+            } catch (const std::runtime_error& ex) {
+                bool cancelled = cancel && cancel->isCancelled();
+                if (cancelled || attempt >= policy.maxRetries) throw;
+                int delay = policy.baseDelayMs;
+                if (policy.exponentialBackoff) delay *= (1 << attempt);
+                log(LogLevel::Warn, "Download retrying [" + std::to_string(attempt + 1) + "/" + std::to_string(policy.maxRetries)
+                                    + "] after " + std::to_string(delay) + "ms, error: " + ex.what());
+                std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+                continue;
+            }
 
-    static HttpResponse read_response(HINTERNET hRequest)
-    {
-        HttpResponse resp;
-        resp.statusCode = get_status_code(hRequest);
-
-        // Reason phrase
-        {
-            DWORD size = 0;
-            WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_TEXT,
-                                WINHTTP_HEADER_NAME_BY_INDEX, nullptr, &size,
-                                WINHTTP_NO_HEADER_INDEX);
-            if (GetLastError() == ERROR_INSUFFICIENT_BUFFER && size > 0) {
-                std::wstring val(size / sizeof(wchar_t), 0);
-                if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_TEXT,
-                                        WINHTTP_HEADER_NAME_BY_INDEX, val.data(), &size,
-                                        WINHTTP_NO_HEADER_INDEX))
-                    resp.reasonPhrase = detail::to_utf8(val);
-            }
-        }
-
-        // 所有响应头
-        DWORD headerSize = 0;
-        WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF,
-                            WINHTTP_HEADER_NAME_BY_INDEX, nullptr, &headerSize,
-                            WINHTTP_NO_HEADER_INDEX);
-        if (headerSize > 0) {
-            std::wstring rawHeaders(headerSize / sizeof(wchar_t), 0);
-            WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF,
-                                WINHTTP_HEADER_NAME_BY_INDEX, rawHeaders.data(), &headerSize,
-                                WINHTTP_NO_HEADER_INDEX);
-            auto headersStr = detail::to_utf8(rawHeaders);
-            std::istringstream iss(headersStr);
-            std::string line;
-            while (std::getline(iss, line)) {
-                if (!line.empty() && line.back() == '\r') line.pop_back();
-                auto sepPos = line.find(':');
-                if (sepPos != std::string::npos) {
-                    auto key = line.substr(0, sepPos);
-                    auto val = line.substr(sepPos + 1);
-                    while (!val.empty() && val[0] == ' ') val = val.substr(1);
-                    resp.headers[key] = val;
-                }
+            if (!expectedHash.empty() && !detail::iequals(result.fileHash, expectedHash)) {
+                discardPartialDownload(destPath);
+                throw std::runtime_error("Hash mismatch: expected " + expectedHash + ", got " + result.fileHash);
             }
-        }
 
-        // Body
-        std::vector<uint8_t> allData;
-        char buf[81920];
-        DWORD bytesRead = 0;
-        while (WinHttpReadData(hRequest, buf, sizeof(buf), &bytesRead) && bytesRead > 0) {
-            allData.insert(allData.end(), buf, buf + bytesRead);
-            bytesRead = 0;
+            std::error_code ignored;
+            fs::remove(metaFile, ignored);
+            atomic_file_replace(tempFile, destPath);
+            return result;
         }
-        resp.bodyBytes = std::move(allData);
-        return resp;
     }
 
-    // ──────────────────── 下载辅助 ─────────────────────────────────────
+    // ──────────────────── 分段下载 ─────────────────────────────────────
 
-    void open_download_request(const detail::UrlParts& parts, const Headers& headers,
-                               detail::WinHttpHandle& outConnect, detail::WinHttpHandle& outRequest)
+    /// 一次分段下载的不变参数
+    struct SegmentPlan
     {
-        auto wHost = detail::to_wide(parts.host);
-        outConnect.reset(WinHttpConnect(hSession_.get(), wHost.c_str(), (INTERNET_PORT)parts.port, 0));
-        if (!outConnect) throw std::runtime_error("Download: WinHttpConnect failed");
-
-        auto wPath = detail::to_wide(parts.path);
-        DWORD flags = parts.isHttps ? WINHTTP_FLAG_SECURE : 0;
-        outRequest.reset(WinHttpOpenRequest(outConnect.get(), L"GET", wPath.c_str(), nullptr,
-                                             WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags));
-        if (!outRequest) throw std::runtime_error("Download: WinHttpOpenRequest failed");
+        detail::UrlParts parts;
+        Headers          headers;
+        std::string      validator;   ///< If-Range 的值 (强 ETag 或 Last-Modified)，可为空
+        std::string      tempFile;
+        int64_t          total = 0;
+        int64_t          chunk = 0;
+    };
 
-        apply_ssl_flags(outRequest.get(), parts.isHttps);
+    /// 分段下载的共享状态: 区间按 chunk 依次领取，任一区间失败即整体停止
+    struct SegmentState
+    {
+        std::mutex              mu;
+        std::condition_variable cv;
+        int64_t                 next = 0;        ///< 下一个待领取区间的起点
+        size_t                  running = 0;     ///< 仍在运行的工作线程
+        std::exception_ptr      error;
+        std::atomic<bool>       stopped{ false };
+        std::atomic<int64_t>    received{ 0 };   ///< 已写入临时文件的字节
+
+        bool claim(const SegmentPlan& plan, int64_t& begin, int64_t& end)
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            if (stopped.load() || next >= plan.total) return false;
+            begin = next;
+            end = std::min(plan.total, next + plan.chunk);
+            next = end;
+            return true;
+        }
 
-        int timeout = timeoutMs_.load();
-        if (timeout > 0) WinHttpSetTimeouts(outRequest.get(), timeout, timeout, timeout, timeout);
+        bool pending(const SegmentPlan& plan)
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            return !stopped.load() && next < plan.total;
+        }
 
-        std::wstring wHeaders;
+        void fail(std::exception_ptr e)
         {
-            std::lock_guard<std::mutex> lock(mu_);
-            for (auto& [k, v] : defaultHeaders_)
-                wHeaders += detail::to_wide(k) + L": " + detail::to_wide(v) + L"\r\n";
+            std::lock_guard<std::mutex> lock(mu);
+            if (!error) error = e;
+            stopped = true;
+            cv.notify_all();
         }
-        for (auto& [k, v] : headers)
-            wHeaders += detail::to_wide(k) + L": " + detail::to_wide(detail::ensure_ascii_header(v)) + L"\r\n";
+    };
 
-        auto cookieHdr = build_cookie_header(parts.host);
-        if (!cookieHdr.empty()) wHeaders += L"Cookie: " + detail::to_wide(cookieHdr) + L"\r\n";
+    /// 并行取回 [probeEnd, total)，probe 为已打开的首段 [0, probeEnd) 响应。
+    /// 调用线程负责进度回调、取消与按吞吐增加连接: 每个采样间隔内吞吐比上次提升 10% 以上时再加一条，否则停止增长
+    int64_t download_segments(const SegmentPlan& plan, std::unique_ptr<detail::HttpExchange> probe, int64_t probeEnd,
+                              const SegmentedDownloadOptions& options, const ProgressCallback& progress, CancelToken* cancel)
+    {
+        using Clock = std::chrono::steady_clock;
 
-        apply_session_header(wHeaders);
+        detail::PositionalFile file(plan.tempFile);
+        file.preallocate((uint64_t)plan.total);
 
-        if (!wHeaders.empty())
-            WinHttpAddRequestHeaders(outRequest.get(), wHeaders.c_str(), (DWORD)wHeaders.size(), WINHTTP_ADDREQ_FLAG_ADD);
+        SegmentState st;
+        st.next = probeEnd;
+        std::vector<std::thread> workers;
+        auto spawn = [&](std::unique_ptr<detail::HttpExchange> first, int64_t begin, int64_t end) {
+            {
+                std::lock_guard<std::mutex> lock(st.mu);
+                ++st.running;
+            }
+            try {
+                workers.emplace_back([this, &st, &plan, &file, first = std::move(first), begin, end]() mutable {
+                    segment_worker(st, plan, file, std::move(first), begin, end);
+                });
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(st.mu);
+                --st.running;
+                throw;
+            }
+        };
 
-        if (!WinHttpSendRequest(outRequest.get(), WINHTTP_NO_ADDITIONAL_HEADERS, 0, nullptr, 0, 0, 0) ||
-            !WinHttpReceiveResponse(outRequest.get(), nullptr)) {
-            throw std::runtime_error("Download: send/receive failed: " + detail::winhttp_error_string(GetLastError()));
+        size_t maxSegments = std::max<size_t>(options.maxSegments, 1);
+        try {
+            spawn(std::move(probe), 0, probeEnd);
+            size_t initial = std::min(std::max<size_t>(options.initialSegments, 1), maxSegments);
+            while (workers.size() < initial && st.pending(plan)) spawn(nullptr, 0, 0);
+
+            auto sampleStart = Clock::now();
+            int64_t sampleBytes = 0, reported = -1;
+            double bestRate = 0;
+            bool growing = workers.size() < maxSegments;
+
+            std::unique_lock<std::mutex> lock(st.mu);
+            while (st.running > 0) {
+                st.cv.wait_for(lock, std::chrono::milliseconds(100));
+                lock.unlock();
+
+                if (cancel && cancel->isCancelled() && !st.stopped.load())
+                    st.fail(std::make_exception_ptr(std::runtime_error("Download cancelled")));
+
+                int64_t got = st.received.load();
+                if (progress && got != reported) { progress(got, plan.total); reported = got; }
+
+                auto now = Clock::now();
+                if (growing && now - sampleStart >= std::chrono::milliseconds(std::max(options.sampleMs, 50))) {
+                    double rate = (got - sampleBytes) / std::chrono::duration<double>(now - sampleStart).count();
+                    growing = rate > bestRate * 1.1 && workers.size() < maxSegments && st.pending(plan);
+                    if (growing) {
+                        bestRate = rate;
+                        spawn(nullptr, 0, 0);
+                        log(LogLevel::Debug, "Segmented download: " + std::to_string(workers.size()) + " connections");
+                    }
+                    sampleStart = now;
+                    sampleBytes = got;
+                }
+                lock.lock();
+            }
+        } catch (...) {
+            st.fail(std::current_exception());
         }
-    }
 
-    // ──────────────────── WinHTTP 查询辅助 ─────────────────────────────
+        for (auto& t : workers) t.join();
+        file.close();
+        if (st.error) std::rethrow_exception(st.error);
 
-    static int get_status_code(HINTERNET hRequest)
-    {
-        DWORD statusCode = 0, size = sizeof(statusCode);
-        WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
-                            WINHTTP_HEADER_NAME_BY_INDEX, &statusCode, &size,
-                            WINHTTP_NO_HEADER_INDEX);
-        return (int)statusCode;
+        int64_t got = st.received.load();
+        if (got != plan.total)
+            throw std::runtime_error("Download incomplete: " + std::to_string(got) + " of " + std::to_string(plan.total) + " bytes");
+        if (progress) progress(got, plan.total);
+        return got;
     }
 
-    static int64_t get_content_length(HINTERNET hRequest)
+    void segment_worker(SegmentState& st, const SegmentPlan& plan, detail::PositionalFile& file,
+                        std::unique_ptr<detail::HttpExchange> first, int64_t begin, int64_t end)
     {
-        DWORD size = 0;
-        WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_CONTENT_LENGTH,
-                            WINHTTP_HEADER_NAME_BY_INDEX, nullptr, &size,
-                            WINHTTP_NO_HEADER_INDEX);
-        if (size > 0) {
-            std::wstring val(size / sizeof(wchar_t), 0);
-            WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_CONTENT_LENGTH,
-                                WINHTTP_HEADER_NAME_BY_INDEX, val.data(), &size,
-                                WINHTTP_NO_HEADER_INDEX);
-            try { return std::stoll(detail::to_utf8(val)); } catch (...) {}
+        try {
+            std::vector<char> buf(1024 * 1024);
+            bool have = first != nullptr || st.claim(plan, begin, end);
+            while (have) {
+                fetch_range(st, plan, file, std::move(first), begin, end, buf);
+                have = st.claim(plan, begin, end);
+            }
+        } catch (...) {
+            st.fail(std::current_exception());
         }
-        return -1;
+        std::lock_guard<std::mutex> lock(st.mu);
+        --st.running;
+        st.cv.notify_all();
     }
 
-    static std::string get_header(HINTERNET hRequest, const wchar_t* headerName)
+    /// 取回 [begin, end) 写入临时文件。连接错误或响应提前结束时从已写入处重新请求，共尝试 3 次；
+    /// 服务器拒绝区间或资源已变化 (If-Range 不匹配回 200) 时不重试
+    void fetch_range(SegmentState& st, const SegmentPlan& plan, detail::PositionalFile& file,
+                     std::unique_ptr<detail::HttpExchange> exchange, int64_t begin, int64_t end, std::vector<char>& buf)
     {
-        DWORD size = 0;
-        WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_CUSTOM, headerName, nullptr, &size, WINHTTP_NO_HEADER_INDEX);
-        if (GetLastError() == ERROR_INSUFFICIENT_BUFFER && size > 0) {
-            std::wstring val(size / sizeof(wchar_t), 0);
-            if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_CUSTOM, headerName, val.data(), &size, WINHTTP_NO_HEADER_INDEX))
-                return detail::to_utf8(val);
+        constexpr int kAttempts = 3;
+        int64_t pos = begin;
+        for (int attempt = 1; pos < end && !st.stopped.load(); ++attempt) {
+            std::string rejected;
+            try {
+                if (!exchange) {
+                    exchange = std::make_unique<detail::HttpExchange>(session_);
+                    exchange->open(range_spec(plan.parts, plan.headers, pos, end - 1, plan.validator));
+                    rejected = range_rejection(*exchange, plan, pos);
+                }
+                if (rejected.empty()) read_range(st, file, *exchange, pos, end, buf);
+            } catch (const std::runtime_error& ex) {
+                if (attempt >= kAttempts || st.stopped.load()) throw;
+                log(LogLevel::Warn, "Segment " + std::to_string(pos) + "-" + std::to_string(end - 1) + " retrying: " + ex.what());
+            }
+            exchange.reset();
+            if (!rejected.empty()) throw std::runtime_error(rejected);
+            if (pos < end && attempt >= kAttempts)
+                throw std::runtime_error("Download: range ended early at byte " + std::to_string(pos));
         }
-        return {};
     }
 
-    // ──────────────────── Cookie 辅助 ──────────────────────────────────
+    /// 区间响应是否可用，不可用时返回错误消息
+    static std::string range_rejection(const detail::HttpExchange& exchange, const SegmentPlan& plan, int64_t pos)
+    {
+        int status = exchange.statusCode();
+        if (status == 200)
+            return "Download: resource changed during segmented download (range request answered with 200)";
+        if (status != 206)
+            return "Download: range request failed: HTTP " + std::to_string(status) + " " + exchange.reasonPhrase();
+        int64_t first = 0, last = 0, total = -1;
+        if (!detail::parse_content_range(detail::find_header(exchange.headers(), "Content-Range"), first, last, total) || first != pos)
+            return "Download: unexpected Content-Range for byte " + std::to_string(pos);
+        if (total >= 0 && total != plan.total)
+            return "Download: resource changed during segmented download (length " + std::to_string(total) + ")";
+        return {};
+    }
 
-    std::string build_cookie_header(const std::string& host) const
+    /// 读取区间响应写入 file，按 1 MB 攒批写出；pos 推进到已写入的位置
+    static void read_range(SegmentState& st, detail::PositionalFile& file, detail::HttpExchange& exchange,
+                           int64_t& pos, int64_t end, std::vector<char>& buf)
     {
-        std::lock_guard<std::mutex> lock(mu_);
-        std::string out;
-        for (auto& c : cookies_) {
-            bool match = c.domain.empty() || host.find(c.domain) != std::string::npos || detail::iequals(c.domain, host);
-            if (match) {
-                if (!out.empty()) out += "; ";
-                out += c.name + "=" + c.value;
-            }
+        size_t filled = 0;
+        auto flush = [&]() {
+            file.writeAt((uint64_t)pos, buf.data(), filled);
+            pos += (int64_t)filled;
+            st.received += (int64_t)filled;
+            filled = 0;
+        };
+        while (!st.stopped.load()) {
+            size_t n = exchange.read(buf.data() + filled, buf.size() - filled);
+            if (n == 0) break;
+            if (pos + (int64_t)(filled + n) > end)
+                throw std::runtime_error("Download: server sent more than the requested range");
+            filled += n;
+            if (filled == buf.size()) flush();
         }
-        return out;
+        flush();
     }
 
-    void parse_set_cookies(HINTERNET hRequest, const std::string& host)
+    /// 无法分段时把已打开的整体响应顺序写入临时文件
+    static int64_t download_single(detail::HttpExchange& exchange, const std::string& tempFile, int64_t totalBytes,
+                                   const ProgressCallback& progress, CancelToken* cancel)
     {
-        DWORD index = 0;
-        while (true) {
-            DWORD size = 0;
-            WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_SET_COOKIE, WINHTTP_HEADER_NAME_BY_INDEX,
-                                nullptr, &size, &index);
-            if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || size == 0) break;
-
-            std::wstring val(size / sizeof(wchar_t), 0);
-            if (!WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_SET_COOKIE, WINHTTP_HEADER_NAME_BY_INDEX,
-                                     val.data(), &size, &index))
-                break;
+        std::ofstream ofs(tempFile, std::ios::binary);
+        if (!ofs)
+            throw std::runtime_error("Cannot create temp file: " + tempFile);
 
-            parse_single_set_cookie(detail::to_utf8(val), host);
+        char buf[81920];
+        size_t bytesRead = 0;
+        int64_t totalRead = 0;
+        while ((bytesRead = exchange.read(buf, sizeof(buf))) > 0) {
+            if (cancel && cancel->isCancelled()) throw std::runtime_error("Download cancelled");
+            ofs.write(buf, (std::streamsize)bytesRead);
+            totalRead += (int64_t)bytesRead;
+            if (progress) progress(totalRead, totalBytes);
         }
+        if (!ofs) throw std::runtime_error("Cannot write temp file: " + tempFile);
+        return totalRead;
     }
 
-    void parse_single_set_cookie(const std::string& setCookie, const std::string& defaultDomain)
+    detail::RequestSpec range_spec(const detail::UrlParts& parts, const Headers& headers,
+                                   int64_t first, int64_t last, const std::string& validator) const
     {
-        auto semiPos = setCookie.find(';');
-        auto nameVal = (semiPos != std::string::npos) ? setCookie.substr(0, semiPos) : setCookie;
-        auto eqPos = nameVal.find('=');
-        if (eqPos == std::string::npos) return;
+        Headers rangeHeaders = headers;
+        rangeHeaders["Range"] = "bytes=" + std::to_string(first) + "-" + std::to_string(last);
+        if (!validator.empty()) rangeHeaders["If-Range"] = validator;
+        return download_spec(parts, rangeHeaders);
+    }
 
-        Cookie c;
-        c.name  = nameVal.substr(0, eqPos);
-        c.value = nameVal.substr(eqPos + 1);
-        c.domain = defaultDomain;
-        c.path = "/";
-
-        auto rest = (semiPos != std::string::npos) ? setCookie.substr(semiPos + 1) : "";
-        std::istringstream iss(rest);
-        std::string attr;
-        while (std::getline(iss, attr, ';')) {
-            while (!attr.empty() && attr[0] == ' ') attr = attr.substr(1);
-            if (detail::iequals(attr, "secure")) c.secure = true;
-            else if (detail::iequals(attr, "httponly")) c.httpOnly = true;
-            else {
-                auto aEq = attr.find('=');
-                if (aEq != std::string::npos) {
-                    auto key = attr.substr(0, aEq);
-                    auto val = attr.substr(aEq + 1);
-                    if (detail::iequals(key, "domain")) c.domain = val;
-                    else if (detail::iequals(key, "path")) c.path = val;
-                }
-            }
+    /// 基础间隔 (服务器 retry: 优先) 按连续失败次数指数退避，封顶后加 ±jitter 随机浮动
+    static int sse_reconnect_delay(const SseReconnectOptions& options, int serverRetryMs, int failures)
+    {
+        double base  = serverRetryMs >= 0 ? serverRetryMs : options.initialDelayMs;
+        double delay = base;
+        for (int i = 1; i < failures && delay < options.maxDelayMs; ++i) delay *= std::max(1.0, options.backoffFactor);
+        delay = std::min(delay, std::max<double>(base, options.maxDelayMs));
+        if (options.jitter > 0) {
+            thread_local std::mt19937 rng(std::random_device{}());
+            double j = std::min(options.jitter, 1.0);
+            delay *= std::uniform_real_distribution<double>(1.0 - j, 1.0 + j)(rng);
         }
+        return (int)std::max(0.0, delay);
+    }
 
-        std::lock_guard<std::mutex> lock(mu_);
-        for (auto& existing : cookies_) {
-            if (detail::iequals(existing.name, c.name) && detail::iequals(existing.domain, c.domain)) {
-                existing.value = c.value;
-                existing.path = c.path;
-                existing.secure = c.secure;
-                existing.httpOnly = c.httpOnly;
-                return;
-            }
-        }
-        cookies_.push_back(c);
+    detail::RequestSpec sse_spec(const detail::UrlParts& parts, const Headers& headers) const
+    {
+        detail::RequestSpec spec;
+        spec.method = "GET";
+        spec.url = parts;
+        std::string extra = "Accept: text/event-stream\r\nCache-Control: no-cache\r\n";
+        auto cfg = config();
+        add_accept_encoding(*cfg, spec, headers, extra);
+        spec.headers = build_request_headers(*cfg, headers, parts, extra, false);
+        spec.ignoreSslErrors = ignoreSslErrors_.load();
+        spec.errorPrefix = "SSE: ";
+        return spec;
+    }
+
+    // ──────────────────── Cookie 辅助 ──────────────────────────────────
+
+    void parse_set_cookies(const detail::HeaderList& headers, const detail::UrlParts& url)
+    {
+        auto now = unix_now();
+        for (auto value : headers.getAll("Set-Cookie")) cookies_.setFromHeader(value, url, now);
     }
 
     static std::string extract_host(const std::string& url)
@@ -1920,6 +13553,7 @@ private:
     static void atomic_file_replace(const std::string& tempFile, const std::string& destPath)
     {
         namespace fs = std::filesystem;
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
         if (fs::exists(destPath)) {
             auto wTemp = detail::to_wide(tempFile);
             auto wDest = detail::to_wide(destPath);
@@ -1930,85 +13564,368 @@ private:
         } else {
             fs::rename(tempFile, destPath);
         }
+#else
+        fs::rename(tempFile, destPath);   // POSIX rename 原子替换
+#endif
     }
 
-    // ──────────────────── 请求队列 (无 detach, 安全析构) ──────────────
+    // ──────────────────── 请求队列 (固定线程池, 安全析构) ──────────────
 
-    void queue_worker()
+    bool submit_queued(const HttpRequest& req, std::function<void(HttpResponse)> callback, int timeoutMs)
     {
-        while (queueRunning_.load()) {
-            QueueEntry entry;
-            {
-                std::unique_lock<std::mutex> lock(queueMu_);
-                queueCv_.wait(lock, [this]() { return !queue_.empty() || !queueRunning_.load(); });
-                if (!queueRunning_.load() && queue_.empty()) break;
-                if (queue_.empty()) continue;
-                entry = std::move(queue_.front());
-                queue_.pop();
+        QueuedTask task = [this, req, callback = std::move(callback)]() {
+            HttpResponse resp;
+            try {
+                resp = send(req);
+            } catch (const std::exception& ex) {
+                log(LogLevel::Error, std::string("Queued request failed: ") + ex.what());
+                resp = HttpResponse();
+                resp.statusCode = -1;
+            } catch (...) {
+                resp = HttpResponse();
+                resp.statusCode = -1;
             }
+            if (callback) callback(std::move(resp));
+        };
 
-            // 等待并发槽位 (condition_variable, 不再 spin-wait)
-            {
-                std::unique_lock<std::mutex> lock(concurrencyMu_);
-                concurrencyCv_.wait(lock, [this]() { return activeTasks_.load() < maxConcurrent_; });
+        std::shared_ptr<detail::WorkerPool> pool;
+        {
+            std::lock_guard<std::mutex> lock(queueMu_);
+            if (!queuePool_) {
+                queueBacklog_.push_back(std::move(task));
+                return true;
             }
+            pool = queuePool_;
+        }
+        if (timeoutMs < 0 && pool->onWorkerThread()) {
+            pool->submitOrRun(std::move(task));
+            return true;
+        }
+        return pool->submit(std::move(task), timeoutMs);
+    }
+
+    void stop_queue()
+    {
+        std::shared_ptr<detail::WorkerPool> pool;
+        {
+            std::lock_guard<std::mutex> lock(queueMu_);
+            pool.swap(queuePool_);
+        }
+        // 执行完已入队的请求后 join 全部工作线程
+        if (pool) pool->stop();
+    }
+
+    // ──────────────────── 异步请求 (引擎回调 + 重试) ──────────────────
+
+    /// 一次 sendAsync 在各次重试之间共享的状态
+    struct AsyncState
+    {
+        detail::RequestSpec                         spec;     ///< body 指针由引擎在提交时设置
+        std::shared_ptr<const std::vector<uint8_t>> body;
+        CancelToken                                 cancel;
+        RetryPolicy                                 policy;
+        ResponseCallback                            callback;
+        int                                         attempt = 0;
+    };
+
+    std::shared_ptr<AsyncState> make_async_state(const HttpRequest& req, const CancelToken& cancel)
+    {
+        auto cfg = config();
+        auto state = std::make_shared<AsyncState>();
+        state->spec = make_request_spec(*cfg, req.method, req.url, req.body, req.bodyBytes, req.headers, req.query);
+        if (state->spec.encodedBody)  state->body = std::move(state->spec.encodedBody);
+        else if (!req.bodyBytes.empty())  state->body = std::make_shared<const std::vector<uint8_t>>(req.bodyBytes);
+        else if (!req.body.empty())  state->body = std::make_shared<const std::vector<uint8_t>>(req.body.begin(), req.body.end());
+        state->spec.body = nullptr;
+        state->spec.bodyLen = 0;
+        state->cancel = cancel;
+        state->policy = cfg->retryPolicy;
+        return state;
+    }
 
-            activeTasks_++;
+    detail::AsyncEngine& async_engine()
+    {
+        std::lock_guard<std::mutex> lock(asyncMu_);
+        if (asyncStopped_) throw std::runtime_error("Async engine stopped");
+        if (!asyncEngine_) asyncEngine_ = std::make_unique<detail::AsyncEngine>(session_);
+        return *asyncEngine_;
+    }
+
+    void submit_async(const std::shared_ptr<AsyncState>& state, int delayMs)
+    {
+        auto call = std::make_unique<detail::AsyncCall>();
+        call->spec    = state->spec;
+        call->body    = state->body;
+        call->cancel  = state->cancel;
+        call->delayMs = delayMs;
+        if (state->spec.decodeContent) {
+            attach_async_decoder(state, *call);
+        } else {
+            call->done = [this, state](detail::AsyncResult&& result, std::exception_ptr error) {
+                on_async_done(state, std::move(result), error);
+            };
+        }
+        try {
+            async_engine().submit(std::move(call));
+        } catch (const std::exception&) {
+            deliver_async(*state, HttpResponse(), std::current_exception());
+        }
+    }
 
-            // 用 joinable thread 代替 detach
-            auto worker = std::thread([this, entry = std::move(entry)]() mutable {
+    /// 声明了 Accept-Encoding 的异步请求: onHead 按响应头建立解码器，body 经 onBody 边收边解压，
+    /// 完成时放入 result.body (未压缩的响应同样经此追加，预分配与引擎自己缓存时一致)
+    void attach_async_decoder(const std::shared_ptr<AsyncState>& state, detail::AsyncCall& call)
+    {
+        struct Decode
+        {
+            std::unique_ptr<detail::ResponseDecoder> decoder;
+            std::vector<uint8_t>                     body;
+        };
+        auto decode = std::make_shared<Decode>();
+        call.onHead = [state, decode](int statusCode, const detail::HeaderList& headers) {
+            decode->decoder = detail::ResponseDecoder::create(state->spec, statusCode, headers);
+            int64_t length = detail::content_length_of(headers);
+            if (!decode->decoder && length > 0) decode->body.reserve((size_t)std::min<int64_t>(length, 64ll << 20));
+        };
+        call.onBody = [decode](const char* data, size_t len) {
+            auto& body = decode->body;
+            if (!decode->decoder) {
+                body.insert(body.end(), data, data + len);
+                return;
+            }
+            decode->decoder->push(data, len, [&](const char* out, size_t n) { body.insert(body.end(), out, out + n); });
+        };
+        call.done = [this, state, decode](detail::AsyncResult&& result, std::exception_ptr error) {
+            if (!error) {
                 try {
-                    auto resp = send(entry.request);
-                    if (entry.callback) entry.callback(std::move(resp));
-                } catch (...) {
-                    if (entry.callback) {
-                        HttpResponse errResp;
-                        errResp.statusCode = -1;
-                        entry.callback(std::move(errResp));
-                    }
+                    if (decode->decoder) decode->decoder->finish();
+                    result.body = std::move(decode->body);
+                } catch (const std::exception&) {
+                    error = std::current_exception();
                 }
-                activeTasks_--;
-                concurrencyCv_.notify_one();
-            });
+            }
+            on_async_done(state, std::move(result), error, decode->decoder.get());
+        };
+    }
+
+    void on_async_done(const std::shared_ptr<AsyncState>& state, detail::AsyncResult&& result, std::exception_ptr error,
+                       const detail::ResponseDecoder* decoder = nullptr)
+    {
+        const auto& policy = state->policy;
+        bool canRetry = state->attempt < policy.maxRetries && !state->cancel.isCancelled();
+        int delay = policy.baseDelayMs;
+        if (policy.exponentialBackoff) delay *= (1 << state->attempt);
+        std::string retryPrefix = "Retrying [" + std::to_string(state->attempt + 1) + "/" + std::to_string(policy.maxRetries)
+                                  + "] after " + std::to_string(delay) + "ms, ";
+
+        if (error) {
+            if (canRetry) {
+                std::string message = "unknown error";
+                try { std::rethrow_exception(error); } catch (const std::exception& ex) { message = ex.what(); } catch (...) {}
+                log(LogLevel::Warn, retryPrefix + "error: " + message);
+                ++state->attempt;
+                submit_async(state, delay);
+                return;
+            }
+            deliver_async(*state, HttpResponse(), error);
+            return;
+        }
+
+        if (autoManageCookies_.load())
+            parse_set_cookies(result.headers, state->spec.url);
+
+        if (canRetry && policy.shouldRetry && policy.shouldRetry(result.statusCode)) {
+            log(LogLevel::Warn, retryPrefix + "status=" + std::to_string(result.statusCode));
+            ++state->attempt;
+            submit_async(state, delay);
+            return;
+        }
+
+        auto resp = make_response(result.statusCode, result.reasonPhrase, result.headers, std::move(result.body));
+        resp.compression = state->spec.compression;
+        if (decoder) apply_decoded(resp, *decoder);
+        compressionCounters_.add(resp.compression);
+        log(LogLevel::Debug, "Response: " + std::to_string(resp.statusCode) + " " + resp.reasonPhrase);
+        invalidate_after(state->spec.method, state->spec.url, resp.statusCode);
+        deliver_async(*state, std::move(resp), nullptr);
+    }
+
+    /// 一次 sendBatch 的共享状态。origins[i] 为该 origin 尚未发出的请求下标
+    struct BatchState
+    {
+        std::mutex                               mu;
+        std::condition_variable                  cv;
+        std::vector<std::shared_ptr<AsyncState>> states;
+        std::vector<std::deque<size_t>>          origins;
+        std::vector<BatchResult>                 results;
+        size_t                                   remaining = 0;
+        CancelToken                              cancel;
+        std::chrono::steady_clock::time_point    deadline = std::chrono::steady_clock::time_point::max();
+        bool                                     deadlineHit = false;
+    };
 
-            // 追踪工作线程
+    /// 从 origin 队列取下一个请求发出；完成回调 (I/O 线程) 中再取同组下一个，形成一条连接上的串行车道
+    void launch_batch(const std::shared_ptr<BatchState>& batch, size_t origin)
+    {
+        using Clock = std::chrono::steady_clock;
+        while (true) {
+            size_t index;
+            bool expired;
             {
-                std::lock_guard<std::mutex> lock(workerMu_);
-                // 清理已完成的线程
-                workerThreads_.erase(
-                    std::remove_if(workerThreads_.begin(), workerThreads_.end(),
-                                   [](std::thread& t) {
-                                       if (t.joinable()) {
-                                           // 尝试快速 join (已完成的线程)
-                                           // 注意: std::thread 没有 try_join, 我们在 stop_queue 中统一 join
-                                           return false;
-                                       }
-                                       return true;
-                                   }),
-                    workerThreads_.end());
-                workerThreads_.push_back(std::move(worker));
+                std::lock_guard<std::mutex> lock(batch->mu);
+                auto& queue = batch->origins[origin];
+                if (queue.empty()) return;
+                index = queue.front();
+                queue.pop_front();
+                expired = batch->deadlineHit || Clock::now() >= batch->deadline;
+                if (expired) batch->deadlineHit = true;
+            }
+
+            auto state = batch->states[index];   // 副本: 同步完成时 finish_batch_item 会清空 states[index]
+            if (expired || batch->cancel.isCancelled()) {
+                finish_batch_item(*batch, index, HttpResponse(),
+                                  expired ? "Batch deadline exceeded" : "Request cancelled");
+                continue;
+            }
+
+            // 单个请求的超时不超过整批剩余时间
+            if (batch->deadline != Clock::time_point::max()) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(batch->deadline - Clock::now()).count();
+                int leftMs = (int)std::max<int64_t>(left, 1);
+                if (state->spec.timeoutMs <= 0 || state->spec.timeoutMs > leftMs) state->spec.timeoutMs = leftMs;
             }
+            // 提交失败时回调在 submit_async 内同步执行；此时由这里的循环接着发下一个，而不是在回调里递归，
+            // 否则整组请求同步失败时每项加深一层栈。0 = 提交中，1 = 提交期间已完成，2 = 提交已返回
+            auto handoff = std::make_shared<std::atomic<int>>(0);
+            state->callback = [this, batch, origin, index, handoff](HttpResponse resp, std::exception_ptr error) {
+                std::string message;
+                if (error) {
+                    message = "unknown error";
+                    try { std::rethrow_exception(error); } catch (const std::exception& ex) { message = ex.what(); } catch (...) {}
+                    std::lock_guard<std::mutex> lock(batch->mu);
+                    if (batch->deadlineHit) message = "Batch deadline exceeded";
+                }
+                finish_batch_item(*batch, index, std::move(resp), std::move(message));
+                int submitting = 0;
+                if (handoff->compare_exchange_strong(submitting, 1)) return;
+                launch_batch(batch, origin);
+            };
+            submit_async(state, 0);
+            int submitting = 0;
+            if (handoff->compare_exchange_strong(submitting, 2)) return;
         }
     }
 
-    void stop_queue()
+    static void finish_batch_item(BatchState& batch, size_t index, HttpResponse resp, std::string error)
+    {
+        std::lock_guard<std::mutex> lock(batch.mu);
+        batch.results[index].response = std::move(resp);
+        batch.results[index].error    = std::move(error);
+        batch.states[index].reset();   // 释放请求体
+        if (--batch.remaining == 0) batch.cv.notify_all();
+    }
+
+    void deliver_async(AsyncState& state, HttpResponse resp, std::exception_ptr error)
     {
-        if (!queueRunning_.load()) return;
-        queueRunning_.store(false);
-        queueCv_.notify_all();
+        if (!state.callback) return;
+        try {
+            state.callback(std::move(resp), error);
+        } catch (const std::exception& ex) {
+            log(LogLevel::Error, std::string("Async callback threw: ") + ex.what());
+        } catch (...) {}
+    }
+
+    void stop_async()
+    {
+        std::unique_ptr<detail::AsyncEngine> engine;
+        {
+            std::lock_guard<std::mutex> lock(asyncMu_);
+            asyncStopped_ = true;
+            engine.swap(asyncEngine_);
+        }
+        // 未完成的请求以 "Async engine stopped" 结束并回调
+        if (engine) engine->stop();
+    }
 
-        if (queueThread_.joinable())
-            queueThread_.join();
+#if defined(DRX_HTTP_HAS_COROUTINES)
+    /// downloadFileAsync 的实现: body 经 AsyncCall::onBody 直接写入临时文件
+    void start_download_async(const std::string& url, const std::string& destPath,
+                              const Headers& headers, const QueryParams& query,
+                              ProgressCallback progress, CancelToken cancel,
+                              std::function<void(DownloadResult, std::exception_ptr)> complete)
+    {
+        namespace fs = std::filesystem;
 
-        // 等待所有工作线程完成
+        struct Download
         {
-            std::lock_guard<std::mutex> lock(workerMu_);
-            for (auto& t : workerThreads_) {
-                if (t.joinable()) t.join();
+            std::ofstream    file;
+            std::string      tempFile;
+            DownloadResult   result;
+            ProgressCallback progress;
+        };
+        auto dl = std::make_shared<Download>();
+        dl->tempFile = destPath + ".download.tmp";
+        dl->progress = std::move(progress);
+
+        try {
+            auto parts = detail::parse_url(detail::resolve_url(baseAddress_, detail::build_url(url, query)));
+
+            auto dir = fs::path(destPath).parent_path();
+            if (!dir.empty()) fs::create_directories(dir);
+            dl->file.open(dl->tempFile, std::ios::binary);
+            if (!dl->file)
+                throw std::runtime_error("Cannot create temp file: " + dl->tempFile);
+
+            auto call = std::make_unique<detail::AsyncCall>();
+            call->spec   = download_spec(parts, headers);
+            call->cancel = cancel;
+            call->onHead = [dl](int statusCode, const detail::HeaderList& head) {
+                auto& result = dl->result;
+                result.statusCode  = statusCode;
+                result.totalBytes  = detail::content_length_of(head);
+                result.contentType = detail::find_header(head, "Content-Type");
+                result.etag        = detail::find_header(head, "ETag");
+                auto meta = detail::find_header(head, "X-MetaData");
+                if (!meta.empty()) result.serverMetadata["X-MetaData"] = meta;
+            };
+            call->onBody = [dl](const char* data, size_t len) {
+                dl->file.write(data, (std::streamsize)len);
+                if (!dl->file) throw std::runtime_error("Cannot write temp file: " + dl->tempFile);
+                dl->result.downloadedBytes += (int64_t)len;
+                if (dl->progress) dl->progress(dl->result.downloadedBytes, dl->result.totalBytes);
+            };
+            call->done = [this, dl, url, destPath, origin = parts, complete](detail::AsyncResult&& result, std::exception_ptr error) {
+                dl->file.close();
+                if (!error) {
+                    try {
+                        if (autoManageCookies_.load()) parse_set_cookies(result.headers, origin);
+                        atomic_file_replace(dl->tempFile, destPath);
+                        dl->result.savedFilePath = destPath;
+                        dl->result.fileName = fs::path(destPath).filename().string();
+                        log(LogLevel::Info, "Downloaded: " + url + " -> " + destPath);
+                    } catch (const std::exception&) {
+                        error = std::current_exception();
+                    }
+                }
+                if (error) {
+                    std::error_code ec;
+                    fs::remove(dl->tempFile, ec);
+                    complete(DownloadResult(), error);
+                    return;
+                }
+                complete(std::move(dl->result), nullptr);
+            };
+            async_engine().submit(std::move(call));
+        } catch (const std::exception&) {
+            if (dl->file.is_open()) {
+                dl->file.close();
+                std::error_code ec;
+                fs::remove(dl->tempFile, ec);
             }
-            workerThreads_.clear();
+            complete(DownloadResult(), std::current_exception());
         }
     }
+#endif
 };
 
 }}}} // namespace drx::sdk::network::http
@@ -2034,6 +13951,7 @@ namespace drx { namespace sdk { namespace network { namespace http {
 ///   }
 inline void setupConsoleUtf8()
 {
+#if defined(DRX_HTTP_BACKEND_WINHTTP)
     // 设置控制台输入/输出 codepage 为 UTF-8
     SetConsoleCP(CP_UTF8);
     SetConsoleOutputCP(CP_UTF8);
@@ -2043,6 +13961,9 @@ inline void setupConsoleUtf8()
     
     // 可选：也配置 stderr
     _setmode(_fileno(stderr), _O_U8TEXT);
+#else
+    // Linux 终端默认即为 UTF-8，无需配置
+#endif
 }
 
 }}}} // namespace drx::sdk::network::http